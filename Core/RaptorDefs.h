@@ -31,6 +31,7 @@ namespace Raptor
 			RECONNECT = 'Rejn',
 			
 			INFO = 'Info',
+			INFO_QUERY = 'Inf?',
 			CHANGE_STATE = 'Mode',
 			
 			UPDATE = 'Updt',
@@ -38,11 +39,18 @@ namespace Raptor
 			OBJECTS_ADD = 'Obj+',
 			OBJECTS_REMOVE = 'Obj-',
 			OBJECTS_CLEAR = 'ObjC',
+			SYNC_PROGRESS = 'Sync',
 			
 			PLAYER_LIST = 'Plrs',
 			PLAYER_ADD = 'Plr+',
 			PLAYER_REMOVE = 'Plr-',
 			PLAYER_PROPERTIES = 'PlrP',
+			PROPERTY_DELTA = 'PrpD',
+			
+			SHARD_HELLO = 'ShHi',
+			SHARD_HANDOFF = 'ShHo',
+			SHARD_GHOSTS = 'ShGh',
+			SHARD_REDIRECT = 'ShRd',
 			
 			PING = 'Ping',
 			PONG = 'Pong',
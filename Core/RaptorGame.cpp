@@ -34,6 +34,23 @@ RaptorGame::RaptorGame( std::string game, std::string version, RaptorServer *ser
 	FrameTime = 0.;
 	State = Raptor::State::DISCONNECTED;
 	PlayerID = 0;
+	SyncProgress = 0.;
+	
+	// These are decoded into messages by the network thread, so the main thread only applies them.
+	Handlers.RegisterOffThread( &RaptorGame::ProcessUpdate, &RaptorGame::DecodeUpdate );
+	Handlers.Register( &RaptorGame::ProcessObjectsAdd );
+	Handlers.Register( &RaptorGame::ProcessObjectsRemove );
+	Handlers.Register( &RaptorGame::ProcessObjectsClear );
+	Handlers.Register( &RaptorGame::ProcessSyncProgress );
+	Handlers.Register( &RaptorGame::ProcessPlayerAdd );
+	Handlers.Register( &RaptorGame::ProcessPlayerRemove );
+	Handlers.RegisterOffThread( &RaptorGame::ProcessPlayerProperties );
+	Handlers.Register( &RaptorGame::ProcessPlayerList );
+	Handlers.RegisterOffThread( &RaptorGame::ProcessInfo );
+	Handlers.RegisterOffThread( &RaptorGame::ProcessPropertyDelta );
+	Handlers.Register( &RaptorGame::ProcessMessage );
+	Handlers.Register( &RaptorGame::ProcessPlaySound );
+	Handlers.Register( &RaptorGame::ProcessPlayMusic );
 }
 
 
@@ -75,6 +92,9 @@ void RaptorGame::Initialize( int argc, char **argv )
 	// Check for command-line options.
 	
 	char *connect = NULL;
+	char *replay = NULL;
+	char *demo = NULL;
+	bool timedemo = false;
 	bool host = false;
 	bool screensaver = false;
 	
@@ -105,6 +125,17 @@ void RaptorGame::Initialize( int argc, char **argv )
 			connect = argv[ i + 1 ];
 			i ++;
 		}
+		else if( (i + 1 < argc) && (strcmp( argv[ i ], "-replay" ) == 0) )
+		{
+			replay = argv[ i + 1 ];
+			i ++;
+		}
+		else if( (i + 1 < argc) && ((strcmp( argv[ i ], "-demo" ) == 0) || (strcmp( argv[ i ], "-timedemo" ) == 0)) )
+		{
+			timedemo = (strcmp( argv[ i ], "-timedemo" ) == 0);
+			demo = argv[ i + 1 ];
+			i ++;
+		}
 		else if( strcmp( argv[ i ], "-host" ) == 0 )
 		{
 			host = true;
@@ -134,6 +165,23 @@ void RaptorGame::Initialize( int argc, char **argv )
 	}
 	
 	
+	// Server journals are replayed headless, so don't bother initializing anything else.
+	
+	if( replay )
+	{
+		if( Server )
+		{
+			Server->NetRate = Cfg.SettingAsDouble( "sv_netrate", 30. );
+			printf( "%s\n", Server->ReplayJournal( replay ).c_str() );
+		}
+		else
+			printf( "No server to replay journal: %s\n", replay );
+		
+		Quit();
+		return;
+	}
+	
+	
 	// Initialize SDL and subsystems.
 	
 	Gfx.Initialize();
@@ -178,6 +226,8 @@ void RaptorGame::Initialize( int argc, char **argv )
 		Net.Connect( connect, Cfg.Settings[ "name" ].c_str(), Cfg.Settings[ "password" ].c_str() );
 	if( host )
 		Host();
+	if( demo )
+		PlayDemo( demo, 1., timedemo ? (1. / 60.) : 0. );
 	if( screensaver )
 	{
 		if( Server )
@@ -204,6 +254,15 @@ void RaptorGame::Run( void )
 			FrameTime = GameClock.ElapsedSeconds();
 			GameClock.Reset();
 			
+			// Demo playback stands in for the server, and can run faster or slower than real time.
+			if( DemoPlay.IsOpen() )
+			{
+				FrameTime = DemoPlay.Advance( FrameTime );
+				PlayDemoPackets();
+			}
+			else if( DemoRecord.KeyframeDue() )
+				RecordKeyframe();
+			
 			// Keep the list of joysticks up-to-date.
 			Joy.FindJoysticks();
 			
@@ -260,6 +319,10 @@ void RaptorGame::Run( void )
 			if( (Net.ReconnectTime > 0) && (Net.ReconnectClock.ElapsedSeconds() > Net.ReconnectTime) )
 				Net.Reconnect( Cfg.SettingAsString("name").c_str(), Cfg.SettingAsString("password").c_str() );
 			
+			// If a sharded server handed us to a neighbour, connect there once the old connection is done.
+			if( Net.Redirecting )
+				Net.FollowRedirect( Cfg.SettingAsString("name").c_str() );
+			
 			// Draw to all viewports.
 			bool vr_enable = Cfg.SettingAsBool("vr_enable");
 			if( vr_enable && ! Head.Initialized )
@@ -320,6 +383,9 @@ void RaptorGame::Run( void )
 		SDL_Delay( 1 );
 	}
 	
+	// Finish writing any demo being recorded.
+	StopDemo();
+	
 	// Save our settings.
 	if( ! Cfg.SettingAsBool("screensaver") )
 		Cfg.Save( "settings.cfg" );
@@ -375,229 +441,188 @@ bool RaptorGame::HandleCommand( std::string cmd, std::vector<std::string> *eleme
 
 bool RaptorGame::ProcessPacket( Packet *packet )
 {
-	packet->Rewind();
-	PacketType type = packet->Type();
-	
-	if( type == Raptor::Packet::UPDATE )
+	return Handlers.Dispatch( this, packet );
+}
+
+
+bool RaptorGame::DecodeUpdate( UpdateMessage *msg, Packet *packet )
+{
+	return Data.DecodeUpdate( msg, packet, true );
+}
+
+
+bool RaptorGame::ProcessUpdate( UpdateMessage *msg, Packet *packet )
+{
+	if( ! Data.ApplyUpdateFromServer( msg, packet ) )
 	{
-		// First read the precision of the update.
-		int8_t precision = packet->NextChar();
-		
-		// Then read the number of objects.
-		uint32_t obj_count = packet->NextUInt();
-		
-		// Loop through for each object's update data.
-		while( obj_count )
-		{
-			obj_count --;
-			
-			// First read the ID.
-			uint32_t obj_id = packet->NextUInt();
-			
-			// Look up the ID in the client-side list of objects and update it.
-			std::map<uint32_t,GameObject*>::iterator obj_iter = Data.GameObjects.find( obj_id );
-			if( obj_iter != Data.GameObjects.end() )
-				obj_iter->second->ReadFromUpdatePacketFromServer( packet, precision );
-			else
-			{
-				// The server thinks we should have this object, so we're out of sync!
-				// This means the rest of the update packet could be misaligned, so stop trying to parse it.
-				Console.Print( "Sync error: UPDATE", TextConsole::MSG_ERROR );
-				return true;
-			}
-		}
-		
-		return true;
+		// The server thinks we should have an object we don't, so we're out of sync!
+		Console.Print( "Sync error: UPDATE", TextConsole::MSG_ERROR );
 	}
 	
-	else if( type == Raptor::Packet::OBJECTS_ADD )
+	return true;
+}
+
+
+bool RaptorGame::ProcessObjectsAdd( ObjectsAddMessage *msg, Packet *packet )
+{
+	// Loop through for each object's initialization data.
+	uint32_t obj_count = msg->ObjectCount;
+	while( obj_count )
 	{
-		// First read the number of objects being added.
-		uint32_t obj_count = packet->NextUInt();
+		obj_count --;
 		
-		// Loop through for each object's initialization data.
-		while( obj_count )
-		{
-			obj_count --;
-			
-			uint32_t id = packet->NextUInt();
-			uint32_t type = packet->NextUInt();
-			GameObject *obj = NewObject( id, type );
-			Data.AddObject( obj );
-			obj->ReadFromInitPacket( packet );
-			AddedObject( obj );
-		}
-		
-		return true;
+		uint32_t id = packet->NextUInt();
+		uint32_t type = packet->NextUInt();
+		GameObject *obj = NewObject( id, type );
+		Data.AddObject( obj );
+		obj->ReadFromInitPacket( packet );
+		AddedObject( obj );
 	}
 	
-	else if( type == Raptor::Packet::OBJECTS_REMOVE )
-	{
-		// First read the number of objects being removed.
-		uint32_t obj_count = packet->NextUInt();
-		
-		// Loop through for each object's ID and remove them.
-		while( obj_count )
-		{
-			obj_count --;
-			
-			uint32_t id = packet->NextUInt();
-			Data.RemoveObject( id );
-		}
-		
-		return true;
-	}
+	return true;
+}
+
+
+bool RaptorGame::ProcessObjectsRemove( ObjectsRemoveMessage *msg, Packet *packet )
+{
+	for( PacketList<uint32_t,uint32_t>::iterator id_iter = msg->ObjectIDs.begin(); id_iter != msg->ObjectIDs.end(); id_iter ++ )
+		Data.RemoveObject( *id_iter );
 	
-	else if( type == Raptor::Packet::OBJECTS_CLEAR )
-	{
-		Data.ClearObjects();
-		
-		return true;
-	}
+	return true;
+}
+
+
+bool RaptorGame::ProcessObjectsClear( ObjectsClearMessage *msg, Packet *packet )
+{
+	Data.ClearObjects();
 	
-	else if( type == Raptor::Packet::PLAYER_ADD )
-	{
-		uint16_t id = packet->NextUShort();
-		char *name = packet->NextString();
-		
-		Player *player = NewPlayer( id );
-		player->Name = name;
-		Data.AddPlayer( player );
-		
-		return true;
-	}
+	return true;
+}
+
+
+bool RaptorGame::ProcessSyncProgress( SyncProgressMessage *msg, Packet *packet )
+{
+	// The server streams existing objects in chunks after we join.
+	SyncProgress = msg->Total ? (msg->Sent / (double) msg->Total) : 1.;
 	
-	else if( type == Raptor::Packet::PLAYER_REMOVE )
-	{
-		uint16_t id = packet->NextUShort();
-		Data.RemovePlayer( id );
-		
-		return true;
-	}
+	return true;
+}
+
+
+bool RaptorGame::ProcessPlayerAdd( PlayerAddMessage *msg, Packet *packet )
+{
+	Player *player = NewPlayer( msg->PlayerID );
+	player->Name = msg->Name;
+	Data.AddPlayer( player );
+	
+	return true;
+}
+
+
+bool RaptorGame::ProcessPlayerRemove( PlayerRemoveMessage *msg, Packet *packet )
+{
+	Data.RemovePlayer( msg->PlayerID );
 	
-	else if( type == Raptor::Packet::PLAYER_PROPERTIES )
+	return true;
+}
+
+
+bool RaptorGame::ProcessPlayerProperties( PlayerPropertiesMessage *msg, Packet *packet )
+{
+	Player *player = Data.GetPlayer( msg->PlayerID );
+	if( ! player )
 	{
-		// Read the player ID and look them up.
-		uint16_t id = packet->NextUShort();
-		Player *player = Data.GetPlayer( id );
-		
-		// First read the number of properties.
-		uint32_t property_count = packet->NextUInt();
-		
-		// Loop through for each property being changed.
-		while( property_count )
-		{
-			property_count --;
-			
-			std::string property_name = packet->NextString();
-			std::string property_value = packet->NextString();
-			
-			if( player )
-			{
-				if( property_name == "name" )
-					player->Name = property_value;
-				else
-					player->Properties[ property_name ] = property_value;
-			}
-			else
-			{
-				// The server thinks we should have this player, so we're out of sync!
-				Console.Print( "Sync error: PLAYER_PROPERTIES", TextConsole::MSG_ERROR );
-			}
-		}
-		
+		// The server thinks we should have this player, so we're out of sync!
+		Console.Print( "Sync error: PLAYER_PROPERTIES", TextConsole::MSG_ERROR );
 		return true;
 	}
 	
-	else if( type == Raptor::Packet::PLAYER_LIST )
+	for( PacketList<uint32_t,PacketProperty>::iterator property_iter = msg->Properties.begin(); property_iter != msg->Properties.end(); property_iter ++ )
 	{
-		// First read the number of players.
-		uint16_t obj_count = packet->NextUShort();
-		
-		// Loop through for each player's data.
-		while( obj_count )
-		{
-			obj_count --;
-			
-			uint16_t id = packet->NextUShort();
-			char *name = packet->NextString();
-			
-			Player *player = NULL;
-			std::map<uint16_t,Player*>::iterator player_iter = Data.Players.find( id );
-			if( player_iter != Data.Players.end() )
-				player = player_iter->second;
-			
-			if( ! player )
-			{
-				player = NewPlayer( id );
-				Data.AddPlayer( player );
-			}
-			
-			player->Name = name ? name : "?";
-		}
-		
-		return true;
+		if( property_iter->Name == "name" )
+			player->Name = property_iter->Value;
+		else
+			player->Properties.Set( property_iter->Name, property_iter->Value );
 	}
 	
-	else if( type == Raptor::Packet::INFO )
+	return true;
+}
+
+
+bool RaptorGame::ProcessPlayerList( PlayerListMessage *msg, Packet *packet )
+{
+	for( PacketList<uint16_t,PlayerListEntry>::iterator entry_iter = msg->Players.begin(); entry_iter != msg->Players.end(); entry_iter ++ )
 	{
-		// First read the number of properties.
-		uint16_t property_count = packet->NextUShort();
+		Player *player = NULL;
+		std::map<uint16_t,Player*>::iterator player_iter = Data.Players.find( entry_iter->ID );
+		if( player_iter != Data.Players.end() )
+			player = player_iter->second;
 		
-		// Loop through for each name/value pair.
-		for( int i = 0; i < property_count; i ++ )
+		if( ! player )
 		{
-			std::string name = packet->NextString();
-			std::string value = packet->NextString();
-			
-			Data.Properties[ name ] = value;
+			player = NewPlayer( entry_iter->ID );
+			Data.AddPlayer( player );
 		}
 		
-		return true;
+		player->Name = entry_iter->Name;
 	}
 	
-	else if( type == Raptor::Packet::MESSAGE )
-	{
-		std::string message = packet->NextString();
-		uint32_t msg_type = 0;
-		if( packet->Remaining() )
-			msg_type = packet->NextUInt();
-		Raptor::Game->Console.Print( message, msg_type );
-		Raptor::Game->Msg.Print( message, msg_type );
-	}
+	return true;
+}
+
+
+bool RaptorGame::ProcessInfo( InfoMessage *msg, Packet *packet )
+{
+	for( PacketList<uint16_t,PacketProperty>::iterator property_iter = msg->Properties.begin(); property_iter != msg->Properties.end(); property_iter ++ )
+		Data.SetProperty( property_iter->Name, property_iter->Value );
 	
-	else if( type == Raptor::Packet::PLAY_SOUND )
+	return true;
+}
+
+
+bool RaptorGame::ProcessPropertyDelta( PropertyDeltaMessage *msg, Packet *packet )
+{
+	if( ! Data.ApplyPropertyDelta( msg ) )
 	{
-		Mix_Chunk *sound = Res.GetSound( packet->NextString() );
-		float music_volume = 1.f;
-		float sound_volume = 1.f;
-		
-		if( packet->Remaining() )
-			music_volume = Num::UnitFloatFrom8( packet->NextChar() );
-		if( packet->Remaining() )
-			sound_volume = Num::UnitFloatFrom8( packet->NextChar() );
-		
-		if( sound )
-		{
-			int channel = Snd.Play( sound );
-			Snd.AttenuateFor = channel;
-			Snd.SoundAttenuate = sound_volume;
-			Snd.MusicAttenuate = music_volume;
-		}
-		
-		return true;
+		// The server thinks we should have a player we don't, so we're out of sync!
+		Console.Print( "Sync error: PROPERTY_DELTA", TextConsole::MSG_ERROR );
 	}
 	
-	else if( type == Raptor::Packet::PLAY_MUSIC )
+	return true;
+}
+
+
+bool RaptorGame::ProcessMessage( TextMessage *msg, Packet *packet )
+{
+	Console.Print( msg->Text, msg->MsgType );
+	Msg.Print( msg->Text, msg->MsgType );
+	
+	return false;
+}
+
+
+bool RaptorGame::ProcessPlaySound( PlaySoundMessage *msg, Packet *packet )
+{
+	Mix_Chunk *sound = Res.GetSound( msg->Sound );
+	if( sound )
 	{
-		Mix_Music *music = Res.GetMusic( packet->NextString() );
-		if( music )
-			Snd.PlayMusicOnce( music );
-		
-		return true;
+		int channel = Snd.Play( sound );
+		Snd.AttenuateFor = channel;
+		Snd.SoundAttenuate = Num::UnitFloatFrom8( msg->SoundVolume );
+		Snd.MusicAttenuate = Num::UnitFloatFrom8( msg->MusicVolume );
 	}
 	
-	return false;
+	return true;
+}
+
+
+bool RaptorGame::ProcessPlayMusic( PlayMusicMessage *msg, Packet *packet )
+{
+	Mix_Music *music = Res.GetMusic( msg->Music );
+	if( music )
+		Snd.PlayMusicOnce( music );
+	
+	return true;
 }
 
 
@@ -642,6 +667,209 @@ void RaptorGame::SendUpdate( int8_t precision )
 }
 
 
+// ---------------------------------------------------------------------------
+
+
+bool RaptorGame::RecordDemo( std::string filename )
+{
+	if( DemoPlay.IsOpen() )
+	{
+		Console.Print( "Can't record while playing a demo.", TextConsole::MSG_ERROR );
+		return false;
+	}
+	
+	StopDemo();
+	
+	if( ! DemoRecord.Open( filename, Game, Version, Cfg.SettingAsDouble( "cl_demo_keyframe", 10. ) ) )
+	{
+		Console.Print( "Could not write demo: " + filename, TextConsole::MSG_ERROR );
+		return false;
+	}
+	
+	// Start with a keyframe so playback doesn't depend on anything received before recording.
+	RecordKeyframe();
+	
+	Console.Print( "Recording demo: " + filename );
+	return true;
+}
+
+
+void RaptorGame::RecordKeyframe( void )
+{
+	// Describe everything the server has told us the same way it would tell a player joining now.
+	// Properties use the server's IDs, so PROPERTY_DELTA packets recorded after this still make sense.
+	std::vector<Packet*> packets;
+	
+	PlayerListMessage player_list_msg;
+	for( std::map<uint16_t,Player*>::iterator player_iter = Data.Players.begin(); player_iter != Data.Players.end(); player_iter ++ )
+		player_list_msg.Players.push_back( PlayerListEntry( player_iter->second->ID, player_iter->second->Name ) );
+	packets.push_back( new Packet() );
+	EncodePacket( packets.back(), &player_list_msg );
+	
+	PropertyDeltaMessage properties_msg;
+	std::map<uint16_t,uint16_t> server_keys;
+	for( std::map<uint16_t,uint16_t>::iterator key_iter = Data.RemotePropertyKeys.begin(); key_iter != Data.RemotePropertyKeys.end(); key_iter ++ )
+	{
+		server_keys[ key_iter->second ] = key_iter->first;
+		properties_msg.Keys.push_back( PropertyKeyDef( key_iter->first, Data.PropertyKeyIDs.Name( key_iter->second ) ) );
+	}
+	std::vector< std::pair<uint16_t,const PropertyStore*> > stores;
+	stores.push_back( std::pair<uint16_t,const PropertyStore*>( 0, &(Data.Properties) ) );
+	for( std::map<uint16_t,Player*>::iterator player_iter = Data.Players.begin(); player_iter != Data.Players.end(); player_iter ++ )
+		stores.push_back( std::pair<uint16_t,const PropertyStore*>( player_iter->first, &(player_iter->second->Properties) ) );
+	for( std::vector< std::pair<uint16_t,const PropertyStore*> >::iterator store_iter = stores.begin(); store_iter != stores.end(); store_iter ++ )
+	{
+		PropertyStoreDelta delta( store_iter->first );
+		for( std::map<uint16_t,PropertyValue>::const_iterator value_iter = store_iter->second->Values.begin(); value_iter != store_iter->second->Values.end(); value_iter ++ )
+		{
+			std::map<uint16_t,uint16_t>::iterator key_iter = server_keys.find( value_iter->first );
+			if( key_iter != server_keys.end() )
+				delta.Changes.push_back( PropertyChange( key_iter->second, value_iter->second.Version, value_iter->second.Value ) );
+		}
+		if( delta.Changes.size() )
+			properties_msg.Stores.push_back( delta );
+	}
+	packets.push_back( new Packet() );
+	EncodePacket( packets.back(), &properties_msg );
+	
+	// Client-side objects aren't from the server, so they will be recreated by whatever made them.
+	std::vector<GameObject*> objects;
+	for( std::map<uint32_t,GameObject*>::iterator obj_iter = Data.GameObjects.begin(); obj_iter != Data.GameObjects.end(); obj_iter ++ )
+	{
+		if( obj_iter->first < Data.GameObjectIDs.Initial )
+			objects.push_back( obj_iter->second );
+	}
+	ObjectsAddMessage add_msg;
+	add_msg.ObjectCount = objects.size();
+	packets.push_back( new Packet() );
+	EncodePacket( packets.back(), &add_msg );
+	for( std::vector<GameObject*>::iterator obj_iter = objects.begin(); obj_iter != objects.end(); obj_iter ++ )
+	{
+		packets.back()->AddUInt( (*obj_iter)->ID );
+		packets.back()->AddUInt( (*obj_iter)->Type() );
+		(*obj_iter)->AddToInitPacket( packets.back() );
+	}
+	
+	DemoRecord.RecordKeyframe( State, PlayerID, &packets );
+	
+	for( std::vector<Packet*>::iterator packet_iter = packets.begin(); packet_iter != packets.end(); packet_iter ++ )
+		delete *packet_iter;
+}
+
+
+bool RaptorGame::PlayDemo( std::string filename, double speed, double fixed_step )
+{
+	StopDemo();
+	
+	if( ! DemoPlay.Open( filename ) )
+	{
+		Console.Print( "Could not read demo: " + filename, TextConsole::MSG_ERROR );
+		return false;
+	}
+	if( DemoPlay.Header.Game != Game )
+	{
+		Console.Print( filename + " was recorded by " + DemoPlay.Header.Game + ", not " + Game + ".", TextConsole::MSG_ERROR );
+		DemoPlay.Close();
+		return false;
+	}
+	
+	// Playback replaces the server, so leave any game in progress.
+	if( Net.Connected )
+		Net.DisconnectNice();
+	
+	DemoPlay.Speed = speed;
+	DemoPlay.FixedStep = fixed_step;
+	SeekDemo( 0. );
+	return true;
+}
+
+
+void RaptorGame::SeekDemo( double time )
+{
+	if( ! DemoPlay.IsOpen() )
+		return;
+	
+	// Rebuild from the nearest keyframe before the requested time.
+	Packet *keyframe = DemoPlay.Seek( time );
+	DemoKeyframe keyframe_msg;
+	if( keyframe && DecodePacket( keyframe, &keyframe_msg ) )
+	{
+		Data.Clear();
+		PlayerID = keyframe_msg.PlayerID;
+		
+		while( Packet *packet = DemoPlayer::NextKeyframePacket( keyframe ) )
+		{
+			ProcessDemoPacket( packet );
+			delete packet;
+		}
+		
+		if( State != keyframe_msg.State )
+			ChangeState( keyframe_msg.State );
+	}
+	delete keyframe;
+	
+	// Then catch up to it without drawing anything in between.
+	PlayDemoPackets();
+}
+
+
+void RaptorGame::PlayDemoPackets( void )
+{
+	while( Packet *packet = DemoPlay.NextDue() )
+	{
+		ProcessDemoPacket( packet );
+		delete packet;
+	}
+	
+	if( DemoPlay.Finished )
+		StopDemo();
+}
+
+
+void RaptorGame::ProcessDemoPacket( Packet *packet )
+{
+	// Decode as the network thread would have, then handle it like NetClient::ProcessPacket.
+	Handlers.Predecode( this, packet );
+	if( ProcessPacket( packet ) )
+		return;
+	
+	// Of the packets NetClient handles itself, only these change what playback should show.
+	if( packet->Type() == ChangeStateMessage::TYPE )
+	{
+		ChangeStateMessage state_msg;
+		if( DecodePacket( packet, &state_msg ) )
+			ChangeState( state_msg.State );
+	}
+	else if( packet->Type() == LoginAcceptMessage::TYPE )
+	{
+		LoginAcceptMessage login_msg;
+		if( DecodePacket( packet, &login_msg ) )
+			PlayerID = login_msg.PlayerID;
+	}
+}
+
+
+void RaptorGame::StopDemo( void )
+{
+	if( DemoRecord.IsOpen() )
+	{
+		DemoRecord.Close();
+		Console.Print( "Finished recording demo: " + DemoRecord.Filename );
+	}
+	
+	if( DemoPlay.IsOpen() )
+	{
+		double seconds = DemoPlay.PlayClock.ElapsedSeconds();
+		char cstr[ 1024 ] = "";
+		snprintf( cstr, 1024, "Demo %s: %i frames in %.2f seconds (%.1f fps).", DemoPlay.Finished ? "finished" : "stopped", DemoPlay.Frames, seconds, (seconds > 0.) ? (DemoPlay.Frames / seconds) : 0. );
+		Console.Print( cstr );
+		
+		DemoPlay.Close();
+		ChangeState( Raptor::State::DISCONNECTED );
+	}
+}
+
+
 void RaptorGame::ChangeState( int state )
 {
 	State = state;
@@ -650,6 +878,7 @@ void RaptorGame::ChangeState( int state )
 	{
 		// Clear all game data.
 		Data.Clear();
+		SyncProgress = 0.;
 		
 		// Clear the message list, since it's session-specific; copies remain in the console.
 		Raptor::Game->Msg.Clear();
@@ -669,7 +898,14 @@ void RaptorGame::RemovedObject( GameObject *obj )
 
 GameObject *RaptorGame::NewObject( uint32_t id, uint32_t type )
 {
-	return new GameObject( id, type );
+	GameObject *obj = new( &Data ) GameObject( id, type );
+	
+	// Plain GameObjects send nothing beyond the standard update layout, and only move in Update.
+	obj->StandardLayout = true;
+	obj->SleepsAtRest = true;
+	obj->UpdatesInParallel = true;
+	
+	return obj;
 }
 
 
@@ -690,10 +926,19 @@ void RaptorGame::Host( void )
 	if( Server )
 	{
 		Server->Port = Cfg.SettingAsInt( "sv_port", 7000 );
+		Server->QueryPort = Cfg.SettingAsInt( "sv_query_port", -1 );
 		Server->MaxFPS = Cfg.SettingAsDouble( "sv_maxfps", 60. );
 		Server->NetRate = Cfg.SettingAsDouble( "sv_netrate", 30. );
+		Server->UpdateKeepAlive = Cfg.SettingAsDouble( "sv_keepalive", 2. );
+		Server->Data.SleepTicks = Cfg.SettingAsInt( "sv_sleep", 60 );
+		Server->ParallelReplication = Cfg.SettingAsBool( "sv_parallel_replication", true );
+		Server->JobThreads = Cfg.SettingAsInt( "sv_job_threads", -1 );
+		Server->PinJobThreads = Cfg.SettingAsBool( "sv_job_pin" );
 		Server->UseOutThreads = Cfg.SettingAsBool( "sv_use_out_threads", true );
-		Server->Start( Cfg.SettingAsString( "name" , Raptor::Server->Game.c_str() ) );
+		Server->SetRelay( Cfg.SettingAsString( "sv_relay" ) );
+		Server->SetShards( Cfg.SettingAsString( "sv_shards" ), Cfg.SettingAsString( "sv_shard_bounds" ), Cfg.SettingAsInt( "sv_shard", 0 ) );
+		Server->JournalFile = Cfg.SettingAsString( "sv_journal" );
+		Server->Start( Cfg.SettingAsString( "name" , Server->Game.c_str() ) );
 		
 		Clock wait_for_start;
 		while( ! Server->IsRunning() )
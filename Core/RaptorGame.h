@@ -24,6 +24,9 @@ class RaptorGame;
 #include "ClientConsole.h"
 #include "ResourceManager.h"
 #include "NetClient.h"
+#include "ClientDemo.h"
+#include "PacketRegistry.h"
+#include "Messages.h"
 #include "ClientConfig.h"
 
 #include "MouseState.h"
@@ -69,6 +72,12 @@ public:
 	volatile int State;
 	GameData Data;
 	uint16_t PlayerID;
+	double SyncProgress;
+	
+	DemoRecorder DemoRecord;
+	DemoPlayer DemoPlay;
+	
+	PacketRegistry<RaptorGame> Handlers;
 	
 	RaptorServer *Server;
 	
@@ -89,8 +98,31 @@ public:
 	virtual bool HandleEvent( SDL_Event *event );
 	virtual bool HandleCommand( std::string cmd, std::vector<std::string> *elements );
 	virtual bool ProcessPacket( Packet *packet );
+	bool DecodeUpdate( UpdateMessage *msg, Packet *packet );
+	bool ProcessUpdate( UpdateMessage *msg, Packet *packet );
+	bool ProcessObjectsAdd( ObjectsAddMessage *msg, Packet *packet );
+	bool ProcessObjectsRemove( ObjectsRemoveMessage *msg, Packet *packet );
+	bool ProcessObjectsClear( ObjectsClearMessage *msg, Packet *packet );
+	bool ProcessSyncProgress( SyncProgressMessage *msg, Packet *packet );
+	bool ProcessPlayerAdd( PlayerAddMessage *msg, Packet *packet );
+	bool ProcessPlayerRemove( PlayerRemoveMessage *msg, Packet *packet );
+	bool ProcessPlayerProperties( PlayerPropertiesMessage *msg, Packet *packet );
+	bool ProcessPlayerList( PlayerListMessage *msg, Packet *packet );
+	bool ProcessInfo( InfoMessage *msg, Packet *packet );
+	bool ProcessPropertyDelta( PropertyDeltaMessage *msg, Packet *packet );
+	bool ProcessMessage( TextMessage *msg, Packet *packet );
+	bool ProcessPlaySound( PlaySoundMessage *msg, Packet *packet );
+	bool ProcessPlayMusic( PlayMusicMessage *msg, Packet *packet );
 	virtual void SendUpdate( int8_t precision = 0 );
 	
+	bool RecordDemo( std::string filename );
+	void RecordKeyframe( void );
+	bool PlayDemo( std::string filename, double speed = 1., double fixed_step = 0. );
+	void SeekDemo( double time );
+	void PlayDemoPackets( void );
+	void ProcessDemoPacket( Packet *packet );
+	void StopDemo( void );
+	
 	virtual void ChangeState( int state );
 	virtual void AddedObject( GameObject *obj );
 	virtual void RemovedObject( GameObject *obj );
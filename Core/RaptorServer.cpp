@@ -7,8 +7,12 @@
 #include "RaptorServer.h"
 
 #include <cstddef>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
 #include <string>
 #include <map>
+#include <set>
 #include <signal.h>
 
 #include "RaptorDefs.h"
@@ -20,12 +24,14 @@
 
 namespace Raptor
 {
-	// Global pointer to the game server object.
+	// Global pointer to the game server object hosted by the client (if any).
+	// Engine networking code uses each instance's own pointer instead, so one process can run several servers.
 	RaptorServer *Server = NULL;
 }
 
 
 RaptorServer::RaptorServer( std::string game, std::string version )
+:	Net( this ), Relay( this )
 {
 	Game = game;
 	Version = version;
@@ -36,12 +42,56 @@ RaptorServer::RaptorServer( std::string game, std::string version )
 	NetRate = 30.;
 	Announce = true;
 	AnnounceInterval = 3.;
+	AnnouncePort = 7000;
+	QueryPort = -1;
 	UseOutThreads = true;
+	SyncChunkSize = 16384;
+	RelayPort = 7000;
+	RelayMode = false;
+	ShardIndex = -1;
+	GhostRate = 10.;
+	UpdateKeepAlive = 2.;
+	ShardMode = false;
+	RandomSeed = 0;
+	ParallelReplication = true;
+	JobThreads = -1;
+	PinJobThreads = false;
 	
 	Console = NULL;
 	
 	FrameTime = 0.;
 	State = Raptor::State::DISCONNECTED;
+	
+	CachedInfo = NULL;
+	CachedInfoVersion = 0;
+	PropertyKeysSent = 0;
+	
+	PublishedSnapshot = NULL;
+	CapturedSnapshot = NULL;
+	Replication.Jobs = JobSystem::Shared();
+	Replicating = false;
+	
+	// These are decoded into messages by each client's network thread, so the server thread only applies them.
+	Handlers.RegisterOffThread( &RaptorServer::ProcessUpdate, &RaptorServer::DecodeUpdate );
+	Handlers.RegisterOffThread( &RaptorServer::ProcessPlayerProperties );
+	Handlers.RegisterOffThread( &RaptorServer::ProcessInfo );
+	Handlers.Register( &RaptorServer::ProcessMessage );
+	Handlers.Register( &RaptorServer::ProcessShardHello );
+	Handlers.Register( &RaptorServer::ProcessShardHandoff );
+	Handlers.Register( &RaptorServer::ProcessShardGhosts );
+	
+	// Relays mirror what the upstream server sends.  Anything not registered here is passed straight to spectators.
+	RelayHandlers.RegisterOffThread( &RaptorServer::RelayUpdate, &RaptorServer::DecodeRelayUpdate );
+	RelayHandlers.Register( &RaptorServer::RelayObjectsAdd );
+	RelayHandlers.Register( &RaptorServer::RelayObjectsRemove );
+	RelayHandlers.Register( &RaptorServer::RelayObjectsClear );
+	RelayHandlers.Register( &RaptorServer::RelaySyncProgress );
+	RelayHandlers.Register( &RaptorServer::RelayPlayerList );
+	RelayHandlers.Register( &RaptorServer::RelayPlayerAdd );
+	RelayHandlers.Register( &RaptorServer::RelayPlayerRemove );
+	RelayHandlers.RegisterOffThread( &RaptorServer::RelayPlayerProperties );
+	RelayHandlers.RegisterOffThread( &RaptorServer::RelayPropertyDelta );
+	RelayHandlers.Register( &RaptorServer::RelayChangeState );
 }
 
 
@@ -57,12 +107,17 @@ RaptorServer::~RaptorServer()
 		SDL_KillThread( Thread );
 		Thread = NULL;
 	}
+	
+	delete CachedInfo;
+	CachedInfo = NULL;
+	
+	ClearShards();
 }
 
 
 int RaptorServer::Start( std::string name )
 {
-	Data.Properties["name"] = name;
+	Data.SetProperty( "name", name );
 	
 	if( IsRunning() )
 	{
@@ -71,17 +126,54 @@ int RaptorServer::Start( std::string name )
 		SDL_Delay( 200 );
 	}
 	
+	// The port may have changed, so make sure announcements are rebuilt.
+	delete CachedInfo;
+	CachedInfo = NULL;
+	
 	Net.NetRate = NetRate;
 	Net.UseOutThreads = UseOutThreads;
 	
+	// Relays don't run the game, they just pass along what the upstream server sends.
+	RelayMode = (RelayHost.size() > 0);
+	
+	// Sharded servers listen where the shard list says, and give out IDs that won't collide with their neighbours.
+	ClearShards();
+	ShardMode = (! RelayMode) && (ShardIndex >= 0) && (Shards.size() > 1);
+	if( ShardMode )
+	{
+		Port = Shards.Shards[ ShardIndex ].Port;
+		Data.GameObjectIDs.Clear( ShardMap::FirstObjectID( ShardIndex ) );
+		Data.PlayerIDs.Clear( ShardMap::FirstPlayerID( ShardIndex ) );
+		
+		for( size_t i = 0; i < Shards.size(); i ++ )
+			ShardLinks.push_back( ((int) i == ShardIndex) ? NULL : new ShardLink( this, i ) );
+		GhostsSent.resize( Shards.size() );
+	}
+	
+	// Seed before anything runs, and keep the seed so a journal can replay the same random sequence.
+	RandomSeed = time(NULL);
+	Rand::Seed( RandomSeed );
+	
+	// Relays don't run the game, so there is nothing for a journal to reproduce.
+	Journal.Close();
+	if( JournalFile.size() && ! RelayMode )
+	{
+		if( Journal.Open( JournalFile, Game, Version, RandomSeed ) )
+			ConsolePrint( std::string("Recording server journal: ") + JournalFile );
+		else
+			ConsolePrint( std::string("Could not open server journal: ") + JournalFile, TextConsole::MSG_ERROR );
+	}
+	
 	if( !( Thread = SDL_CreateThread( RaptorServerThread, this ) ) )
 	{
 		fprintf( stderr, "SDL_CreateThread: %s\n", SDLNet_GetError() );
+		Journal.Close();
 		return -1;
 	}
 	
 	State = Raptor::State::CONNECTED;
-	Started();
+	if( ! RelayMode )
+		Started();
 	
 	return 0;
 }
@@ -98,8 +190,21 @@ void RaptorServer::StopAndWait( double max_wait_seconds )
 			break;
 	}
 	
+	Relay.DisconnectNice();
+	Relay.ReconnectAttempts = 0;
+	
+	ClearShards();
+	Journal.Close();
+	
 	Data.Clear();
-	Stopped();
+	if( ShardMode )
+	{
+		Data.GameObjectIDs.Clear( 1 );
+		Data.PlayerIDs.Clear( 1 );
+	}
+	
+	if( ! RelayMode )
+		Stopped();
 }
 
 
@@ -141,122 +246,132 @@ void RaptorServer::Update( double dt )
 
 bool RaptorServer::ProcessPacket( Packet *packet, ConnectedClient *from_client )
 {
-	PacketType type = packet->Type();
+	return Handlers.Dispatch( this, packet, from_client );
+}
+
+
+bool RaptorServer::DecodeUpdate( UpdateMessage *msg, Packet *packet )
+{
+	return Data.DecodeUpdate( msg, packet, false );
+}
+
+
+bool RaptorServer::ProcessUpdate( UpdateMessage *msg, Packet *packet, ConnectedClient *from_client )
+{
+	uint32_t obj_count = msg->ObjectCount;
 	
-	if( type == Raptor::Packet::UPDATE )
+	// Apply any object updates the network thread already decoded.
+	for( std::vector<ObjectUpdate>::iterator update_iter = msg->Objects.begin(); update_iter != msg->Objects.end(); update_iter ++ )
 	{
-		// First read the precision of this update packet.
-		int8_t precision = packet->NextChar();
-		
-		// Then read the number of objects.
-		uint32_t obj_count = packet->NextUInt();
+		std::map<uint32_t,GameObject*>::iterator obj_iter = Data.GameObjects.find( update_iter->ID );
+		if( obj_iter == Data.GameObjects.end() )
+		{
+			// The client thinks we should have this object, so we're out of sync!
+			//ConsolePrint( "Sync error: UPDATE", TextConsole::MSG_ERROR );
+			return true;
+		}
 		
-		// Loop through for each object's update data.
-		while( obj_count )
+		if( ! obj_iter->second->StandardUpdateLayout() )
 		{
-			obj_count --;
-			
-			// First read the ID.
-			uint32_t obj_id = packet->NextUInt();
-			
-			// Look up the ID in the server-side list of objects and update it.
-			std::map<uint32_t,GameObject*>::iterator obj_iter = Data.GameObjects.find( obj_id );
-			if( obj_iter != Data.GameObjects.end() )
-			{
-				// FIXME: Make sure the client is authorized to update this object?
-				obj_iter->second->ReadFromUpdatePacketFromClient( packet, precision );
-			}
-			else
-			{
-				// The client thinks we should have this object, so we're out of sync!
-				// This means the rest of the update packet could be misaligned, so stop trying to parse it.
-				//ConsolePrint( "Sync error: UPDATE", TextConsole::MSG_ERROR );
-				return true;
-			}
+			// The object was replaced after this was decoded, so read the rest of the packet the slow way.
+			packet->Offset = update_iter->Offset;
+			break;
 		}
 		
-		return true;
+		// FIXME: Make sure the client is authorized to update this object?
+		obj_iter->second->ApplyUpdate( &*update_iter );
+		obj_count --;
 	}
 	
-	else if( type == Raptor::Packet::PLAYER_PROPERTIES )
+	// Loop through for each remaining object's update data.
+	while( obj_count )
 	{
-		// Read the player ID and look them up.
-		// FIXME: Make sure the sending client is authorized to update this player?
-		uint16_t id = packet->NextUShort();
-		Player *player = Data.GetPlayer( id );
+		obj_count --;
 		
-		// Then read the number of properties.
-		uint32_t property_count = packet->NextUInt();
+		// First read the ID.
+		uint32_t obj_id = packet->NextUInt();
 		
-		// We'll keep track of these properties so we can report them to the clients.
-		std::map<std::string,std::string> changed_properties;
-		
-		// Loop through for each property being changed.
-		while( property_count )
+		// Look up the ID in the server-side list of objects and update it.
+		std::map<uint32_t,GameObject*>::iterator obj_iter = Data.GameObjects.find( obj_id );
+		if( obj_iter != Data.GameObjects.end() )
 		{
-			property_count --;
-			
-			std::string property_name = packet->NextString();
-			std::string property_value = packet->NextString();
-			
-			if( player )
-			{
-				if( property_name == "name" )
-					player->Name = property_value;
-				else
-					player->Properties[ property_name ] = property_value;
-				
-				changed_properties[ property_name ] = property_value;
-			}
-			else
-			{
-				// The client thinks we should have this player, so we're out of sync!
-				//ConsolePrint( "Sync error: PLAYER_PROPERTIES", TextConsole::MSG_ERROR );
-			}
+			// FIXME: Make sure the client is authorized to update this object?
+			obj_iter->second->ReadFromUpdatePacketFromClient( packet, msg->Precision );
 		}
-		
-		if( changed_properties.size() )
+		else
 		{
-			// Now tell everyone what properties were changed.
-			Packet player_properties( Raptor::Packet::PLAYER_PROPERTIES );
-			player_properties.AddUShort( id );
-			player_properties.AddUInt( changed_properties.size() );
-			for( std::map<std::string,std::string>::iterator property_iter = changed_properties.begin(); property_iter != changed_properties.end(); property_iter ++ )
-			{
-				player_properties.AddString( property_iter->first.c_str() );
-				player_properties.AddString( property_iter->second.c_str() );
-			}
-			Net.SendAll( &player_properties );
+			// The client thinks we should have this object, so we're out of sync!
+			// This means the rest of the update packet could be misaligned, so stop trying to parse it.
+			//ConsolePrint( "Sync error: UPDATE", TextConsole::MSG_ERROR );
+			return true;
 		}
 	}
+	
+	return true;
+}
 
-	else if( type == Raptor::Packet::INFO )
+
+bool RaptorServer::ProcessPlayerProperties( PlayerPropertiesMessage *msg, Packet *packet, ConnectedClient *from_client )
+{
+	// Look up the player.
+	// FIXME: Make sure the sending client is authorized to update this player?
+	Player *player = Data.GetPlayer( msg->PlayerID );
+	if( ! player )
 	{
-		// First read the number of properties.
-		uint16_t property_count = packet->NextUShort();
-		
-		// Loop through for each name/value pair.
-		for( int i = 0; i < property_count; i ++ )
+		// The client thinks we should have this player, so we're out of sync!
+		//ConsolePrint( "Sync error: PLAYER_PROPERTIES", TextConsole::MSG_ERROR );
+		return false;
+	}
+	
+	for( PacketList<uint32_t,PacketProperty>::iterator property_iter = msg->Properties.begin(); property_iter != msg->Properties.end(); property_iter ++ )
+	{
+		if( property_iter->Name == "name" )
 		{
-			std::string name = packet->NextString();
-			std::string value = packet->NextString();
+			if( player->Name == property_iter->Value )
+				continue;
 			
-			// FIXME: Make sure the client is authorized to update this data?
-			Data.Properties[ name ] = value;
+			player->Name = property_iter->Value;
+			
+			// Player names are included in server announcements.
+			Data.InfoVersion ++;
+			
+			// Names aren't stored as properties, so tell everyone about them right away.
+			PlayerPropertiesMessage name_msg;
+			name_msg.PlayerID = msg->PlayerID;
+			name_msg.Properties.push_back( *property_iter );
+			Packet player_properties;
+			EncodePacket( &player_properties, &name_msg );
+			Net.SendAll( &player_properties );
 		}
 		
-		// Lazy solution: Just resend this packet back to everyone.
-		Net.SendAll( packet );
-		
-		return true;
+		// Other changes are sent to everyone by SendPropertyChanges at the end of the frame.
+		else
+			player->Properties.Set( property_iter->Name, property_iter->Value );
 	}
 	
-	else if( type == Raptor::Packet::MESSAGE )
+	return false;
+}
+
+
+bool RaptorServer::ProcessInfo( InfoMessage *msg, Packet *packet, ConnectedClient *from_client )
+{
+	for( PacketList<uint16_t,PacketProperty>::iterator property_iter = msg->Properties.begin(); property_iter != msg->Properties.end(); property_iter ++ )
 	{
-		// Lazy solution: Just resend this packet back to everyone.
-		Net.SendAll( packet );
+		// FIXME: Make sure the client is authorized to update this data?
+		Data.SetProperty( property_iter->Name, property_iter->Value );
 	}
 	
+	// Changes are sent to everyone by SendPropertyChanges at the end of the frame.
+	
+	return true;
+}
+
+
+bool RaptorServer::ProcessMessage( TextMessage *msg, Packet *packet, ConnectedClient *from_client )
+{
+	// Lazy solution: Just resend this packet back to everyone.
+	Net.SendAll( packet );
+	
 	return false;
 }
 
@@ -274,82 +389,113 @@ void RaptorServer::AcceptedClient( ConnectedClient *client )
 	
 	Player *player = Data.GetPlayer( client->PlayerID );
 	
-	// Send list of server properties to the new client.
-	Packet info( Raptor::Packet::INFO );
-	info.AddUShort( Data.Properties.size() );
-	for( std::map<std::string,std::string>::iterator property_iter = Data.Properties.begin(); property_iter != Data.Properties.end(); property_iter ++ )
+	// Send the player list and all properties to the new client.
+	SendPlayers( client );
+	
+	// Tell other clients about the new player.
+	PlayerAddMessage player_add_msg;
+	player_add_msg.PlayerID = client->PlayerID;
+	player_add_msg.Name = player ? player->Name : "";
+	Packet player_add;
+	EncodePacket( &player_add, &player_add_msg );
+	Net.SendAllExcept( &player_add, client );
+	
+	// Tell other clients about the new player's properties.
+	if( player && player->Properties.size() )
 	{
-		info.AddString( property_iter->first.c_str() );
-		info.AddString( property_iter->second.c_str() );
+		PropertyDeltaMessage player_properties_msg;
+		AddPropertyKeys( &player_properties_msg );
+		AddPropertyStore( &player_properties_msg, client->PlayerID, &(player->Properties), false );
+		Packet player_properties;
+		EncodePacket( &player_properties, &player_properties_msg );
+		Net.SendAllExcept( &player_properties, client );
 	}
-	client->Send( &info );
 	
-	// Send list of all players to the new client.
-	Packet player_list( Raptor::Packet::PLAYER_LIST );
-	player_list.AddUShort( Raptor::Server->Data.Players.size() );
-	for( std::map<uint16_t,Player*>::iterator player_iter = Raptor::Server->Data.Players.begin(); player_iter != Raptor::Server->Data.Players.end(); player_iter ++ )
+	// Start streaming existing objects to the new client.
+	QueueSync( client );
+	
+	if( player )
 	{
-		player_list.AddUShort( player_iter->second->ID );
-		player_list.AddString( player_iter->second->Name );
+		// Tell other players to display a message about the new player.
+		Packet message( Raptor::Packet::MESSAGE );
+		message.AddString( (player->Name + " has joined the game.").c_str() );
+		Net.SendAllExcept( &message, client );
 	}
-	client->Send( &player_list );
+}
+
+
+void RaptorServer::AcceptedSpectator( ConnectedClient *client )
+{
+	// Relay spectators get the mirrored players and objects, but nobody else needs to hear about them.
+	SendPlayers( client );
 	
-	// Send all existing players' properties to the new client.
-	for( std::map<uint16_t,Player*>::iterator player_iter = Raptor::Server->Data.Players.begin(); player_iter != Raptor::Server->Data.Players.end(); player_iter ++ )
+	if( State > Raptor::State::CONNECTED )
 	{
-		Packet player_properties( Raptor::Packet::PLAYER_PROPERTIES );
-		player_properties.AddUShort( player_iter->second->ID );
-		player_properties.AddUInt( player_iter->second->Properties.size() );
-		for( std::map<std::string,std::string>::iterator property_iter = player_iter->second->Properties.begin(); property_iter != player_iter->second->Properties.end(); property_iter ++ )
-		{
-			player_properties.AddString( property_iter->first.c_str() );
-			player_properties.AddString( property_iter->second.c_str() );
-		}
-		client->Send( &player_properties );
+		ChangeStateMessage state_msg;
+		state_msg.State = State;
+		Packet state;
+		EncodePacket( &state, &state_msg );
+		client->Send( &state );
 	}
 	
-	// Tell other clients about the new player.
-	Packet player_add( Raptor::Packet::PLAYER_ADD );
-	player_add.AddUShort( client->PlayerID );
-	player_add.AddString( player ? player->Name.c_str() : "" );
-	Net.SendAllExcept( &player_add, client );
+	QueueSync( client );
+}
+
+
+void RaptorServer::SendPlayers( ConnectedClient *client )
+{
+	// Send list of all players to the new client.
+	PlayerListMessage player_list_msg;
+	for( std::map<uint16_t,Player*>::iterator player_iter = Data.Players.begin(); player_iter != Data.Players.end(); player_iter ++ )
+		player_list_msg.Players.push_back( PlayerListEntry( player_iter->second->ID, player_iter->second->Name ) );
+	Packet player_list;
+	EncodePacket( &player_list, &player_list_msg );
+	client->Send( &player_list );
 	
-	// Tell other clients about the new player's properties.
-	if( player )
+	// Send all server and player properties to the new client in one packet, along with every property name.
+	PropertyDeltaMessage properties_msg;
+	for( uint16_t key = 1; key && (key <= Data.PropertyKeyIDs.Last()); key ++ )
+		properties_msg.Keys.push_back( PropertyKeyDef( key, Data.PropertyKeyIDs.Name( key ) ) );
+	AddPropertyStore( &properties_msg, 0, &(Data.Properties), false );
+	for( std::map<uint16_t,Player*>::iterator player_iter = Data.Players.begin(); player_iter != Data.Players.end(); player_iter ++ )
+		AddPropertyStore( &properties_msg, player_iter->first, &(player_iter->second->Properties), false );
+	Packet properties;
+	if( ! EncodePacket( &properties, &properties_msg ) )
+		fprintf( stderr, "RaptorServer::SendPlayers: Too many properties for one packet; some were left out.\n" );
+	client->Send( &properties );
+}
+
+
+void RaptorServer::QueueSync( ConnectedClient *client )
+{
+	// Queue existing objects to be streamed to the new client in chunks, most important first.
+	// Positions of the client's own objects are gathered once here rather than looked up for every object ranked.
+	std::vector<Pos3D> owned_positions;
+	for( std::map<uint32_t,GameObject*>::iterator obj_iter = Data.GameObjects.begin(); obj_iter != Data.GameObjects.end(); obj_iter ++ )
 	{
-		Packet player_properties( Raptor::Packet::PLAYER_PROPERTIES );
-		player_properties.AddUShort( client->PlayerID );
-		player_properties.AddUInt( player->Properties.size() );
-		for( std::map<std::string,std::string>::iterator property_iter = player->Properties.begin(); property_iter != player->Properties.end(); property_iter ++ )
-		{
-			player_properties.AddString( property_iter->first.c_str() );
-			player_properties.AddString( property_iter->second.c_str() );
-		}
-		Net.SendAllExcept( &player_properties, client );
+		if( client->PlayerID && (obj_iter->second->PlayerID == client->PlayerID) )
+			owned_positions.push_back( Pos3D( obj_iter->second ) );
 	}
-	
-	// Send list of existing objects to the new client.
-	Packet obj_list = Packet( Raptor::Packet::OBJECTS_ADD );
-	obj_list.AddUInt( Data.GameObjects.size() );
+	std::multimap<double,uint32_t> sync_order;
 	for( std::map<uint32_t,GameObject*>::iterator obj_iter = Data.GameObjects.begin(); obj_iter != Data.GameObjects.end(); obj_iter ++ )
+		sync_order.insert( std::pair<double,uint32_t>( SyncPriority( client, obj_iter->second, &owned_positions ), obj_iter->first ) );
+	client->SyncQueue.clear();
+	client->SyncPending.clear();
+	for( std::multimap<double,uint32_t>::iterator sync_iter = sync_order.begin(); sync_iter != sync_order.end(); sync_iter ++ )
 	{
-		obj_list.AddUInt( obj_iter->second->ID );
-		obj_list.AddUInt( obj_iter->second->Type() );
-		obj_iter->second->AddToInitPacket( &obj_list );
+		client->SyncQueue.push_back( sync_iter->second );
+		client->SyncPending.insert( sync_iter->second );
 	}
-	client->Send( &obj_list );
+	client->SyncSent = 0;
+	client->SyncTotal = client->SyncQueue.size();
+	client->SyncVersion = Data.ChangeVersion;
 	
-	// The client is now synchronized, so it should receive updates.
+	// The client should receive updates for objects as soon as it has them.
 	client->Synchronized = true;
-	client->NetClock.Reset();
+	Timers.Schedule( &(client->UpdateTimer), 1.0 / client->NetRate );
 	
-	if( player )
-	{
-		// Tell other players to display a message about the new player.
-		Packet message( Raptor::Packet::MESSAGE );
-		message.AddString( (player->Name + " has joined the game.").c_str() );
-		Net.SendAllExcept( &message, client );
-	}
+	// Send the first chunk now; NetServer::SendUpdates will send the rest.
+	SendSyncChunk( client );
 }
 
 
@@ -360,8 +506,10 @@ void RaptorServer::DroppedClient( ConnectedClient *client )
 	Player *player = Data.GetPlayer( client->PlayerID );
 	
 	// Tell other clients about the removed player.
-	Packet player_remove( Raptor::Packet::PLAYER_REMOVE );
-	player_remove.AddUShort( client->PlayerID );
+	PlayerRemoveMessage player_remove_msg;
+	player_remove_msg.PlayerID = client->PlayerID;
+	Packet player_remove;
+	EncodePacket( &player_remove, &player_remove_msg );
 	Net.SendAllExcept( &player_remove, client );
 	
 	if( player )
@@ -385,9 +533,22 @@ void RaptorServer::SendUpdate( ConnectedClient *client, int8_t precision )
 	
 	std::vector<GameObject*> objects_to_update;
 	
+	// Objects that haven't changed since this client's last update are only resent as a slow keep-alive,
+	// spread across packets by ID so each one goes out about every UpdateKeepAlive seconds.  Sleeping objects aren't kept alive.
+	uint32_t keepalive_slots = std::max<int>( 1, client->NetRate * UpdateKeepAlive + 0.5 );
+	uint32_t keepalive_slot = client->KeepAliveSlot % keepalive_slots;
+	client->KeepAliveSlot = keepalive_slot + 1;
+	
 	// Before adding anything to the packet, count how many objects we will be sending data for.
 	for( std::map<uint32_t,GameObject*>::iterator obj_iter = Data.GameObjects.begin(); obj_iter != Data.GameObjects.end(); obj_iter ++ )
 	{
+		// Skip objects the client hasn't been sent yet.
+		if( client->SyncPending.size() && (client->SyncPending.find( obj_iter->first ) != client->SyncPending.end()) )
+			continue;
+		
+		if( (obj_iter->second->ChangedVersion <= client->SentChangeVersion) && (obj_iter->second->Sleeping || (obj_iter->first % keepalive_slots != keepalive_slot)) && obj_iter->second->ServerTracksChanges() )
+			continue;
+		
 		if( client->PlayerID && (client->PlayerID == obj_iter->second->PlayerID) )
 		{
 			if( obj_iter->second->ServerShouldUpdatePlayer() )
@@ -397,16 +558,7 @@ void RaptorServer::SendUpdate( ConnectedClient *client, int8_t precision )
 			objects_to_update.push_back( obj_iter->second );
 	}
 	
-	// If precision is auto (-128), the number of objects to update dictates how much detail to send about each.
-	if( precision == -128 )
-	{
-		if( objects_to_update.size() < 32 )
-			precision = 127;
-		else if( objects_to_update.size() < 1024 )
-			precision = 0;
-		else
-			precision = -127;
-	}
+	precision = UpdatePrecision( precision, objects_to_update.size() );
 	
 	Packet update_packet = Packet( Raptor::Packet::UPDATE );
 	
@@ -422,114 +574,1449 @@ void RaptorServer::SendUpdate( ConnectedClient *client, int8_t precision )
 		update_packet.AddUInt( (*obj_iter)->ID );
 		(*obj_iter)->AddToUpdatePacketFromServer( &update_packet, precision );
 	}
-
-	// Send the packet.
-	client->Send( &update_packet );
+	
+	client->SentChangeVersion = Data.ChangeVersion;
+	
+	// Send the packet, unless nothing changed.
+	if( objects_to_update.size() )
+		client->Send( &update_packet );
 }
 
 
-// ---------------------------------------------------------------------------
-
-
-void RaptorServer::ChangeState( int state )
+int8_t RaptorServer::UpdatePrecision( int8_t precision, size_t object_count )
 {
-	State = state;
+	// If precision is auto (-128), the number of objects to update dictates how much detail to send about each.
+	if( precision == -128 )
+	{
+		if( object_count < 32 )
+			precision = 127;
+		else if( object_count < 1024 )
+			precision = 0;
+		else
+			precision = -127;
+	}
+	
+	return precision;
 }
 
 
-// ---------------------------------------------------------------------------
+double RaptorServer::SyncPriority( ConnectedClient *client, const GameObject *obj, const std::vector<Pos3D> *owned_positions )
+{
+	// Lower values are sent first: the client's own objects, then objects nearest to them.
+	// Game servers can override this to prioritize by camera position or relevance.
+	if( client->PlayerID && (obj->PlayerID == client->PlayerID) )
+		return 0.;
+	
+	// Compare squared distances, so there is only one square root per object however many the client owns.
+	double nearest_squared = 0.;
+	for( std::vector<Pos3D>::const_iterator owned_iter = owned_positions->begin(); owned_iter != owned_positions->end(); owned_iter ++ )
+	{
+		double dx = obj->X - owned_iter->X, dy = obj->Y - owned_iter->Y, dz = obj->Z - owned_iter->Z;
+		double dist_squared = dx*dx + dy*dy + dz*dz;
+		if( (dist_squared < nearest_squared) || (owned_iter == owned_positions->begin()) )
+			nearest_squared = dist_squared;
+	}
+	
+	return 1. + sqrt( nearest_squared );
+}
 
 
-int RaptorServer::RaptorServerThread( void *game_server )
+void RaptorServer::SendSyncChunk( ConnectedClient *client )
 {
-	Rand::Seed( time(NULL) );
-	
-	((RaptorServer*) game_server)->Net.Initialize( ((RaptorServer*) game_server)->Port );
+	Packet obj_list = Packet( Raptor::Packet::OBJECTS_ADD );
 	
-	char cstr[ 1024 ] = "";
+	// Reserve space for the object count, which is filled in once we know how many fit in this chunk.
+	obj_list.AddUInt( 0 );
+	uint32_t obj_count = 0;
 	
-	if( ((RaptorServer*) game_server)->Net.Listening )
+	while( client->SyncQueue.size() && (obj_list.Size() < SyncChunkSize) )
 	{
-		snprintf( cstr, 1024, "%s server started on port %i.", ((RaptorServer*) game_server)->Game.c_str(), ((RaptorServer*) game_server)->Port );
-		((RaptorServer*) game_server)->ConsolePrint( cstr );
+		uint32_t obj_id = client->SyncQueue.front();
+		client->SyncQueue.pop_front();
+		client->SyncPending.erase( obj_id );
+		client->SyncSent ++;
 		
-		NetUDP ServerAnnouncer;
-		ServerAnnouncer.Initialize();
-		
-		Clock GameClock;
-		Clock AnnounceClock;
-		bool sleep_longer = false;
+		// Objects removed since the client joined were already announced as removed, so skip them.
+		// IDs are reused, so an object added since then under a queued ID was already announced too.
+		GameObject *obj = Data.GetObject( obj_id );
+		if( ! obj || (obj->AddedVersion > client->SyncVersion) )
+			continue;
 		
-		while( ((RaptorServer*) game_server)->Net.Listening )
-		{
-			// Process network input buffers (one packet per client).
-			((RaptorServer*) game_server)->Net.ProcessTop();
-			
-			// Calculate the time elapsed for the "frame".
-			double elapsed = GameClock.ElapsedSeconds();
-			if( (((RaptorServer*) game_server)->MaxFPS <= 0.0) || ( (elapsed > 0.0) && ((1.0 / elapsed) <= ((RaptorServer*) game_server)->MaxFPS) ) )
-			{
-				((RaptorServer*) game_server)->FrameTime = GameClock.ElapsedSeconds();
-				GameClock.Reset();
-				
-				// Update location.
-				((RaptorServer*) game_server)->Update( ((RaptorServer*) game_server)->FrameTime );
-				
-				// Drop disconnected clients from the list.
-				((RaptorServer*) game_server)->Net.RemoveDisconnectedClients();
-				
-				// Send periodic updates to clients.
-				((RaptorServer*) game_server)->Net.SendUpdates();
+		obj_list.AddUInt( obj->ID );
+		obj_list.AddUInt( obj->Type() );
+		obj->AddToInitPacket( &obj_list );
+		obj_count ++;
+	}
+	
+	if( obj_count )
+	{
+		Endian::WriteBig32( obj_count, obj_list.Data + PACKET_HEADER_SIZE );
+		client->Send( &obj_list );
+	}
+	
+	// Let the client know how far along it is.
+	SyncProgressMessage progress_msg;
+	progress_msg.Sent = client->SyncSent;
+	progress_msg.Total = client->SyncTotal;
+	Packet progress;
+	EncodePacket( &progress, &progress_msg );
+	client->Send( &progress );
+}
 
-				// Send periodic server announcements over UDP broadcast.
-				if( ((RaptorServer*) game_server)->Announce && (AnnounceClock.ElapsedSeconds() > ((RaptorServer*) game_server)->AnnounceInterval) )
-				{
-					AnnounceClock.Reset();
 
-					Packet info( Raptor::Packet::INFO );
-					
-					// Properties.
-					info.AddUShort( 3 + ((RaptorServer*) game_server)->Data.Properties.size() );
-					info.AddString( "game" );
-					info.AddString( ((RaptorServer*) game_server)->Game );
-					info.AddString( "version" );
-					info.AddString( ((RaptorServer*) game_server)->Version );
-					info.AddString( "port" );
-					char port_str[ 32 ] = "";
-					snprintf( port_str, 32, "%i", ((RaptorServer*) game_server)->Port );
-					info.AddString( port_str );
-					for( std::map<std::string,std::string>::iterator property_iter = ((RaptorServer*) game_server)->Data.Properties.begin(); property_iter != ((RaptorServer*) game_server)->Data.Properties.end(); property_iter ++ )
-					{
-						info.AddString( property_iter->first.c_str() );
-						info.AddString( property_iter->second.c_str() );
-					}
-					
-					// Players.
-					info.AddUShort( ((RaptorServer*) game_server)->Data.Players.size() );
-					for( std::map<uint16_t,Player*>::iterator player_iter = ((RaptorServer*) game_server)->Data.Players.begin(); player_iter != ((RaptorServer*) game_server)->Data.Players.end(); player_iter ++ )
-						info.AddString( player_iter->second->Name.c_str() );
-					
-					ServerAnnouncer.Broadcast( &info, 7000 );
-				}
-				
-				// Don't work very hard if nobody is connected.
-				sleep_longer = ( ((RaptorServer*) game_server)->Net.Clients.size() < 1 );
-			}
-			
-			// Let the thread rest a bit.
-			SDL_Delay( sleep_longer ? 100 : 1 );
+void RaptorServer::AddPropertyKeys( PropertyDeltaMessage *msg )
+{
+	// Define any property names that clients haven't been told about yet.
+	for( uint16_t key = PropertyKeysSent + 1; key && (key <= Data.PropertyKeyIDs.Last()); key ++ )
+		msg->Keys.push_back( PropertyKeyDef( key, Data.PropertyKeyIDs.Name( key ) ) );
+	
+	PropertyKeysSent = Data.PropertyKeyIDs.Last();
+}
+
+
+void RaptorServer::AddPropertyStore( PropertyDeltaMessage *msg, uint16_t player_id, const PropertyStore *store, bool changed_only )
+{
+	PropertyStoreDelta delta( player_id );
+	
+	if( changed_only )
+	{
+		for( std::set<uint16_t>::const_iterator key_iter = store->Changed.begin(); key_iter != store->Changed.end(); key_iter ++ )
+		{
+			std::map<uint16_t,PropertyValue>::const_iterator value_iter = store->Values.find( *key_iter );
+			if( value_iter != store->Values.end() )
+				delta.Changes.push_back( PropertyChange( value_iter->first, value_iter->second.Version, value_iter->second.Value ) );
 		}
-		
-		snprintf( cstr, 1024, "%s server stopped.", ((RaptorServer*) game_server)->Game.c_str() );
-		((RaptorServer*) game_server)->ConsolePrint( cstr );
 	}
 	else
 	{
-		snprintf( cstr, 1024, "%s server failed to start.", ((RaptorServer*) game_server)->Game.c_str() );
-		((RaptorServer*) game_server)->ConsolePrint( cstr, TextConsole::MSG_ERROR );
+		for( std::map<uint16_t,PropertyValue>::const_iterator value_iter = store->Values.begin(); value_iter != store->Values.end(); value_iter ++ )
+			delta.Changes.push_back( PropertyChange( value_iter->first, value_iter->second.Version, value_iter->second.Value ) );
 	}
 	
-	((RaptorServer*) game_server)->Thread = NULL;
-	((RaptorServer*) game_server)->State = Raptor::State::DISCONNECTED;
-	return 0;
+	if( delta.Changes.size() )
+		msg->Stores.push_back( delta );
+}
+
+
+void RaptorServer::SendPropertyChanges( void )
+{
+	// Batch every property change made this frame into one packet for everyone.
+	PropertyDeltaMessage delta_msg;
+	
+	AddPropertyStore( &delta_msg, 0, &(Data.Properties), true );
+	Data.Properties.Changed.clear();
+	
+	for( std::map<uint16_t,Player*>::iterator player_iter = Data.Players.begin(); player_iter != Data.Players.end(); player_iter ++ )
+	{
+		if( player_iter->second->Properties.Changed.size() )
+		{
+			AddPropertyStore( &delta_msg, player_iter->first, &(player_iter->second->Properties), true );
+			player_iter->second->Properties.Changed.clear();
+		}
+	}
+	
+	if( ! delta_msg.Stores.size() )
+		return;
+	
+	AddPropertyKeys( &delta_msg );
+	
+	Packet delta;
+	if( ! EncodePacket( &delta, &delta_msg ) )
+		fprintf( stderr, "RaptorServer::SendPropertyChanges: Too many property changes for one packet; some were left out.\n" );
+	Net.SendAll( &delta );
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+void RaptorServer::SetRelay( std::string host )
+{
+	// Takes "host" or "host:port", which applies the next time the server starts.  Empty means run the game normally.
+	RelayHost = host;
+	RelayPort = 7000;
+	
+	size_t colon = host.rfind( ':' );
+	if( colon != std::string::npos )
+	{
+		RelayHost = host.substr( 0, colon );
+		RelayPort = atoi( host.substr( colon + 1 ).c_str() );
+		if( RelayPort <= 0 )
+			RelayPort = 7000;
+	}
+}
+
+
+bool RaptorServer::Relaying( void ) const
+{
+	return RelayMode;
+}
+
+
+void RaptorServer::UpdateRelay( void )
+{
+	// Mirror and pass along whatever the upstream server sent since last frame.
+	Relay.ProcessIn();
+	
+	if( Relay.Connected )
+		return;
+	
+	if( ! Relay.ReconnectAttempts )
+	{
+		// Without an upstream server there's nothing to watch.
+		Net.DisconnectNice( "Lost connection to upstream server." );
+	}
+	else if( Relay.ReconnectReady() )
+	{
+		// The upstream server will resend everything, so start over with an empty mirror.
+		Data.Clear();
+		Relay.Reconnect();
+	}
+}
+
+
+bool RaptorServer::ProcessRelayPacket( Packet *packet )
+{
+	if( RelayHandlers.Dispatch( this, packet ) )
+		return true;
+	
+	// Anything we don't need to mirror (chat, sounds, game-specific packets) goes straight to the spectators.
+	Net.SendAllSynchronized( packet );
+	return true;
+}
+
+
+bool RaptorServer::ProcessSpectatorPacket( Packet *packet, ConnectedClient *from_client )
+{
+	// Spectator chat goes upstream, and comes back down to everyone with the rest of the upstream traffic.
+	if( from_client->Synchronized && (packet->Type() == Raptor::Packet::MESSAGE) )
+	{
+		Relay.Send( packet );
+		return true;
+	}
+	
+	return false;
+}
+
+
+bool RaptorServer::DecodeRelayUpdate( UpdateMessage *msg, Packet *packet )
+{
+	return Data.DecodeUpdate( msg, packet, true );
+}
+
+
+bool RaptorServer::RelayUpdate( UpdateMessage *msg, Packet *packet )
+{
+	Data.ApplyUpdateFromServer( msg, packet );
+	
+	// Spectators still receiving the initial object list would see updates for objects they don't have yet.
+	Net.SendAllSynchronized( packet, true );
+	return true;
+}
+
+
+bool RaptorServer::RelayObjectsAdd( ObjectsAddMessage *msg, Packet *packet )
+{
+	uint32_t obj_count = msg->ObjectCount;
+	while( obj_count )
+	{
+		obj_count --;
+		
+		uint32_t id = packet->NextUInt();
+		uint32_t type = packet->NextUInt();
+		GameObject *obj = NewObject( id, type );
+		Data.AddObject( obj );
+		obj->ReadFromInitPacket( packet );
+	}
+	
+	Net.SendAllSynchronized( packet );
+	return true;
+}
+
+
+bool RaptorServer::RelayObjectsRemove( ObjectsRemoveMessage *msg, Packet *packet )
+{
+	for( PacketList<uint32_t,uint32_t>::iterator id_iter = msg->ObjectIDs.begin(); id_iter != msg->ObjectIDs.end(); id_iter ++ )
+		Data.RemoveObject( *id_iter );
+	
+	Net.SendAllSynchronized( packet );
+	return true;
+}
+
+
+bool RaptorServer::RelayObjectsClear( ObjectsClearMessage *msg, Packet *packet )
+{
+	Data.ClearObjects();
+	
+	Net.SendAllSynchronized( packet );
+	return true;
+}
+
+
+bool RaptorServer::RelaySyncProgress( SyncProgressMessage *msg, Packet *packet )
+{
+	// This is our own progress syncing with upstream; spectators get theirs from SendSyncChunk.
+	return true;
+}
+
+
+bool RaptorServer::RelayPlayerList( PlayerListMessage *msg, Packet *packet )
+{
+	for( PacketList<uint16_t,PlayerListEntry>::iterator entry_iter = msg->Players.begin(); entry_iter != msg->Players.end(); entry_iter ++ )
+	{
+		Player *player = Data.GetPlayer( entry_iter->ID );
+		if( ! player )
+		{
+			player = NewPlayer( entry_iter->ID );
+			Data.AddPlayer( player );
+		}
+		
+		player->Name = entry_iter->Name;
+	}
+	
+	Net.SendAllSynchronized( packet );
+	return true;
+}
+
+
+bool RaptorServer::RelayPlayerAdd( PlayerAddMessage *msg, Packet *packet )
+{
+	Player *player = Data.GetPlayer( msg->PlayerID );
+	if( ! player )
+	{
+		player = NewPlayer( msg->PlayerID );
+		Data.AddPlayer( player );
+	}
+	player->Name = msg->Name;
+	
+	Net.SendAllSynchronized( packet );
+	return true;
+}
+
+
+bool RaptorServer::RelayPlayerRemove( PlayerRemoveMessage *msg, Packet *packet )
+{
+	Data.RemovePlayer( msg->PlayerID );
+	
+	Net.SendAllSynchronized( packet );
+	return true;
+}
+
+
+bool RaptorServer::RelayPlayerProperties( PlayerPropertiesMessage *msg, Packet *packet )
+{
+	Player *player = Data.GetPlayer( msg->PlayerID );
+	if( player )
+	{
+		for( PacketList<uint32_t,PacketProperty>::iterator property_iter = msg->Properties.begin(); property_iter != msg->Properties.end(); property_iter ++ )
+		{
+			if( property_iter->Name == "name" )
+			{
+				player->Name = property_iter->Value;
+				Data.InfoVersion ++;
+			}
+			else
+				player->Properties.Set( property_iter->Name, property_iter->Value );
+		}
+	}
+	
+	Net.SendAllSynchronized( packet );
+	return true;
+}
+
+
+bool RaptorServer::RelayPropertyDelta( PropertyDeltaMessage *msg, Packet *packet )
+{
+	// Upstream property IDs mean nothing to our spectators, so this isn't passed along as-is.
+	// The mirrored stores mark what changed, and SendPropertyChanges sends it with our own IDs.
+	Data.ApplyPropertyDelta( msg );
+	return true;
+}
+
+
+bool RaptorServer::RelayChangeState( ChangeStateMessage *msg, Packet *packet )
+{
+	// Don't call ChangeState, since game servers may start running game logic there.
+	if( msg->State >= Raptor::State::CONNECTED )
+		State = msg->State;
+	
+	Net.SendAllSynchronized( packet );
+	return true;
+}
+
+
+GameObject *RaptorServer::NewObject( uint32_t id, uint32_t type )
+{
+	// Game servers that can be relayed should return their own object types, like RaptorGame::NewObject.
+	GameObject *obj = new( &Data ) GameObject( id, type );
+	
+	// Plain GameObjects send nothing beyond the standard update layout, and only move in Update.
+	obj->StandardLayout = true;
+	obj->SleepsAtRest = true;
+	obj->UpdatesInParallel = true;
+	
+	return obj;
+}
+
+
+Player *RaptorServer::NewPlayer( uint16_t id )
+{
+	return new Player( id );
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+bool RaptorServer::SetShards( std::string hosts, std::string bounds, int index )
+{
+	// Every shard is given the same hosts and boundaries, plus its own index.  This applies the next time the server starts.
+	ShardIndex = -1;
+	Shards.Clear();
+	if( hosts.empty() )
+		return true;
+	
+	if( Shards.Configure( hosts, bounds ) && (index >= 0) && (index < (int) Shards.size()) )
+	{
+		ShardIndex = index;
+		return true;
+	}
+	
+	Shards.Clear();
+	ConsolePrint( "Invalid shard configuration; running unsharded.", TextConsole::MSG_ERROR );
+	return false;
+}
+
+
+bool RaptorServer::Sharded( void ) const
+{
+	return ShardMode;
+}
+
+
+bool RaptorServer::ShardOwns( double x ) const
+{
+	// Games should only create world objects that fall within their own shard.
+	return (! ShardMode) || (Shards.ShardAt( x ) == ShardIndex);
+}
+
+
+bool RaptorServer::ShardMigrates( const GameObject *obj )
+{
+	// Games can return false to keep things (like objects spanning the whole world) on the shard that created them.
+	return true;
+}
+
+
+void RaptorServer::UpdateShards( void )
+{
+	// Keep a link open to every other shard, retrying the ones that aren't up yet.
+	for( size_t i = 0; i < ShardLinks.size(); i ++ )
+	{
+		ShardLink *link = ShardLinks[ i ];
+		if( (! link) || link->Connected )
+			continue;
+		
+		link->Cleanup();
+		if( link->RetryReady() )
+		{
+			// A new connection means the neighbour has dropped any ghosts we sent before.
+			GhostsSent[ i ].clear();
+			link->Connect( Shards.Shards[ i ].Host, Shards.Shards[ i ].Port );
+		}
+	}
+	
+	MigrateObjects();
+	
+	if( (GhostRate > 0.) && (GhostClock.ElapsedSeconds() >= (1. / GhostRate)) )
+	{
+		GhostClock.Reset();
+		SendGhosts();
+	}
+	
+	// Forget handed-off players who never showed up.
+	double now = ShardClock.ElapsedSeconds();
+	for( std::map< std::string, std::pair<uint16_t,double> >::iterator arrival_iter = ShardArrivals.begin(); arrival_iter != ShardArrivals.end(); )
+	{
+		std::map< std::string, std::pair<uint16_t,double> >::iterator arrival_next = arrival_iter;
+		arrival_next ++;
+		
+		if( now - arrival_iter->second.second > 30. )
+		{
+			Data.RemovePlayer( arrival_iter->second.first );
+			ShardArrivals.erase( arrival_iter );
+		}
+		
+		arrival_iter = arrival_next;
+	}
+}
+
+
+void RaptorServer::MigrateObjects( void )
+{
+	// Only players with a client here can follow their objects; anything owned by the server's own players just moves.
+	std::set<uint16_t> client_players;
+	if( ! Net.Lock.Lock() )
+		fprintf( stderr, "RaptorServer::MigrateObjects: Net.Lock.Lock: %s\n", SDL_GetError() );
+	for( std::list<ConnectedClient*>::iterator client_iter = Net.Clients.begin(); client_iter != Net.Clients.end(); client_iter ++ )
+	{
+		if( (*client_iter)->Connected && (*client_iter)->PlayerID )
+			client_players.insert( (*client_iter)->PlayerID );
+	}
+	if( ! Net.Lock.Unlock() )
+		fprintf( stderr, "RaptorServer::MigrateObjects: Net.Lock.Unlock: %s\n", SDL_GetError() );
+	
+	// Find objects that have left our slab, and the players whose objects are taking them along.
+	std::map<uint32_t,int> moving_objects;
+	std::map<uint16_t,int> moving_players;
+	for( std::map<uint32_t,GameObject*>::iterator obj_iter = Data.GameObjects.begin(); obj_iter != Data.GameObjects.end(); obj_iter ++ )
+	{
+		GameObject *obj = obj_iter->second;
+		if( Data.GhostIDs.size() && Data.IsGhost( obj_iter->first ) )
+			continue;
+		
+		int shard = Shards.ShardAt( obj->X );
+		if( (shard == ShardIndex) || (shard < 0) || (! ShardLinks[ shard ]) || (! ShardLinks[ shard ]->Connected) )
+			continue;
+		if( ! ShardMigrates( obj ) )
+			continue;
+		
+		moving_objects[ obj_iter->first ] = shard;
+		if( obj->PlayerID && (client_players.find( obj->PlayerID ) != client_players.end()) && (moving_players.find( obj->PlayerID ) == moving_players.end()) )
+			moving_players[ obj->PlayerID ] = shard;
+	}
+	
+	if( moving_objects.empty() )
+		return;
+	
+	// Everything else those players own goes with them, so it isn't left here without an owner.
+	if( moving_players.size() )
+	{
+		for( std::map<uint32_t,GameObject*>::iterator obj_iter = Data.GameObjects.begin(); obj_iter != Data.GameObjects.end(); obj_iter ++ )
+		{
+			std::map<uint16_t,int>::iterator player_iter = moving_players.find( obj_iter->second->PlayerID );
+			if( (player_iter != moving_players.end()) && ! Data.IsGhost( obj_iter->first ) && ShardMigrates( obj_iter->second ) )
+				moving_objects[ obj_iter->first ] = player_iter->second;
+		}
+	}
+	
+	ObjectsRemoveMessage remove_msg;
+	
+	for( size_t shard = 0; shard < ShardLinks.size(); shard ++ )
+	{
+		std::vector<GameObject*> objects;
+		for( std::map<uint32_t,int>::iterator moving_iter = moving_objects.begin(); moving_iter != moving_objects.end(); moving_iter ++ )
+		{
+			if( moving_iter->second == (int) shard )
+				objects.push_back( Data.GameObjects[ moving_iter->first ] );
+		}
+		if( objects.empty() )
+			continue;
+		
+		// Each moving player gets a token to log in to the new shard with.
+		ShardHandoffMessage handoff_msg;
+		for( std::map<uint16_t,int>::iterator player_iter = moving_players.begin(); player_iter != moving_players.end(); player_iter ++ )
+		{
+			if( player_iter->second != (int) shard )
+				continue;
+			
+			Player *player = Data.GetPlayer( player_iter->first );
+			char token[ 64 ] = "";
+			snprintf( token, 64, "shard%i:%i:%08X%08X", ShardIndex, player->ID, (unsigned int) Rand::Int(), (unsigned int) Rand::Int() );
+			ShardPlayer shard_player( player->ID, player->Name, token );
+			for( std::map<uint16_t,PropertyValue>::iterator value_iter = player->Properties.Values.begin(); value_iter != player->Properties.Values.end(); value_iter ++ )
+				shard_player.Properties.push_back( PacketProperty( Data.PropertyKeyIDs.Name( value_iter->first ), value_iter->second.Value ) );
+			handoff_msg.Players.push_back( shard_player );
+		}
+		
+		handoff_msg.ObjectCount = objects.size();
+		Packet handoff;
+		EncodePacket( &handoff, &handoff_msg );
+		for( std::vector<GameObject*>::iterator obj_iter = objects.begin(); obj_iter != objects.end(); obj_iter ++ )
+		{
+			handoff.AddUInt( (*obj_iter)->ID );
+			handoff.AddUInt( (*obj_iter)->Type() );
+			(*obj_iter)->AddToInitPacket( &handoff );
+		}
+		
+		// If the neighbour didn't get it, keep everything here and try again next frame.
+		if( ShardLinks[ shard ]->Send( &handoff ) < 0 )
+			continue;
+		
+		for( PacketList<uint16_t,ShardPlayer>::iterator player_iter = handoff_msg.Players.begin(); player_iter != handoff_msg.Players.end(); player_iter ++ )
+		{
+			// Send the player's client to the new shard.
+			ShardRedirectMessage redirect_msg;
+			redirect_msg.Host = Shards.Shards[ shard ].Host;
+			redirect_msg.Port = Shards.Shards[ shard ].Port;
+			redirect_msg.Token = player_iter->Token;
+			Packet redirect;
+			EncodePacket( &redirect, &redirect_msg );
+			
+			if( ! Net.Lock.Lock() )
+				fprintf( stderr, "RaptorServer::MigrateObjects: Net.Lock.Lock: %s\n", SDL_GetError() );
+			for( std::list<ConnectedClient*>::iterator client_iter = Net.Clients.begin(); client_iter != Net.Clients.end(); client_iter ++ )
+			{
+				if( (*client_iter)->PlayerID != player_iter->ID )
+					continue;
+				
+				// The player is leaving quietly, so the client shouldn't be dropped as if they quit.
+				(*client_iter)->Send( &redirect );
+				(*client_iter)->Synchronized = false;
+				(*client_iter)->PlayerID = 0;
+			}
+			if( ! Net.Lock.Unlock() )
+				fprintf( stderr, "RaptorServer::MigrateObjects: Net.Lock.Unlock: %s\n", SDL_GetError() );
+			
+			PlayerRemoveMessage player_remove_msg;
+			player_remove_msg.PlayerID = player_iter->ID;
+			Packet player_remove;
+			EncodePacket( &player_remove, &player_remove_msg );
+			Net.SendAllSynchronized( &player_remove );
+			
+			Data.RemovePlayer( player_iter->ID );
+		}
+		
+		for( std::vector<GameObject*>::iterator obj_iter = objects.begin(); obj_iter != objects.end(); obj_iter ++ )
+			remove_msg.ObjectIDs.push_back( (*obj_iter)->ID );
+	}
+	
+	if( remove_msg.ObjectIDs.empty() )
+		return;
+	
+	for( PacketList<uint32_t,uint32_t>::iterator id_iter = remove_msg.ObjectIDs.begin(); id_iter != remove_msg.ObjectIDs.end(); id_iter ++ )
+		Data.RemoveObject( *id_iter );
+	
+	Packet objects_remove;
+	EncodePacket( &objects_remove, &remove_msg );
+	Net.SendAllSynchronized( &objects_remove );
+}
+
+
+void RaptorServer::SendGhosts( void )
+{
+	// Each neighbour gets copies of our objects near its slab, so things can collide across the border.
+	std::vector< std::vector<GameObject*> > nearby( Shards.size() );
+	for( std::map<uint32_t,GameObject*>::iterator obj_iter = Data.GameObjects.begin(); obj_iter != Data.GameObjects.end(); obj_iter ++ )
+	{
+		if( Data.GhostIDs.size() && Data.IsGhost( obj_iter->first ) )
+			continue;
+		
+		std::vector<int> shards = Shards.GhostShards( obj_iter->second->X, ShardIndex );
+		for( std::vector<int>::iterator shard_iter = shards.begin(); shard_iter != shards.end(); shard_iter ++ )
+			nearby[ *shard_iter ].push_back( obj_iter->second );
+	}
+	
+	for( size_t shard = 0; shard < ShardLinks.size(); shard ++ )
+	{
+		if( (! ShardLinks[ shard ]) || (! ShardLinks[ shard ]->Connected) )
+			continue;
+		
+		// Objects the neighbour already has a ghost of only need updates; IDs reused for another type start over.
+		ShardGhostsMessage ghosts_msg;
+		std::map<uint32_t,uint32_t> sending;
+		std::vector<GameObject*> added, updated;
+		for( std::vector<GameObject*>::iterator obj_iter = nearby[ shard ].begin(); obj_iter != nearby[ shard ].end(); obj_iter ++ )
+		{
+			sending[ (*obj_iter)->ID ] = (*obj_iter)->Type();
+			std::map<uint32_t,uint32_t>::iterator sent_iter = GhostsSent[ shard ].find( (*obj_iter)->ID );
+			if( (sent_iter != GhostsSent[ shard ].end()) && (sent_iter->second == (*obj_iter)->Type()) )
+				updated.push_back( *obj_iter );
+			else
+			{
+				if( sent_iter != GhostsSent[ shard ].end() )
+					ghosts_msg.RemovedIDs.push_back( sent_iter->first );
+				added.push_back( *obj_iter );
+			}
+		}
+		for( std::map<uint32_t,uint32_t>::iterator sent_iter = GhostsSent[ shard ].begin(); sent_iter != GhostsSent[ shard ].end(); sent_iter ++ )
+		{
+			if( sending.find( sent_iter->first ) == sending.end() )
+				ghosts_msg.RemovedIDs.push_back( sent_iter->first );
+		}
+		
+		if( ghosts_msg.RemovedIDs.empty() && added.empty() && updated.empty() )
+			continue;
+		
+		ghosts_msg.Precision = Net.Precision;
+		ghosts_msg.AddedCount = added.size();
+		ghosts_msg.UpdatedCount = updated.size();
+		Packet ghosts;
+		EncodePacket( &ghosts, &ghosts_msg );
+		for( std::vector<GameObject*>::iterator obj_iter = added.begin(); obj_iter != added.end(); obj_iter ++ )
+		{
+			ghosts.AddUInt( (*obj_iter)->ID );
+			ghosts.AddUInt( (*obj_iter)->Type() );
+			(*obj_iter)->AddToInitPacket( &ghosts, ghosts_msg.Precision );
+		}
+		for( std::vector<GameObject*>::iterator obj_iter = updated.begin(); obj_iter != updated.end(); obj_iter ++ )
+		{
+			ghosts.AddUInt( (*obj_iter)->ID );
+			(*obj_iter)->AddToUpdatePacketFromServer( &ghosts, ghosts_msg.Precision );
+		}
+		
+		if( ShardLinks[ shard ]->Send( &ghosts ) >= 0 )
+			GhostsSent[ shard ] = sending;
+	}
+}
+
+
+void RaptorServer::ClearShards( void )
+{
+	for( std::vector<ShardLink*>::iterator link_iter = ShardLinks.begin(); link_iter != ShardLinks.end(); link_iter ++ )
+		delete *link_iter;
+	
+	ShardLinks.clear();
+	GhostsSent.clear();
+	GhostOwners.clear();
+	ShardArrivals.clear();
+}
+
+
+bool RaptorServer::ProcessShardHello( ShardHelloMessage *msg, Packet *packet, ConnectedClient *from_client )
+{
+	if( (! ShardMode) || (msg->Game != Game) || (msg->Version != Version) || (msg->ShardIndex >= Shards.size()) || ((int) msg->ShardIndex == ShardIndex) )
+	{
+		from_client->DisconnectNice( "Shard configuration mismatch." );
+		return true;
+	}
+	
+	// This connection is a neighbour sending us handoffs and ghosts, not a player.
+	from_client->ShardPeer = msg->ShardIndex;
+	
+	char cstr[ 1024 ] = "";
+	snprintf( cstr, 1024, "Shard %i linked to us.", from_client->ShardPeer );
+	ConsolePrint( cstr );
+	return true;
+}
+
+
+bool RaptorServer::ProcessShardHandoff( ShardHandoffMessage *msg, Packet *packet, ConnectedClient *from_client )
+{
+	if( from_client->ShardPeer < 0 )
+		return false;
+	
+	// Players are added now so their objects have owners, but nobody hears about them until their client logs in.
+	for( PacketList<uint16_t,ShardPlayer>::iterator player_iter = msg->Players.begin(); player_iter != msg->Players.end(); player_iter ++ )
+	{
+		Player *player = Data.GetPlayer( player_iter->ID );
+		if( ! player )
+		{
+			player = NewPlayer( player_iter->ID );
+			Data.AddPlayer( player );
+		}
+		
+		player->Name = player_iter->Name;
+		for( PacketList<uint16_t,PacketProperty>::iterator property_iter = player_iter->Properties.begin(); property_iter != player_iter->Properties.end(); property_iter ++ )
+			player->Properties.Set( property_iter->Name, property_iter->Value );
+		player->Properties.Changed.clear();
+		
+		ShardArrivals[ player_iter->Token ] = std::pair<uint16_t,double>( player_iter->ID, ShardClock.ElapsedSeconds() );
+	}
+	
+	// Objects replace any ghosts we had of them.
+	ObjectsRemoveMessage remove_msg;
+	std::vector<GameObject*> added;
+	uint32_t obj_count = msg->ObjectCount;
+	while( obj_count )
+	{
+		obj_count --;
+		
+		uint32_t id = packet->NextUInt();
+		uint32_t type = packet->NextUInt();
+		if( Data.GetObject( id ) )
+		{
+			Data.RemoveObject( id );
+			GhostOwners.erase( id );
+			remove_msg.ObjectIDs.push_back( id );
+		}
+		
+		GameObject *obj = NewObject( id, type );
+		Data.AddObject( obj );
+		obj->ReadFromInitPacket( packet );
+		added.push_back( obj );
+	}
+	
+	if( remove_msg.ObjectIDs.size() )
+	{
+		Packet objects_remove;
+		EncodePacket( &objects_remove, &remove_msg );
+		Net.SendAllSynchronized( &objects_remove );
+	}
+	
+	if( added.size() )
+	{
+		ObjectsAddMessage add_msg;
+		add_msg.ObjectCount = added.size();
+		Packet objects_add;
+		EncodePacket( &objects_add, &add_msg );
+		for( std::vector<GameObject*>::iterator obj_iter = added.begin(); obj_iter != added.end(); obj_iter ++ )
+		{
+			objects_add.AddUInt( (*obj_iter)->ID );
+			objects_add.AddUInt( (*obj_iter)->Type() );
+			(*obj_iter)->AddToInitPacket( &objects_add );
+		}
+		Net.SendAllSynchronized( &objects_add );
+	}
+	
+	return true;
+}
+
+
+bool RaptorServer::ProcessShardGhosts( ShardGhostsMessage *msg, Packet *packet, ConnectedClient *from_client )
+{
+	if( from_client->ShardPeer < 0 )
+		return false;
+	
+	ObjectsRemoveMessage remove_msg;
+	for( PacketList<uint32_t,uint32_t>::iterator id_iter = msg->RemovedIDs.begin(); id_iter != msg->RemovedIDs.end(); id_iter ++ )
+	{
+		if( Data.IsGhost( *id_iter ) )
+		{
+			Data.RemoveObject( *id_iter );
+			GhostOwners.erase( *id_iter );
+			remove_msg.ObjectIDs.push_back( *id_iter );
+		}
+	}
+	
+	std::vector<GameObject*> added;
+	for( uint32_t i = 0; i < msg->AddedCount; i ++ )
+	{
+		uint32_t id = packet->NextUInt();
+		uint32_t type = packet->NextUInt();
+		GameObject *obj = NewObject( id, type );
+		
+		// If it was just handed to us, the neighbour hadn't heard yet; read past its data and keep ours.
+		if( Data.GetObject( id ) && ! Data.IsGhost( id ) )
+		{
+			obj->ReadFromInitPacket( packet, msg->Precision );
+			delete obj;
+			continue;
+		}
+		
+		if( Data.IsGhost( id ) )
+		{
+			Data.RemoveObject( id );
+			remove_msg.ObjectIDs.push_back( id );
+		}
+		
+		Data.AddObject( obj );
+		obj->ReadFromInitPacket( packet, msg->Precision );
+		Data.GhostIDs.insert( id );
+		GhostOwners[ id ] = from_client->ShardPeer;
+		added.push_back( obj );
+	}
+	
+	for( uint32_t i = 0; i < msg->UpdatedCount; i ++ )
+	{
+		uint32_t id = packet->NextUInt();
+		GameObject *obj = Data.GetObject( id );
+		
+		// Anything else would leave the rest of the packet misaligned, so stop there.
+		if( (! obj) || ! Data.IsGhost( id ) )
+			break;
+		
+		obj->ReadFromUpdatePacketFromServer( packet, msg->Precision );
+	}
+	
+	// Clients see ghosts like any other object, and get updates for them with everything else.
+	if( remove_msg.ObjectIDs.size() )
+	{
+		Packet objects_remove;
+		EncodePacket( &objects_remove, &remove_msg );
+		Net.SendAllSynchronized( &objects_remove );
+	}
+	
+	if( added.size() )
+	{
+		ObjectsAddMessage add_msg;
+		add_msg.ObjectCount = added.size();
+		Packet objects_add;
+		EncodePacket( &objects_add, &add_msg );
+		for( std::vector<GameObject*>::iterator obj_iter = added.begin(); obj_iter != added.end(); obj_iter ++ )
+		{
+			objects_add.AddUInt( (*obj_iter)->ID );
+			objects_add.AddUInt( (*obj_iter)->Type() );
+			(*obj_iter)->AddToInitPacket( &objects_add );
+		}
+		Net.SendAllSynchronized( &objects_add );
+	}
+	
+	return true;
+}
+
+
+void RaptorServer::DroppedShardPeer( ConnectedClient *client )
+{
+	char cstr[ 1024 ] = "";
+	snprintf( cstr, 1024, "Shard %i unlinked.", client->ShardPeer );
+	ConsolePrint( cstr );
+	
+	// Ghosts from a neighbour we can't hear from anymore would never move again.
+	ObjectsRemoveMessage remove_msg;
+	for( std::map<uint32_t,int>::iterator owner_iter = GhostOwners.begin(); owner_iter != GhostOwners.end(); )
+	{
+		std::map<uint32_t,int>::iterator owner_next = owner_iter;
+		owner_next ++;
+		
+		if( owner_iter->second == client->ShardPeer )
+		{
+			Data.RemoveObject( owner_iter->first );
+			remove_msg.ObjectIDs.push_back( owner_iter->first );
+			GhostOwners.erase( owner_iter );
+		}
+		
+		owner_iter = owner_next;
+	}
+	
+	if( remove_msg.ObjectIDs.size() )
+	{
+		Packet objects_remove;
+		EncodePacket( &objects_remove, &remove_msg );
+		Net.SendAllSynchronized( &objects_remove );
+	}
+}
+
+
+uint16_t RaptorServer::ClaimShardArrival( std::string token )
+{
+	if( token.empty() )
+		return 0;
+	
+	std::map< std::string, std::pair<uint16_t,double> >::iterator arrival_iter = ShardArrivals.find( token );
+	if( arrival_iter == ShardArrivals.end() )
+		return 0;
+	
+	uint16_t player_id = arrival_iter->second.first;
+	ShardArrivals.erase( arrival_iter );
+	return Data.GetPlayer( player_id ) ? player_id : 0;
+}
+
+
+std::string RaptorServer::ShardStatus( void )
+{
+	if( ! ShardMode )
+		return "Server is not sharded.";
+	
+	std::string status;
+	char cstr[ 1024 ] = "";
+	for( size_t i = 0; i < Shards.size(); i ++ )
+	{
+		const char *link_status = "this server";
+		if( (int) i != ShardIndex )
+			link_status = (ShardLinks[ i ] && ShardLinks[ i ]->Connected) ? "linked" : "not linked";
+		snprintf( cstr, 1024, "Shard %i: %s:%i (%s)\n", (int) i, Shards.Shards[ i ].Host.c_str(), Shards.Shards[ i ].Port, link_status );
+		status += cstr;
+	}
+	snprintf( cstr, 1024, "Ghosts: %i", (int) GhostOwners.size() );
+	status += cstr;
+	return status;
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+std::string RaptorServer::ReplayJournal( std::string filename )
+{
+	// Runs on the calling thread instead of RaptorServerThread, so the server must not already be running.
+	if( IsRunning() )
+		return "Can't replay a journal while the server is running.";
+	
+	JournalReader journal;
+	if( ! journal.Open( filename ) )
+		return std::string("Could not read server journal: ") + filename;
+	if( journal.Header.Game != Game )
+		return filename + std::string(" was recorded by ") + journal.Header.Game + std::string(", not ") + Game + std::string(".");
+	
+	// Start from the same random sequence as the recorded server, then feed it everything it received as fast as possible.
+	RelayMode = false;
+	ShardMode = false;
+	RandomSeed = journal.Header.Seed;
+	Rand::Seed( RandomSeed );
+	State = Raptor::State::CONNECTED;
+	Started();
+	
+	// Journal client IDs are never reused, so a dropped client's entry stays NULL to ignore anything after it.
+	std::map<uint32_t,ConnectedClient*> clients;
+	uint32_t packets = 0, ticks = 0, worst_tick = 0;
+	double game_seconds = 0., tick_seconds = 0., max_tick_seconds = 0.;
+	Clock replay_clock, tick_clock;
+	
+	// Timers and object clocks follow game time during replay, so updates go out as often as they did when recorded.
+	// Only this server's own clocks are switched; replay_clock and tick_clock still measure how long it really takes.
+	ReplayTime.Set( 0. );
+	Data.SetTimeSource( &ReplayTime );
+	Timers.Clear();
+	
+	while( Packet *record = journal.Next() )
+	{
+		if( record->Type() == JournalPacket::TYPE )
+		{
+			JournalPacket journal_packet;
+			if( DecodePacket( record, &journal_packet ) && (record->Offset + PACKET_HEADER_SIZE <= record->Size()) )
+			{
+				std::map<uint32_t,ConnectedClient*>::iterator client_iter = clients.find( journal_packet.ClientID );
+				if( client_iter == clients.end() )
+				{
+					// Clients without a socket don't start network threads, and count what they would have sent.
+					ConnectedClient *client = new ConnectedClient( this, NULL, false, NetRate, Net.Precision );
+					client->ClientID = journal_packet.ClientID;
+					
+					if( ! Net.Lock.Lock() )
+						fprintf( stderr, "RaptorServer::ReplayJournal: Net.Lock.Lock: %s\n", SDL_GetError() );
+					Net.Clients.push_back( client );
+					if( ! Net.Lock.Unlock() )
+						fprintf( stderr, "RaptorServer::ReplayJournal: Net.Lock.Unlock: %s\n", SDL_GetError() );
+					
+					client_iter = clients.insert( std::pair<uint32_t,ConnectedClient*>( journal_packet.ClientID, client ) ).first;
+				}
+				
+				if( client_iter->second && client_iter->second->Connected )
+				{
+					Packet received( record->Data + record->Offset, record->Size() - record->Offset );
+					Handlers.Predecode( this, &received );
+					client_iter->second->ProcessPacket( &received );
+					packets ++;
+				}
+			}
+		}
+		else if( record->Type() == JournalTick::TYPE )
+		{
+			JournalTick tick;
+			if( DecodePacket( record, &tick ) )
+			{
+				tick_clock.Reset();
+				
+				FrameTime = tick.dT;
+				ReplayTime.Advance( FrameTime );
+				Timers.AdvanceTo( game_seconds + FrameTime );
+				Update( FrameTime );
+				
+				// RemoveDisconnectedClients deletes them, so forget them first.
+				for( std::map<uint32_t,ConnectedClient*>::iterator client_iter = clients.begin(); client_iter != clients.end(); client_iter ++ )
+				{
+					if( client_iter->second && ! client_iter->second->Connected )
+						client_iter->second = NULL;
+				}
+				
+				Net.RemoveDisconnectedClients();
+				SendPropertyChanges();
+				Net.SendUpdates();
+				
+				double elapsed = tick_clock.ElapsedSeconds();
+				ticks ++;
+				game_seconds += tick.dT;
+				tick_seconds += elapsed;
+				if( elapsed > max_tick_seconds )
+				{
+					max_tick_seconds = elapsed;
+					worst_tick = tick.Tick;
+				}
+			}
+		}
+		else if( record->Type() == JournalDrop::TYPE )
+		{
+			JournalDrop drop;
+			if( DecodePacket( record, &drop ) )
+			{
+				std::map<uint32_t,ConnectedClient*>::iterator client_iter = clients.find( drop.ClientID );
+				if( (client_iter != clients.end()) && client_iter->second )
+					client_iter->second->Disconnect();
+			}
+		}
+		
+		delete record;
+	}
+	
+	double replay_seconds = replay_clock.ElapsedSeconds();
+	
+	Net.Disconnect();
+	Net.RemoveDisconnectedClients();
+	Data.Clear();
+	State = Raptor::State::DISCONNECTED;
+	Stopped();
+	Data.SetTimeSource( NULL );
+	
+	char cstr[ 1024 ] = "";
+	snprintf( cstr, 1024, "Replayed %i packets from %i clients over %i ticks (%.1f game seconds) in %.3f seconds.\nTick time: %.3fms average, %.3fms worst (tick %i).",
+		packets, (int) clients.size(), ticks, game_seconds, replay_seconds,
+		ticks ? (tick_seconds * 1000. / ticks) : 0., max_tick_seconds * 1000., worst_tick );
+	return std::string(cstr);
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+void RaptorServer::StartReplication( void )
+{
+	PublishedSnapshot = NULL;
+	CapturedSnapshot = NULL;
+	
+	// Without workers there's nobody to build updates while the server thread runs the next tick.
+	Replicating = ParallelReplication && Replication.Jobs->Threads();
+	Data.TrackRemovals = Replicating;
+}
+
+
+void RaptorServer::StopReplication( void )
+{
+	FinishReplication();
+	
+	Replicating = false;
+	Data.TrackRemovals = false;
+	if( ! Data.SnapshotLock.Lock() )
+		fprintf( stderr, "RaptorServer::StopReplication: Data.SnapshotLock.Lock: %s\n", SDL_GetError() );
+	Data.RemovedSinceSnapshot.clear();
+	if( ! Data.SnapshotLock.Unlock() )
+		fprintf( stderr, "RaptorServer::StopReplication: Data.SnapshotLock.Unlock: %s\n", SDL_GetError() );
+	
+	PublishedSnapshot = NULL;
+	CapturedSnapshot = NULL;
+	Snapshots[ 0 ].Clear();
+	Snapshots[ 1 ].Clear();
+}
+
+
+void RaptorServer::CaptureSnapshot( void )
+{
+	if( ! Replicating )
+		return;
+	
+	// Objects without the standard update layout are written now for every precision a client might need.
+	std::set<int8_t> precisions;
+	if( ! Net.Lock.Lock() )
+		fprintf( stderr, "RaptorServer::CaptureSnapshot: Net.Lock.Lock: %s\n", SDL_GetError() );
+	for( std::list<ConnectedClient*>::iterator client_iter = Net.Clients.begin(); client_iter != Net.Clients.end(); client_iter ++ )
+	{
+		if( (*client_iter)->Precision == -128 )
+		{
+			precisions.insert( 127 );
+			precisions.insert( 0 );
+			precisions.insert( -127 );
+		}
+		else
+			precisions.insert( (*client_iter)->Precision );
+	}
+	if( ! Net.Lock.Unlock() )
+		fprintf( stderr, "RaptorServer::CaptureSnapshot: Net.Lock.Unlock: %s\n", SDL_GetError() );
+	
+	// Fill whichever buffer the replication threads aren't reading.
+	CapturedSnapshot = (PublishedSnapshot == &(Snapshots[ 0 ])) ? &(Snapshots[ 1 ]) : &(Snapshots[ 0 ]);
+	CapturedSnapshot->Capture( &Data, &precisions );
+}
+
+
+void RaptorServer::FinishReplication( void )
+{
+	// Help with anything still queued, then wait for the rest so clients can be changed or removed safely.
+	Replication.Wait();
+	
+	if( CapturedSnapshot )
+	{
+		PublishedSnapshot = CapturedSnapshot;
+		CapturedSnapshot = NULL;
+		
+		// The new snapshot was taken after these were removed, so it already leaves them out.
+		if( ! Data.SnapshotLock.Lock() )
+			fprintf( stderr, "RaptorServer::FinishReplication: Data.SnapshotLock.Lock: %s\n", SDL_GetError() );
+		Data.RemovedSinceSnapshot.clear();
+		if( ! Data.SnapshotLock.Unlock() )
+			fprintf( stderr, "RaptorServer::FinishReplication: Data.SnapshotLock.Unlock: %s\n", SDL_GetError() );
+	}
+}
+
+
+bool RaptorServer::QueueReplication( ConnectedClient *client )
+{
+	// Clients still receiving the object list, or without their own send thread, are updated on the server thread.
+	if( ! Replicating || ! PublishedSnapshot || ! client->Synchronized || ! client->UseOutThread || client->SyncPending.size() )
+		return false;
+	
+	Replication.Add( new ReplicationTask( this, client ) );
+	return true;
+}
+
+
+void RaptorServer::SendSnapshotUpdate( ConnectedClient *client, int8_t precision )
+{
+	// This runs on job system workers, so it must only read the published snapshot and this client.
+	const GameSnapshot *snapshot = PublishedSnapshot;
+	
+	uint32_t keepalive_slots = std::max<int>( 1, client->NetRate * UpdateKeepAlive + 0.5 );
+	uint32_t keepalive_slot = client->KeepAliveSlot % keepalive_slots;
+	client->KeepAliveSlot = keepalive_slot + 1;
+	
+	// Objects removed since the snapshot are left out.  If more are removed while building the packet, build it again,
+	// so an update can never reach the client after the removal that the server thread is about to send.
+	std::set<uint32_t> removed;
+	for( ; ; )
+	{
+		if( ! Data.SnapshotLock.Lock() )
+			fprintf( stderr, "RaptorServer::SendSnapshotUpdate: Data.SnapshotLock.Lock: %s\n", SDL_GetError() );
+		removed = Data.RemovedSinceSnapshot;
+		if( ! Data.SnapshotLock.Unlock() )
+			fprintf( stderr, "RaptorServer::SendSnapshotUpdate: Data.SnapshotLock.Unlock: %s\n", SDL_GetError() );
+		
+		std::vector<const SnapshotObject*> objects_to_update;
+		for( size_t i = 0; i < snapshot->ObjectCount; i ++ )
+		{
+			const SnapshotObject *obj = &(snapshot->Objects[ i ]);
+			
+			if( removed.size() && (removed.find( obj->State.ID ) != removed.end()) )
+				continue;
+			
+			if( (obj->ChangedVersion <= client->SentChangeVersion) && (obj->Sleeping || (obj->State.ID % keepalive_slots != keepalive_slot)) && obj->TracksChanges )
+				continue;
+			
+			if( client->PlayerID && (client->PlayerID == obj->State.PlayerID) )
+			{
+				if( obj->UpdatePlayer )
+					objects_to_update.push_back( obj );
+			}
+			else if( obj->UpdateOthers )
+				objects_to_update.push_back( obj );
+		}
+		
+		int8_t update_precision = UpdatePrecision( precision, objects_to_update.size() );
+		
+		Packet update_packet = Packet( Raptor::Packet::UPDATE );
+		update_packet.AddChar( update_precision );
+		update_packet.AddUInt( objects_to_update.size() );
+		for( std::vector<const SnapshotObject*>::iterator obj_iter = objects_to_update.begin(); obj_iter != objects_to_update.end(); obj_iter ++ )
+		{
+			update_packet.AddUInt( (*obj_iter)->State.ID );
+			(*obj_iter)->AddToUpdatePacket( &update_packet, update_precision );
+		}
+		
+		if( ! Data.SnapshotLock.Lock() )
+			fprintf( stderr, "RaptorServer::SendSnapshotUpdate: Data.SnapshotLock.Lock: %s\n", SDL_GetError() );
+		
+		bool current = (Data.RemovedSinceSnapshot.size() == removed.size());
+		if( current )
+		{
+			client->SentChangeVersion = snapshot->ChangeVersion;
+			if( objects_to_update.size() )
+				client->Send( &update_packet );
+		}
+		
+		if( ! Data.SnapshotLock.Unlock() )
+			fprintf( stderr, "RaptorServer::SendSnapshotUpdate: Data.SnapshotLock.Unlock: %s\n", SDL_GetError() );
+		
+		if( current )
+			break;
+	}
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+void RaptorServer::ChangeState( int state )
+{
+	State = state;
+}
+
+
+Packet *RaptorServer::InfoPacket( void )
+{
+	// Only rebuild the announcement when server properties or the player list have changed.
+	if( CachedInfo && (CachedInfoVersion == Data.InfoVersion) )
+		return CachedInfo;
+	
+	if( ! CachedInfo )
+		CachedInfo = new Packet( Raptor::Packet::INFO );
+	
+	CachedInfoVersion = Data.InfoVersion;
+	
+	InfoAnnounceMessage announce;
+	
+	// Properties.
+	char port_str[ 32 ] = "";
+	snprintf( port_str, 32, "%i", Port );
+	announce.Properties.push_back( PacketProperty( "game", Game ) );
+	announce.Properties.push_back( PacketProperty( "version", Version ) );
+	announce.Properties.push_back( PacketProperty( "port", port_str ) );
+	for( std::map<uint16_t,PropertyValue>::iterator value_iter = Data.Properties.Values.begin(); value_iter != Data.Properties.Values.end(); value_iter ++ )
+		announce.Properties.push_back( PacketProperty( Data.PropertyKeyIDs.Name( value_iter->first ), value_iter->second.Value ) );
+	
+	// Players.
+	for( std::map<uint16_t,Player*>::iterator player_iter = Data.Players.begin(); player_iter != Data.Players.end(); player_iter ++ )
+		announce.PlayerNames.push_back( player_iter->second->Name );
+	
+	EncodePacket( CachedInfo, &announce );
+	return CachedInfo;
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+int RaptorServer::RaptorServerThread( void *game_server )
+{
+	((RaptorServer*) game_server)->Net.Initialize( ((RaptorServer*) game_server)->Port );
+	
+	char cstr[ 1024 ] = "";
+	
+	if( ((RaptorServer*) game_server)->Net.Listening )
+	{
+		snprintf( cstr, 1024, "%s server started on port %i.", ((RaptorServer*) game_server)->Game.c_str(), ((RaptorServer*) game_server)->Port );
+		((RaptorServer*) game_server)->ConsolePrint( cstr );
+		
+		// Relays log in to the upstream server like any other client.
+		if( ((RaptorServer*) game_server)->RelayMode )
+		{
+			if( ((RaptorServer*) game_server)->Relay.Connect( ((RaptorServer*) game_server)->RelayHost, ((RaptorServer*) game_server)->RelayPort, ((RaptorServer*) game_server)->Data.Properties.Get( "name", ((RaptorServer*) game_server)->Game ), "" ) < 0 )
+				((RaptorServer*) game_server)->Net.Disconnect();
+		}
+		
+		// Relays pass along what they receive, so only servers running the game encode updates from snapshots.
+		if( ! ((RaptorServer*) game_server)->RelayMode )
+		{
+			// The job system is shared with the rest of the process, so it's only started here if nothing else has.
+			JobSystem *jobs = JobSystem::Shared();
+			if( ((RaptorServer*) game_server)->JobThreads && ! jobs->Threads() )
+			{
+				jobs->PinThreads = ((RaptorServer*) game_server)->PinJobThreads;
+				jobs->Start( ((RaptorServer*) game_server)->JobThreads );
+			}
+			if( jobs->Threads() )
+				((RaptorServer*) game_server)->Data.Jobs = jobs;
+			
+			((RaptorServer*) game_server)->StartReplication();
+		}
+		
+		NetUDP ServerAnnouncer;
+		ServerAnnouncer.Initialize();
+		
+		// Listen for LAN browsers asking for server info on demand.  By default that's on the port after ours, so servers sharing a host don't collide.
+		int query_port = (((RaptorServer*) game_server)->QueryPort < 0) ? (((RaptorServer*) game_server)->Port + 1) : ((RaptorServer*) game_server)->QueryPort;
+		if( query_port > 0 )
+		{
+			if( ServerAnnouncer.StartListening( query_port ) < 0 )
+			{
+				snprintf( cstr, 1024, "Could not listen for info queries on port %i.", query_port );
+				((RaptorServer*) game_server)->ConsolePrint( cstr, TextConsole::MSG_ERROR );
+			}
+		}
+		
+		Clock GameClock;
+		((RaptorServer*) game_server)->Timers.Clear();
+		TimerCountdown AnnounceTimer;
+		bool sleep_longer = false;
+		
+		while( ((RaptorServer*) game_server)->Net.Listening )
+		{
+			// Process network input buffers (one packet per client).
+			((RaptorServer*) game_server)->Net.ProcessTop();
+			
+			// Calculate the time elapsed for the "frame".
+			double elapsed = GameClock.ElapsedSeconds();
+			if( (((RaptorServer*) game_server)->MaxFPS <= 0.0) || ( (elapsed > 0.0) && ((1.0 / elapsed) <= ((RaptorServer*) game_server)->MaxFPS) ) )
+			{
+				((RaptorServer*) game_server)->FrameTime = GameClock.ElapsedSeconds();
+				GameClock.Reset();
+				
+				// Fire any timers that came due since last frame.
+				((RaptorServer*) game_server)->Timers.Advance();
+				
+				// Update location, or just mirror the upstream server if we're a relay.
+				if( ((RaptorServer*) game_server)->RelayMode )
+					((RaptorServer*) game_server)->UpdateRelay();
+				else
+				{
+					((RaptorServer*) game_server)->Journal.RecordTick( ((RaptorServer*) game_server)->FrameTime );
+					((RaptorServer*) game_server)->Update( ((RaptorServer*) game_server)->FrameTime );
+					
+					// Hand off objects that left our part of the world, and share the ones near its borders.
+					if( ((RaptorServer*) game_server)->ShardMode )
+						((RaptorServer*) game_server)->UpdateShards();
+					
+					// Copy this tick's replicated state so updates can be built from it while the next tick runs.
+					((RaptorServer*) game_server)->CaptureSnapshot();
+				}
+				
+				// Updates from the previous snapshot must be done before clients are changed or removed.
+				((RaptorServer*) game_server)->FinishReplication();
+				
+				// Drop disconnected clients from the list.
+				((RaptorServer*) game_server)->Net.RemoveDisconnectedClients();
+				
+				// Send property changes made this frame, then periodic updates to clients.
+				((RaptorServer*) game_server)->SendPropertyChanges();
+				((RaptorServer*) game_server)->Net.SendUpdates();
+
+				// Send periodic server announcements over UDP broadcast.  An interval of 0 means only answer queries.
+				if( ((RaptorServer*) game_server)->Announce && (((RaptorServer*) game_server)->AnnounceInterval > 0.) && (! AnnounceTimer.Scheduled()) )
+				{
+					((RaptorServer*) game_server)->Timers.Schedule( &AnnounceTimer, ((RaptorServer*) game_server)->AnnounceInterval );
+					ServerAnnouncer.Broadcast( ((RaptorServer*) game_server)->InfoPacket(), ((RaptorServer*) game_server)->AnnouncePort );
+				}
+				
+				// Answer info queries directly to whoever asked.
+				while( NetUDPPacket *query = ServerAnnouncer.GetPacket() )
+				{
+					if( ((RaptorServer*) game_server)->Announce && (query->Type() == Raptor::Packet::INFO_QUERY) )
+					{
+						// Queries may specify which port they are listening for the reply on.
+						InfoQueryMessage info_query;
+						info_query.ReplyPort = ((RaptorServer*) game_server)->AnnouncePort;
+						if( DecodePacket( query, &info_query ) )
+						{
+							IPaddress ip;
+							ip.host = query->IP;
+							Endian::WriteBig16( info_query.ReplyPort, &(ip.port) );
+							ServerAnnouncer.Send( ((RaptorServer*) game_server)->InfoPacket(), &ip );
+						}
+					}
+					
+					delete query;
+				}
+				
+				// Don't work very hard if nobody is connected.
+				sleep_longer = ( ((RaptorServer*) game_server)->Net.Clients.size() < 1 );
+			}
+			
+			// Let the thread rest a bit.
+			SDL_Delay( sleep_longer ? 100 : 1 );
+		}
+		
+		((RaptorServer*) game_server)->StopReplication();
+		((RaptorServer*) game_server)->Data.Jobs = NULL;
+		
+		snprintf( cstr, 1024, "%s server stopped.", ((RaptorServer*) game_server)->Game.c_str() );
+		((RaptorServer*) game_server)->ConsolePrint( cstr );
+	}
+	else
+	{
+		snprintf( cstr, 1024, "%s server failed to start.", ((RaptorServer*) game_server)->Game.c_str() );
+		((RaptorServer*) game_server)->ConsolePrint( cstr, TextConsole::MSG_ERROR );
+	}
+	
+	((RaptorServer*) game_server)->Thread = NULL;
+	((RaptorServer*) game_server)->State = Raptor::State::DISCONNECTED;
+	return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+ReplicationTask::ReplicationTask( RaptorServer *server, ConnectedClient *client )
+{
+	Server = server;
+	Client = client;
+	DeleteWhenDone = true;
+}
+
+
+ReplicationTask::~ReplicationTask()
+{
+}
+
+
+void ReplicationTask::Run( void )
+{
+	Server->SendSnapshotUpdate( Client, Client->Precision );
 }
@@ -4,16 +4,30 @@
 
 #pragma once
 class RaptorServer;
+class ReplicationTask;
 
 #include "PlatformSpecific.h"
 
 #include <string>
+#include <vector>
+#include <map>
+#include <list>
 #include <SDL/SDL.h>
 #include <SDL/SDL_thread.h>
 #include "NetServer.h"
+#include "RelayClient.h"
+#include "ShardMap.h"
+#include "ShardLink.h"
+#include "PacketJournal.h"
 #include "Packet.h"
+#include "PacketRegistry.h"
+#include "Messages.h"
 #include "GameData.h"
+#include "GameSnapshot.h"
 #include "TextConsole.h"
+#include "Clock.h"
+#include "TimerWheel.h"
+#include "JobSystem.h"
 
 
 class RaptorServer
@@ -23,6 +37,7 @@ public:
 	std::string Version;
 	
 	NetServer Net;
+	RelayClient Relay;
 	SDL_Thread *Thread;
 	TextConsole *Console;
 	int Port;
@@ -30,13 +45,43 @@ public:
 	double NetRate;
 	bool Announce;
 	double AnnounceInterval;
+	int AnnouncePort;
+	// Port to answer INFO_QUERY packets on; -1 means Port + 1, and 0 turns queries off.
+	int QueryPort;
 	bool UseOutThreads;
+	uint32_t SyncChunkSize;
+	std::string RelayHost;
+	int RelayPort;
+	ShardMap Shards;
+	int ShardIndex;
+	std::vector<ShardLink*> ShardLinks;
+	double GhostRate;
+	double UpdateKeepAlive;
+	std::string JournalFile;
+	PacketJournal Journal;
+	uint32_t RandomSeed;
+	
+	// Build client updates from the last tick's snapshot on the shared job system while the next tick runs.
+	bool ParallelReplication;
+	
+	// Threads for the shared job system if nothing has started it yet; -1 uses one less than the number of cores, 0 does everything on the server thread.
+	int JobThreads;
+	bool PinJobThreads;
 	
 	double FrameTime;
 	
 	volatile int State;
 	GameData Data;
 	
+	// Timers that come due on the server thread, advanced once per frame.
+	TimerWheel Timers;
+	
+	// Game time while replaying a journal, so Clocks started during the replay follow the recorded ticks.
+	VirtualTimeSource ReplayTime;
+	
+	PacketRegistry<RaptorServer,ConnectedClient*> Handlers;
+	PacketRegistry<RaptorServer> RelayHandlers;
+	
 	
 	RaptorServer( std::string game, std::string version );
 	virtual ~RaptorServer();
@@ -53,14 +98,108 @@ public:
 	virtual void Started( void );
 	virtual void Stopped( void );
 	virtual bool ProcessPacket( Packet *packet, ConnectedClient *from_client );
+	bool DecodeUpdate( UpdateMessage *msg, Packet *packet );
+	bool ProcessUpdate( UpdateMessage *msg, Packet *packet, ConnectedClient *from_client );
+	bool ProcessPlayerProperties( PlayerPropertiesMessage *msg, Packet *packet, ConnectedClient *from_client );
+	bool ProcessInfo( InfoMessage *msg, Packet *packet, ConnectedClient *from_client );
+	bool ProcessMessage( TextMessage *msg, Packet *packet, ConnectedClient *from_client );
 	virtual bool ValidateLogin( std::string name, std::string password );
 	virtual void AcceptedClient( ConnectedClient *client );
+	void AcceptedSpectator( ConnectedClient *client );
+	void SendPlayers( ConnectedClient *client );
+	void QueueSync( ConnectedClient *client );
 	virtual void DroppedClient( ConnectedClient *client );
 	virtual void SendUpdate( ConnectedClient *client, int8_t precision = 0 );
+	static int8_t UpdatePrecision( int8_t precision, size_t object_count );
+	virtual double SyncPriority( ConnectedClient *client, const GameObject *obj, const std::vector<Pos3D> *owned_positions );
+	void SendSyncChunk( ConnectedClient *client );
+	void AddPropertyKeys( PropertyDeltaMessage *msg );
+	void AddPropertyStore( PropertyDeltaMessage *msg, uint16_t player_id, const PropertyStore *store, bool changed_only );
+	void SendPropertyChanges( void );
+	
+	void SetRelay( std::string host );
+	bool Relaying( void ) const;
+	void UpdateRelay( void );
+	bool ProcessRelayPacket( Packet *packet );
+	bool ProcessSpectatorPacket( Packet *packet, ConnectedClient *from_client );
+	bool DecodeRelayUpdate( UpdateMessage *msg, Packet *packet );
+	bool RelayUpdate( UpdateMessage *msg, Packet *packet );
+	bool RelayObjectsAdd( ObjectsAddMessage *msg, Packet *packet );
+	bool RelayObjectsRemove( ObjectsRemoveMessage *msg, Packet *packet );
+	bool RelayObjectsClear( ObjectsClearMessage *msg, Packet *packet );
+	bool RelaySyncProgress( SyncProgressMessage *msg, Packet *packet );
+	bool RelayPlayerList( PlayerListMessage *msg, Packet *packet );
+	bool RelayPlayerAdd( PlayerAddMessage *msg, Packet *packet );
+	bool RelayPlayerRemove( PlayerRemoveMessage *msg, Packet *packet );
+	bool RelayPlayerProperties( PlayerPropertiesMessage *msg, Packet *packet );
+	bool RelayPropertyDelta( PropertyDeltaMessage *msg, Packet *packet );
+	bool RelayChangeState( ChangeStateMessage *msg, Packet *packet );
+	virtual GameObject *NewObject( uint32_t id, uint32_t type );
+	virtual Player *NewPlayer( uint16_t id );
+	
+	bool SetShards( std::string hosts, std::string bounds, int index );
+	bool Sharded( void ) const;
+	bool ShardOwns( double x ) const;
+	virtual bool ShardMigrates( const GameObject *obj );
+	void UpdateShards( void );
+	void MigrateObjects( void );
+	void SendGhosts( void );
+	void ClearShards( void );
+	bool ProcessShardHello( ShardHelloMessage *msg, Packet *packet, ConnectedClient *from_client );
+	bool ProcessShardHandoff( ShardHandoffMessage *msg, Packet *packet, ConnectedClient *from_client );
+	bool ProcessShardGhosts( ShardGhostsMessage *msg, Packet *packet, ConnectedClient *from_client );
+	void DroppedShardPeer( ConnectedClient *client );
+	uint16_t ClaimShardArrival( std::string token );
+	std::string ShardStatus( void );
+	
+	std::string ReplayJournal( std::string filename );
+	
+	void StartReplication( void );
+	void StopReplication( void );
+	void CaptureSnapshot( void );
+	void FinishReplication( void );
+	bool QueueReplication( ConnectedClient *client );
+	void SendSnapshotUpdate( ConnectedClient *client, int8_t precision );
 	
 	virtual void ChangeState( int state );
 	
+	Packet *InfoPacket( void );
+	
 	static int RaptorServerThread( void *game_server );
+	
+private:
+	Packet *CachedInfo;
+	uint32_t CachedInfoVersion;
+	uint16_t PropertyKeysSent;
+	volatile bool RelayMode;
+	volatile bool ShardMode;
+	
+	// Object IDs and types each neighbour has ghosts of, and which neighbour owns each of our ghosts.
+	std::vector< std::map<uint32_t,uint32_t> > GhostsSent;
+	std::map<uint32_t,int> GhostOwners;
+	
+	// Players handed off to us by token, and when, so we can forget them if they never arrive.
+	std::map< std::string, std::pair<uint16_t,double> > ShardArrivals;
+	Clock ShardClock, GhostClock;
+	
+	// Replication tasks read PublishedSnapshot while the server thread captures the next tick into the other one.
+	GameSnapshot Snapshots[ 2 ];
+	GameSnapshot *PublishedSnapshot, *CapturedSnapshot;
+	JobGroup Replication;
+	bool Replicating;
+};
+
+
+class ReplicationTask : public JobTask
+{
+public:
+	RaptorServer *Server;
+	ConnectedClient *Client;
+	
+	ReplicationTask( RaptorServer *server, ConnectedClient *client );
+	virtual ~ReplicationTask();
+	
+	void Run( void );
 };
 
 
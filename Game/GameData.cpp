@@ -7,6 +7,7 @@
 #include <cstddef>
 #include "Camera.h"
 #include "RaptorGame.h"
+#include "Messages.h"
 
 
 #define COMPLEX_THREADS 0
@@ -15,7 +16,17 @@
 GameData::GameData( void )
 :	GameObjectIDs( 1 )
 ,	PlayerIDs( 1 )
+,	FrameTime( NULL )
 {
+	InfoVersion = 0;
+	ChangeVersion = 0;
+	SleepTicks = 60;
+	SleepingCount = 0;
+	TrackRemovals = false;
+	Jobs = NULL;
+	ParallelBatch = 64;
+	UpdatingInParallel = false;
+	Properties.SetKeys( &PropertyKeyIDs );
 }
 
 
@@ -34,8 +45,21 @@ uint32_t GameData::AddObject( GameObject *obj )
 		obj->ID = GameObjectIDs.NextAvailable();
 	
 	GameObjects[ obj->ID ] = obj;
+	Spatial.Insert( obj );
+	
+	if( ! StandardUpdateLock.Lock() )
+		fprintf( stderr, "GameData::AddObject: StandardUpdateLock.Lock: %s\n", SDL_GetError() );
+	if( obj->StandardUpdateLayout() )
+		StandardUpdateIDs.insert( obj->ID );
+	else
+		StandardUpdateIDs.erase( obj->ID );
+	if( ! StandardUpdateLock.Unlock() )
+		fprintf( stderr, "GameData::AddObject: StandardUpdateLock.Unlock: %s\n", SDL_GetError() );
 	
 	obj->Data = this;
+	obj->Lifetime.SetSource( &FrameTime );
+	obj->AddedVersion = ++ ChangeVersion;
+	obj->MarkChanged();
 	if( this == &(Raptor::Game->Data) )
 		obj->ClientInit();
 	
@@ -53,7 +77,9 @@ uint16_t GameData::AddPlayer( Player *player )
 		player->ID = PlayerIDs.NextAvailable();
 	
 	Players[ player->ID ] = player;
-
+	player->Properties.SetKeys( &PropertyKeyIDs );
+	InfoVersion ++;
+	
 	return player->ID;
 }
 
@@ -63,13 +89,33 @@ void GameData::RemoveObject( uint32_t id )
 	std::map<uint32_t,GameObject*>::iterator obj_iter = GameObjects.find( id );
 	if( obj_iter != GameObjects.end() )
 	{
+		if( obj_iter->second->Sleeping )
+			SleepingCount --;
+		
+		Spatial.Remove( id );
 		delete obj_iter->second;
 		obj_iter->second = NULL;
 		GameObjects.erase( obj_iter );
+		GhostIDs.erase( id );
+		
+		if( ! StandardUpdateLock.Lock() )
+			fprintf( stderr, "GameData::RemoveObject: StandardUpdateLock.Lock: %s\n", SDL_GetError() );
+		StandardUpdateIDs.erase( id );
+		if( ! StandardUpdateLock.Unlock() )
+			fprintf( stderr, "GameData::RemoveObject: StandardUpdateLock.Unlock: %s\n", SDL_GetError() );
+		
+		if( TrackRemovals )
+		{
+			if( ! SnapshotLock.Lock() )
+				fprintf( stderr, "GameData::RemoveObject: SnapshotLock.Lock: %s\n", SDL_GetError() );
+			RemovedSinceSnapshot.insert( id );
+			if( ! SnapshotLock.Unlock() )
+				fprintf( stderr, "GameData::RemoveObject: SnapshotLock.Unlock: %s\n", SDL_GetError() );
+		}
 	}
 	
 	// Make this ID available again, unless it is lower than the range we're using for new objects.
-	if( id <= GameObjectIDs.Initial )
+	if( id >= GameObjectIDs.Initial )
 		GameObjectIDs.Remove( id );
 }
 
@@ -82,22 +128,48 @@ void GameData::RemovePlayer( uint16_t id )
 		delete player_iter->second;
 		player_iter->second = NULL;
 		Players.erase( player_iter );
+		InfoVersion ++;
 	}
 	
-	PlayerIDs.Remove( id );
+	// Players from other shards keep IDs from their own range, which shouldn't be given out here.
+	if( id >= PlayerIDs.Initial )
+		PlayerIDs.Remove( id );
 }
 
 
 void GameData::ClearObjects( void )
 {
+	if( TrackRemovals )
+	{
+		if( ! SnapshotLock.Lock() )
+			fprintf( stderr, "GameData::ClearObjects: SnapshotLock.Lock: %s\n", SDL_GetError() );
+		for( std::map<uint32_t,GameObject*>::iterator obj_iter = GameObjects.begin(); obj_iter != GameObjects.end(); obj_iter ++ )
+			RemovedSinceSnapshot.insert( obj_iter->first );
+		if( ! SnapshotLock.Unlock() )
+			fprintf( stderr, "GameData::ClearObjects: SnapshotLock.Unlock: %s\n", SDL_GetError() );
+	}
+	
 	for( std::map<uint32_t,GameObject*>::iterator obj_iter = GameObjects.begin(); obj_iter != GameObjects.end(); obj_iter ++ )
 		delete obj_iter->second;
 	
 	GameObjects.clear();
 	GameObjectIDs.Clear();
+	GhostIDs.clear();
+	Spatial.Clear();
+	SleepingCount = 0;
+	
 	ObjectIDsToRemove.clear();
 	Collisions.clear();
-	Effects.clear();
+	Effects.Clear();
+	
+	// With this game's objects gone, its pools can give their memory back, whatever other games are still using.
+	Arena.Trim();
+	
+	if( ! StandardUpdateLock.Lock() )
+		fprintf( stderr, "GameData::ClearObjects: StandardUpdateLock.Lock: %s\n", SDL_GetError() );
+	StandardUpdateIDs.clear();
+	if( ! StandardUpdateLock.Unlock() )
+		fprintf( stderr, "GameData::ClearObjects: StandardUpdateLock.Unlock: %s\n", SDL_GetError() );
 }
 
 
@@ -110,7 +182,9 @@ void GameData::Clear( void )
 	
 	Players.clear();
 	PlayerIDs.Clear();
-	Properties.clear();
+	Properties.Clear();
+	RemotePropertyKeys.clear();
+	InfoVersion ++;
 }
 
 
@@ -124,6 +198,7 @@ void GameData::CheckCollisions( double dt )
 	std::map< uint32_t, std::list<GameObject*> > stationary_can_hit_other_types;
 	std::list<GameObject*> complex;
 	std::list<CollisionDataSet> threads;
+	JobGroup complex_jobs( Jobs ? Jobs : JobSystem::Shared() );
 	
 	// Pre-sort by object type and collidability.
 	for( std::map<uint32_t,GameObject*>::iterator obj_iter = GameObjects.begin(); obj_iter != GameObjects.end(); obj_iter ++ )
@@ -133,7 +208,7 @@ void GameData::CheckCollisions( double dt )
 			complex.push_back( obj_iter->second );
 		else
 		#endif
-		if( obj_iter->second->IsMoving() )
+		if( (! obj_iter->second->Sleeping) && obj_iter->second->IsMoving() )
 		{
 			if( obj_iter->second->CanCollideWithOwnType() )
 				moving_can_hit_own_type[ obj_iter->second->Type() ].push_back( obj_iter->second );
@@ -212,7 +287,7 @@ void GameData::CheckCollisions( double dt )
 		}
 		
 		for( int i = 0; i < COMPLEX_THREADS; i ++ )
-			data_sets[ i ]->Thread = SDL_CreateThread( &FindCollisionsThread, data_sets[ i ] );
+			complex_jobs.Add( data_sets[ i ] );
 	}
 	#endif
 	
@@ -292,32 +367,153 @@ void GameData::CheckCollisions( double dt )
 		}
 	}
 	
-	// Wait for threads to end, and gather their results.
+	// Wait for complex collision jobs to finish, and gather their results.
+	complex_jobs.Wait();
 	for( std::list< CollisionDataSet >::iterator thread_iter = threads.begin(); thread_iter != threads.end(); thread_iter ++ )
 	{
-		SDL_WaitThread( thread_iter->Thread, NULL );
 		for( std::list<Collision>::iterator collision_iter = thread_iter->Collisions.begin(); collision_iter != thread_iter->Collisions.end(); collision_iter ++ )
 			Collisions.push_back( *collision_iter );
 	}
+	
+	// Collisions between two ghosts are handled wherever those objects are simulated.
+	if( GhostIDs.size() )
+	{
+		for( std::list<Collision>::iterator collision_iter = Collisions.begin(); collision_iter != Collisions.end(); )
+		{
+			std::list<Collision>::iterator collision_next = collision_iter;
+			collision_next ++;
+			
+			if( IsGhost( collision_iter->first->ID ) && IsGhost( collision_iter->second->ID ) )
+				Collisions.erase( collision_iter );
+			
+			collision_iter = collision_next;
+		}
+	}
+	
+	// Anything hit by a moving object needs to be simulated again.
+	if( SleepingCount )
+	{
+		for( std::list<Collision>::iterator collision_iter = Collisions.begin(); collision_iter != Collisions.end(); collision_iter ++ )
+		{
+			collision_iter->first->Wake();
+			collision_iter->second->Wake();
+		}
+	}
 }
 
 
 void GameData::Update( double dt )
 {
-	for( std::map<uint32_t,GameObject*>::iterator obj_iter = GameObjects.begin(); obj_iter != GameObjects.end(); obj_iter ++ )
-		obj_iter->second->Update( dt );
+	// Object clocks read the time from here instead of asking the system each time.
+	FrameTime.Update();
 	
-	for( std::list<Effect>::iterator effect_iter = Effects.begin(); effect_iter != Effects.end(); )
+	bool parallel = Jobs && Jobs->Threads();
+	
+	if( parallel )
 	{
-		std::list<Effect>::iterator effect_next = effect_iter;
-		effect_next ++;
+		// Objects that only touch their own state are updated first, in batches across threads.
+		ParallelObjects.clear();
+		for( std::map<uint32_t,GameObject*>::iterator obj_iter = GameObjects.begin(); obj_iter != GameObjects.end(); obj_iter ++ )
+		{
+			if( obj_iter->second->Sleeping || ! obj_iter->second->ParallelUpdate() )
+				continue;
+			if( GhostIDs.size() && IsGhost( obj_iter->first ) )
+				continue;
+			
+			ParallelObjects.push_back( obj_iter->second );
+		}
 		
-		effect_iter->Update( dt );
-		if( effect_iter->Finished() )
-			Effects.erase( effect_iter );
+		if( ParallelObjects.size() )
+		{
+			ObjectUpdateJob job( &ParallelObjects, dt );
+			UpdatingInParallel = true;
+			Jobs->ParallelFor( &job, ParallelObjects.size(), ParallelBatch );
+			UpdatingInParallel = false;
+			
+			// Merge in ID order, so spawned objects get the same IDs no matter which thread updated what.
+			for( std::vector<GameObject*>::iterator obj_iter = ParallelObjects.begin(); obj_iter != ParallelObjects.end(); obj_iter ++ )
+			{
+				(*obj_iter)->MergeParallelUpdate();
+				CheckSleep( *obj_iter );
+			}
+		}
+	}
+	
+	for( std::map<uint32_t,GameObject*>::iterator obj_iter = GameObjects.begin(); obj_iter != GameObjects.end(); obj_iter ++ )
+	{
+		if( GhostIDs.size() && IsGhost( obj_iter->first ) )
+			continue;
 		
-		effect_iter = effect_next;
+		GameObject *obj = obj_iter->second;
+		if( obj->Sleeping )
+			continue;
+		if( parallel && obj->ParallelUpdate() )
+			continue;
+		
+		obj->Update( dt );
+		CheckSleep( obj );
 	}
+	
+	Effects.Update( dt );
+	
+	Spatial.Refresh();
+}
+
+
+void GameData::SetTimeSource( TimeSource *source )
+{
+	// Objects keep their ages across the switch, so their Lifetime clocks never mix the two timelines.
+	for( std::map<uint32_t,GameObject*>::iterator obj_iter = GameObjects.begin(); obj_iter != GameObjects.end(); obj_iter ++ )
+		obj_iter->second->Lifetime.SetSource( NULL );
+	
+	FrameTime.Source = source;
+	FrameTime.Update();
+	
+	for( std::map<uint32_t,GameObject*>::iterator obj_iter = GameObjects.begin(); obj_iter != GameObjects.end(); obj_iter ++ )
+		obj_iter->second->Lifetime.SetSource( &FrameTime );
+}
+
+
+void GameData::CheckSleep( GameObject *obj )
+{
+	if( SleepTicks && obj->CanSleep() )
+	{
+		obj->RestTicks ++;
+		if( obj->RestTicks >= SleepTicks )
+			SleepObject( obj );
+	}
+	else
+		obj->RestTicks = 0;
+}
+
+
+size_t GameData::ObjectsWithinRadius( const Pos3D *center, double radius, std::vector<GameObject*> *found, uint32_t type, uint32_t exclude_id ) const
+{
+	return Spatial.WithinRadius( center, radius, found, type, exclude_id );
+}
+
+
+size_t GameData::ObjectsWithinBox( const Vec3D &min, const Vec3D &max, std::vector<GameObject*> *found, uint32_t type, uint32_t exclude_id ) const
+{
+	return Spatial.WithinBox( min, max, found, type, exclude_id );
+}
+
+
+size_t GameData::NearestObjects( const Pos3D *pt, size_t count, std::vector<GameObject*> *found, uint32_t type, uint32_t exclude_id, double max_dist ) const
+{
+	return Spatial.NearestObjects( pt, count, found, type, exclude_id, max_dist );
+}
+
+
+GameObject *GameData::NearestObject( const Pos3D *pt, uint32_t type, uint32_t exclude_id, double max_dist ) const
+{
+	return Spatial.NearestObject( pt, type, exclude_id, max_dist );
+}
+
+
+GameObject *GameData::RayCast( const Pos3D *start, const Vec3D *direction, double max_dist, double *hit_dist, uint32_t type, uint32_t exclude_id ) const
+{
+	return Spatial.RayCast( start, direction, max_dist, hit_dist, type, exclude_id );
 }
 
 
@@ -341,6 +537,164 @@ Player *GameData::GetPlayer( uint16_t id )
 }
 
 
+bool GameData::IsGhost( uint32_t id ) const
+{
+	return (GhostIDs.find( id ) != GhostIDs.end());
+}
+
+
+void GameData::SleepObject( GameObject *obj )
+{
+	if( obj->Sleeping )
+		return;
+	
+	obj->Sleeping = true;
+	obj->RestTicks = 0;
+	SleepingCount ++;
+}
+
+
+void GameData::WakeObject( GameObject *obj )
+{
+	if( ! obj->Sleeping )
+		return;
+	
+	obj->Sleeping = false;
+	obj->RestTicks = 0;
+	SleepingCount --;
+}
+
+
+void GameData::SetProperty( std::string name, std::string value )
+{
+	if( Properties.Set( name, value ) )
+		InfoVersion ++;
+}
+
+
+bool GameData::DecodeUpdate( UpdateMessage *msg, Packet *packet, bool from_server )
+{
+	// This is called from network threads, so it only reads the packet and the set of standard-layout IDs.
+	// Objects with their own update layout (and everything after them) are left for the main thread.
+	
+	if( ! StandardUpdateLock.Lock() )
+		fprintf( stderr, "GameData::DecodeUpdate: StandardUpdateLock.Lock: %s\n", SDL_GetError() );
+	
+	bool complete = true;
+	try
+	{
+		while( msg->Objects.size() < msg->ObjectCount )
+		{
+			PacketSize offset = packet->Offset;
+			uint32_t obj_id = packet->NextUInt();
+			if( StandardUpdateIDs.find( obj_id ) == StandardUpdateIDs.end() )
+			{
+				packet->Offset = offset;
+				break;
+			}
+			
+			msg->Objects.push_back( ObjectUpdate( obj_id ) );
+			msg->Objects.back().Offset = offset;
+			msg->Objects.back().Read( packet, msg->Precision, from_server );
+		}
+	}
+	catch( PacketSmall &e )
+	{
+		complete = false;
+	}
+	
+	if( ! StandardUpdateLock.Unlock() )
+		fprintf( stderr, "GameData::DecodeUpdate: StandardUpdateLock.Unlock: %s\n", SDL_GetError() );
+	
+	return complete;
+}
+
+
+bool GameData::ApplyUpdateFromServer( UpdateMessage *msg, Packet *packet )
+{
+	uint32_t obj_count = msg->ObjectCount;
+	
+	// Apply any object updates the network thread already decoded.
+	for( std::vector<ObjectUpdate>::iterator update_iter = msg->Objects.begin(); update_iter != msg->Objects.end(); update_iter ++ )
+	{
+		std::map<uint32_t,GameObject*>::iterator obj_iter = GameObjects.find( update_iter->ID );
+		if( obj_iter == GameObjects.end() )
+			return false;
+		
+		if( ! obj_iter->second->StandardUpdateLayout() )
+		{
+			// The object was replaced after this was decoded, so read the rest of the packet the slow way.
+			packet->Offset = update_iter->Offset;
+			break;
+		}
+		
+		obj_iter->second->ApplyUpdateFromServer( &*update_iter );
+		obj_count --;
+	}
+	
+	// Loop through for each remaining object's update data.
+	while( obj_count )
+	{
+		obj_count --;
+		
+		// First read the ID.
+		uint32_t obj_id = packet->NextUInt();
+		
+		// Look up the ID in our list of objects and update it.
+		// If we don't have it, the rest of the update packet could be misaligned, so stop trying to parse it.
+		std::map<uint32_t,GameObject*>::iterator obj_iter = GameObjects.find( obj_id );
+		if( obj_iter == GameObjects.end() )
+			return false;
+		
+		obj_iter->second->ReadFromUpdatePacketFromServer( packet, msg->Precision );
+	}
+	
+	return true;
+}
+
+
+bool GameData::ApplyPropertyDelta( PropertyDeltaMessage *msg )
+{
+	bool synced = true;
+	
+	// Map the server's property IDs to our own.
+	for( PacketList<uint16_t,PropertyKeyDef>::iterator key_iter = msg->Keys.begin(); key_iter != msg->Keys.end(); key_iter ++ )
+		RemotePropertyKeys[ key_iter->ID ] = PropertyKeyIDs.Intern( key_iter->Name );
+	
+	for( PacketList<uint16_t,PropertyStoreDelta>::iterator store_iter = msg->Stores.begin(); store_iter != msg->Stores.end(); store_iter ++ )
+	{
+		PropertyStore *store = &Properties;
+		if( store_iter->PlayerID )
+		{
+			Player *player = GetPlayer( store_iter->PlayerID );
+			if( ! player )
+			{
+				// The server thinks we should have this player, so we're out of sync!
+				synced = false;
+				continue;
+			}
+			store = &(player->Properties);
+		}
+		
+		bool changed = false;
+		for( PacketList<uint16_t,PropertyChange>::iterator change_iter = store_iter->Changes.begin(); change_iter != store_iter->Changes.end(); change_iter ++ )
+		{
+			std::map<uint16_t,uint16_t>::iterator key_iter = RemotePropertyKeys.find( change_iter->Key );
+			if( key_iter == RemotePropertyKeys.end() )
+				continue;
+			if( store->Set( key_iter->second, change_iter->Value, change_iter->Version ) )
+				changed = true;
+		}
+		
+		// Server properties are included in server announcements.
+		if( changed && (store == &Properties) )
+			InfoVersion ++;
+	}
+	
+	return synced;
+}
+
+
 // -----------------------------------------------------------------------------
 
 
@@ -367,7 +721,6 @@ Collision::~Collision()
 
 CollisionDataSet::CollisionDataSet( double dt )
 {
-	Thread = NULL;
 	dT = dt;
 }
 
@@ -396,13 +749,28 @@ void CollisionDataSet::DetectCollisions( void )
 }
 
 
+void CollisionDataSet::Run( void )
+{
+	DetectCollisions();
+}
+
+
 // -----------------------------------------------------------------------------
 
 
-int FindCollisionsThread( void *data_set_ptr )
+ObjectUpdateJob::ObjectUpdateJob( std::vector<GameObject*> *objects, double dt )
 {
-	CollisionDataSet *data_set = (CollisionDataSet*) data_set_ptr;
-	data_set->DetectCollisions();
-	
-	return 0;
+	Objects = objects;
+	dT = dt;
+}
+
+
+ObjectUpdateJob::~ObjectUpdateJob()
+{
+}
+
+
+void ObjectUpdateJob::Run( size_t index )
+{
+	(*Objects)[ index ]->Update( dT );
 }
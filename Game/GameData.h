@@ -6,6 +6,9 @@
 class GameData;
 class Collision;
 class CollisionDataSet;
+class UpdateMessage;
+class PropertyDeltaMessage;
+class ObjectUpdateJob;
 
 #include "PlatformSpecific.h"
 
@@ -13,16 +16,27 @@ class CollisionDataSet;
 #include <map>
 #include <list>
 #include <set>
+#include <vector>
 #include "Identifier.h"
 #include "GameObject.h"
 #include "Player.h"
+#include "PropertyStore.h"
 #include "Effect.h"
+#include "ParticleSystem.h"
 #include "Clock.h"
+#include "Mutex.h"
+#include "Packet.h"
+#include "JobSystem.h"
+#include "SpatialIndex.h"
+#include "MemoryPool.h"
 
 
 class GameData
 {
 public:
+	// Memory for objects created with new( data ).  Declared first so it outlives everything else here.
+	MemoryArena Arena;
+	
 	Identifier<uint32_t> GameObjectIDs;
 	std::map<uint32_t,GameObject*> GameObjects;
 	
@@ -31,12 +45,51 @@ public:
 	
 	Clock GameTime;
 	
+	// The time as of this GameData's last Update, for Clocks belonging to its objects (such as their Lifetime).
+	// Update refreshes it on the owning thread, so reading it costs nothing and is the same all frame.
+	CachedTimeSource FrameTime;
+	
 	std::list<Collision> Collisions;
 	std::set<uint32_t> ObjectIDsToRemove;
 	
-	std::list<Effect> Effects;
+	ParticleSystem Effects;
+	
+	// Objects simulated by someone else (such as a neighbouring shard); they can be hit, but aren't updated here.
+	std::set<uint32_t> GhostIDs;
+	
+	// Property names used by this game's server and player properties, and how the server's IDs map onto them.
+	PropertyKeys PropertyKeyIDs;
+	std::map<uint16_t,uint16_t> RemotePropertyKeys;
+	
+	PropertyStore Properties;
+	
+	// Incremented whenever Properties or the player list changes, so cached data can tell when to rebuild.
+	uint32_t InfoVersion;
+	
+	// Incremented by GameObject::MarkChanged, so the server can tell which objects changed since each client's last update.
+	uint64_t ChangeVersion;
+	
+	// Objects at rest for this many updates in a row stop being updated, moved or kept alive until woken (0 never sleeps).
+	uint32_t SleepTicks;
+	size_t SleepingCount;
+	
+	// IDs of objects whose updates network threads may decode ahead of time; see GameObject::StandardUpdateLayout.
+	std::set<uint32_t> StandardUpdateIDs;
+	Mutex StandardUpdateLock;
+	
+	// While the server replicates from snapshots, IDs removed since the last one so replication threads can leave them out.
+	bool TrackRemovals;
+	std::set<uint32_t> RemovedSinceSnapshot;
+	Mutex SnapshotLock;
 	
-	std::map<std::string,std::string> Properties;
+	// Objects that opt in with GameObject::ParallelUpdate are updated in batches on these threads (NULL updates everything here).
+	JobSystem *Jobs;
+	size_t ParallelBatch;
+	volatile bool UpdatingInParallel;
+	std::vector<GameObject*> ParallelObjects;
+	
+	// Grid of object positions for the spatial queries below, refreshed after each Update.
+	SpatialIndex Spatial;
 	
 	
 	GameData( void );
@@ -50,9 +103,25 @@ public:
 	void Clear( void );
 	GameObject *GetObject( uint32_t id );
 	Player *GetPlayer( uint16_t id );
+	bool IsGhost( uint32_t id ) const;
+	void SleepObject( GameObject *obj );
+	void WakeObject( GameObject *obj );
+	
+	void SetProperty( std::string name, std::string value );
+	bool DecodeUpdate( UpdateMessage *msg, Packet *packet, bool from_server );
+	bool ApplyUpdateFromServer( UpdateMessage *msg, Packet *packet );
+	bool ApplyPropertyDelta( PropertyDeltaMessage *msg );
 	
 	void CheckCollisions( double dt );
 	void Update( double dt );
+	void SetTimeSource( TimeSource *source );
+	void CheckSleep( GameObject *obj );
+	
+	size_t ObjectsWithinRadius( const Pos3D *center, double radius, std::vector<GameObject*> *found, uint32_t type = 0, uint32_t exclude_id = 0 ) const;
+	size_t ObjectsWithinBox( const Vec3D &min, const Vec3D &max, std::vector<GameObject*> *found, uint32_t type = 0, uint32_t exclude_id = 0 ) const;
+	size_t NearestObjects( const Pos3D *pt, size_t count, std::vector<GameObject*> *found, uint32_t type = 0, uint32_t exclude_id = 0, double max_dist = DBL_MAX ) const;
+	GameObject *NearestObject( const Pos3D *pt, uint32_t type = 0, uint32_t exclude_id = 0, double max_dist = DBL_MAX ) const;
+	GameObject *RayCast( const Pos3D *start, const Vec3D *direction, double max_dist, double *hit_dist = NULL, uint32_t type = 0, uint32_t exclude_id = 0 ) const;
 };
 
 
@@ -68,10 +137,9 @@ public:
 };
 
 
-class CollisionDataSet
+class CollisionDataSet : public JobTask
 {
 public:
-	SDL_Thread *Thread;
 	std::list<GameObject*> Objects1, Objects2;
 	double dT;
 	std::list<Collision> Collisions;
@@ -80,7 +148,18 @@ public:
 	virtual ~CollisionDataSet();
 	
 	void DetectCollisions( void );
+	void Run( void );
 };
 
 
-int FindCollisionsThread( void *data_set_ptr );
+class ObjectUpdateJob : public ParallelJob
+{
+public:
+	std::vector<GameObject*> *Objects;
+	double dT;
+	
+	ObjectUpdateJob( std::vector<GameObject*> *objects, double dt );
+	virtual ~ObjectUpdateJob();
+	
+	void Run( size_t index );
+};
@@ -27,10 +27,18 @@ GameObject::GameObject( uint32_t id, uint32_t type_code, uint16_t player_id ) :
 	YawRate = 0.;
 	NextUpdateTimeTweak = 0.;
 	SmoothPos = true;
+	ChangedVersion = 0;
+	AddedVersion = 0;
+	StandardLayout = false;
+	SleepsAtRest = false;
+	UpdatesInParallel = false;
+	Sleeping = false;
+	RestTicks = 0;
+	ChangePending = false;
 }
 
 
-GameObject::GameObject( const GameObject &other ) : Pos3D( other )
+GameObject::GameObject( const GameObject &other ) : Pos3D( other ), Lifetime( other.Lifetime )
 {
 	ID = other.ID;
 	TypeCode = other.TypeCode;
@@ -40,9 +48,19 @@ GameObject::GameObject( const GameObject &other ) : Pos3D( other )
 	RollRate = other.RollRate;
 	PitchRate = other.PitchRate;
 	YawRate = other.YawRate;
-	Lifetime = other.Lifetime;
 	NextUpdateTimeTweak = 0.;
 	SmoothPos = true;
+	ChangedVersion = other.ChangedVersion;
+	AddedVersion = other.AddedVersion;
+	StandardLayout = other.StandardLayout;
+	SleepsAtRest = other.SleepsAtRest;
+	UpdatesInParallel = other.UpdatesInParallel;
+	Sleeping = false;
+	RestTicks = 0;
+	ChangePending = false;
+	
+	// The original's GameData may not outlive this copy, so don't keep reading its frame time.
+	Lifetime.SetSource( NULL );
 }
 
 
@@ -51,6 +69,31 @@ GameObject::~GameObject()
 }
 
 
+void *GameObject::operator new( size_t size )
+{
+	return MemoryArena::Shared()->Allocate( size );
+}
+
+
+void *GameObject::operator new( size_t size, GameData *data )
+{
+	return data ? data->Arena.Allocate( size ) : MemoryArena::Shared()->Allocate( size );
+}
+
+
+void GameObject::operator delete( void *ptr )
+{
+	MemoryArena::Free( ptr );
+}
+
+
+void GameObject::operator delete( void *ptr, GameData *data )
+{
+	// Only used if a constructor throws during new( data ).
+	MemoryArena::Free( ptr );
+}
+
+
 void GameObject::ClientInit( void )
 {
 }
@@ -77,6 +120,98 @@ bool GameObject::ServerShouldUpdateOthers( void ) const
 	return true;
 }
 
+bool GameObject::ServerTracksChanges( void ) const
+{
+	// Objects are only left out of updates if everything they send is tracked by MarkChanged.
+	// Subclasses that send more than the standard layout can override this if they call MarkChanged whenever those fields change.
+	return StandardUpdateLayout();
+}
+
+
+void GameObject::MarkChanged( void )
+{
+	// ChangeVersion is shared, so parallel updates only note the change and number it when merged.
+	if( Data && Data->UpdatingInParallel )
+	{
+		ChangePending = true;
+		return;
+	}
+	
+	if( Data )
+		ChangedVersion = ++ Data->ChangeVersion;
+	
+	// Anything worth replicating is worth simulating again.
+	if( Sleeping )
+		Wake();
+}
+
+
+bool GameObject::AtRest( void ) const
+{
+	return ! ( RollRate || PitchRate || YawRate || MotionVector.X || MotionVector.Y || MotionVector.Z );
+}
+
+bool GameObject::CanSleep( void ) const
+{
+	// Subclasses usually do more in Update than move, so they must opt in with SleepsAtRest.
+	return SleepsAtRest && AtRest();
+}
+
+
+void GameObject::Wake( void )
+{
+	if( Data )
+		Data->WakeObject( this );
+	else
+		Sleeping = false;
+	
+	RestTicks = 0;
+}
+
+
+bool GameObject::ParallelUpdate( void ) const
+{
+	// Only objects whose Update touches nothing but their own state (using Spawn and AddEffect for anything else) may opt in.
+	return UpdatesInParallel;
+}
+
+
+void GameObject::Spawn( GameObject *obj )
+{
+	if( Data && Data->UpdatingInParallel )
+		PendingSpawns.push_back( obj );
+	else if( Data )
+		Data->AddObject( obj );
+}
+
+
+void GameObject::AddEffect( const EffectRequest &effect )
+{
+	if( Data && Data->UpdatingInParallel )
+		PendingEffects.push_back( effect );
+	else if( Data )
+		Data->Effects.Add( effect );
+}
+
+
+void GameObject::MergeParallelUpdate( void )
+{
+	if( ChangePending )
+	{
+		ChangePending = false;
+		MarkChanged();
+	}
+	
+	for( std::vector<GameObject*>::iterator spawn_iter = PendingSpawns.begin(); spawn_iter != PendingSpawns.end(); spawn_iter ++ )
+		Data->AddObject( *spawn_iter );
+	PendingSpawns.clear();
+	
+	for( std::vector<EffectRequest>::iterator effect_iter = PendingEffects.begin(); effect_iter != PendingEffects.end(); effect_iter ++ )
+		Data->Effects.Add( *effect_iter );
+	PendingEffects.clear();
+}
+
+
 bool GameObject::CanCollideWithOwnType( void ) const
 {
 	return false;
@@ -100,6 +235,20 @@ bool GameObject::ComplexCollisionDetection( void ) const
 }
 
 
+double GameObject::BoundingRadius( void ) const
+{
+	// Used by GameData::RayCast; objects with no size can be found by position but not hit by rays.
+	return 0.;
+}
+
+
+const Model *GameObject::CollisionModel( void ) const
+{
+	// When set, GameData::RayCast only hits this object where the ray meets the model's triangles, at the object's position and scale 1.
+	return NULL;
+}
+
+
 void GameObject::AddToInitPacket( Packet *packet, int8_t precision )
 {
 	AddToUpdatePacketFromServer( packet, precision );
@@ -158,63 +307,9 @@ void GameObject::AddToUpdatePacket( Packet *packet, int8_t precision )
 
 void GameObject::ReadFromUpdatePacket( Packet *packet, int8_t precision )
 {
-	PrevPos.Copy( this );
-	
-	X = packet->NextDouble();
-	Y = packet->NextDouble();
-	Z = packet->NextDouble();
-	if( precision >= 0 )
-	{
-		Fwd.X = packet->NextFloat();
-		Fwd.Y = packet->NextFloat();
-		Fwd.Z = packet->NextFloat();
-	}
-	else
-	{
-		Fwd.X = Num::UnitFloatFrom16( packet->NextShort() );
-		Fwd.Y = Num::UnitFloatFrom16( packet->NextShort() );
-		Fwd.Z = Num::UnitFloatFrom16( packet->NextShort() );
-	}
-	if( precision >= 1 )
-	{
-		Up.X = packet->NextFloat();
-		Up.Y = packet->NextFloat();
-		Up.Z = packet->NextFloat();
-	}
-	else if( precision >= 0 )
-	{
-		Up.X = Num::UnitFloatFrom16( packet->NextShort() );
-		Up.Y = Num::UnitFloatFrom16( packet->NextShort() );
-		Up.Z = Num::UnitFloatFrom16( packet->NextShort() );
-	}
-	else
-	{
-		Up.X = Num::UnitFloatFrom8( packet->NextChar() );
-		Up.Y = Num::UnitFloatFrom8( packet->NextChar() );
-		Up.Z = Num::UnitFloatFrom8( packet->NextChar() );
-	}
-	MotionVector.X = packet->NextFloat();
-	MotionVector.Y = packet->NextFloat();
-	MotionVector.Z = packet->NextFloat();
-	
-	if( SmoothPos && (Dist(&PrevPos) < SMOOTH_RADIUS) )
-	{
-		// Average with the previously-calculated position to reduce jitter.
-		
-		X += PrevPos.X;
-		Y += PrevPos.Y;
-		Z += PrevPos.Z;
-		X /= 2.;
-		Y /= 2.;
-		Z /= 2.;
-		
-		Fwd += PrevPos.Fwd;
-		Fwd /= 2.;
-		Up += PrevPos.Up;
-		Up /= 2.;
-	}
-	
-	FixVectors();
+	ObjectUpdate update( ID );
+	update.Read( packet, precision, false );
+	ApplyUpdate( &update );
 }
 
 
@@ -248,6 +343,57 @@ void GameObject::ReadFromUpdatePacketFromClient( Packet *packet, int8_t precisio
 }
 
 
+bool GameObject::StandardUpdateLayout( void ) const
+{
+	// Network threads can only decode updates ahead of time if they know the layout, so subclasses must opt in.
+	return StandardLayout;
+}
+
+
+void GameObject::ApplyUpdate( const ObjectUpdate *update )
+{
+	PrevPos.Copy( this );
+	
+	X = update->X;
+	Y = update->Y;
+	Z = update->Z;
+	Fwd.Copy( update->Fwd );
+	Up.Copy( update->Up );
+	MotionVector.Copy( update->MotionVector );
+	
+	if( SmoothPos && (Dist(&PrevPos) < SMOOTH_RADIUS) )
+	{
+		// Average with the previously-calculated position to reduce jitter.
+		
+		X += PrevPos.X;
+		Y += PrevPos.Y;
+		Z += PrevPos.Z;
+		X /= 2.;
+		Y /= 2.;
+		Z /= 2.;
+		
+		Fwd += PrevPos.Fwd;
+		Fwd /= 2.;
+		Up += PrevPos.Up;
+		Up /= 2.;
+	}
+	
+	FixVectors();
+	MarkChanged();
+}
+
+
+void GameObject::ApplyUpdateFromServer( const ObjectUpdate *update )
+{
+	// Client-side anti-lag.
+	NextUpdateTimeTweak -= Raptor::Game->FrameTime / 2.;
+	NextUpdateTimeTweak += Raptor::Game->Net.MedianPing() / 4000.;
+	
+	ApplyUpdate( update );
+	PlayerID = update->PlayerID;
+}
+
+
 bool GameObject::WillCollide( const GameObject *other, double dt, std::string *this_object, std::string *other_object ) const
 {
 	return false;
@@ -256,15 +402,21 @@ bool GameObject::WillCollide( const GameObject *other, double dt, std::string *t
 
 void GameObject::Update( double dt )
 {
-	PrevPos.Copy( this );
+	// Plain assignment keeps PrevPos bit-identical, so an object that didn't turn isn't seen as turned.
+	PrevPos = *this;
 	
 	dt += NextUpdateTimeTweak;
 	NextUpdateTimeTweak = 0.;
 	
-	Roll( dt * RollRate );
-	Pitch( dt * PitchRate );
-	Yaw( dt * YawRate );
+	if( RollRate || PitchRate || YawRate )
+		Spin( dt * RollRate, dt * PitchRate, dt * YawRate );
 	Move( MotionVector.X * dt, MotionVector.Y * dt, MotionVector.Z * dt );
+	
+	// Stationary objects don't need to be sent again.
+	bool moved = (X != PrevPos.X) || (Y != PrevPos.Y) || (Z != PrevPos.Z);
+	bool turned = (Fwd.X != PrevPos.Fwd.X) || (Fwd.Y != PrevPos.Fwd.Y) || (Fwd.Z != PrevPos.Fwd.Z) || (Up.X != PrevPos.Up.X) || (Up.Y != PrevPos.Up.Y) || (Up.Z != PrevPos.Up.Z);
+	if( moved || turned )
+		MarkChanged();
 }
 
 
@@ -8,9 +8,14 @@ class GameObject;
 #include "PlatformSpecific.h"
 
 #include <stdint.h>
+#include <vector>
 #include "Pos.h"
 #include "Clock.h"
+#include "MemoryPool.h"
 #include "Packet.h"
+#include "ObjectUpdate.h"
+#include "Effect.h"
+#include "Model.h"
 #include "GameData.h"
 
 
@@ -33,21 +38,67 @@ public:
 	bool SmoothPos;
 	double NextUpdateTimeTweak;
 	
+	// Value of Data->ChangeVersion when replicated state last changed, so the server can skip sending unchanged objects.
+	uint64_t ChangedVersion;
+	
+	// Value of Data->ChangeVersion when the object was added, to tell it apart from an earlier object with the same ID.
+	uint64_t AddedVersion;
+	
+	// Subclasses set this in their constructor if they send exactly GameObject's update layout (they don't override
+	// AddToUpdatePacket and ReadFromUpdatePacket, or only call the base versions).  Network threads can then decode their
+	// updates ahead of time, and the server skips sending them while unchanged.  It starts false, since a subclass that
+	// sends more would be misread; RaptorGame and RaptorServer set it for the plain GameObjects their NewObject makes.
+	bool StandardLayout;
+	
+	// Objects that stay at rest for GameData::SleepTicks updates are parked until something wakes them.
+	// Subclasses set SleepsAtRest in their constructor if their Update does nothing while not moving or turning.
+	// Leave it false for anything with timers, AI or other work in Update, or override CanSleep to decide each update.
+	bool SleepsAtRest;
+	bool Sleeping;
+	uint32_t RestTicks;
+	
+	// Subclasses set UpdatesInParallel in their constructor if their Update only touches their own state, using Spawn and
+	// AddEffect for anything else, so GameData may update them on its job threads.  It starts false.
+	bool UpdatesInParallel;
+	
+	// While Data->UpdatingInParallel, changes, spawns and effects are held here until GameData merges them in ID order.
+	bool ChangePending;
+	std::vector<GameObject*> PendingSpawns;
+	std::vector<EffectRequest> PendingEffects;
+	
 	
 	GameObject( uint32_t id = 0, uint32_t type_code = '    ', uint16_t player_id = 0 );
 	GameObject( const GameObject &other );
 	virtual ~GameObject();
 	
+	// Objects of every subclass come from pooled memory, since weapons create and remove so many of them.
+	// Use new( data ) to take it from that GameData's arena, so ClearObjects can give it back; plain new uses the shared arena.
+	static void *operator new( size_t size );
+	static void *operator new( size_t size, GameData *data );
+	static void operator delete( void *ptr );
+	static void operator delete( void *ptr, GameData *data );
+	
 	virtual void ClientInit( void );
 	
 	virtual uint32_t Type( void ) const;
 	virtual bool PlayerShouldUpdateServer( void ) const;
 	virtual bool ServerShouldUpdatePlayer( void ) const;
 	virtual bool ServerShouldUpdateOthers( void ) const;
+	virtual bool ServerTracksChanges( void ) const;
+	void MarkChanged( void );
+	bool AtRest( void ) const;
+	virtual bool CanSleep( void ) const;
+	void Wake( void );
+	virtual bool ParallelUpdate( void ) const;
+	void Spawn( GameObject *obj );
+	void AddEffect( const EffectRequest &effect );
+	void MergeParallelUpdate( void );
 	virtual bool CanCollideWithOwnType( void ) const;
 	virtual bool CanCollideWithOtherTypes( void ) const;
 	virtual bool IsMoving( void ) const;
 	virtual bool ComplexCollisionDetection( void ) const;
+	virtual double BoundingRadius( void ) const;
+	virtual const Model *CollisionModel( void ) const;
 	
 	virtual void AddToInitPacket( Packet *packet, int8_t precision = 0 );
 	virtual void ReadFromInitPacket( Packet *packet, int8_t precision = 0 );
@@ -58,11 +109,15 @@ public:
 	virtual void AddToUpdatePacketFromClient( Packet *packet, int8_t precision = 0 );
 	virtual void ReadFromUpdatePacketFromClient( Packet *packet, int8_t precision = 0 );
 	
+	virtual bool StandardUpdateLayout( void ) const;
+	virtual void ApplyUpdate( const ObjectUpdate *update );
+	void ApplyUpdateFromServer( const ObjectUpdate *update );
+	
 	virtual bool WillCollide( const GameObject *other, double dt, std::string *this_object = NULL, std::string *other_object = NULL ) const;
 	virtual void Update( double dt );
 	
 	virtual void Draw( void );
-	
+
 private:
 	uint32_t TypeCode;
 };
@@ -0,0 +1,105 @@
+/*
+ *  GameSnapshot.cpp
+ */
+
+#include "GameSnapshot.h"
+
+#include <cstddef>
+
+
+SnapshotObject::SnapshotObject( void )
+{
+	ChangedVersion = 0;
+	Sleeping = false;
+	TracksChanges = false;
+	UpdatePlayer = false;
+	UpdateOthers = false;
+	Standard = true;
+}
+
+
+SnapshotObject::~SnapshotObject()
+{
+}
+
+
+void SnapshotObject::AddToUpdatePacket( Packet *packet, int8_t precision ) const
+{
+	if( Standard )
+	{
+		State.Write( packet, precision, true );
+		return;
+	}
+	
+	std::map< int8_t, std::vector<uint8_t> >::const_iterator encoded_iter = Encoded.find( precision );
+	if( (encoded_iter != Encoded.end()) && encoded_iter->second.size() )
+		packet->AddData( &(encoded_iter->second[ 0 ]), encoded_iter->second.size() );
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+GameSnapshot::GameSnapshot( void )
+{
+	ChangeVersion = 0;
+	ObjectCount = 0;
+}
+
+
+GameSnapshot::~GameSnapshot()
+{
+}
+
+
+void GameSnapshot::Capture( GameData *data, const std::set<int8_t> *precisions )
+{
+	// Objects is only ever grown, so after the first few ticks capturing doesn't allocate anything for standard objects.
+	ChangeVersion = data->ChangeVersion;
+	ObjectCount = data->GameObjects.size();
+	if( Objects.size() < ObjectCount )
+		Objects.resize( ObjectCount );
+	
+	size_t index = 0;
+	for( std::map<uint32_t,GameObject*>::iterator obj_iter = data->GameObjects.begin(); obj_iter != data->GameObjects.end(); obj_iter ++ )
+	{
+		GameObject *obj = obj_iter->second;
+		SnapshotObject *snap = &(Objects[ index ]);
+		index ++;
+		
+		snap->State.ID = obj->ID;
+		snap->State.X = obj->X;
+		snap->State.Y = obj->Y;
+		snap->State.Z = obj->Z;
+		snap->State.Fwd.Copy( obj->Fwd );
+		snap->State.Up.Copy( obj->Up );
+		snap->State.MotionVector.Copy( obj->MotionVector );
+		snap->State.PlayerID = obj->PlayerID;
+		snap->ChangedVersion = obj->ChangedVersion;
+		snap->Sleeping = obj->Sleeping;
+		snap->TracksChanges = obj->ServerTracksChanges();
+		snap->UpdatePlayer = obj->ServerShouldUpdatePlayer();
+		snap->UpdateOthers = obj->ServerShouldUpdateOthers();
+		snap->Standard = obj->StandardUpdateLayout();
+		snap->Encoded.clear();
+		
+		if( snap->Standard || ! (snap->UpdatePlayer || snap->UpdateOthers) )
+			continue;
+		
+		for( std::set<int8_t>::const_iterator precision_iter = precisions->begin(); precision_iter != precisions->end(); precision_iter ++ )
+		{
+			Packet packet;
+			obj->AddToUpdatePacketFromServer( &packet, *precision_iter );
+			if( packet.Size() > PACKET_HEADER_SIZE )
+				snap->Encoded[ *precision_iter ].assign( packet.Data + PACKET_HEADER_SIZE, packet.Data + packet.Size() );
+		}
+	}
+}
+
+
+void GameSnapshot::Clear( void )
+{
+	ChangeVersion = 0;
+	ObjectCount = 0;
+	Objects.clear();
+}
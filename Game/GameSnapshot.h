@@ -0,0 +1,58 @@
+/*
+ *  GameSnapshot.h
+ */
+
+#pragma once
+class SnapshotObject;
+class GameSnapshot;
+
+#include "PlatformSpecific.h"
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <vector>
+#include "ObjectUpdate.h"
+#include "Packet.h"
+#include "GameData.h"
+
+
+// Read-only copy of what the server replicates about each object, taken at the end of a tick.
+// Replication tasks build client updates from it while the server thread simulates the next tick.
+
+
+class SnapshotObject
+{
+public:
+	ObjectUpdate State;
+	uint64_t ChangedVersion;
+	bool Sleeping;
+	bool TracksChanges;
+	bool UpdatePlayer, UpdateOthers;
+	
+	// Objects without the standard update layout can only be written by the object itself, so they are written ahead of time for each precision clients use.
+	bool Standard;
+	std::map< int8_t, std::vector<uint8_t> > Encoded;
+	
+	
+	SnapshotObject( void );
+	virtual ~SnapshotObject();
+	
+	void AddToUpdatePacket( Packet *packet, int8_t precision ) const;
+};
+
+
+class GameSnapshot
+{
+public:
+	uint64_t ChangeVersion;
+	std::vector<SnapshotObject> Objects;
+	size_t ObjectCount;
+	
+	
+	GameSnapshot( void );
+	virtual ~GameSnapshot();
+	
+	void Capture( GameData *data, const std::set<int8_t> *precisions );
+	void Clear( void );
+};
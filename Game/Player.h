@@ -10,6 +10,7 @@ class Player;
 #include <stdint.h>
 #include <string>
 #include <map>
+#include "PropertyStore.h"
 
 
 class Player
@@ -17,7 +18,7 @@ class Player
 public:
 	uint16_t ID;
 	std::string Name;
-	std::map<std::string,std::string> Properties;
+	PropertyStore Properties;
 	
 	Player( uint16_t id = 0 );
 	virtual ~Player();
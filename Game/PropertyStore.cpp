@@ -0,0 +1,219 @@
+/*
+ *  PropertyStore.cpp
+ */
+
+#include "PropertyStore.h"
+
+#include <cstddef>
+#include <cstdio>
+
+
+PropertyKeys::PropertyKeys( void )
+{
+	// ID 0 means no key.
+	Names.push_back( "" );
+	Version = 0;
+}
+
+
+PropertyKeys::~PropertyKeys()
+{
+}
+
+
+uint16_t PropertyKeys::Intern( const std::string &name )
+{
+	std::map<std::string,uint16_t>::const_iterator id_iter = IDs.find( name );
+	if( id_iter != IDs.end() )
+		return id_iter->second;
+	
+	if( Names.size() > 0xFFFF )
+	{
+		fprintf( stderr, "PropertyKeys::Intern: Too many property names, ignoring \"%s\".\n", name.c_str() );
+		return 0;
+	}
+	
+	uint16_t id = Names.size();
+	Names.push_back( name );
+	IDs[ name ] = id;
+	return id;
+}
+
+
+uint16_t PropertyKeys::Find( const std::string &name ) const
+{
+	std::map<std::string,uint16_t>::const_iterator id_iter = IDs.find( name );
+	if( id_iter != IDs.end() )
+		return id_iter->second;
+	return 0;
+}
+
+
+const std::string &PropertyKeys::Name( uint16_t id ) const
+{
+	if( id < Names.size() )
+		return Names[ id ];
+	return Names[ 0 ];
+}
+
+
+uint16_t PropertyKeys::Last( void ) const
+{
+	return Names.size() - 1;
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+PropertyValue::PropertyValue( void )
+{
+	Version = 0;
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+PropertyStore::PropertyStore( void )
+{
+	Keys = &LocalKeys;
+}
+
+
+PropertyStore::PropertyStore( const PropertyStore &other )
+{
+	Keys = &LocalKeys;
+	*this = other;
+}
+
+
+PropertyStore::~PropertyStore()
+{
+}
+
+
+PropertyStore &PropertyStore::operator=( const PropertyStore &other )
+{
+	if( &other == this )
+		return *this;
+	
+	// Copy by name, since the other store's IDs may come from a different table; our own table stays put.
+	Clear();
+	for( std::map<uint16_t,PropertyValue>::const_iterator value_iter = other.Values.begin(); value_iter != other.Values.end(); value_iter ++ )
+		Set( other.Keys->Name( value_iter->first ), value_iter->second.Value );
+	
+	return *this;
+}
+
+
+void PropertyStore::SetKeys( PropertyKeys *keys )
+{
+	if( ! keys )
+		keys = &LocalKeys;
+	if( keys == Keys )
+		return;
+	
+	// Re-intern anything already stored, since IDs from the old table mean nothing in the new one.
+	std::map<uint16_t,PropertyValue> old_values = Values;
+	Values.clear();
+	Changed.clear();
+	PropertyKeys *old_keys = Keys;
+	Keys = keys;
+	
+	for( std::map<uint16_t,PropertyValue>::iterator value_iter = old_values.begin(); value_iter != old_values.end(); value_iter ++ )
+		Set( old_keys->Name( value_iter->first ), value_iter->second.Value );
+}
+
+
+bool PropertyStore::Set( const std::string &name, const std::string &value )
+{
+	return Set( Keys->Intern( name ), value );
+}
+
+
+bool PropertyStore::Set( uint16_t key, const std::string &value, uint32_t version )
+{
+	if( ! key )
+		return false;
+	
+	std::map<uint16_t,PropertyValue>::iterator value_iter = Values.find( key );
+	if( value_iter == Values.end() )
+		value_iter = Values.insert( std::pair<uint16_t,PropertyValue>( key, PropertyValue() ) ).first;
+	else if( value_iter->second.Value == value )
+		return false;
+	
+	value_iter->second.Value = value;
+	
+	// Replicated values keep the version they were given; local changes take the next version from our table.
+	if( version )
+	{
+		value_iter->second.Version = version;
+		if( version > Keys->Version )
+			Keys->Version = version;
+	}
+	else
+		value_iter->second.Version = ++ Keys->Version;
+	
+	Changed.insert( key );
+	return true;
+}
+
+
+const std::string *PropertyStore::Find( const std::string &name ) const
+{
+	return Find( Keys->Find( name ) );
+}
+
+
+const std::string *PropertyStore::Find( uint16_t key ) const
+{
+	std::map<uint16_t,PropertyValue>::const_iterator value_iter = Values.find( key );
+	if( value_iter != Values.end() )
+		return &(value_iter->second.Value);
+	return NULL;
+}
+
+
+std::string PropertyStore::Get( const std::string &name, const std::string &default_value ) const
+{
+	const std::string *value = Find( name );
+	return value ? *value : default_value;
+}
+
+
+bool PropertyStore::Has( const std::string &name ) const
+{
+	return (Find( name ) != NULL);
+}
+
+
+uint32_t PropertyStore::Version( const std::string &name ) const
+{
+	std::map<uint16_t,PropertyValue>::const_iterator value_iter = Values.find( Keys->Find( name ) );
+	if( value_iter != Values.end() )
+		return value_iter->second.Version;
+	return 0;
+}
+
+
+size_t PropertyStore::size( void ) const
+{
+	return Values.size();
+}
+
+
+void PropertyStore::Clear( void )
+{
+	Values.clear();
+	Changed.clear();
+}
+
+
+std::map<std::string,std::string> PropertyStore::Map( void ) const
+{
+	std::map<std::string,std::string> map;
+	for( std::map<uint16_t,PropertyValue>::const_iterator value_iter = Values.begin(); value_iter != Values.end(); value_iter ++ )
+		map[ Keys->Name( value_iter->first ) ] = value_iter->second.Value;
+	return map;
+}
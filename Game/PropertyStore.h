@@ -0,0 +1,92 @@
+/*
+ *  PropertyStore.h
+ */
+
+#pragma once
+class PropertyKeys;
+class PropertyValue;
+class PropertyStore;
+
+#include "PlatformSpecific.h"
+
+#include <stdint.h>
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+
+
+// Property names are interned to small numeric IDs so stores and network deltas don't pass strings around.
+// Each GameData has its own table; IDs are only meaningful within that table, so the network code translates them.
+// A store that isn't in a GameData yet uses a table of its own, so nothing here is shared between threads.
+//
+// PropertyStore replaces the std::map<std::string,std::string> that Player and GameData used to expose:
+//   Properties[ name ] = value      becomes  Properties.Set( name, value )
+//   Properties.find( name )         becomes  Properties.Find( name ), which returns NULL if it's not set
+//   Properties[ name ] (to read)    becomes  Properties.Get( name )
+//   iterating over Properties       becomes  iterating over Properties.Map(), a name-to-value copy
+
+
+class PropertyKeys
+{
+public:
+	std::map<std::string,uint16_t> IDs;
+	std::vector<std::string> Names;
+	uint32_t Version;
+	
+	
+	PropertyKeys( void );
+	virtual ~PropertyKeys();
+	
+	uint16_t Intern( const std::string &name );
+	uint16_t Find( const std::string &name ) const;
+	const std::string &Name( uint16_t id ) const;
+	uint16_t Last( void ) const;
+};
+
+
+class PropertyValue
+{
+public:
+	std::string Value;
+	uint32_t Version;
+	
+	PropertyValue( void );
+};
+
+
+class PropertyStore
+{
+public:
+	PropertyKeys *Keys;
+	std::map<uint16_t,PropertyValue> Values;
+	
+	// Keys set since the last time the server sent changes.
+	std::set<uint16_t> Changed;
+	
+	
+	PropertyStore( void );
+	PropertyStore( const PropertyStore &other );
+	virtual ~PropertyStore();
+	
+	PropertyStore &operator=( const PropertyStore &other );
+	
+	void SetKeys( PropertyKeys *keys );
+	
+	bool Set( const std::string &name, const std::string &value );
+	bool Set( uint16_t key, const std::string &value, uint32_t version = 0 );
+	
+	const std::string *Find( const std::string &name ) const;
+	const std::string *Find( uint16_t key ) const;
+	std::string Get( const std::string &name, const std::string &default_value = "" ) const;
+	bool Has( const std::string &name ) const;
+	uint32_t Version( const std::string &name ) const;
+	
+	size_t size( void ) const;
+	void Clear( void );
+	std::map<std::string,std::string> Map( void ) const;
+
+private:
+	// Used until SetKeys attaches the store to a GameData's table, or after SetKeys( NULL ) detaches it.
+	PropertyKeys LocalKeys;
+};
@@ -0,0 +1,501 @@
+/*
+ *  SpatialIndex.cpp
+ */
+
+#include "SpatialIndex.h"
+
+#include <cmath>
+#include <algorithm>
+#include "GameObject.h"
+
+
+// Cell coordinates are packed 21 bits per axis into the 64-bit key, offset so negative coordinates fit.
+#define SPATIAL_COORD_BITS 21
+#define SPATIAL_COORD_OFFSET (1 << (SPATIAL_COORD_BITS - 1))
+
+
+SpatialCell::SpatialCell( int x, int y, int z )
+{
+	X = x;
+	Y = y;
+	Z = z;
+}
+
+
+SpatialCell::~SpatialCell()
+{
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+SpatialEntry::SpatialEntry( GameObject *obj, uint64_t cell )
+{
+	Object = obj;
+	Cell = cell;
+}
+
+
+SpatialEntry::~SpatialEntry()
+{
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+class SpatialNearer
+{
+public:
+	bool operator()( const std::pair<double,GameObject*> &a, const std::pair<double,GameObject*> &b ) const
+	{
+		// Break ties by ID so results don't depend on where objects happen to be in memory.
+		if( a.first != b.first )
+			return a.first < b.first;
+		return a.second->ID < b.second->ID;
+	}
+};
+
+
+static bool SpatialSegmentHitsBox( const Vec3D &start, const Vec3D &dir, double length, const double *min, const double *max )
+{
+	double t_min = 0., t_max = length;
+	double origin[ 3 ] = { start.X, start.Y, start.Z };
+	double d[ 3 ] = { dir.X, dir.Y, dir.Z };
+	
+	for( int axis = 0; axis < 3; axis ++ )
+	{
+		if( fabs(d[ axis ]) < 1e-12 )
+		{
+			if( (origin[ axis ] < min[ axis ]) || (origin[ axis ] > max[ axis ]) )
+				return false;
+			continue;
+		}
+		
+		double t1 = (min[ axis ] - origin[ axis ]) / d[ axis ];
+		double t2 = (max[ axis ] - origin[ axis ]) / d[ axis ];
+		if( t1 > t2 )
+			std::swap( t1, t2 );
+		t_min = std::max<double>( t_min, t1 );
+		t_max = std::min<double>( t_max, t2 );
+		if( t_min > t_max )
+			return false;
+	}
+	
+	return true;
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+SpatialIndex::SpatialIndex( double cell_size )
+{
+	CellSize = (cell_size > 0.) ? cell_size : 512.;
+	MaxRadius = 0.;
+}
+
+
+SpatialIndex::~SpatialIndex()
+{
+}
+
+
+void SpatialIndex::Clear( void )
+{
+	Cells.clear();
+	Entries.clear();
+	MaxRadius = 0.;
+}
+
+
+void SpatialIndex::SetCellSize( double cell_size )
+{
+	if( (cell_size <= 0.) || (cell_size == CellSize) )
+		return;
+	
+	CellSize = cell_size;
+	
+	// Every object's cell changes, so rebuild the grid from the entries.
+	Cells.clear();
+	for( std::map<uint32_t,SpatialEntry>::iterator entry_iter = Entries.begin(); entry_iter != Entries.end(); entry_iter ++ )
+	{
+		entry_iter->second.Cell = CellKey( entry_iter->second.Object );
+		AddToCell( entry_iter->second.Object, entry_iter->second.Cell );
+	}
+}
+
+
+void SpatialIndex::Insert( GameObject *obj )
+{
+	if( ! obj )
+		return;
+	
+	std::map<uint32_t,SpatialEntry>::iterator entry_iter = Entries.find( obj->ID );
+	if( entry_iter != Entries.end() )
+	{
+		Move( obj );
+		return;
+	}
+	
+	uint64_t key = CellKey( obj );
+	Entries[ obj->ID ] = SpatialEntry( obj, key );
+	AddToCell( obj, key );
+	
+	double radius = obj->BoundingRadius();
+	if( radius > MaxRadius )
+		MaxRadius = radius;
+}
+
+
+void SpatialIndex::Remove( uint32_t id )
+{
+	std::map<uint32_t,SpatialEntry>::iterator entry_iter = Entries.find( id );
+	if( entry_iter == Entries.end() )
+		return;
+	
+	RemoveFromCell( entry_iter->second.Object, entry_iter->second.Cell );
+	Entries.erase( entry_iter );
+}
+
+
+void SpatialIndex::Move( GameObject *obj )
+{
+	if( ! obj )
+		return;
+	
+	std::map<uint32_t,SpatialEntry>::iterator entry_iter = Entries.find( obj->ID );
+	if( entry_iter == Entries.end() )
+	{
+		Insert( obj );
+		return;
+	}
+	
+	uint64_t key = CellKey( obj );
+	if( (key != entry_iter->second.Cell) || (obj != entry_iter->second.Object) )
+	{
+		RemoveFromCell( entry_iter->second.Object, entry_iter->second.Cell );
+		AddToCell( obj, key );
+		entry_iter->second.Object = obj;
+		entry_iter->second.Cell = key;
+	}
+	
+	double radius = obj->BoundingRadius();
+	if( radius > MaxRadius )
+		MaxRadius = radius;
+}
+
+
+void SpatialIndex::Refresh( void )
+{
+	// Most objects stay in the same cell from one update to the next, so this is usually just a key comparison each.
+	for( std::map<uint32_t,SpatialEntry>::iterator entry_iter = Entries.begin(); entry_iter != Entries.end(); entry_iter ++ )
+	{
+		GameObject *obj = entry_iter->second.Object;
+		if( obj->Sleeping )
+			continue;
+		
+		uint64_t key = CellKey( obj );
+		if( key != entry_iter->second.Cell )
+		{
+			RemoveFromCell( obj, entry_iter->second.Cell );
+			AddToCell( obj, key );
+			entry_iter->second.Cell = key;
+		}
+	}
+}
+
+
+size_t SpatialIndex::Count( void ) const
+{
+	return Entries.size();
+}
+
+
+size_t SpatialIndex::WithinRadius( const Pos3D *center, double radius, std::vector<GameObject*> *found, uint32_t type, uint32_t exclude_id ) const
+{
+	found->clear();
+	if( radius < 0. )
+		return 0;
+	
+	std::vector<const SpatialCell*> cells;
+	CellsInRange( Vec3D( center->X - radius, center->Y - radius, center->Z - radius ), Vec3D( center->X + radius, center->Y + radius, center->Z + radius ), &cells );
+	
+	double radius_squared = radius * radius;
+	for( std::vector<const SpatialCell*>::const_iterator cell_iter = cells.begin(); cell_iter != cells.end(); cell_iter ++ )
+	{
+		for( std::vector<GameObject*>::const_iterator obj_iter = (*cell_iter)->Objects.begin(); obj_iter != (*cell_iter)->Objects.end(); obj_iter ++ )
+		{
+			const GameObject *obj = *obj_iter;
+			double dx = obj->X - center->X, dy = obj->Y - center->Y, dz = obj->Z - center->Z;
+			if( (dx*dx + dy*dy + dz*dz <= radius_squared) && Matches( obj, type, exclude_id ) )
+				found->push_back( *obj_iter );
+		}
+	}
+	
+	return found->size();
+}
+
+
+size_t SpatialIndex::WithinBox( const Vec3D &min, const Vec3D &max, std::vector<GameObject*> *found, uint32_t type, uint32_t exclude_id ) const
+{
+	found->clear();
+	
+	std::vector<const SpatialCell*> cells;
+	CellsInRange( min, max, &cells );
+	
+	for( std::vector<const SpatialCell*>::const_iterator cell_iter = cells.begin(); cell_iter != cells.end(); cell_iter ++ )
+	{
+		for( std::vector<GameObject*>::const_iterator obj_iter = (*cell_iter)->Objects.begin(); obj_iter != (*cell_iter)->Objects.end(); obj_iter ++ )
+		{
+			const GameObject *obj = *obj_iter;
+			if( (obj->X < min.X) || (obj->X > max.X) || (obj->Y < min.Y) || (obj->Y > max.Y) || (obj->Z < min.Z) || (obj->Z > max.Z) )
+				continue;
+			if( Matches( obj, type, exclude_id ) )
+				found->push_back( *obj_iter );
+		}
+	}
+	
+	return found->size();
+}
+
+
+size_t SpatialIndex::NearestObjects( const Pos3D *pt, size_t count, std::vector<GameObject*> *found, uint32_t type, uint32_t exclude_id, double max_dist ) const
+{
+	found->clear();
+	if( (! count) || Cells.empty() || (max_dist < 0.) )
+		return 0;
+	
+	// Search a growing radius until it holds enough matches.  Any object outside the radius is farther than
+	// everything inside it, so once there are enough inside, the nearest of those are the nearest overall.
+	std::vector<const SpatialCell*> cells;
+	std::vector< std::pair<double,GameObject*> > candidates;
+	double radius = std::min<double>( CellSize, max_dist );
+	
+	for( ;; )
+	{
+		cells.clear();
+		candidates.clear();
+		CellsInRange( Vec3D( pt->X - radius, pt->Y - radius, pt->Z - radius ), Vec3D( pt->X + radius, pt->Y + radius, pt->Z + radius ), &cells );
+		
+		// Once every occupied cell is in range, growing the radius can't find anything new, so take everything within max_dist.
+		bool all_cells = (cells.size() >= Cells.size());
+		double radius_squared = all_cells ? (max_dist * max_dist) : (radius * radius);
+		for( std::vector<const SpatialCell*>::const_iterator cell_iter = cells.begin(); cell_iter != cells.end(); cell_iter ++ )
+		{
+			for( std::vector<GameObject*>::const_iterator obj_iter = (*cell_iter)->Objects.begin(); obj_iter != (*cell_iter)->Objects.end(); obj_iter ++ )
+			{
+				const GameObject *obj = *obj_iter;
+				double dx = obj->X - pt->X, dy = obj->Y - pt->Y, dz = obj->Z - pt->Z;
+				double dist_squared = dx*dx + dy*dy + dz*dz;
+				if( (dist_squared <= radius_squared) && Matches( obj, type, exclude_id ) )
+					candidates.push_back( std::pair<double,GameObject*>( dist_squared, *obj_iter ) );
+			}
+		}
+		
+		if( (candidates.size() >= count) || (radius >= max_dist) || all_cells )
+			break;
+		
+		radius = std::min<double>( radius * 2., max_dist );
+	}
+	
+	if( candidates.size() > count )
+	{
+		std::partial_sort( candidates.begin(), candidates.begin() + count, candidates.end(), SpatialNearer() );
+		candidates.resize( count );
+	}
+	else
+		std::sort( candidates.begin(), candidates.end(), SpatialNearer() );
+	
+	for( std::vector< std::pair<double,GameObject*> >::const_iterator candidate_iter = candidates.begin(); candidate_iter != candidates.end(); candidate_iter ++ )
+		found->push_back( candidate_iter->second );
+	
+	return found->size();
+}
+
+
+GameObject *SpatialIndex::NearestObject( const Pos3D *pt, uint32_t type, uint32_t exclude_id, double max_dist ) const
+{
+	std::vector<GameObject*> found;
+	if( NearestObjects( pt, 1, &found, type, exclude_id, max_dist ) )
+		return found.front();
+	return NULL;
+}
+
+
+GameObject *SpatialIndex::RayCast( const Pos3D *start, const Vec3D *direction, double max_dist, double *hit_dist, uint32_t type, uint32_t exclude_id ) const
+{
+	double length = direction->Length();
+	if( (! length) || (max_dist < 0.) || Cells.empty() )
+		return NULL;
+	
+	Vec3D origin( start->X, start->Y, start->Z );
+	Vec3D dir = *direction / length;
+	Vec3D end = origin + dir * max_dist;
+	
+	Vec3D min( std::min<double>( origin.X, end.X ) - MaxRadius, std::min<double>( origin.Y, end.Y ) - MaxRadius, std::min<double>( origin.Z, end.Z ) - MaxRadius );
+	Vec3D max( std::max<double>( origin.X, end.X ) + MaxRadius, std::max<double>( origin.Y, end.Y ) + MaxRadius, std::max<double>( origin.Z, end.Z ) + MaxRadius );
+	std::vector<const SpatialCell*> cells;
+	CellsInRange( min, max, &cells );
+	
+	GameObject *hit = NULL;
+	double best = max_dist;
+	
+	for( std::vector<const SpatialCell*>::const_iterator cell_iter = cells.begin(); cell_iter != cells.end(); cell_iter ++ )
+	{
+		// Objects can stick out of their cell by up to MaxRadius, so skip cells whose padded bounds the ray misses.
+		const SpatialCell *cell = *cell_iter;
+		double cell_min[ 3 ] = { cell->X * CellSize - MaxRadius, cell->Y * CellSize - MaxRadius, cell->Z * CellSize - MaxRadius };
+		double cell_max[ 3 ] = { (cell->X + 1) * CellSize + MaxRadius, (cell->Y + 1) * CellSize + MaxRadius, (cell->Z + 1) * CellSize + MaxRadius };
+		if( ! SpatialSegmentHitsBox( origin, dir, best, cell_min, cell_max ) )
+			continue;
+		
+		for( std::vector<GameObject*>::const_iterator obj_iter = cell->Objects.begin(); obj_iter != cell->Objects.end(); obj_iter ++ )
+		{
+			const GameObject *obj = *obj_iter;
+			double radius = obj->BoundingRadius();
+			if( radius <= 0. )
+				continue;
+			
+			Vec3D to_obj( obj->X - origin.X, obj->Y - origin.Y, obj->Z - origin.Z );
+			double along = to_obj.Dot( dir );
+			double miss_squared = to_obj.Dot( to_obj ) - along * along;
+			double radius_squared = radius * radius;
+			if( miss_squared > radius_squared )
+				continue;
+			
+			double half_chord = sqrt( radius_squared - miss_squared );
+			double dist = along - half_chord;
+			if( dist < 0. )
+			{
+				// Starting inside the sphere counts as a hit right away; a sphere entirely behind the start doesn't.
+				if( along + half_chord < 0. )
+					continue;
+				dist = 0.;
+			}
+			
+			if( (dist > best) || ((dist == best) && hit && (obj->ID >= hit->ID)) || ! Matches( obj, type, exclude_id ) )
+				continue;
+			
+			// The bounding sphere only says the ray might hit; objects with a model are hit where it meets their triangles.
+			const Model *model = obj->CollisionModel();
+			if( model )
+			{
+				Pos3D ray_start( origin.X, origin.Y, origin.Z );
+				Pos3D ray_end( origin.X + dir.X * best, origin.Y + dir.Y * best, origin.Z + dir.Z * best );
+				Pos3D at;
+				if( ! model->SegmentHit( obj, &ray_start, &ray_end, 1., &at ) )
+					continue;
+				
+				dist = ray_start.Dist( &at );
+				if( (dist > best) || ((dist == best) && hit && (obj->ID >= hit->ID)) )
+					continue;
+			}
+			
+			hit = *obj_iter;
+			best = dist;
+		}
+	}
+	
+	if( hit && hit_dist )
+		*hit_dist = best;
+	
+	return hit;
+}
+
+
+int SpatialIndex::CellCoord( double value ) const
+{
+	double coord = floor( value / CellSize );
+	if( coord < -SPATIAL_COORD_OFFSET )
+		return -SPATIAL_COORD_OFFSET;
+	if( coord > SPATIAL_COORD_OFFSET - 1 )
+		return SPATIAL_COORD_OFFSET - 1;
+	return (int) coord;
+}
+
+
+uint64_t SpatialIndex::CellKey( int x, int y, int z ) const
+{
+	return ((uint64_t)( x + SPATIAL_COORD_OFFSET ) << (SPATIAL_COORD_BITS * 2))
+	     | ((uint64_t)( y + SPATIAL_COORD_OFFSET ) << SPATIAL_COORD_BITS)
+	     |  (uint64_t)( z + SPATIAL_COORD_OFFSET );
+}
+
+
+uint64_t SpatialIndex::CellKey( const Pos3D *pos ) const
+{
+	return CellKey( CellCoord( pos->X ), CellCoord( pos->Y ), CellCoord( pos->Z ) );
+}
+
+
+void SpatialIndex::AddToCell( GameObject *obj, uint64_t key )
+{
+	std::map<uint64_t,SpatialCell>::iterator cell_iter = Cells.find( key );
+	if( cell_iter == Cells.end() )
+		cell_iter = Cells.insert( std::pair<uint64_t,SpatialCell>( key, SpatialCell( CellCoord( obj->X ), CellCoord( obj->Y ), CellCoord( obj->Z ) ) ) ).first;
+	
+	cell_iter->second.Objects.push_back( obj );
+}
+
+
+void SpatialIndex::RemoveFromCell( GameObject *obj, uint64_t key )
+{
+	std::map<uint64_t,SpatialCell>::iterator cell_iter = Cells.find( key );
+	if( cell_iter == Cells.end() )
+		return;
+	
+	std::vector<GameObject*> *objects = &(cell_iter->second.Objects);
+	std::vector<GameObject*>::iterator obj_iter = std::find( objects->begin(), objects->end(), obj );
+	if( obj_iter != objects->end() )
+	{
+		*obj_iter = objects->back();
+		objects->pop_back();
+	}
+	
+	if( objects->empty() )
+		Cells.erase( cell_iter );
+}
+
+
+void SpatialIndex::CellsInRange( const Vec3D &min, const Vec3D &max, std::vector<const SpatialCell*> *cells ) const
+{
+	int lo_x = CellCoord( min.X ), lo_y = CellCoord( min.Y ), lo_z = CellCoord( min.Z );
+	int hi_x = CellCoord( max.X ), hi_y = CellCoord( max.Y ), hi_z = CellCoord( max.Z );
+	if( (hi_x < lo_x) || (hi_y < lo_y) || (hi_z < lo_z) )
+		return;
+	
+	// Look up each cell in range, unless there are fewer occupied cells than that; then just check those instead.
+	double range_cells = (hi_x - lo_x + 1.) * (hi_y - lo_y + 1.) * (hi_z - lo_z + 1.);
+	if( range_cells <= Cells.size() )
+	{
+		for( int x = lo_x; x <= hi_x; x ++ )
+			for( int y = lo_y; y <= hi_y; y ++ )
+				for( int z = lo_z; z <= hi_z; z ++ )
+				{
+					std::map<uint64_t,SpatialCell>::const_iterator cell_iter = Cells.find( CellKey( x, y, z ) );
+					if( cell_iter != Cells.end() )
+						cells->push_back( &(cell_iter->second) );
+				}
+	}
+	else
+	{
+		for( std::map<uint64_t,SpatialCell>::const_iterator cell_iter = Cells.begin(); cell_iter != Cells.end(); cell_iter ++ )
+		{
+			const SpatialCell *cell = &(cell_iter->second);
+			if( (cell->X >= lo_x) && (cell->X <= hi_x) && (cell->Y >= lo_y) && (cell->Y <= hi_y) && (cell->Z >= lo_z) && (cell->Z <= hi_z) )
+				cells->push_back( cell );
+		}
+	}
+}
+
+
+bool SpatialIndex::Matches( const GameObject *obj, uint32_t type, uint32_t exclude_id ) const
+{
+	if( exclude_id && (obj->ID == exclude_id) )
+		return false;
+	if( type && (obj->Type() != type) )
+		return false;
+	return true;
+}
@@ -0,0 +1,85 @@
+/*
+ *  SpatialIndex.h
+ */
+
+#pragma once
+class SpatialCell;
+class SpatialEntry;
+class SpatialIndex;
+
+#include "PlatformSpecific.h"
+
+#include <cstddef>
+#include <cfloat>
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include "Vec.h"
+#include "Pos.h"
+
+class GameObject;
+
+
+class SpatialCell
+{
+public:
+	int X, Y, Z;
+	std::vector<GameObject*> Objects;
+	
+	SpatialCell( int x = 0, int y = 0, int z = 0 );
+	virtual ~SpatialCell();
+};
+
+
+class SpatialEntry
+{
+public:
+	GameObject *Object;
+	uint64_t Cell;
+	
+	SpatialEntry( GameObject *obj = NULL, uint64_t cell = 0 );
+	virtual ~SpatialEntry();
+};
+
+
+// Hashed grid of object positions, kept up to date as objects move so queries only look at nearby cells.
+// Radius, box and nearest queries go by object position; ray casts test each object's GameObject::BoundingRadius, then its CollisionModel if it has one.
+// A type of 0 matches any type, and an exclude_id of 0 excludes nothing.
+class SpatialIndex
+{
+public:
+	double CellSize;
+	
+	// Largest BoundingRadius seen since the last Clear, so ray casts know how far past a cell objects can reach.
+	double MaxRadius;
+	
+	std::map<uint64_t,SpatialCell> Cells;
+	std::map<uint32_t,SpatialEntry> Entries;
+	
+	
+	SpatialIndex( double cell_size = 512. );
+	virtual ~SpatialIndex();
+	
+	void Clear( void );
+	void SetCellSize( double cell_size );
+	void Insert( GameObject *obj );
+	void Remove( uint32_t id );
+	void Move( GameObject *obj );
+	void Refresh( void );
+	size_t Count( void ) const;
+	
+	size_t WithinRadius( const Pos3D *center, double radius, std::vector<GameObject*> *found, uint32_t type = 0, uint32_t exclude_id = 0 ) const;
+	size_t WithinBox( const Vec3D &min, const Vec3D &max, std::vector<GameObject*> *found, uint32_t type = 0, uint32_t exclude_id = 0 ) const;
+	size_t NearestObjects( const Pos3D *pt, size_t count, std::vector<GameObject*> *found, uint32_t type = 0, uint32_t exclude_id = 0, double max_dist = DBL_MAX ) const;
+	GameObject *NearestObject( const Pos3D *pt, uint32_t type = 0, uint32_t exclude_id = 0, double max_dist = DBL_MAX ) const;
+	GameObject *RayCast( const Pos3D *start, const Vec3D *direction, double max_dist, double *hit_dist = NULL, uint32_t type = 0, uint32_t exclude_id = 0 ) const;
+
+private:
+	int CellCoord( double value ) const;
+	uint64_t CellKey( int x, int y, int z ) const;
+	uint64_t CellKey( const Pos3D *pos ) const;
+	void AddToCell( GameObject *obj, uint64_t key );
+	void RemoveFromCell( GameObject *obj, uint64_t key );
+	void CellsInRange( const Vec3D &min, const Vec3D &max, std::vector<const SpatialCell*> *cells ) const;
+	bool Matches( const GameObject *obj, uint32_t type, uint32_t exclude_id ) const;
+};
@@ -170,6 +170,13 @@ void Animation::Start( void )
 
 
 GLuint Animation::CurrentFrame( void )
+{
+	MostRecentFrame = FrameAt( Timer.ElapsedSeconds(), Speed );
+	return MostRecentFrame;
+}
+
+
+GLuint Animation::FrameAt( double seconds, double speed )
 {
 	if( LoadedTime.ElapsedSeconds() > Raptor::Game->Res.ResetTime.ElapsedSeconds() )
 		Reload();
@@ -177,43 +184,38 @@ GLuint Animation::CurrentFrame( void )
 	int count = FrameTimes.size();
 	if( count )
 	{
-		if( Finished() )
+		if( FinishedAt( seconds, speed ) )
 		{
 			// If the animation is done looping, always return the last frame.
 			
 			try
 			{
-				MostRecentFrame = Frames.at( count - 1 );
-				return MostRecentFrame;
+				return Frames.at( count - 1 );
 			}
 			catch( std::out_of_range &exception )
 			{
-				fprintf( stderr, "Animation::CurrentFrame: std::out_of_range\n" );
+				fprintf( stderr, "Animation::FrameAt: std::out_of_range\n" );
 			}
 			
-			MostRecentFrame = 0;
-			return MostRecentFrame;
+			return 0;
 		}
 		
 		
 		// Figure out where we are in the cycle and return that frame.
 		
-		double time_in_animation = fmod( Timer.ElapsedSeconds(), LoopTime() );
+		double time_in_animation = fmod( seconds, StoredTime() / speed );
 		
 		for( int i = 0; i < count; i ++ )
 		{
 			try
 			{
-				time_in_animation -= FrameTimes.at( i ) / Speed;
+				time_in_animation -= FrameTimes.at( i ) / speed;
 				if( time_in_animation < 0.0 )
-				{
-					MostRecentFrame = Frames.at( i );
-					return MostRecentFrame;
-				}
+					return Frames.at( i );
 			}
 			catch( std::out_of_range &exception )
 			{
-				fprintf( stderr, "Animation::CurrentFrame: std::out_of_range\n" );
+				fprintf( stderr, "Animation::FrameAt: std::out_of_range\n" );
 			}
 		}
 		
@@ -226,15 +228,14 @@ GLuint Animation::CurrentFrame( void )
 		}
 		catch( std::out_of_range &exception )
 		{
-			fprintf( stderr, "Animation::CurrentFrame: std::out_of_range\n" );
+			fprintf( stderr, "Animation::FrameAt: std::out_of_range\n" );
 		}
 	}
 	
 	
 	// If there are no frames or something went wrong, return 0.
 	
-	MostRecentFrame = 0;
-	return MostRecentFrame;
+	return 0;
 }
 
 
@@ -266,12 +267,18 @@ double Animation::LoopTime( void )
 
 
 bool Animation::Finished( void )
+{
+	return FinishedAt( Timer.ElapsedSeconds(), Speed );
+}
+
+
+bool Animation::FinishedAt( double seconds, double speed )
 {
 	// PlayCount 0 means loop forever, so it's never finished.
 	if( PlayCount <= 0 )
 		return false;
 	
-	if( Timer.ElapsedSeconds() >= (LoopTime() * (double) PlayCount) )
+	if( seconds >= (StoredTime() / speed * (double) PlayCount) )
 		return true;
 	
 	return false;
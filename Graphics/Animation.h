@@ -41,6 +41,10 @@ public:
 	double LoopTime( void );
 	bool Finished( void );
 	
+	// For things like particles that share this animation but each started at a different time and speed.
+	GLuint FrameAt( double seconds, double speed );
+	bool FinishedAt( double seconds, double speed );
+	
 private:
 	Clock LoadedTime;
 };
@@ -112,3 +112,31 @@ void Effect::Draw( void )
 	glDisable( GL_TEXTURE_2D );
 }
 
+
+// -----------------------------------------------------------------------------
+
+
+EffectRequest::EffectRequest( Animation *anim, double size, Mix_Chunk *sound, double loudness, const Pos3D *pos, const Vec3D *motion_vec, double rotation_speed, double speed_scale, double seconds_to_live ) : Pos( pos )
+{
+	Anim = anim;
+	Size = size;
+	Sound = sound;
+	Loudness = loudness;
+	HasMotion = motion_vec;
+	if( motion_vec )
+		MotionVector = *motion_vec;
+	RotationSpeed = rotation_speed;
+	SpeedScale = speed_scale;
+	SecondsToLive = seconds_to_live;
+}
+
+
+EffectRequest::~EffectRequest()
+{
+}
+
+
+Effect EffectRequest::Create( void ) const
+{
+	return Effect( Anim, Size, Sound, Loudness, &Pos, HasMotion ? &MotionVector : NULL, RotationSpeed, SpeedScale, SecondsToLive );
+}
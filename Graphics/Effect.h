@@ -32,3 +32,25 @@ public:
 	bool Finished( void );
 	void Draw( void );
 };
+
+
+// Everything needed to create an Effect later, such as one requested during a parallel update that must start on the main thread.
+class EffectRequest
+{
+public:
+	Animation *Anim;
+	double Size;
+	Mix_Chunk *Sound;
+	double Loudness;
+	Pos3D Pos;
+	Vec3D MotionVector;
+	bool HasMotion;
+	double RotationSpeed;
+	double SpeedScale;
+	double SecondsToLive;
+	
+	EffectRequest( Animation *anim, double size, Mix_Chunk *sound, double loudness, const Pos3D *pos, const Vec3D *motion_vec = NULL, double rotation_speed = 0, double speed_scale = 1., double seconds_to_live = -1. );
+	virtual ~EffectRequest();
+	
+	Effect Create( void ) const;
+};
@@ -429,6 +429,9 @@ bool Model::IncludeOBJ( std::string filename, bool get_textures )
 		
 		input.close();
 		
+		// Collision queries may run on other threads, so their BVHs must be ready before anyone else sees the model.
+		BuildBVH();
+		
 		// Return true for success.
 		return true;
 	}
@@ -494,6 +497,13 @@ void Model::CalculateNormals( void )
 }
 
 
+void Model::BuildBVH( void )
+{
+	for( std::map<std::string,ModelObject>::iterator obj_iter = Objects.begin(); obj_iter != Objects.end(); obj_iter ++ )
+		obj_iter->second.BuildBVH();
+}
+
+
 void Model::DrawAt( const Pos3D *pos, double scale, double fwd_scale, double up_scale, double right_scale )
 {
 	bool use_shaders = Raptor::Game->ShaderMgr.Active();
@@ -1008,6 +1018,7 @@ void Model::Move( double fwd, double up, double right )
 	}
 	
 	MakeMaterialArrays();
+	BuildBVH();
 	
 	if( MaxRadius >= 0. )
 	{
@@ -1058,6 +1069,7 @@ void Model::ScaleBy( double fwd_scale, double up_scale, double right_scale )
 		}
 		
 		obj_iter->second.Recalc();
+		obj_iter->second.BuildBVH();
 	}
 	
 	MakeMaterialArrays();
@@ -1275,6 +1287,72 @@ int Model::VertexCount( void ) const
 }
 
 
+bool Model::SegmentHit( const Pos3D *pos, const Pos3D *end1, const Pos3D *end2, double scale, Pos3D *at, std::string *object_name ) const
+{
+	// Find the hit nearest end1 across all objects, not just the first object that was hit.
+	bool hit = false;
+	double best_dist = DBL_MAX;
+	
+	for( std::map<std::string,ModelObject>::const_iterator obj_iter = Objects.begin(); obj_iter != Objects.end(); obj_iter ++ )
+	{
+		Pos3D obj_at;
+		if( ! obj_iter->second.GetBVH()->SegmentHit( pos, end1, end2, scale, &obj_at ) )
+			continue;
+		
+		double dist = end1->Dist( &obj_at );
+		if( dist < best_dist )
+		{
+			hit = true;
+			best_dist = dist;
+			if( at )
+				at->SetPos( obj_at.X, obj_at.Y, obj_at.Z );
+			if( object_name )
+				*object_name = obj_iter->first;
+		}
+	}
+	
+	return hit;
+}
+
+
+bool Model::SphereHit( const Pos3D *pos, const Pos3D *center, double radius, double scale, std::string *object_name ) const
+{
+	for( std::map<std::string,ModelObject>::const_iterator obj_iter = Objects.begin(); obj_iter != Objects.end(); obj_iter ++ )
+	{
+		if( obj_iter->second.GetBVH()->SphereHit( pos, center, radius, scale ) )
+		{
+			if( object_name )
+				*object_name = obj_iter->first;
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
+double Model::ClosestPoint( const Pos3D *pos, const Pos3D *pt, double scale, Pos3D *closest, std::string *object_name ) const
+{
+	double best_dist = DBL_MAX;
+	
+	for( std::map<std::string,ModelObject>::const_iterator obj_iter = Objects.begin(); obj_iter != Objects.end(); obj_iter ++ )
+	{
+		Pos3D obj_closest;
+		double dist = obj_iter->second.GetBVH()->ClosestPoint( pos, pt, scale, &obj_closest );
+		if( dist < best_dist )
+		{
+			best_dist = dist;
+			if( closest )
+				closest->SetPos( obj_closest.X, obj_closest.Y, obj_closest.Z );
+			if( object_name )
+				*object_name = obj_iter->first;
+		}
+	}
+	
+	return best_dist;
+}
+
+
 // ---------------------------------------------------------------------------
 
 
@@ -1645,6 +1723,7 @@ ModelObject::ModelObject( void )
 	CenterPoint.SetPos( 0., 0., 0. );
 	MaxRadius = 0.;
 	NeedsRecalc = false;
+	SharedBVH = NULL;
 	
 	RandomizeExplosionVectors();
 }
@@ -1658,6 +1737,8 @@ ModelObject::ModelObject( const ModelObject &other )
 	CenterPoint = other.CenterPoint;
 	MaxRadius = other.MaxRadius;
 	NeedsRecalc = other.NeedsRecalc;
+	BVH = other.BVH;
+	SharedBVH = other.SharedBVH;
 	
 	ExplosionRotationAxis = other.ExplosionRotationAxis;
 	ExplosionRotationRate = other.ExplosionRotationRate;
@@ -1684,6 +1765,8 @@ void ModelObject::BecomeInstance( const ModelObject *other )
 	ExplosionRotationRate = other->ExplosionRotationRate;
 	
 	NeedsRecalc = true;
+	BVH.Clear();
+	SharedBVH = other->GetBVH();
 }
 
 
@@ -1872,6 +1955,22 @@ Vec3D ModelObject::GetExplosionMotion( void )
 }
 
 
+void ModelObject::BuildBVH( void )
+{
+	BVH.Clear();
+	for( std::map<std::string,ModelArrays>::const_iterator array_iter = Arrays.begin(); array_iter != Arrays.end(); array_iter ++ )
+		BVH.AddTriangles( array_iter->second.VertexArray, array_iter->second.VertexCount );
+	BVH.Build();
+	SharedBVH = NULL;
+}
+
+
+const MeshBVH *ModelObject::GetBVH( void ) const
+{
+	return SharedBVH ? SharedBVH : &BVH;
+}
+
+
 // ---------------------------------------------------------------------------
 
 
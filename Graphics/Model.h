@@ -18,6 +18,7 @@ class ModelMaterial;
 #include "RaptorGL.h"
 #include "Vec.h"
 #include "Pos.h"
+#include "MeshBVH.h"
 #include "Animation.h"
 #include "Color.h"
 
@@ -43,6 +44,7 @@ public:
 	bool IncludeOBJ( std::string filename, bool get_textures = true );
 	void MakeMaterialArrays( void );
 	void CalculateNormals( void );
+	void BuildBVH( void );
 	
 	void DrawAt( const Pos3D *pos, double scale = 1., double fwd_scale = 1., double up_scale = 1., double right_scale = 1. );
 	void DrawObjectsAt( const std::list<std::string> *object_names, const Pos3D *pos, double scale = 1., double fwd_scale = 1., double up_scale = 1., double right_scale = 1. );
@@ -66,6 +68,10 @@ public:
 	int ArrayCount( void ) const;
 	int TriangleCount( void ) const;
 	int VertexCount( void ) const;
+	
+	bool SegmentHit( const Pos3D *pos, const Pos3D *end1, const Pos3D *end2, double scale = 1., Pos3D *at = NULL, std::string *object_name = NULL ) const;
+	bool SphereHit( const Pos3D *pos, const Pos3D *center, double radius, double scale = 1., std::string *object_name = NULL ) const;
+	double ClosestPoint( const Pos3D *pos, const Pos3D *pt, double scale = 1., Pos3D *closest = NULL, std::string *object_name = NULL ) const;
 };
 
 
@@ -134,9 +140,16 @@ public:
 	double GetWidth( void );
 	double GetMaxRadius( void );
 	Vec3D GetExplosionMotion( void );
+	void BuildBVH( void );
+	const MeshBVH *GetBVH( void ) const;
 	
 private:
 	bool NeedsRecalc;
+	
+	// Built by whichever thread loads or reshapes the model, so collision queries on other threads only read it.
+	// Instances share their original's vertex arrays, so they share its BVH too.
+	MeshBVH BVH;
+	const MeshBVH *SharedBVH;
 };
 
 
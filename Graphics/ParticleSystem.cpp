@@ -0,0 +1,363 @@
+/*
+ *  ParticleSystem.cpp
+ */
+
+#include "ParticleSystem.h"
+
+#include <cmath>
+#include <algorithm>
+#include "Num.h"
+#include "RaptorGame.h"
+
+
+ParticleSystem::ParticleSystem( void )
+{
+	PlayingAudio = 0;
+}
+
+
+ParticleSystem::~ParticleSystem()
+{
+	Clear();
+}
+
+
+size_t ParticleSystem::Add( const Animation *anim, double size, Mix_Chunk *sound, double loudness, const Pos3D *pos, const Vec3D *motion_vec, double rotation_speed, double speed_scale, double seconds_to_live )
+{
+	size_t index = Anims.size();
+	Resize( index + 1 );
+	
+	Anims[ index ] = Instance( anim );
+	X[ index ] = pos->X;
+	Y[ index ] = pos->Y;
+	Z[ index ] = pos->Z;
+	MotionX[ index ] = motion_vec ? motion_vec->X : 0.;
+	MotionY[ index ] = motion_vec ? motion_vec->Y : 0.;
+	MotionZ[ index ] = motion_vec ? motion_vec->Z : 0.;
+	Rotation[ index ] = 0.;
+	RotationSpeed[ index ] = rotation_speed;
+	Size[ index ] = size;
+	Age[ index ] = 0.;
+	SecondsToLive[ index ] = seconds_to_live;
+	Speed[ index ] = speed_scale;
+	Red[ index ] = 1.f;
+	Green[ index ] = 1.f;
+	Blue[ index ] = 1.f;
+	Alpha[ index ] = 1.f;
+	AlphaRate[ index ] = 0.f;
+	
+	AudioChannels[ index ] = -1;
+	if( sound )
+		AudioChannels[ index ] = Raptor::Game->Snd.PlayPanned( sound, pos->X, pos->Y, pos->Z, loudness );
+	if( AudioChannels[ index ] != -1 )
+		PlayingAudio ++;
+	
+	return index;
+}
+
+
+size_t ParticleSystem::Add( const EffectRequest &request )
+{
+	return Add( request.Anim, request.Size, request.Sound, request.Loudness, &(request.Pos), request.HasMotion ? &(request.MotionVector) : NULL, request.RotationSpeed, request.SpeedScale, request.SecondsToLive );
+}
+
+
+size_t ParticleSystem::Add( const Effect &effect )
+{
+	// The particle picks up where the effect is now, and takes over its sound channel.
+	size_t index = Add( &(effect.Anim), effect.Size, NULL, 0., &effect, &(effect.MotionVector), effect.RotationSpeed, effect.Anim.Speed, effect.SecondsToLive );
+	Rotation[ index ] = effect.Rotation;
+	Age[ index ] = effect.Lifetime.ElapsedSeconds();
+	SetColor( index, effect.Red, effect.Green, effect.Blue, effect.Alpha );
+	
+	AudioChannels[ index ] = effect.AudioChannel;
+	if( AudioChannels[ index ] != -1 )
+		PlayingAudio ++;
+	
+	return index;
+}
+
+
+void ParticleSystem::SetColor( size_t index, float red, float green, float blue, float alpha, float alpha_rate )
+{
+	if( index >= Anims.size() )
+		return;
+	
+	Red[ index ] = red;
+	Green[ index ] = green;
+	Blue[ index ] = blue;
+	Alpha[ index ] = alpha;
+	AlphaRate[ index ] = alpha_rate;
+}
+
+
+void ParticleSystem::Clear( void )
+{
+	Resize( 0 );
+	PlayingAudio = 0;
+	
+	for( std::map<Animation*,size_t>::iterator instance_iter = InstanceRefs.begin(); instance_iter != InstanceRefs.end(); instance_iter ++ )
+		delete instance_iter->first;
+	InstanceRefs.clear();
+	Instances.clear();
+}
+
+
+size_t ParticleSystem::Count( void ) const
+{
+	return Anims.size();
+}
+
+
+void ParticleSystem::Update( double dt )
+{
+	size_t count = Anims.size();
+	if( ! count )
+		return;
+	
+	// One field per loop, so each is a simple pass the compiler can vectorize.
+	for( size_t i = 0; i < count; i ++ )
+		X[ i ] += MotionX[ i ] * dt;
+	for( size_t i = 0; i < count; i ++ )
+		Y[ i ] += MotionY[ i ] * dt;
+	for( size_t i = 0; i < count; i ++ )
+		Z[ i ] += MotionZ[ i ] * dt;
+	for( size_t i = 0; i < count; i ++ )
+		Rotation[ i ] += RotationSpeed[ i ] * dt;
+	for( size_t i = 0; i < count; i ++ )
+		Age[ i ] += dt;
+	
+	float fade = dt;
+	for( size_t i = 0; i < count; i ++ )
+	{
+		float alpha = Alpha[ i ] + AlphaRate[ i ] * fade;
+		Alpha[ i ] = (alpha > 0.f) ? alpha : 0.f;
+	}
+	
+	if( PlayingAudio )
+	{
+		PlayingAudio = 0;
+		for( size_t i = 0; i < count; i ++ )
+		{
+			if( AudioChannels[ i ] == -1 )
+				continue;
+			
+			AudioChannels[ i ] = Raptor::Game->Snd.SetPos( AudioChannels[ i ], X[ i ], Y[ i ], Z[ i ] );
+			if( AudioChannels[ i ] != -1 )
+				PlayingAudio ++;
+		}
+	}
+	
+	// Remove finished particles, keeping the rest in the order they were added.
+	size_t kept = 0;
+	for( size_t i = 0; i < count; i ++ )
+	{
+		if( Finished( i ) )
+		{
+			if( AudioChannels[ i ] != -1 )
+				PlayingAudio --;
+			Release( Anims[ i ] );
+			continue;
+		}
+		
+		if( kept != i )
+			CopyIndex( kept, i );
+		kept ++;
+	}
+	
+	if( kept != count )
+		Resize( kept );
+}
+
+
+bool ParticleSystem::Finished( size_t index )
+{
+	if( (SecondsToLive[ index ] > 0.) && (Age[ index ] > SecondsToLive[ index ]) )
+		return true;
+	if( (AlphaRate[ index ] < 0.f) && (Alpha[ index ] <= 0.f) )
+		return true;
+	if( Anims[ index ] && Anims[ index ]->FinishedAt( Age[ index ], Speed[ index ] ) )
+		return true;
+	return false;
+}
+
+
+void ParticleSystem::Draw( const Pos3D *cam )
+{
+	size_t count = Anims.size();
+	if( ! count )
+		return;
+	
+	// Sort by texture so each one is bound once; ties keep the order particles were added.
+	DrawOrder.resize( count );
+	for( size_t i = 0; i < count; i ++ )
+		DrawOrder[ i ] = std::pair<GLuint,size_t>( Anims[ i ] ? Anims[ i ]->FrameAt( Age[ i ], Speed[ i ] ) : 0, i );
+	std::sort( DrawOrder.begin(), DrawOrder.end() );
+	
+	VertexArray.resize( count * 4 * 3 );
+	TexCoordArray.resize( count * 4 * 2 );
+	ColorArray.resize( count * 4 * 4 );
+	
+	// Rotating the camera's Up and Right around its Fwd gives each sprite's corners without any RotateAround calls.
+	Vec3D up = cam->Up, right = cam->Right;
+	up.ScaleTo( 1. );
+	right.ScaleTo( 1. );
+	static const GLfloat tex_coords[ 8 ] = { 0.f, 0.f,  0.f, 1.f,  1.f, 1.f,  1.f, 0.f };
+	
+	for( size_t n = 0; n < count; n ++ )
+	{
+		size_t i = DrawOrder[ n ].second;
+		double radians = Num::DegToRad( Rotation[ i ] );
+		double c = cos( radians ) * Size[ i ] * 0.5, s = sin( radians ) * Size[ i ] * 0.5;
+		Vec3D rot_up = up * c + right * s;
+		Vec3D rot_right = right * c - up * s;
+		Vec3D tl = rot_up - rot_right;
+		Vec3D tr = rot_up + rot_right;
+		
+		// Top-left, bottom-left, bottom-right, top-right.
+		GLdouble *vertex = &(VertexArray[ n * 12 ]);
+		vertex[ 0 ] = X[ i ] + tl.X;  vertex[ 1 ] = Y[ i ] + tl.Y;  vertex[ 2 ] = Z[ i ] + tl.Z;
+		vertex[ 3 ] = X[ i ] - tr.X;  vertex[ 4 ] = Y[ i ] - tr.Y;  vertex[ 5 ] = Z[ i ] - tr.Z;
+		vertex[ 6 ] = X[ i ] - tl.X;  vertex[ 7 ] = Y[ i ] - tl.Y;  vertex[ 8 ] = Z[ i ] - tl.Z;
+		vertex[ 9 ] = X[ i ] + tr.X;  vertex[ 10 ] = Y[ i ] + tr.Y;  vertex[ 11 ] = Z[ i ] + tr.Z;
+		
+		std::copy( tex_coords, tex_coords + 8, &(TexCoordArray[ n * 8 ]) );
+		
+		GLfloat *color = &(ColorArray[ n * 16 ]);
+		for( int corner = 0; corner < 4; corner ++ )
+		{
+			color[ corner * 4 + 0 ] = Red[ i ];
+			color[ corner * 4 + 1 ] = Green[ i ];
+			color[ corner * 4 + 2 ] = Blue[ i ];
+			color[ corner * 4 + 3 ] = Alpha[ i ];
+		}
+	}
+	
+	glEnable( GL_TEXTURE_2D );
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glEnableClientState( GL_COLOR_ARRAY );
+	
+	glVertexPointer( 3, GL_DOUBLE, 0, &(VertexArray[ 0 ]) );
+	glTexCoordPointer( 2, GL_FLOAT, 0, &(TexCoordArray[ 0 ]) );
+	glColorPointer( 4, GL_FLOAT, 0, &(ColorArray[ 0 ]) );
+	
+	// One draw call for each run of particles showing the same texture.
+	size_t first = 0;
+	while( first < count )
+	{
+		GLuint texture = DrawOrder[ first ].first;
+		size_t last = first + 1;
+		while( (last < count) && (DrawOrder[ last ].first == texture) )
+			last ++;
+		
+		glBindTexture( GL_TEXTURE_2D, texture );
+		glDrawArrays( GL_QUADS, first * 4, (last - first) * 4 );
+		
+		first = last;
+	}
+	
+	glDisableClientState( GL_COLOR_ARRAY );
+	glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+	glDisableClientState( GL_VERTEX_ARRAY );
+	glDisable( GL_TEXTURE_2D );
+}
+
+
+Animation *ParticleSystem::Instance( const Animation *anim )
+{
+	if( ! anim )
+		return NULL;
+	
+	// The source is only used to find an existing copy; check its frames too, in case it was freed and something else took its address.
+	std::map<const Animation*,Animation*>::iterator instance_iter = Instances.find( anim );
+	if( instance_iter != Instances.end() )
+	{
+		Animation *instance = instance_iter->second;
+		if( (instance->Frames == anim->Frames) && (instance->FrameTimes == anim->FrameTimes) && (instance->PlayCount == anim->PlayCount) )
+		{
+			InstanceRefs[ instance ] ++;
+			return instance;
+		}
+	}
+	
+	Animation *instance = new Animation();
+	instance->BecomeInstance( anim );
+	Instances[ anim ] = instance;
+	InstanceRefs[ instance ] = 1;
+	return instance;
+}
+
+
+void ParticleSystem::Release( Animation *instance )
+{
+	if( ! instance )
+		return;
+	
+	std::map<Animation*,size_t>::iterator ref_iter = InstanceRefs.find( instance );
+	if( ref_iter == InstanceRefs.end() )
+		return;
+	
+	ref_iter->second --;
+	if( ref_iter->second )
+		return;
+	
+	InstanceRefs.erase( ref_iter );
+	for( std::map<const Animation*,Animation*>::iterator instance_iter = Instances.begin(); instance_iter != Instances.end(); instance_iter ++ )
+	{
+		if( instance_iter->second == instance )
+		{
+			Instances.erase( instance_iter );
+			break;
+		}
+	}
+	delete instance;
+}
+
+
+void ParticleSystem::Resize( size_t size )
+{
+	Anims.resize( size );
+	X.resize( size );
+	Y.resize( size );
+	Z.resize( size );
+	MotionX.resize( size );
+	MotionY.resize( size );
+	MotionZ.resize( size );
+	Rotation.resize( size );
+	RotationSpeed.resize( size );
+	Size.resize( size );
+	Age.resize( size );
+	SecondsToLive.resize( size );
+	Speed.resize( size );
+	Red.resize( size );
+	Green.resize( size );
+	Blue.resize( size );
+	Alpha.resize( size );
+	AlphaRate.resize( size );
+	AudioChannels.resize( size );
+}
+
+
+void ParticleSystem::CopyIndex( size_t to, size_t from )
+{
+	Anims[ to ] = Anims[ from ];
+	X[ to ] = X[ from ];
+	Y[ to ] = Y[ from ];
+	Z[ to ] = Z[ from ];
+	MotionX[ to ] = MotionX[ from ];
+	MotionY[ to ] = MotionY[ from ];
+	MotionZ[ to ] = MotionZ[ from ];
+	Rotation[ to ] = Rotation[ from ];
+	RotationSpeed[ to ] = RotationSpeed[ from ];
+	Size[ to ] = Size[ from ];
+	Age[ to ] = Age[ from ];
+	SecondsToLive[ to ] = SecondsToLive[ from ];
+	Speed[ to ] = Speed[ from ];
+	Red[ to ] = Red[ from ];
+	Green[ to ] = Green[ from ];
+	Blue[ to ] = Blue[ from ];
+	Alpha[ to ] = Alpha[ from ];
+	AlphaRate[ to ] = AlphaRate[ from ];
+	AudioChannels[ to ] = AudioChannels[ from ];
+}
@@ -0,0 +1,69 @@
+/*
+ *  ParticleSystem.h
+ */
+
+#pragma once
+class ParticleSystem;
+
+#include "PlatformSpecific.h"
+
+#include <cstddef>
+#include <vector>
+#include <map>
+#include <utility>
+#include "RaptorGL.h"
+#include "Pos.h"
+#include "Animation.h"
+#include "SoundOut.h"
+#include "Effect.h"
+
+
+// Billboard sprites that do what Effect does (motion, spin, fade and lifetime), stored as parallel arrays.
+// Particles update in straight passes over each field, and draw as one vertex array per texture instead of a glBegin block per sprite.
+// Each animation used is instanced once here (like Effect::Anim), and particles made from it share that copy until the last one finishes.
+//
+// GameData::Effects used to be a std::list<Effect>; code that built an Effect and called push_back can pass it to Add instead.
+class ParticleSystem
+{
+public:
+	std::vector<Animation*> Anims;
+	std::vector<double> X, Y, Z;
+	std::vector<double> MotionX, MotionY, MotionZ;
+	std::vector<double> Rotation, RotationSpeed;
+	std::vector<double> Size;
+	std::vector<double> Age, SecondsToLive, Speed;
+	std::vector<float> Red, Green, Blue, Alpha, AlphaRate;
+	std::vector<int> AudioChannels;
+	
+	
+	ParticleSystem( void );
+	virtual ~ParticleSystem();
+	
+	size_t Add( const Animation *anim, double size, Mix_Chunk *sound, double loudness, const Pos3D *pos, const Vec3D *motion_vec = NULL, double rotation_speed = 0, double speed_scale = 1., double seconds_to_live = -1. );
+	size_t Add( const EffectRequest &request );
+	size_t Add( const Effect &effect );
+	void SetColor( size_t index, float red, float green, float blue, float alpha = 1.f, float alpha_rate = 0.f );
+	void Clear( void );
+	size_t Count( void ) const;
+	
+	void Update( double dt );
+	bool Finished( size_t index );
+	void Draw( const Pos3D *cam );
+
+private:
+	size_t PlayingAudio;
+	
+	// Our copy of each animation particles were created from, and how many particles are using each copy.
+	std::map<const Animation*,Animation*> Instances;
+	std::map<Animation*,size_t> InstanceRefs;
+	
+	std::vector< std::pair<GLuint,size_t> > DrawOrder;
+	std::vector<GLdouble> VertexArray;
+	std::vector<GLfloat> TexCoordArray;
+	std::vector<GLfloat> ColorArray;
+	
+	Animation *Instance( const Animation *anim );
+	void Release( Animation *instance );
+	void Resize( size_t size );
+	void CopyIndex( size_t to, size_t from );
+};
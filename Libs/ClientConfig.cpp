@@ -245,6 +245,7 @@ void ClientConfig::SetDefaults( void )
 	
 	Settings[ "netrate" ] = "30";
 	Settings[ "maxfps" ] = "120";
+	Settings[ "cl_demo_keyframe" ] = "10";
 	
 	#ifdef APPLE_POWERPC
 		Settings[ "g_fsaa" ] = "2";
@@ -256,8 +257,19 @@ void ClientConfig::SetDefaults( void )
 	// Default server settings.
 	
 	Settings[ "sv_port" ] = "7000";
+	Settings[ "sv_query_port" ] = "-1";
 	Settings[ "sv_netrate" ] = "30";
+	Settings[ "sv_keepalive" ] = "2";
+	Settings[ "sv_sleep" ] = "60";
+	Settings[ "sv_parallel_replication" ] = "true";
+	Settings[ "sv_job_threads" ] = "-1";
+	Settings[ "sv_job_pin" ] = "false";
 	Settings[ "sv_maxfps" ] = "60";
+	Settings[ "sv_relay" ] = "";
+	Settings[ "sv_shards" ] = "";
+	Settings[ "sv_shard_bounds" ] = "";
+	Settings[ "sv_shard" ] = "0";
+	Settings[ "sv_journal" ] = "";
 	
 	Settings[ "password" ] = "";
 }
@@ -498,6 +510,42 @@ void ClientConfig::Command( std::string str, bool show_in_console )
 					Raptor::Game->Host();
 				}
 				
+				else if( cmd == "demo" )
+				{
+					// Usage: demo record <file>, demo play <file> [speed], demo timedemo <file> [fps], demo seek <seconds>, demo speed <x>, demo stop.
+					std::string demo_cmd = (elements.size() >= 2) ? elements.at(1) : "";
+					
+					if( (demo_cmd == "record") && (elements.size() >= 3) )
+						Raptor::Game->RecordDemo( elements.at(2) );
+					else if( (demo_cmd == "play") && (elements.size() >= 3) )
+						Raptor::Game->PlayDemo( elements.at(2), (elements.size() >= 4) ? Str::AsDouble( elements.at(3) ) : 1. );
+					else if( (demo_cmd == "timedemo") && (elements.size() >= 3) )
+					{
+						double fps = (elements.size() >= 4) ? Str::AsDouble( elements.at(3) ) : 60.;
+						Raptor::Game->PlayDemo( elements.at(2), 1., 1. / ((fps > 0.) ? fps : 60.) );
+					}
+					else if( (demo_cmd == "seek") && (elements.size() >= 3) )
+						Raptor::Game->SeekDemo( Str::AsDouble( elements.at(2) ) );
+					else if( (demo_cmd == "speed") && (elements.size() >= 3) )
+						Raptor::Game->DemoPlay.Speed = Str::AsDouble( elements.at(2) );
+					else if( demo_cmd == "stop" )
+						Raptor::Game->StopDemo();
+					else if( Raptor::Game->DemoPlay.IsOpen() )
+					{
+						char cstr[ 1024 ] = "";
+						snprintf( cstr, 1024, "Playing demo %s: %.1f of %.1f seconds at %.2fx, %i keyframes.", Raptor::Game->DemoPlay.Filename.c_str(), Raptor::Game->DemoPlay.Time, Raptor::Game->DemoPlay.Index.Duration, Raptor::Game->DemoPlay.Speed, (int) Raptor::Game->DemoPlay.Index.Keyframes.size() );
+						Raptor::Game->Console.Print( cstr );
+					}
+					else if( Raptor::Game->DemoRecord.IsOpen() )
+					{
+						char cstr[ 1024 ] = "";
+						snprintf( cstr, 1024, "Recording demo %s: %.1f seconds, %iKB, %i keyframes.", Raptor::Game->DemoRecord.Filename.c_str(), Raptor::Game->DemoRecord.RecordClock.ElapsedSeconds(), (int)( Raptor::Game->DemoRecord.BytesWritten / 1024 ), (int) Raptor::Game->DemoRecord.Index.Keyframes.size() );
+						Raptor::Game->Console.Print( cstr );
+					}
+					else
+						Raptor::Game->Console.Print( "Usage: demo record|play|timedemo <file>, demo seek <seconds>, demo speed <x>, demo stop", TextConsole::MSG_ERROR );
+				}
+				
 				else if( cmd == "version" )
 				{
 					Raptor::Game->Console.Print( Raptor::Game->Game + " " + Raptor::Game->Version );
@@ -515,6 +563,9 @@ void ClientConfig::Command( std::string str, bool show_in_console )
 					Raptor::Game->Console.Print( Raptor::Game->Mouse.Status() );
 					Raptor::Game->Console.Print( Raptor::Game->Joy.Status() );
 					Raptor::Game->Console.Print( Raptor::Game->Net.Status() );
+					std::string packet_status = Raptor::Game->Handlers.Status();
+					if( packet_status.size() )
+						Raptor::Game->Console.Print( packet_status );
 					
 					snprintf( cstr, 1024, "Players: %i", (int) Raptor::Game->Data.Players.size() );
 					Raptor::Game->Console.Print( cstr );
@@ -615,7 +666,8 @@ void ClientConfig::Command( std::string str, bool show_in_console )
 								int count = 0;
 								const char *cstr = elements.at(2).c_str();
 								int len = strlen(cstr);
-								for( std::map<std::string, std::string>::iterator property_iter = Raptor::Game->Data.Properties.begin(); property_iter != Raptor::Game->Data.Properties.end(); property_iter ++ )
+								std::map<std::string,std::string> properties = Raptor::Game->Data.Properties.Map();
+								for( std::map<std::string, std::string>::iterator property_iter = properties.begin(); property_iter != properties.end(); property_iter ++ )
 								{
 									if( strncmp( property_iter->first.c_str(), cstr, len ) == 0 )
 									{
@@ -628,11 +680,12 @@ void ClientConfig::Command( std::string str, bool show_in_console )
 							}
 							else
 							{
-								for( std::map<std::string, std::string>::iterator setting_iter = Raptor::Game->Data.Properties.begin(); setting_iter != Raptor::Game->Data.Properties.end(); setting_iter ++ )
+								std::map<std::string,std::string> properties = Raptor::Game->Data.Properties.Map();
+								for( std::map<std::string, std::string>::iterator setting_iter = properties.begin(); setting_iter != properties.end(); setting_iter ++ )
 									Raptor::Game->Console.Print( setting_iter->first + ": " + setting_iter->second );
 							}
 						}
-						else if( Raptor::Game->Data.Properties.find( sv_cmd ) != Raptor::Game->Data.Properties.end() )
+						else if( Raptor::Game->Data.Properties.Has( sv_cmd ) )
 						{
 							if( elements.size() >= 3 )
 							{
@@ -643,7 +696,7 @@ void ClientConfig::Command( std::string str, bool show_in_console )
 								Raptor::Game->Net.Send( &info );
 							}
 							else
-								Raptor::Game->Console.Print( sv_cmd + ": " + Raptor::Server->Data.Properties[ sv_cmd ] );
+								Raptor::Game->Console.Print( sv_cmd + ": " + Raptor::Game->Data.Properties.Get( sv_cmd ) );
 						}
 						else
 							Raptor::Game->Console.Print( "Unknown rcon command: " + sv_cmd, TextConsole::MSG_ERROR );
@@ -664,13 +717,7 @@ void ClientConfig::Command( std::string str, bool show_in_console )
 						{
 							if( elements.size() >= 4 )
 							{
-								Raptor::Server->Data.Properties[ elements.at(2) ] = elements.at(3);
-								
-								Packet info = Packet( Raptor::Packet::INFO );
-								info.AddUShort( 1 );
-								info.AddString( elements.at(2) );
-								info.AddString( elements.at(3) );
-								Raptor::Server->Net.SendAll( &info );
+								Raptor::Server->Data.SetProperty( elements.at(2), elements.at(3) );
 							}
 							else
 								Raptor::Game->Console.Print( "Usage: sv set <variable> <value>", TextConsole::MSG_ERROR );
@@ -682,7 +729,8 @@ void ClientConfig::Command( std::string str, bool show_in_console )
 								int count = 0;
 								const char *cstr = elements.at(2).c_str();
 								int len = strlen(cstr);
-								for( std::map<std::string, std::string>::iterator property_iter = Raptor::Server->Data.Properties.begin(); property_iter != Raptor::Server->Data.Properties.end(); property_iter ++ )
+								std::map<std::string,std::string> properties = Raptor::Server->Data.Properties.Map();
+								for( std::map<std::string, std::string>::iterator property_iter = properties.begin(); property_iter != properties.end(); property_iter ++ )
 								{
 									if( strncmp( property_iter->first.c_str(), cstr, len ) == 0 )
 									{
@@ -695,7 +743,8 @@ void ClientConfig::Command( std::string str, bool show_in_console )
 							}
 							else
 							{
-								for( std::map<std::string, std::string>::iterator setting_iter = Raptor::Server->Data.Properties.begin(); setting_iter != Raptor::Server->Data.Properties.end(); setting_iter ++ )
+								std::map<std::string,std::string> properties = Raptor::Server->Data.Properties.Map();
+								for( std::map<std::string, std::string>::iterator setting_iter = properties.begin(); setting_iter != properties.end(); setting_iter ++ )
 									Raptor::Game->Console.Print( setting_iter->first + ": " + setting_iter->second );
 							}
 						}
@@ -743,12 +792,80 @@ void ClientConfig::Command( std::string str, bool show_in_console )
 							else
 								Raptor::Game->Console.Print( std::string("Server use_out_threads: ") + (Raptor::Game->Server->Net.UseOutThreads ? "true" : "false") );
 						}
+						else if( sv_cmd == "relay" )
+						{
+							if( elements.size() >= 3 )
+								Settings["sv_relay"] = (elements.at(2) == "off") ? "" : elements.at(2);
+							else
+							{
+								if( Raptor::Server->Relaying() )
+									Raptor::Game->Console.Print( Raptor::Server->Relay.Status() );
+								else
+									Raptor::Game->Console.Print( "Server is not relaying." );
+								
+								std::string sv_relay = SettingAsString( "sv_relay" );
+								Raptor::Game->Console.Print( std::string("(Relay setting is ") + (sv_relay.size() ? sv_relay : "off") + std::string(", used when the server starts.)") );
+							}
+						}
+						else if( sv_cmd == "shards" )
+						{
+							// Usage: sv shards <host:port,host:port,...> <x_bound,...> <index>, or sv shards off.
+							if( (elements.size() >= 3) && (elements.at(2) == "off") )
+								Settings["sv_shards"] = "";
+							else if( elements.size() >= 5 )
+							{
+								Settings["sv_shards"] = elements.at(2);
+								Settings["sv_shard_bounds"] = elements.at(3);
+								Settings["sv_shard"] = elements.at(4);
+							}
+							else
+							{
+								Raptor::Game->Console.Print( Raptor::Server->ShardStatus() );
+								
+								std::string sv_shards = SettingAsString( "sv_shards" );
+								Raptor::Game->Console.Print( std::string("(Shard setting is ") + (sv_shards.size() ? (sv_shards + " split at " + SettingAsString( "sv_shard_bounds" ) + ", index " + SettingAsString( "sv_shard" )) : "off") + std::string(", used when the server starts.)") );
+							}
+						}
+						else if( sv_cmd == "journal" )
+						{
+							if( elements.size() >= 3 )
+								Settings["sv_journal"] = (elements.at(2) == "off") ? "" : elements.at(2);
+							else
+							{
+								if( Raptor::Server->Journal.IsOpen() )
+									Raptor::Game->Console.Print( std::string("Recording server journal: ") + Raptor::Server->Journal.Filename + std::string(" (") + Num::ToString( (int)( Raptor::Server->Journal.BytesWritten / 1024 ) ) + std::string("KB)") );
+								else
+									Raptor::Game->Console.Print( "Server is not recording a journal." );
+								
+								std::string sv_journal = SettingAsString( "sv_journal" );
+								Raptor::Game->Console.Print( std::string("(Journal setting is ") + (sv_journal.size() ? sv_journal : "off") + std::string(", used when the server starts.)") );
+							}
+						}
+						else if( sv_cmd == "replay" )
+						{
+							if( elements.size() >= 3 )
+							{
+								Raptor::Server->NetRate = Raptor::Game->Cfg.SettingAsDouble( "sv_netrate", 30. );
+								Raptor::Game->Console.Print( Raptor::Server->ReplayJournal( elements.at(2) ) );
+							}
+							else
+								Raptor::Game->Console.Print( "Usage: sv replay <journal>", TextConsole::MSG_ERROR );
+						}
 						else if( sv_cmd == "restart" )
 						{
 							Raptor::Server->Port = Raptor::Game->Cfg.SettingAsInt( "sv_port", 7000 );
+							Raptor::Server->QueryPort = Raptor::Game->Cfg.SettingAsInt( "sv_query_port", -1 );
 							Raptor::Server->NetRate = Raptor::Game->Cfg.SettingAsDouble( "sv_netrate", 30. );
+							Raptor::Server->UpdateKeepAlive = Raptor::Game->Cfg.SettingAsDouble( "sv_keepalive", 2. );
+							Raptor::Server->Data.SleepTicks = Raptor::Game->Cfg.SettingAsInt( "sv_sleep", 60 );
+							Raptor::Server->ParallelReplication = Raptor::Game->Cfg.SettingAsBool( "sv_parallel_replication", true );
+							Raptor::Server->JobThreads = Raptor::Game->Cfg.SettingAsInt( "sv_job_threads", -1 );
+							Raptor::Server->PinJobThreads = Raptor::Game->Cfg.SettingAsBool( "sv_job_pin" );
 							Raptor::Server->MaxFPS = Raptor::Game->Cfg.SettingAsDouble( "sv_maxfps", 60. );
 							Raptor::Server->UseOutThreads = Raptor::Game->Cfg.SettingAsBool( "sv_out_threads", true );
+							Raptor::Server->SetRelay( Raptor::Game->Cfg.SettingAsString( "sv_relay" ) );
+							Raptor::Server->SetShards( Raptor::Game->Cfg.SettingAsString( "sv_shards" ), Raptor::Game->Cfg.SettingAsString( "sv_shard_bounds" ), Raptor::Game->Cfg.SettingAsInt( "sv_shard", 0 ) );
+							Raptor::Server->JournalFile = Raptor::Game->Cfg.SettingAsString( "sv_journal" );
 							
 							Raptor::Server->Start( Raptor::Game->Cfg.SettingAsString("name") );
 						}
@@ -762,10 +879,24 @@ void ClientConfig::Command( std::string str, bool show_in_console )
 							
 							snprintf( cstr, 1024, "Players: %i", (int) Raptor::Server->Data.Players.size() );
 							Raptor::Game->Console.Print( cstr );
-							snprintf( cstr, 1024, "Objects: %i", (int) Raptor::Server->Data.GameObjects.size() );
+							snprintf( cstr, 1024, "Objects: %i (%i sleeping)", (int) Raptor::Server->Data.GameObjects.size(), (int) Raptor::Server->Data.SleepingCount );
 							Raptor::Game->Console.Print( cstr );
 							snprintf( cstr, 1024, "Server FPS: %.0f", 1. / Raptor::Server->FrameTime );
 							Raptor::Game->Console.Print( cstr );
+							std::string packet_status = Raptor::Server->Handlers.Status();
+							if( packet_status.size() )
+								Raptor::Game->Console.Print( packet_status );
+							if( Raptor::Server->Relaying() )
+							{
+								Raptor::Game->Console.Print( Raptor::Server->Relay.Status() );
+								std::string relay_status = Raptor::Server->RelayHandlers.Status();
+								if( relay_status.size() )
+									Raptor::Game->Console.Print( relay_status );
+							}
+							if( Raptor::Server->Sharded() )
+								Raptor::Game->Console.Print( Raptor::Server->ShardStatus() );
+							if( Raptor::Server->Journal.IsOpen() )
+								Raptor::Game->Console.Print( std::string("Journal: ") + Raptor::Server->Journal.Filename );
 						}
 						else if( sv_cmd == "say" )
 						{
@@ -813,20 +944,14 @@ void ClientConfig::Command( std::string str, bool show_in_console )
 								Raptor::Game->Console.Print( cstr );
 							}
 						}
-						else if( Raptor::Server->Data.Properties.find( sv_cmd ) != Raptor::Server->Data.Properties.end() )
+						else if( Raptor::Server->Data.Properties.Has( sv_cmd ) )
 						{
 							if( elements.size() >= 3 )
 							{
-								Raptor::Server->Data.Properties[ sv_cmd ] = elements.at(2);
-								
-								Packet info = Packet( Raptor::Packet::INFO );
-								info.AddUShort( 1 );
-								info.AddString( sv_cmd );
-								info.AddString( elements.at(2) );
-								Raptor::Server->Net.SendAll( &info );
+								Raptor::Server->Data.SetProperty( sv_cmd, elements.at(2) );
 							}
 							else
-								Raptor::Game->Console.Print( sv_cmd + ": " + Raptor::Server->Data.Properties[ sv_cmd ] );
+								Raptor::Game->Console.Print( sv_cmd + ": " + Raptor::Server->Data.Properties.Get( sv_cmd ) );
 						}
 						else
 							Raptor::Game->Console.Print( "Unknown sv command: " + sv_cmd, TextConsole::MSG_ERROR );
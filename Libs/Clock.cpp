@@ -7,10 +7,109 @@
 #include <cstddef>
 
 
+TimeSource::TimeSource( void )
+{
+}
+
+
+TimeSource::~TimeSource()
+{
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+MonotonicTimeSource::MonotonicTimeSource( void )
+{
+}
+
+
+MonotonicTimeSource::~MonotonicTimeSource()
+{
+}
+
+
+double MonotonicTimeSource::Seconds( void )
+{
+	return Clock::MonotonicSeconds();
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+CachedTimeSource::CachedTimeSource( TimeSource *source )
+{
+	Source = source;
+	Cached = 0.;
+	Valid = false;
+}
+
+
+CachedTimeSource::~CachedTimeSource()
+{
+}
+
+
+void CachedTimeSource::Update( void )
+{
+	Cached = Clock::Now( Source );
+	Valid = true;
+}
+
+
+double CachedTimeSource::Seconds( void )
+{
+	if( ! Valid )
+		Update();
+	
+	return Cached;
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+VirtualTimeSource::VirtualTimeSource( double now )
+{
+	Now = now;
+}
+
+
+VirtualTimeSource::~VirtualTimeSource()
+{
+}
+
+
+void VirtualTimeSource::Set( double now )
+{
+	Now = now;
+}
+
+
+void VirtualTimeSource::Advance( double seconds )
+{
+	Now += seconds;
+}
+
+
+double VirtualTimeSource::Seconds( void )
+{
+	return Now;
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+TimeSource *volatile Clock::Default = NULL;
+
+
 Clock::Clock( void )
 {
-	TimeVal.tv_sec = 0;
-	TimeVal.tv_usec = 0;
+	Source = DefaultSource();
+	Started = 0.;
 	CountUpToSecs = 0.;
 	Reset();
 }
@@ -18,8 +117,17 @@ Clock::Clock( void )
 
 Clock::Clock( double count_up_to_secs )
 {
-	TimeVal.tv_sec = 0;
-	TimeVal.tv_usec = 0;
+	Source = DefaultSource();
+	Started = 0.;
+	CountUpToSecs = count_up_to_secs;
+	Reset();
+}
+
+
+Clock::Clock( TimeSource *source, double count_up_to_secs )
+{
+	Source = source;
+	Started = 0.;
 	CountUpToSecs = count_up_to_secs;
 	Reset();
 }
@@ -27,8 +135,8 @@ Clock::Clock( double count_up_to_secs )
 
 Clock::Clock( const Clock &c )
 {
-	TimeVal.tv_sec = c.TimeVal.tv_sec;
-	TimeVal.tv_usec = c.TimeVal.tv_usec;
+	Source = c.Source;
+	Started = c.Started;
 	CountUpToSecs = c.CountUpToSecs;
 }
 
@@ -40,41 +148,32 @@ Clock::~Clock()
 
 void Clock::Reset( void )
 {
-	gettimeofday( &TimeVal, NULL );
+	Started = Seconds();
 }
 
 
 void Clock::Reset( double count_up_to_secs )
 {
-	gettimeofday( &TimeVal, NULL );
+	Started = Seconds();
 	CountUpToSecs = count_up_to_secs;
 }
 
 
 double Clock::ElapsedSeconds( void ) const
 {
-	struct timeval current_time;
-	gettimeofday( &current_time, NULL );
-	
-	return ((double)( current_time.tv_sec - TimeVal.tv_sec )) + ((double)( current_time.tv_usec - TimeVal.tv_usec )) / 1000000.0;
+	return Seconds() - Started;
 }
 
 
 double Clock::ElapsedMilliseconds( void ) const
 {
-	struct timeval current_time;
-	gettimeofday( &current_time, NULL );
-	
-	return ((double)( current_time.tv_sec - TimeVal.tv_sec )) * 1000.0 + ((double)( current_time.tv_usec - TimeVal.tv_usec )) / 1000.0;
+	return (Seconds() - Started) * 1000.0;
 }
 
 
 double Clock::ElapsedMicroseconds( void ) const
 {
-	struct timeval current_time;
-	gettimeofday( &current_time, NULL );
-	
-	return ((double)( current_time.tv_sec - TimeVal.tv_sec )) * 1000000.0 + ((double)( current_time.tv_usec - TimeVal.tv_usec ));
+	return (Seconds() - Started) * 1000000.0;
 }
 
 
@@ -82,3 +181,66 @@ double Clock::RemainingSeconds( void ) const
 {
 	return CountUpToSecs - ElapsedSeconds();
 }
+
+
+double Clock::Seconds( void ) const
+{
+	return Now( Source );
+}
+
+
+void Clock::SetSource( TimeSource *source )
+{
+	// Carry the elapsed time over, so the Clock never compares times from two different sources.
+	double elapsed = ElapsedSeconds();
+	Source = source;
+	Started = Seconds() - elapsed;
+}
+
+
+TimeSource *Clock::DefaultSource( void )
+{
+	return Default;
+}
+
+
+void Clock::SetDefaultSource( TimeSource *source )
+{
+	// Clocks keep the source they were started with, so this only affects Clocks created afterwards.
+	// Meant for test programs to call before anything else starts; engine code passes sources to its own Clocks instead.
+	Default = source;
+}
+
+
+double Clock::Now( void )
+{
+	return Now( Default );
+}
+
+
+double Clock::Now( TimeSource *source )
+{
+	return source ? source->Seconds() : MonotonicSeconds();
+}
+
+
+double Clock::MonotonicSeconds( void )
+{
+	#ifdef WIN32
+		static LARGE_INTEGER frequency = { 0 };
+		if( ! frequency.QuadPart )
+			QueryPerformanceFrequency( &frequency );
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter( &counter );
+		return ((double) counter.QuadPart) / (double) frequency.QuadPart;
+	#elif defined(__APPLE__)
+		static mach_timebase_info_data_t timebase = { 0, 0 };
+		if( ! timebase.denom )
+			mach_timebase_info( &timebase );
+		return ((double) mach_absolute_time()) * timebase.numer / timebase.denom / 1000000000.;
+	#else
+		struct timespec now;
+		clock_gettime( CLOCK_MONOTONIC, &now );
+		return ((double) now.tv_sec) + ((double) now.tv_nsec) / 1000000000.;
+	#endif
+}
@@ -4,25 +4,90 @@
 
 #pragma once
 class Clock;
+class TimeSource;
+class MonotonicTimeSource;
+class CachedTimeSource;
+class VirtualTimeSource;
 
 #include "PlatformSpecific.h"
 
 #ifndef WIN32
 #include <sys/time.h>
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
 #else
 #include <time.h>
 #include "gettimeofday.h"
 #endif
 
 
+// Where Clocks get the time from, in seconds since some arbitrary starting point.
+class TimeSource
+{
+public:
+	TimeSource( void );
+	virtual ~TimeSource();
+	
+	virtual double Seconds( void ) = 0;
+};
+
+
+// The system's monotonic clock, which never jumps when the system time is changed.  This is the default.
+class MonotonicTimeSource : public TimeSource
+{
+public:
+	MonotonicTimeSource( void );
+	virtual ~MonotonicTimeSource();
+	
+	double Seconds( void );
+};
+
+
+// Holds the time from when Update was last called, so anything reading it during one frame sees the same time
+// without asking the system again.  Only the thread that owns it should call Update.
+class CachedTimeSource : public TimeSource
+{
+public:
+	TimeSource *Source;
+	volatile double Cached;
+	volatile bool Valid;
+	
+	CachedTimeSource( TimeSource *source = NULL );
+	virtual ~CachedTimeSource();
+	
+	void Update( void );
+	double Seconds( void );
+};
+
+
+// Only moves when told to, so tests and replays can run faster or slower than real time.
+class VirtualTimeSource : public TimeSource
+{
+public:
+	volatile double Now;
+	
+	VirtualTimeSource( double now = 0. );
+	virtual ~VirtualTimeSource();
+	
+	void Set( double now );
+	void Advance( double seconds );
+	double Seconds( void );
+};
+
+
 class Clock
 {
 public:
-	struct timeval TimeVal;
+	TimeSource *Source;  // NULL reads the system's monotonic clock directly.
+	double Started;
 	double CountUpToSecs;
 	
 	Clock( void );
 	Clock( double count_up_to_secs );
+	Clock( TimeSource *source, double count_up_to_secs = 0. );
 	Clock( const Clock &c );
 	~Clock();
 	
@@ -34,4 +99,19 @@ public:
 	double ElapsedMicroseconds( void ) const;
 	
 	double RemainingSeconds( void ) const;
+	
+	double Seconds( void ) const;
+	void SetSource( TimeSource *source );
+	
+	// Clocks constructed without a source use the default, which is monotonic (NULL) unless replaced.
+	static TimeSource *DefaultSource( void );
+	static void SetDefaultSource( TimeSource *source );
+	static double Now( void );
+	static double Now( TimeSource *source );
+	
+	// Seconds since an arbitrary starting point, from a clock that never jumps when the system time is changed.
+	static double MonotonicSeconds( void );
+	
+private:
+	static TimeSource *volatile Default;
 };
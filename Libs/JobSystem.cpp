@@ -0,0 +1,475 @@
+/*
+ *  JobSystem.cpp
+ */
+
+#include "JobSystem.h"
+
+#include <cstdio>
+#include <algorithm>
+
+#ifndef WIN32
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+JobTask::JobTask( void )
+{
+	Group = NULL;
+	DeleteWhenDone = false;
+}
+
+
+JobTask::~JobTask()
+{
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+JobGroup::JobGroup( JobSystem *jobs )
+{
+	Jobs = jobs;
+	Pending = 0;
+}
+
+
+JobGroup::~JobGroup()
+{
+	Wait();
+}
+
+
+void JobGroup::Add( JobTask *task )
+{
+	task->Group = this;
+	
+	if( ! Lock.Lock() )
+		fprintf( stderr, "JobGroup::Add: Lock.Lock: %s\n", SDL_GetError() );
+	Pending ++;
+	if( ! Lock.Unlock() )
+		fprintf( stderr, "JobGroup::Add: Lock.Unlock: %s\n", SDL_GetError() );
+	
+	if( Jobs )
+		Jobs->Submit( task );
+	else
+	{
+		task->Run();
+		if( task->DeleteWhenDone )
+			delete task;
+		Finished();
+	}
+}
+
+
+void JobGroup::Then( JobTask *task )
+{
+	// Continuations join the group when everything added before them is done, so Wait covers them too.
+	task->Group = this;
+	
+	if( ! Lock.Lock() )
+		fprintf( stderr, "JobGroup::Then: Lock.Lock: %s\n", SDL_GetError() );
+	bool now = ! Pending;
+	if( ! now )
+		Continuations.push_back( task );
+	if( ! Lock.Unlock() )
+		fprintf( stderr, "JobGroup::Then: Lock.Unlock: %s\n", SDL_GetError() );
+	
+	if( now )
+		Add( task );
+}
+
+
+void JobGroup::Wait( void )
+{
+	// Help out instead of sleeping, which also keeps nested waits on worker threads from running out of workers.
+	while( ! Done() )
+	{
+		if( ! (Jobs && Jobs->RunOne()) )
+			SDL_Delay( 0 );
+	}
+}
+
+
+bool JobGroup::Done( void )
+{
+	if( ! Lock.Lock() )
+		fprintf( stderr, "JobGroup::Done: Lock.Lock: %s\n", SDL_GetError() );
+	bool done = ! Pending;
+	if( ! Lock.Unlock() )
+		fprintf( stderr, "JobGroup::Done: Lock.Unlock: %s\n", SDL_GetError() );
+	
+	return done;
+}
+
+
+void JobGroup::Finished( void )
+{
+	std::vector<JobTask*> continuations;
+	JobSystem *jobs = Jobs;
+	
+	if( ! Lock.Lock() )
+		fprintf( stderr, "JobGroup::Finished: Lock.Lock: %s\n", SDL_GetError() );
+	Pending --;
+	if( ! Pending && Continuations.size() )
+	{
+		continuations.swap( Continuations );
+		Pending += continuations.size();
+	}
+	if( ! Lock.Unlock() )
+		fprintf( stderr, "JobGroup::Finished: Lock.Unlock: %s\n", SDL_GetError() );
+	
+	// Once Pending reaches zero the group may be gone, so only locals are used from here on.
+	for( std::vector<JobTask*>::iterator task_iter = continuations.begin(); task_iter != continuations.end(); task_iter ++ )
+	{
+		if( jobs )
+			jobs->Submit( *task_iter );
+		else
+		{
+			(*task_iter)->Run();
+			if( (*task_iter)->DeleteWhenDone )
+				delete *task_iter;
+			Finished();
+		}
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+ParallelJob::~ParallelJob()
+{
+}
+
+
+ParallelForTask::ParallelForTask( void )
+{
+	Job = NULL;
+	First = 0;
+	Last = 0;
+}
+
+
+ParallelForTask::~ParallelForTask()
+{
+}
+
+
+void ParallelForTask::Run( void )
+{
+	for( size_t i = First; i < Last; i ++ )
+		Job->Run( i );
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+JobSystem::JobSystem( void )
+{
+	PinThreads = false;
+	Wake = NULL;
+	Running = false;
+	NextWorkerIndex = 0;
+	NextQueue = 0;
+}
+
+
+JobSystem::~JobSystem()
+{
+	Stop();
+}
+
+
+bool JobSystem::Start( int threads )
+{
+	Stop();
+	
+	// By default leave one core for the thread that submits work, since it helps while waiting.
+	if( threads < 0 )
+		threads = CPUCount() - 1;
+	if( threads <= 0 )
+		return false;
+	
+	Wake = SDL_CreateSemaphore( 0 );
+	if( ! Wake )
+	{
+		fprintf( stderr, "JobSystem::Start: SDL_CreateSemaphore: %s\n", SDL_GetError() );
+		return false;
+	}
+	
+	for( int i = 0; i < threads; i ++ )
+	{
+		Queues.push_back( new WorkerQueue() );
+		Queues.back()->ThreadID = 0;
+	}
+	
+	Running = true;
+	NextWorkerIndex = 0;
+	for( int i = 0; i < threads; i ++ )
+	{
+		SDL_Thread *thread = SDL_CreateThread( WorkerThread, this );
+		if( thread )
+			Workers.push_back( thread );
+		else
+			fprintf( stderr, "JobSystem::Start: SDL_CreateThread: %s\n", SDL_GetError() );
+	}
+	
+	// Wait for every worker to claim its queue, so CurrentWorker can be trusted as soon as we return.
+	for( ; ; )
+	{
+		if( ! Lock.Lock() )
+			fprintf( stderr, "JobSystem::Start: Lock.Lock: %s\n", SDL_GetError() );
+		bool ready = (NextWorkerIndex >= (int) Workers.size());
+		if( ! Lock.Unlock() )
+			fprintf( stderr, "JobSystem::Start: Lock.Unlock: %s\n", SDL_GetError() );
+		
+		if( ready )
+			break;
+		SDL_Delay( 1 );
+	}
+	
+	// If some workers failed to start, their queues are still emptied by threads waiting on groups.
+	return Workers.size();
+}
+
+
+void JobSystem::Stop( void )
+{
+	Running = false;
+	
+	for( size_t i = 0; i < Workers.size(); i ++ )
+		SDL_SemPost( Wake );
+	for( std::vector<SDL_Thread*>::iterator thread_iter = Workers.begin(); thread_iter != Workers.end(); thread_iter ++ )
+		SDL_WaitThread( *thread_iter, NULL );
+	Workers.clear();
+	
+	// Anything still queued is run here, so no group is left waiting forever.
+	std::vector<WorkerQueue*> queues;
+	queues.swap( Queues );
+	for( std::vector<WorkerQueue*>::iterator queue_iter = queues.begin(); queue_iter != queues.end(); queue_iter ++ )
+	{
+		while( (*queue_iter)->Tasks.size() )
+		{
+			JobTask *task = (*queue_iter)->Tasks.front();
+			(*queue_iter)->Tasks.pop_front();
+			Execute( task );
+		}
+		delete *queue_iter;
+	}
+	
+	if( Wake )
+	{
+		SDL_DestroySemaphore( Wake );
+		Wake = NULL;
+	}
+}
+
+
+int JobSystem::Threads( void ) const
+{
+	return Workers.size();
+}
+
+
+void JobSystem::Submit( JobTask *task )
+{
+	if( Queues.empty() )
+	{
+		Execute( task );
+		return;
+	}
+	
+	// Workers keep what they spawn for themselves; other threads deal tasks out to the workers in turn.
+	int worker = CurrentWorker();
+	if( worker < 0 )
+	{
+		if( ! Lock.Lock() )
+			fprintf( stderr, "JobSystem::Submit: Lock.Lock: %s\n", SDL_GetError() );
+		worker = (NextQueue ++) % Queues.size();
+		if( ! Lock.Unlock() )
+			fprintf( stderr, "JobSystem::Submit: Lock.Unlock: %s\n", SDL_GetError() );
+	}
+	
+	WorkerQueue *queue = Queues[ worker ];
+	if( ! queue->Lock.Lock() )
+		fprintf( stderr, "JobSystem::Submit: queue->Lock.Lock: %s\n", SDL_GetError() );
+	queue->Tasks.push_back( task );
+	if( ! queue->Lock.Unlock() )
+		fprintf( stderr, "JobSystem::Submit: queue->Lock.Unlock: %s\n", SDL_GetError() );
+	
+	SDL_SemPost( Wake );
+}
+
+
+bool JobSystem::RunOne( void )
+{
+	if( Queues.empty() )
+		return false;
+	
+	JobTask *task = Take( CurrentWorker() );
+	if( ! task )
+		return false;
+	
+	Execute( task );
+	return true;
+}
+
+
+void JobSystem::ParallelFor( ParallelJob *job, size_t count, size_t batch_size )
+{
+	if( ! count )
+		return;
+	if( ! batch_size )
+		batch_size = 1;
+	
+	// Without workers (or for a single batch) there's nothing to gain from sharing.
+	if( Workers.empty() || (count <= batch_size) )
+	{
+		for( size_t i = 0; i < count; i ++ )
+			job->Run( i );
+		return;
+	}
+	
+	size_t batches = (count + batch_size - 1) / batch_size;
+	std::vector<ParallelForTask> tasks( batches );
+	JobGroup group( this );
+	for( size_t i = 0; i < batches; i ++ )
+	{
+		tasks[ i ].Job = job;
+		tasks[ i ].First = i * batch_size;
+		tasks[ i ].Last = std::min<size_t>( (i + 1) * batch_size, count );
+		group.Add( &(tasks[ i ]) );
+	}
+	
+	group.Wait();
+}
+
+
+int JobSystem::CurrentWorker( void ) const
+{
+	Uint32 thread_id = SDL_ThreadID();
+	for( size_t i = 0; i < Queues.size(); i ++ )
+	{
+		if( Queues[ i ]->ThreadID == thread_id )
+			return i;
+	}
+	
+	return -1;
+}
+
+
+JobTask *JobSystem::Take( int worker )
+{
+	int queues = Queues.size();
+	int first = (worker >= 0) ? worker : 0;
+	
+	for( int offset = 0; offset < queues; offset ++ )
+	{
+		int index = (first + offset) % queues;
+		WorkerQueue *queue = Queues[ index ];
+		JobTask *task = NULL;
+		
+		if( ! queue->Lock.Lock() )
+			fprintf( stderr, "JobSystem::Take: queue->Lock.Lock: %s\n", SDL_GetError() );
+		if( queue->Tasks.size() )
+		{
+			// Newest first from our own queue (it's still warm in cache), oldest first when stealing.
+			if( index == worker )
+			{
+				task = queue->Tasks.back();
+				queue->Tasks.pop_back();
+			}
+			else
+			{
+				task = queue->Tasks.front();
+				queue->Tasks.pop_front();
+			}
+		}
+		if( ! queue->Lock.Unlock() )
+			fprintf( stderr, "JobSystem::Take: queue->Lock.Unlock: %s\n", SDL_GetError() );
+		
+		if( task )
+			return task;
+	}
+	
+	return NULL;
+}
+
+
+void JobSystem::Execute( JobTask *task )
+{
+	JobGroup *group = task->Group;
+	
+	task->Run();
+	if( task->DeleteWhenDone )
+		delete task;
+	
+	if( group )
+		group->Finished();
+}
+
+
+JobSystem *JobSystem::Shared( void )
+{
+	// One pool for the whole process, so servers, collisions and replication don't each start a thread per core.
+	static JobSystem shared;
+	return &shared;
+}
+
+
+int JobSystem::CPUCount( void )
+{
+	#ifdef WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo( &info );
+		return info.dwNumberOfProcessors;
+	#else
+		long count = sysconf( _SC_NPROCESSORS_ONLN );
+		return (count > 0) ? count : 1;
+	#endif
+}
+
+
+void JobSystem::PinCurrentThread( int core )
+{
+	#if defined(WIN32)
+		SetThreadAffinityMask( GetCurrentThread(), ((DWORD_PTR) 1) << core );
+	#elif defined(__linux__)
+		cpu_set_t cpus;
+		CPU_ZERO( &cpus );
+		CPU_SET( core, &cpus );
+		pthread_setaffinity_np( pthread_self(), sizeof(cpus), &cpus );
+	#endif
+}
+
+
+int JobSystem::WorkerThread( void *job_system )
+{
+	JobSystem *jobs = (JobSystem*) job_system;
+	
+	if( ! jobs->Lock.Lock() )
+		fprintf( stderr, "JobSystem::WorkerThread: Lock.Lock: %s\n", SDL_GetError() );
+	int worker = jobs->NextWorkerIndex ++;
+	jobs->Queues[ worker ]->ThreadID = SDL_ThreadID();
+	if( ! jobs->Lock.Unlock() )
+		fprintf( stderr, "JobSystem::WorkerThread: Lock.Unlock: %s\n", SDL_GetError() );
+	
+	// Core 0 is left for the main thread.
+	if( jobs->PinThreads )
+		PinCurrentThread( (worker + 1) % CPUCount() );
+	
+	while( jobs->Running )
+	{
+		JobTask *task = jobs->Take( worker );
+		if( task )
+			jobs->Execute( task );
+		else
+			SDL_SemWait( jobs->Wake );
+	}
+	
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ *  JobSystem.h
+ */
+
+#pragma once
+class JobTask;
+class JobGroup;
+class ParallelJob;
+class ParallelForTask;
+class JobSystem;
+
+#include "PlatformSpecific.h"
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+#include "Mutex.h"
+
+
+// One piece of work for a JobSystem.  Tasks may be run by any worker, or by a thread waiting on their group.
+class JobTask
+{
+public:
+	JobGroup *Group;
+	bool DeleteWhenDone;
+	
+	JobTask( void );
+	virtual ~JobTask();
+	
+	virtual void Run( void ) = 0;
+};
+
+
+// Tracks a set of tasks so they can be waited on, or followed by continuations once they are all done.
+class JobGroup
+{
+public:
+	JobSystem *Jobs;
+	
+	JobGroup( JobSystem *jobs = NULL );
+	virtual ~JobGroup();
+	
+	void Add( JobTask *task );
+	void Then( JobTask *task );
+	void Wait( void );
+	bool Done( void );
+	
+	void Finished( void );
+
+private:
+	Mutex Lock;
+	int Pending;
+	std::vector<JobTask*> Continuations;
+};
+
+
+// Work to be split across threads by JobSystem::ParallelFor.  Run is called once for each index, from any thread.
+class ParallelJob
+{
+public:
+	virtual ~ParallelJob();
+	virtual void Run( size_t index ) = 0;
+};
+
+
+class ParallelForTask : public JobTask
+{
+public:
+	ParallelJob *Job;
+	size_t First, Last;
+	
+	ParallelForTask( void );
+	virtual ~ParallelForTask();
+	
+	void Run( void );
+};
+
+
+class JobSystem
+{
+public:
+	bool PinThreads;
+	
+	JobSystem( void );
+	virtual ~JobSystem();
+	
+	bool Start( int threads = -1 );
+	void Stop( void );
+	int Threads( void ) const;
+	
+	void Submit( JobTask *task );
+	bool RunOne( void );
+	void ParallelFor( ParallelJob *job, size_t count, size_t batch_size = 1 );
+	
+	static JobSystem *Shared( void );
+	static int CPUCount( void );
+	static void PinCurrentThread( int core );
+	static int WorkerThread( void *job_system );
+
+private:
+	// Each worker pushes and pops its own tasks at the back, and steals from the front of everyone else's.
+	class WorkerQueue
+	{
+	public:
+		Mutex Lock;
+		std::deque<JobTask*> Tasks;
+		Uint32 ThreadID;
+	};
+	
+	std::vector<SDL_Thread*> Workers;
+	std::vector<WorkerQueue*> Queues;
+	Mutex Lock;
+	SDL_sem *Wake;
+	volatile bool Running;
+	int NextWorkerIndex;
+	size_t NextQueue;
+	
+	int CurrentWorker( void ) const;
+	JobTask *Take( int worker );
+	void Execute( JobTask *task );
+};
@@ -6,89 +6,72 @@
 #include "Num.h"
 #include <cmath>
 #include <cfloat>
+#include <algorithm>
 
 
 #ifndef EPSILON
 #define EPSILON 0.0001
 #endif
 
-
-// ----------------------------------------------------------------------------
-
-
-Vec3D Math3D::WorldspaceVec( const Pos3D *pos, double fwd, double up, double right )
-{
-	// Return vector translated to worldspace.
-	// Does not add pos X/Y/Z.
-	return ((pos->Fwd * fwd) + (pos->Up * up) + (pos->Right * right));
-}
-
-
-Pos3D Math3D::WorldspacePos( const Pos3D *pos, double fwd, double up, double right )
-{
-	// Return position translated to worldspace.
-	// Does add pos X/Y/Z.
-	return (*pos + (pos->Fwd * fwd) + (pos->Up * up) + (pos->Right * right));
-}
+// Define MATH3D_NO_SSE2 to build the scalar fallback on hardware that would otherwise use SSE2.
+#if (! defined(MATH3D_NO_SSE2)) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define MATH3D_SSE2 1
+#include <emmintrin.h>
+#endif
 
 
 // ----------------------------------------------------------------------------
 
 
-double Math3D::PointToPointDist( const Pos3D *pt1, const Pos3D *pt2 )
+// These do the work for the single and batch versions alike, on plain doubles so no temporary Pos3D is built.
+// Every operation is done in the same order as the original Vec3D code, so results are bit-identical.
+
+static inline double Length3( double x, double y, double z )
 {
-	Vec3D diff( pt2->X - pt1->X, pt2->Y - pt1->Y, pt2->Z - pt1->Z );
-	return diff.Length();
+	return sqrt( x*x + y*y + z*z );
 }
 
 
-double Math3D::PointToLineSegDist( const Pos3D *pt, const Pos3D *end1, const Pos3D *end2 )
+static inline double PointSegDist( double px, double py, double pz, double ax, double ay, double az, double bx, double by, double bz )
 {
-	// http://forums.codeguru.com/printthread.php?t=194400
-	
-	Vec3D end1_to_end2( end2->X - end1->X, end2->Y - end1->Y, end2->Z - end1->Z );
-	double len = end1_to_end2.Length();
+	double ex = bx - ax, ey = by - ay, ez = bz - az;
+	double len = Length3( ex, ey, ez );
 	
 	if( len <= 0. )
-		return PointToPointDist( pt, end1 );
+		return Length3( ax - px, ay - py, az - pz );
 	
-	Vec3D end1_to_pt( pt->X - end1->X, pt->Y - end1->Y, pt->Z - end1->Z );
-	double r = end1_to_end2.Dot( &end1_to_pt ) / (len*len);
+	double r = (ex * (px - ax) + ey * (py - ay) + ez * (pz - az)) / (len*len);
 	
 	if( r <= 0. )
-		return PointToPointDist( pt, end1 );
+		return Length3( ax - px, ay - py, az - pz );
 	else if( r >= 1. )
-		return PointToPointDist( pt, end2 );
+		return Length3( bx - px, by - py, bz - pz );
 	
-	Pos3D pt_on_line( end1 );
-	end1_to_end2.ScaleBy( r );
-	pt_on_line += end1_to_end2;
-	
-	return PointToPointDist( pt, &pt_on_line );
+	return Length3( (ax + ex * r) - px, (ay + ey * r) - py, (az + ez * r) - pz );
 }
 
 
-double Math3D::LineSegToLineSegDist( const Pos3D *line1end1, const Pos3D *line1end2, const Pos3D *line2end1, const Pos3D *line2end2 )
+static double SegSegDist( double ax, double ay, double az, double bx, double by, double bz, double cx, double cy, double cz, double dx, double dy, double dz )
 {
 	// http://geomalgorithms.com/a07-_distance.html
 	
-	Vec3D u( line1end2->X - line1end1->X, line1end2->Y - line1end1->Y, line1end2->Z - line1end1->Z );
-	if( u.Length() <= 0. )
-		return PointToLineSegDist( line1end1, line2end1, line2end2 );
+	double ux = bx - ax, uy = by - ay, uz = bz - az;
+	if( Length3( ux, uy, uz ) <= 0. )
+		return PointSegDist( ax, ay, az, cx, cy, cz, dx, dy, dz );
 	
-	Vec3D v( line2end2->X - line2end1->X, line2end2->Y - line2end1->Y, line2end2->Z - line2end1->Z );
-	if( v.Length() <= 0. )
-		return PointToLineSegDist( line2end1, line1end1, line1end2 );
+	double vx = dx - cx, vy = dy - cy, vz = dz - cz;
+	if( Length3( vx, vy, vz ) <= 0. )
+		return PointSegDist( cx, cy, cz, ax, ay, az, bx, by, bz );
 	
-	Vec3D w( line1end1->X - line2end1->X, line1end1->Y - line2end1->Y, line1end1->Z - line2end1->Z );
-	if( w.Length() <= 0. )
+	double wx = ax - cx, wy = ay - cy, wz = az - cz;
+	if( Length3( wx, wy, wz ) <= 0. )
 		return 0.;
 	
-	double a = u.Dot(&u);
-	double b = u.Dot(&v);
-	double c = v.Dot(&v);
-	double d = u.Dot(&w);
-	double e = v.Dot(&w);
+	double a = ux*ux + uy*uy + uz*uz;
+	double b = ux*vx + uy*vy + uz*vz;
+	double c = vx*vx + vy*vy + vz*vz;
+	double d = ux*wx + uy*wy + uz*wz;
+	double e = vx*wx + vy*wy + vz*wz;
 	double D = a*c - b*b;
 	double sD = D;
 	double tD = D;
@@ -159,19 +142,99 @@ double Math3D::LineSegToLineSegDist( const Pos3D *line1end1, const Pos3D *line1e
 	sc = (fabs(sN) < EPSILON ? 0. : sN / sD);
 	tc = (fabs(tN) < EPSILON ? 0. : tN / tD);
 	
-	// get the difference of the two closest points
-	Vec3D dP = w + (u * sc) - (v * tc);  // = S1(sc) - S2(tc)
+	// get the difference of the two closest points: S1(sc) - S2(tc)
+	return Length3( (wx + ux * sc) - vx * tc, (wy + uy * sc) - vy * tc, (wz + uz * sc) - vz * tc );
+}
+
+
+#ifdef MATH3D_SSE2
+static inline __m128d Select2( __m128d mask, __m128d if_true, __m128d if_false )
+{
+	return _mm_or_pd( _mm_and_pd( mask, if_true ), _mm_andnot_pd( mask, if_false ) );
+}
+
+
+static inline __m128d LengthSquared2( __m128d x, __m128d y, __m128d z )
+{
+	return _mm_add_pd( _mm_add_pd( _mm_mul_pd( x, x ), _mm_mul_pd( y, y ) ), _mm_mul_pd( z, z ) );
+}
+
+
+// PointSegDist for two lanes at once.  All three candidate distances are computed and the right one picked per lane,
+// taking a single square root at the end (sqrt of the chosen value equals choosing between square roots).
+static inline __m128d PointSegDist2( __m128d px, __m128d py, __m128d pz, __m128d ax, __m128d ay, __m128d az, __m128d bx, __m128d by, __m128d bz )
+{
+	const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd( 1. );
+	
+	__m128d ex = _mm_sub_pd( bx, ax ), ey = _mm_sub_pd( by, ay ), ez = _mm_sub_pd( bz, az );
+	__m128d len = _mm_sqrt_pd( LengthSquared2( ex, ey, ez ) );
+	
+	__m128d dot = _mm_add_pd( _mm_add_pd( _mm_mul_pd( ex, _mm_sub_pd( px, ax ) ), _mm_mul_pd( ey, _mm_sub_pd( py, ay ) ) ), _mm_mul_pd( ez, _mm_sub_pd( pz, az ) ) );
+	__m128d r = _mm_div_pd( dot, _mm_mul_pd( len, len ) );
+	
+	__m128d to_a = LengthSquared2( _mm_sub_pd( ax, px ), _mm_sub_pd( ay, py ), _mm_sub_pd( az, pz ) );
+	__m128d to_b = LengthSquared2( _mm_sub_pd( bx, px ), _mm_sub_pd( by, py ), _mm_sub_pd( bz, pz ) );
+	__m128d to_mid = LengthSquared2( _mm_sub_pd( _mm_add_pd( ax, _mm_mul_pd( ex, r ) ), px ), _mm_sub_pd( _mm_add_pd( ay, _mm_mul_pd( ey, r ) ), py ), _mm_sub_pd( _mm_add_pd( az, _mm_mul_pd( ez, r ) ), pz ) );
+	
+	__m128d use_a = _mm_or_pd( _mm_cmple_pd( len, zero ), _mm_cmple_pd( r, zero ) );
+	__m128d use_b = _mm_cmpge_pd( r, one );
+	__m128d dist_squared = Select2( use_a, to_a, Select2( use_b, to_b, to_mid ) );
+	return _mm_sqrt_pd( dist_squared );
+}
+#endif
+
+
+// ----------------------------------------------------------------------------
+
+
+Vec3D Math3D::WorldspaceVec( const Pos3D *pos, double fwd, double up, double right )
+{
+	// Return vector translated to worldspace.
+	// Does not add pos X/Y/Z.
+	return ((pos->Fwd * fwd) + (pos->Up * up) + (pos->Right * right));
+}
+
+
+Pos3D Math3D::WorldspacePos( const Pos3D *pos, double fwd, double up, double right )
+{
+	// Return position translated to worldspace.
+	// Does add pos X/Y/Z.
+	return (*pos + (pos->Fwd * fwd) + (pos->Up * up) + (pos->Right * right));
+}
+
+
+// ----------------------------------------------------------------------------
+
+
+double Math3D::PointToPointDist( const Pos3D *pt1, const Pos3D *pt2 )
+{
+	Vec3D diff( pt2->X - pt1->X, pt2->Y - pt1->Y, pt2->Z - pt1->Z );
+	return diff.Length();
+}
+
+
+double Math3D::PointToLineSegDist( const Pos3D *pt, const Pos3D *end1, const Pos3D *end2 )
+{
+	// http://forums.codeguru.com/printthread.php?t=194400
 	
-	return dP.Length();   // return the closest distance
+	return PointSegDist( pt->X, pt->Y, pt->Z, end1->X, end1->Y, end1->Z, end2->X, end2->Y, end2->Z );
+}
+
+
+double Math3D::LineSegToLineSegDist( const Pos3D *line1end1, const Pos3D *line1end2, const Pos3D *line2end1, const Pos3D *line2end2 )
+{
+	return SegSegDist( line1end1->X, line1end1->Y, line1end1->Z, line1end2->X, line1end2->Y, line1end2->Z, line2end1->X, line2end1->Y, line2end1->Z, line2end2->X, line2end2->Y, line2end2->Z );
 }
 
 
 double Math3D::MinimumDistance( const Pos3D *pt1, const Vec3D *motion1, const Pos3D *pt2, const Vec3D *motion2, double dt )
 {
-	Pos3D pt1_end( pt1 );
-	pt1_end += (*motion1 * dt) - (*motion2 * dt);
+	// Relative to pt2, pt1 moves along a line segment.
+	double end_x = pt1->X + (motion1->X * dt - motion2->X * dt);
+	double end_y = pt1->Y + (motion1->Y * dt - motion2->Y * dt);
+	double end_z = pt1->Z + (motion1->Z * dt - motion2->Z * dt);
 	
-	return PointToLineSegDist( pt2, pt1, &pt1_end );
+	return PointSegDist( pt2->X, pt2->Y, pt2->Z, pt1->X, pt1->Y, pt1->Z, end_x, end_y, end_z );
 }
 
 
@@ -395,3 +458,88 @@ bool Math3D::LineIntersectsFace( const Pos3D *end1, const Pos3D *end2, const dou
 	
 	return false;
 }
+
+
+// ----------------------------------------------------------------------------
+
+
+void Math3D::PointsToLineSegDist( const double *x, const double *y, const double *z, size_t count, const Pos3D *end1, const Pos3D *end2, double *dists )
+{
+	size_t i = 0;
+	
+	#ifdef MATH3D_SSE2
+		__m128d ax = _mm_set1_pd( end1->X ), ay = _mm_set1_pd( end1->Y ), az = _mm_set1_pd( end1->Z );
+		__m128d bx = _mm_set1_pd( end2->X ), by = _mm_set1_pd( end2->Y ), bz = _mm_set1_pd( end2->Z );
+		for( ; i + 2 <= count; i += 2 )
+			_mm_storeu_pd( dists + i, PointSegDist2( _mm_loadu_pd( x + i ), _mm_loadu_pd( y + i ), _mm_loadu_pd( z + i ), ax, ay, az, bx, by, bz ) );
+	#endif
+	
+	for( ; i < count; i ++ )
+		dists[ i ] = PointSegDist( x[ i ], y[ i ], z[ i ], end1->X, end1->Y, end1->Z, end2->X, end2->Y, end2->Z );
+}
+
+
+void Math3D::LineSegToLineSegsDist( const Pos3D *end1, const Pos3D *end2, const double *x1, const double *y1, const double *z1, const double *x2, const double *y2, const double *z2, size_t count, double *dists )
+{
+	// Too branchy to be worth vectorizing, but still much cheaper than building Pos3Ds for every call.
+	for( size_t i = 0; i < count; i ++ )
+		dists[ i ] = SegSegDist( end1->X, end1->Y, end1->Z, end2->X, end2->Y, end2->Z, x1[ i ], y1[ i ], z1[ i ], x2[ i ], y2[ i ], z2[ i ] );
+}
+
+
+void Math3D::MinimumDistances( const Pos3D *pt1, const Vec3D *motion1, const double *x, const double *y, const double *z, const double *motion_x, const double *motion_y, const double *motion_z, size_t count, double *dists, double dt )
+{
+	// Motion arrays may be NULL for stationary targets, which makes this one segment against many points.
+	double move_x = motion1->X * dt, move_y = motion1->Y * dt, move_z = motion1->Z * dt;
+	if( !( motion_x && motion_y && motion_z ) )
+	{
+		Pos3D pt1_end( pt1->X + move_x, pt1->Y + move_y, pt1->Z + move_z );
+		PointsToLineSegDist( x, y, z, count, pt1, &pt1_end, dists );
+		return;
+	}
+	
+	size_t i = 0;
+	
+	#ifdef MATH3D_SSE2
+		__m128d ax = _mm_set1_pd( pt1->X ), ay = _mm_set1_pd( pt1->Y ), az = _mm_set1_pd( pt1->Z );
+		__m128d mx = _mm_set1_pd( move_x ), my = _mm_set1_pd( move_y ), mz = _mm_set1_pd( move_z ), step = _mm_set1_pd( dt );
+		for( ; i + 2 <= count; i += 2 )
+		{
+			__m128d bx = _mm_add_pd( ax, _mm_sub_pd( mx, _mm_mul_pd( _mm_loadu_pd( motion_x + i ), step ) ) );
+			__m128d by = _mm_add_pd( ay, _mm_sub_pd( my, _mm_mul_pd( _mm_loadu_pd( motion_y + i ), step ) ) );
+			__m128d bz = _mm_add_pd( az, _mm_sub_pd( mz, _mm_mul_pd( _mm_loadu_pd( motion_z + i ), step ) ) );
+			_mm_storeu_pd( dists + i, PointSegDist2( _mm_loadu_pd( x + i ), _mm_loadu_pd( y + i ), _mm_loadu_pd( z + i ), ax, ay, az, bx, by, bz ) );
+		}
+	#endif
+	
+	for( ; i < count; i ++ )
+	{
+		double end_x = pt1->X + (move_x - motion_x[ i ] * dt);
+		double end_y = pt1->Y + (move_y - motion_y[ i ] * dt);
+		double end_z = pt1->Z + (move_z - motion_z[ i ] * dt);
+		dists[ i ] = PointSegDist( x[ i ], y[ i ], z[ i ], pt1->X, pt1->Y, pt1->Z, end_x, end_y, end_z );
+	}
+}
+
+
+size_t Math3D::SweptSphereHits( const Pos3D *pt1, const Vec3D *motion1, double radius1, const double *x, const double *y, const double *z, const double *radii, const double *motion_x, const double *motion_y, const double *motion_z, size_t count, uint8_t *hits, double dt )
+{
+	// Flags each sphere the moving sphere touches during dt, and returns how many.  Radii may be NULL for points.
+	// Work in blocks so the distances stay on the stack.
+	double dists[ 64 ];
+	size_t hit_count = 0;
+	
+	for( size_t first = 0; first < count; first += 64 )
+	{
+		size_t block = std::min<size_t>( 64, count - first );
+		MinimumDistances( pt1, motion1, x + first, y + first, z + first, motion_x ? (motion_x + first) : NULL, motion_y ? (motion_y + first) : NULL, motion_z ? (motion_z + first) : NULL, block, dists, dt );
+		
+		for( size_t i = 0; i < block; i ++ )
+		{
+			hits[ first + i ] = (dists[ i ] <= radius1 + (radii ? radii[ first + i ] : 0.));
+			hit_count += hits[ first + i ];
+		}
+	}
+	
+	return hit_count;
+}
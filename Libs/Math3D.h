@@ -7,6 +7,7 @@
 #include "PlatformSpecific.h"
 
 #include <cstddef>
+#include <stdint.h>
 #include "Vec.h"
 #include "Pos.h"
 
@@ -34,4 +35,11 @@ namespace Math3D
 	double PointDistFromFace( const Pos3D *pt, const double *vertex_array, int vertex_count );
 	double LineSegDistFromFace( const Pos3D *end1, const Pos3D *end2, const double *vertex_array, int vertex_count );
 	bool LineIntersectsFace( const Pos3D *end1, const Pos3D *end2, const double *vertex_array, int vertex_count = 3, Pos3D *at = NULL );
+	
+	// Batch versions test one segment (or moving point) against many others, given as separate X/Y/Z arrays.
+	// Each result is exactly what the single version above returns for that element.
+	void PointsToLineSegDist( const double *x, const double *y, const double *z, size_t count, const Pos3D *end1, const Pos3D *end2, double *dists );
+	void LineSegToLineSegsDist( const Pos3D *end1, const Pos3D *end2, const double *x1, const double *y1, const double *z1, const double *x2, const double *y2, const double *z2, size_t count, double *dists );
+	void MinimumDistances( const Pos3D *pt1, const Vec3D *motion1, const double *x, const double *y, const double *z, const double *motion_x, const double *motion_y, const double *motion_z, size_t count, double *dists, double dt = 1. );
+	size_t SweptSphereHits( const Pos3D *pt1, const Vec3D *motion1, double radius1, const double *x, const double *y, const double *z, const double *radii, const double *motion_x, const double *motion_y, const double *motion_z, size_t count, uint8_t *hits, double dt = 1. );
 }
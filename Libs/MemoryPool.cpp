@@ -0,0 +1,201 @@
+/*
+ *  MemoryPool.cpp
+ */
+
+#include "MemoryPool.h"
+
+#include <cstdio>
+#include <algorithm>
+
+
+const size_t MemoryArena::SizeClassStep;
+const size_t MemoryArena::MaxSizeClass;
+
+
+MemoryPool::MemoryPool( size_t block_size, size_t blocks_per_chunk )
+{
+	// Free blocks hold the free list pointer, so they must have room for one.
+	BlockSize = (block_size > sizeof(void*)) ? block_size : sizeof(void*);
+	BlocksPerChunk = blocks_per_chunk ? blocks_per_chunk : 1;
+	FreeList = NULL;
+	BlocksInUse = 0;
+}
+
+
+MemoryPool::~MemoryPool()
+{
+	for( std::vector<char*>::iterator chunk_iter = Chunks.begin(); chunk_iter != Chunks.end(); chunk_iter ++ )
+		::operator delete( *chunk_iter );
+	Chunks.clear();
+	FreeList = NULL;
+}
+
+
+void *MemoryPool::Allocate( void )
+{
+	if( ! Lock.Lock() )
+		fprintf( stderr, "MemoryPool::Allocate: Lock.Lock: %s\n", SDL_GetError() );
+	
+	if( ! FreeList )
+	{
+		// Thread the new chunk's blocks onto the free list in address order.
+		char *chunk = (char*) ::operator new( BlockSize * BlocksPerChunk );
+		Chunks.push_back( chunk );
+		for( size_t i = BlocksPerChunk; i > 0; i -- )
+		{
+			void *block = chunk + (i - 1) * BlockSize;
+			*((void**) block) = FreeList;
+			FreeList = block;
+		}
+	}
+	
+	void *block = FreeList;
+	FreeList = *((void**) block);
+	BlocksInUse ++;
+	
+	if( ! Lock.Unlock() )
+		fprintf( stderr, "MemoryPool::Allocate: Lock.Unlock: %s\n", SDL_GetError() );
+	
+	return block;
+}
+
+
+void MemoryPool::Free( void *block )
+{
+	if( ! block )
+		return;
+	
+	if( ! Lock.Lock() )
+		fprintf( stderr, "MemoryPool::Free: Lock.Lock: %s\n", SDL_GetError() );
+	
+	*((void**) block) = FreeList;
+	FreeList = block;
+	BlocksInUse --;
+	
+	if( ! Lock.Unlock() )
+		fprintf( stderr, "MemoryPool::Free: Lock.Unlock: %s\n", SDL_GetError() );
+}
+
+
+bool MemoryPool::Trim( void )
+{
+	if( ! Lock.Lock() )
+		fprintf( stderr, "MemoryPool::Trim: Lock.Lock: %s\n", SDL_GetError() );
+	
+	// Every block is free, so the whole pool can go back at once without walking the free list.
+	bool trimmed = false;
+	if( (! BlocksInUse) && Chunks.size() )
+	{
+		for( std::vector<char*>::iterator chunk_iter = Chunks.begin(); chunk_iter != Chunks.end(); chunk_iter ++ )
+			::operator delete( *chunk_iter );
+		Chunks.clear();
+		FreeList = NULL;
+		trimmed = true;
+	}
+	
+	if( ! Lock.Unlock() )
+		fprintf( stderr, "MemoryPool::Trim: Lock.Unlock: %s\n", SDL_GetError() );
+	
+	return trimmed;
+}
+
+
+size_t MemoryPool::InUse( void ) const
+{
+	return BlocksInUse;
+}
+
+
+size_t MemoryPool::Reserved( void ) const
+{
+	return Chunks.size() * BlocksPerChunk;
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+// Room in front of each arena block for the pool it came from, keeping the rest of the block 16-byte aligned.
+#define MEMORYARENA_HEADER 16
+
+// Set up before main runs, so no thread ever races to create it.
+static MemoryArena *SharedArena = MemoryArena::Shared();
+
+
+MemoryArena::MemoryArena( void )
+{
+	// Every size class is made up front, so allocating never has to create one.
+	for( size_t block_size = SizeClassStep; block_size <= MaxSizeClass; block_size += SizeClassStep )
+	{
+		// Smaller blocks come in bigger chunks, so each chunk is roughly the same size.
+		SizeClasses.push_back( new MemoryPool( block_size, std::max<size_t>( 64, 65536 / block_size ) ) );
+	}
+}
+
+
+MemoryArena::~MemoryArena()
+{
+	// Pools with blocks still out are left alone, since those blocks will be freed back to them later.
+	for( std::vector<MemoryPool*>::iterator pool_iter = SizeClasses.begin(); pool_iter != SizeClasses.end(); pool_iter ++ )
+	{
+		if( ! (*pool_iter)->InUse() )
+			delete *pool_iter;
+	}
+	SizeClasses.clear();
+}
+
+
+void *MemoryArena::Allocate( size_t size )
+{
+	size_t total = size + MEMORYARENA_HEADER;
+	MemoryPool *pool = (total <= MaxSizeClass) ? SizeClasses[ (total - 1) / SizeClassStep ] : NULL;
+	
+	char *block = (char*)( pool ? pool->Allocate() : ::operator new( total ) );
+	*((MemoryPool**) block) = pool;
+	return block + MEMORYARENA_HEADER;
+}
+
+
+void MemoryArena::Free( void *block )
+{
+	if( ! block )
+		return;
+	
+	char *header = ((char*) block) - MEMORYARENA_HEADER;
+	MemoryPool *pool = *((MemoryPool**) header);
+	if( pool )
+		pool->Free( header );
+	else
+		::operator delete( header );
+}
+
+
+size_t MemoryArena::Trim( void )
+{
+	size_t trimmed = 0;
+	for( std::vector<MemoryPool*>::iterator pool_iter = SizeClasses.begin(); pool_iter != SizeClasses.end(); pool_iter ++ )
+	{
+		if( (*pool_iter)->Trim() )
+			trimmed ++;
+	}
+	return trimmed;
+}
+
+
+size_t MemoryArena::InUse( void ) const
+{
+	size_t in_use = 0;
+	for( std::vector<MemoryPool*>::const_iterator pool_iter = SizeClasses.begin(); pool_iter != SizeClasses.end(); pool_iter ++ )
+		in_use += (*pool_iter)->InUse();
+	return in_use;
+}
+
+
+MemoryArena *MemoryArena::Shared( void )
+{
+	// Only the static initializer above can see this unset (or another file's static initializer, if it runs first).
+	// Either way that's before main, so there is only one thread.
+	if( ! SharedArena )
+		SharedArena = new MemoryArena();
+	return SharedArena;
+}
@@ -0,0 +1,71 @@
+/*
+ *  MemoryPool.h
+ */
+
+#pragma once
+class MemoryPool;
+class MemoryArena;
+
+#include "PlatformSpecific.h"
+
+#include <cstddef>
+#include <vector>
+#include "Mutex.h"
+
+
+// Fixed-size blocks carved from large chunks, so short-lived objects don't each go through the system allocator.
+// Freed blocks go on a free list for reuse; chunks are only given back by Trim once none of their pool's blocks are in use.
+class MemoryPool
+{
+public:
+	size_t BlockSize;
+	size_t BlocksPerChunk;
+	
+	
+	MemoryPool( size_t block_size, size_t blocks_per_chunk = 256 );
+	~MemoryPool();
+	
+	void *Allocate( void );
+	void Free( void *block );
+	bool Trim( void );
+	size_t InUse( void ) const;
+	size_t Reserved( void ) const;
+
+private:
+	Mutex Lock;
+	std::vector<char*> Chunks;
+	void *FreeList;
+	size_t BlocksInUse;
+	
+	MemoryPool( const MemoryPool &other );
+	MemoryPool &operator=( const MemoryPool &other );
+};
+
+
+// A MemoryPool for each size up to MaxSizeClass, rounded up to SizeClassStep; larger sizes use the system allocator.
+// Each GameData has its own, so clearing one game's objects lets its pools be trimmed even while another game keeps running.
+// Blocks remember which pool they came from, so Free doesn't need to know which arena that was.
+class MemoryArena
+{
+public:
+	static const size_t SizeClassStep = 16;
+	static const size_t MaxSizeClass = 4096;
+	
+	
+	MemoryArena( void );
+	~MemoryArena();
+	
+	void *Allocate( size_t size );
+	static void Free( void *block );
+	size_t Trim( void );
+	size_t InUse( void ) const;
+	
+	// For allocations with no particular GameData, created at startup and never destroyed.
+	static MemoryArena *Shared( void );
+
+private:
+	std::vector<MemoryPool*> SizeClasses;
+	
+	MemoryArena( const MemoryArena &other );
+	MemoryArena &operator=( const MemoryArena &other );
+};
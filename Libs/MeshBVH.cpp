@@ -0,0 +1,464 @@
+/*
+ *  MeshBVH.cpp
+ */
+
+#include "MeshBVH.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+#define MESHBVH_STACK 64
+
+
+MeshBVHNode::MeshBVHNode( void )
+{
+	for( int i = 0; i < 3; i ++ )
+	{
+		Min[ i ] = DBL_MAX;
+		Max[ i ] = -DBL_MAX;
+	}
+	First = 0;
+	Count = 0;
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+class MeshBVHCentroidLess
+{
+public:
+	const std::vector<double> *Centroids;
+	int Axis;
+	
+	MeshBVHCentroidLess( const std::vector<double> *centroids, int axis ) : Centroids( centroids ), Axis( axis ) {}
+	bool operator()( uint32_t a, uint32_t b ) const { return (*Centroids)[ a*3 + Axis ] < (*Centroids)[ b*3 + Axis ]; }
+};
+
+
+static void BuildNode( MeshBVH *bvh, size_t node, uint32_t first, uint32_t count, std::vector<uint32_t> *order, const std::vector<double> *centroids, size_t leaf_size )
+{
+	double centroid_min[ 3 ] = { DBL_MAX, DBL_MAX, DBL_MAX }, centroid_max[ 3 ] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+	MeshBVHNode bounds;
+	
+	for( uint32_t i = first; i < first + count; i ++ )
+	{
+		uint32_t tri = (*order)[ i ];
+		for( int axis = 0; axis < 3; axis ++ )
+		{
+			for( int corner = 0; corner < 3; corner ++ )
+			{
+				double value = bvh->Triangles[ tri*9 + corner*3 + axis ];
+				bounds.Min[ axis ] = std::min<double>( bounds.Min[ axis ], value );
+				bounds.Max[ axis ] = std::max<double>( bounds.Max[ axis ], value );
+			}
+			centroid_min[ axis ] = std::min<double>( centroid_min[ axis ], (*centroids)[ tri*3 + axis ] );
+			centroid_max[ axis ] = std::max<double>( centroid_max[ axis ], (*centroids)[ tri*3 + axis ] );
+		}
+	}
+	
+	// Split at the median along whichever axis the triangle centers are most spread out on.
+	int axis = 0;
+	for( int i = 1; i < 3; i ++ )
+	{
+		if( centroid_max[ i ] - centroid_min[ i ] > centroid_max[ axis ] - centroid_min[ axis ] )
+			axis = i;
+	}
+	
+	if( (count <= leaf_size) || (centroid_max[ axis ] <= centroid_min[ axis ]) )
+	{
+		bounds.First = first;
+		bounds.Count = count;
+		bvh->Nodes[ node ] = bounds;
+		return;
+	}
+	
+	uint32_t half = count / 2;
+	std::nth_element( order->begin() + first, order->begin() + first + half, order->begin() + first + count, MeshBVHCentroidLess( centroids, axis ) );
+	
+	bvh->Nodes[ node ] = bounds;
+	bvh->Nodes.push_back( MeshBVHNode() );
+	BuildNode( bvh, node + 1, first, half, order, centroids, leaf_size );
+	
+	uint32_t right = bvh->Nodes.size();
+	bvh->Nodes[ node ].First = right;
+	bvh->Nodes.push_back( MeshBVHNode() );
+	BuildNode( bvh, right, first + half, count - half, order, centroids, leaf_size );
+}
+
+
+static inline bool SegmentHitsBox( const Vec3D &start, const Vec3D &dir, const MeshBVHNode *node, double max_t )
+{
+	// Slab test for start + dir * t with t in [0,max_t].
+	double near_t = 0., far_t = max_t;
+	const double start_v[ 3 ] = { start.X, start.Y, start.Z }, dir_v[ 3 ] = { dir.X, dir.Y, dir.Z };
+	
+	for( int axis = 0; axis < 3; axis ++ )
+	{
+		if( dir_v[ axis ] == 0. )
+		{
+			if( (start_v[ axis ] < node->Min[ axis ]) || (start_v[ axis ] > node->Max[ axis ]) )
+				return false;
+			continue;
+		}
+		
+		double t1 = (node->Min[ axis ] - start_v[ axis ]) / dir_v[ axis ];
+		double t2 = (node->Max[ axis ] - start_v[ axis ]) / dir_v[ axis ];
+		if( t1 > t2 )
+			std::swap( t1, t2 );
+		near_t = std::max<double>( near_t, t1 );
+		far_t = std::min<double>( far_t, t2 );
+		if( near_t > far_t )
+			return false;
+	}
+	
+	return true;
+}
+
+
+static inline double BoxDistSquared( const Vec3D &pt, const MeshBVHNode *node )
+{
+	const double pt_v[ 3 ] = { pt.X, pt.Y, pt.Z };
+	double dist_squared = 0.;
+	
+	for( int axis = 0; axis < 3; axis ++ )
+	{
+		double outside = 0.;
+		if( pt_v[ axis ] < node->Min[ axis ] )
+			outside = node->Min[ axis ] - pt_v[ axis ];
+		else if( pt_v[ axis ] > node->Max[ axis ] )
+			outside = pt_v[ axis ] - node->Max[ axis ];
+		dist_squared += outside * outside;
+	}
+	
+	return dist_squared;
+}
+
+
+static inline bool SegmentHitsTriangle( const Vec3D &start, const Vec3D &dir, const double *tri, double max_t, double *t )
+{
+	// Moller-Trumbore, accepting hits from either side of the face.
+	Vec3D a( tri[ 0 ], tri[ 1 ], tri[ 2 ] );
+	Vec3D edge1( tri[ 3 ] - tri[ 0 ], tri[ 4 ] - tri[ 1 ], tri[ 5 ] - tri[ 2 ] );
+	Vec3D edge2( tri[ 6 ] - tri[ 0 ], tri[ 7 ] - tri[ 1 ], tri[ 8 ] - tri[ 2 ] );
+	
+	Vec3D p = dir.Cross( edge2 );
+	double det = edge1.Dot( p );
+	if( fabs(det) < 1e-12 )
+		return false;
+	
+	double inv_det = 1. / det;
+	Vec3D s = start - a;
+	double u = s.Dot( p ) * inv_det;
+	if( (u < 0.) || (u > 1.) )
+		return false;
+	
+	Vec3D q = s.Cross( edge1 );
+	double v = dir.Dot( q ) * inv_det;
+	if( (v < 0.) || (u + v > 1.) )
+		return false;
+	
+	double hit_t = edge2.Dot( q ) * inv_det;
+	if( (hit_t < 0.) || (hit_t > max_t) )
+		return false;
+	
+	*t = hit_t;
+	return true;
+}
+
+
+static Vec3D ClosestPointOnTriangle( const Vec3D &p, const double *tri )
+{
+	// From Ericson's Real-Time Collision Detection: find which feature (vertex, edge or face) is nearest.
+	Vec3D a( tri[ 0 ], tri[ 1 ], tri[ 2 ] ), b( tri[ 3 ], tri[ 4 ], tri[ 5 ] ), c( tri[ 6 ], tri[ 7 ], tri[ 8 ] );
+	Vec3D ab = b - a, ac = c - a, ap = p - a;
+	
+	double d1 = ab.Dot( ap ), d2 = ac.Dot( ap );
+	if( (d1 <= 0.) && (d2 <= 0.) )
+		return a;
+	
+	Vec3D bp = p - b;
+	double d3 = ab.Dot( bp ), d4 = ac.Dot( bp );
+	if( (d3 >= 0.) && (d4 <= d3) )
+		return b;
+	
+	double vc = d1*d4 - d3*d2;
+	if( (vc <= 0.) && (d1 >= 0.) && (d3 <= 0.) )
+		return a + ab * (d1 / (d1 - d3));
+	
+	Vec3D cp = p - c;
+	double d5 = ab.Dot( cp ), d6 = ac.Dot( cp );
+	if( (d6 >= 0.) && (d5 <= d6) )
+		return c;
+	
+	double vb = d5*d2 - d1*d6;
+	if( (vb <= 0.) && (d2 >= 0.) && (d6 <= 0.) )
+		return a + ac * (d2 / (d2 - d6));
+	
+	double va = d3*d6 - d5*d4;
+	if( (va <= 0.) && ((d4 - d3) >= 0.) && ((d5 - d6) >= 0.) )
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	
+	double denom = va + vb + vc;
+	if( denom == 0. )
+		return a;
+	return a + ab * (vb / denom) + ac * (vc / denom);
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+MeshBVH::MeshBVH( void )
+{
+}
+
+
+MeshBVH::~MeshBVH()
+{
+}
+
+
+void MeshBVH::Clear( void )
+{
+	Nodes.clear();
+	Triangles.clear();
+}
+
+
+void MeshBVH::AddTriangles( const double *vertex_array, int vertex_count )
+{
+	// Vertex arrays from ModelArrays are already triangulated, 3 vertices per face.
+	if( vertex_array && (vertex_count >= 3) )
+		Triangles.insert( Triangles.end(), vertex_array, vertex_array + (vertex_count / 3) * 9 );
+	Nodes.clear();
+}
+
+
+void MeshBVH::Build( size_t leaf_size )
+{
+	Nodes.clear();
+	
+	size_t count = TriangleCount();
+	if( ! count )
+		return;
+	if( ! leaf_size )
+		leaf_size = 1;
+	
+	std::vector<uint32_t> order( count );
+	std::vector<double> centroids( count * 3 );
+	for( size_t i = 0; i < count; i ++ )
+	{
+		order[ i ] = i;
+		for( int axis = 0; axis < 3; axis ++ )
+			centroids[ i*3 + axis ] = (Triangles[ i*9 + axis ] + Triangles[ i*9 + 3 + axis ] + Triangles[ i*9 + 6 + axis ]) / 3.;
+	}
+	
+	Nodes.reserve( count * 2 / leaf_size + 1 );
+	Nodes.push_back( MeshBVHNode() );
+	BuildNode( this, 0, 0, count, &order, &centroids, leaf_size );
+	
+	// Store the triangles in leaf order, so each leaf reads one contiguous block.
+	std::vector<double> sorted( Triangles.size() );
+	for( size_t i = 0; i < count; i ++ )
+		std::copy( Triangles.begin() + order[ i ] * 9, Triangles.begin() + order[ i ] * 9 + 9, sorted.begin() + i * 9 );
+	Triangles.swap( sorted );
+}
+
+
+size_t MeshBVH::TriangleCount( void ) const
+{
+	return Triangles.size() / 9;
+}
+
+
+bool MeshBVH::SegmentHit( const Vec3D &end1, const Vec3D &end2, Vec3D *at, size_t *triangle ) const
+{
+	// Finds the hit nearest end1.
+	if( Nodes.empty() )
+		return false;
+	
+	Vec3D dir = end2 - end1;
+	double best_t = 1.;
+	bool hit = false;
+	
+	uint32_t stack[ MESHBVH_STACK ];
+	int stack_size = 0;
+	stack[ stack_size ++ ] = 0;
+	
+	while( stack_size )
+	{
+		const MeshBVHNode *node = &(Nodes[ stack[ -- stack_size ] ]);
+		if( ! SegmentHitsBox( end1, dir, node, best_t ) )
+			continue;
+		
+		if( node->Count )
+		{
+			for( uint32_t i = node->First; i < node->First + node->Count; i ++ )
+			{
+				double t = 0.;
+				if( SegmentHitsTriangle( end1, dir, &(Triangles[ i*9 ]), best_t, &t ) )
+				{
+					best_t = t;
+					hit = true;
+					if( triangle )
+						*triangle = i;
+				}
+			}
+		}
+		else if( stack_size + 2 <= MESHBVH_STACK )
+		{
+			stack[ stack_size ++ ] = node->First;
+			stack[ stack_size ++ ] = (node - &(Nodes[ 0 ])) + 1;
+		}
+	}
+	
+	if( hit && at )
+		*at = end1 + dir * best_t;
+	
+	return hit;
+}
+
+
+bool MeshBVH::SphereHit( const Vec3D &center, double radius ) const
+{
+	if( Nodes.empty() )
+		return false;
+	
+	double radius_squared = radius * radius;
+	
+	uint32_t stack[ MESHBVH_STACK ];
+	int stack_size = 0;
+	stack[ stack_size ++ ] = 0;
+	
+	while( stack_size )
+	{
+		const MeshBVHNode *node = &(Nodes[ stack[ -- stack_size ] ]);
+		if( BoxDistSquared( center, node ) > radius_squared )
+			continue;
+		
+		if( node->Count )
+		{
+			for( uint32_t i = node->First; i < node->First + node->Count; i ++ )
+			{
+				Vec3D diff = ClosestPointOnTriangle( center, &(Triangles[ i*9 ]) ) - center;
+				if( diff.Dot( diff ) <= radius_squared )
+					return true;
+			}
+		}
+		else if( stack_size + 2 <= MESHBVH_STACK )
+		{
+			stack[ stack_size ++ ] = node->First;
+			stack[ stack_size ++ ] = (node - &(Nodes[ 0 ])) + 1;
+		}
+	}
+	
+	return false;
+}
+
+
+double MeshBVH::ClosestPoint( const Vec3D &pt, Vec3D *closest, double max_dist ) const
+{
+	// Returns DBL_MAX if there is no triangle within max_dist.
+	if( Nodes.empty() )
+		return DBL_MAX;
+	
+	double best_squared = (max_dist < DBL_MAX) ? (max_dist * max_dist) : DBL_MAX;
+	bool found = false;
+	
+	uint32_t stack[ MESHBVH_STACK ];
+	int stack_size = 0;
+	stack[ stack_size ++ ] = 0;
+	
+	while( stack_size )
+	{
+		const MeshBVHNode *node = &(Nodes[ stack[ -- stack_size ] ]);
+		if( BoxDistSquared( pt, node ) > best_squared )
+			continue;
+		
+		if( node->Count )
+		{
+			for( uint32_t i = node->First; i < node->First + node->Count; i ++ )
+			{
+				Vec3D nearest = ClosestPointOnTriangle( pt, &(Triangles[ i*9 ]) );
+				Vec3D diff = nearest - pt;
+				double dist_squared = diff.Dot( diff );
+				if( dist_squared <= best_squared )
+				{
+					best_squared = dist_squared;
+					found = true;
+					if( closest )
+						*closest = nearest;
+				}
+			}
+		}
+		else if( stack_size + 2 <= MESHBVH_STACK )
+		{
+			// Visit the nearer child first so the search radius shrinks sooner.
+			uint32_t left = (node - &(Nodes[ 0 ])) + 1, right = node->First;
+			if( BoxDistSquared( pt, &(Nodes[ left ]) ) < BoxDistSquared( pt, &(Nodes[ right ]) ) )
+				std::swap( left, right );
+			stack[ stack_size ++ ] = left;
+			stack[ stack_size ++ ] = right;
+		}
+	}
+	
+	return found ? sqrt( best_squared ) : DBL_MAX;
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+bool MeshBVH::SegmentHit( const Pos3D *pos, const Pos3D *end1, const Pos3D *end2, double scale, Pos3D *at ) const
+{
+	Vec3D model_at;
+	if( ! SegmentHit( ToModelSpace( pos, end1, scale ), ToModelSpace( pos, end2, scale ), &model_at ) )
+		return false;
+	
+	if( at )
+	{
+		Pos3D world = ToWorldSpace( pos, model_at, scale );
+		at->SetPos( world.X, world.Y, world.Z );
+	}
+	return true;
+}
+
+
+bool MeshBVH::SphereHit( const Pos3D *pos, const Pos3D *center, double radius, double scale ) const
+{
+	return SphereHit( ToModelSpace( pos, center, scale ), radius / scale );
+}
+
+
+double MeshBVH::ClosestPoint( const Pos3D *pos, const Pos3D *pt, double scale, Pos3D *closest ) const
+{
+	Vec3D model_closest;
+	double dist = ClosestPoint( ToModelSpace( pos, pt, scale ), &model_closest );
+	if( dist == DBL_MAX )
+		return DBL_MAX;
+	
+	if( closest )
+	{
+		Pos3D world = ToWorldSpace( pos, model_closest, scale );
+		closest->SetPos( world.X, world.Y, world.Z );
+	}
+	return dist * scale;
+}
+
+
+Vec3D MeshBVH::ToModelSpace( const Pos3D *pos, const Pos3D *pt, double scale )
+{
+	// Inverse of ModelArrays::MakeWorldSpace with uniform scale, using that Fwd, Up and Right are orthonormal.
+	Vec3D diff( pt->X - pos->X, pt->Y - pos->Y, pt->Z - pos->Z );
+	return Vec3D( diff.Dot( pos->Fwd ), diff.Dot( pos->Up ), diff.Dot( pos->Right ) ) / scale;
+}
+
+
+Pos3D MeshBVH::ToWorldSpace( const Pos3D *pos, const Vec3D &pt, double scale )
+{
+	Pos3D world( pos );
+	world += (pos->Fwd * pt.X + pos->Up * pt.Y + pos->Right * pt.Z) * scale;
+	return world;
+}
@@ -0,0 +1,57 @@
+/*
+ *  MeshBVH.h
+ */
+
+#pragma once
+class MeshBVHNode;
+class MeshBVH;
+
+#include "PlatformSpecific.h"
+
+#include <cstddef>
+#include <cfloat>
+#include <stdint.h>
+#include <vector>
+#include "Vec.h"
+#include "Pos.h"
+
+
+class MeshBVHNode
+{
+public:
+	double Min[ 3 ], Max[ 3 ];
+	
+	// Leaves have Count triangles starting at First.  Branches have Count 0, the left child right after them, and the right child at First.
+	uint32_t First, Count;
+	
+	MeshBVHNode( void );
+};
+
+
+// Bounding volume hierarchy over a mesh's triangles, for collision and ray queries that don't have to test every face.
+// Queries are in model space (X = fwd, Y = up, Z = right, as in ModelArrays) unless given a Pos3D to transform by.
+class MeshBVH
+{
+public:
+	std::vector<MeshBVHNode> Nodes;
+	std::vector<double> Triangles;  // 9 doubles per triangle, reordered by Build so each leaf's triangles are together.
+	
+	MeshBVH( void );
+	virtual ~MeshBVH();
+	
+	void Clear( void );
+	void AddTriangles( const double *vertex_array, int vertex_count );
+	void Build( size_t leaf_size = 4 );
+	size_t TriangleCount( void ) const;
+	
+	bool SegmentHit( const Vec3D &end1, const Vec3D &end2, Vec3D *at = NULL, size_t *triangle = NULL ) const;
+	bool SphereHit( const Vec3D &center, double radius ) const;
+	double ClosestPoint( const Vec3D &pt, Vec3D *closest = NULL, double max_dist = DBL_MAX ) const;
+	
+	bool SegmentHit( const Pos3D *pos, const Pos3D *end1, const Pos3D *end2, double scale = 1., Pos3D *at = NULL ) const;
+	bool SphereHit( const Pos3D *pos, const Pos3D *center, double radius, double scale = 1. ) const;
+	double ClosestPoint( const Pos3D *pos, const Pos3D *pt, double scale = 1., Pos3D *closest = NULL ) const;
+	
+	static Vec3D ToModelSpace( const Pos3D *pos, const Pos3D *pt, double scale = 1. );
+	static Pos3D ToWorldSpace( const Pos3D *pos, const Vec3D &pt, double scale = 1. );
+};
@@ -16,11 +16,6 @@ Pos3D::Pos3D( void )
 	SetUpVec( 0., 1., 0. );
 }
 
-Pos3D::Pos3D( const Pos3D &other )
-{
-	Copy( &other );
-}
-
 Pos3D::Pos3D( const Pos3D *other )
 {
 	Copy( other );
@@ -33,10 +28,6 @@ Pos3D::Pos3D( double x, double y, double z )
 	SetUpVec( 0., 1., 0. );
 }
 
-Pos3D::~Pos3D()
-{
-}
-
 
 void Pos3D::Copy( const Pos3D *other )
 {
@@ -120,6 +111,64 @@ void Pos3D::FixVectorsKeepUp( void )
 	Fwd = Up.Cross( &Right );
 }
 
+void Pos3D::Orthonormalize( void )
+{
+	// Cheap cleanup for vectors that are already nearly orthonormal, such as after RotateBy.
+	Fwd.ScaleTo( 1. );
+	Up -= Fwd * Fwd.Dot( Up );
+	double up_length = Up.Length();
+	if( (up_length < 0.000001) || (up_length != up_length) )
+	{
+		FixVectors();
+		return;
+	}
+	Up /= up_length;
+	UpdateRight();
+}
+
+
+Quat Pos3D::Orientation( void ) const
+{
+	// The rotation that takes the default orientation (Fwd 0,0,-1 and Up 0,1,0) to this one.
+	// Its matrix columns are Right, Up and -Fwd.
+	double m00 = Right.X, m01 = Up.X, m02 = -Fwd.X;
+	double m10 = Right.Y, m11 = Up.Y, m12 = -Fwd.Y;
+	double m20 = Right.Z, m21 = Up.Z, m22 = -Fwd.Z;
+	
+	Quat q;
+	double trace = m00 + m11 + m22;
+	if( trace > 0. )
+	{
+		double s = 0.5 / sqrt( trace + 1. );
+		q = Quat( 0.25 / s, (m21 - m12) * s, (m02 - m20) * s, (m10 - m01) * s );
+	}
+	else if( (m00 > m11) && (m00 > m22) )
+	{
+		double s = 2. * sqrt( 1. + m00 - m11 - m22 );
+		q = Quat( (m21 - m12) / s, 0.25 * s, (m01 + m10) / s, (m02 + m20) / s );
+	}
+	else if( m11 > m22 )
+	{
+		double s = 2. * sqrt( 1. + m11 - m00 - m22 );
+		q = Quat( (m02 - m20) / s, (m01 + m10) / s, 0.25 * s, (m12 + m21) / s );
+	}
+	else
+	{
+		double s = 2. * sqrt( 1. + m22 - m00 - m11 );
+		q = Quat( (m10 - m01) / s, (m02 + m20) / s, (m12 + m21) / s, 0.25 * s );
+	}
+	
+	q.Normalize();
+	return q;
+}
+
+void Pos3D::SetOrientation( const Quat &orientation )
+{
+	Fwd = orientation.Rotate( Vec3D( 0., 0., -1. ) );
+	Up = orientation.Rotate( Vec3D( 0., 1., 0. ) );
+	Orthonormalize();
+}
+
 
 void Pos3D::Yaw( double degrees )
 {
@@ -146,6 +195,25 @@ void Pos3D::RotateAround( const Vec3D *axis, double degrees )
 	Right.RotateAround( axis, degrees );
 }
 
+void Pos3D::RotateBy( const Quat &rotation )
+{
+	Fwd = rotation.Rotate( Fwd );
+	Up = rotation.Rotate( Up );
+	Orthonormalize();
+}
+
+void Pos3D::Spin( double roll, double pitch, double yaw )
+{
+	// Roll, pitch and yaw together in one rotation about the combined axis, with the same signs as Roll, Pitch and Yaw.
+	// For constant rates this is the exact rotation over the step, rather than three slightly different sequential ones.
+	Vec3D axis = Fwd * roll + Right * pitch - Up * yaw;
+	double degrees = axis.Length();
+	if( ! degrees )
+		return;
+	
+	RotateBy( Quat( &axis, degrees ) );
+}
+
 
 void Pos3D::Move( double dx, double dy, double dz )
 {
@@ -315,61 +383,3 @@ Pos3D *Pos3D::Nearest( const std::list<Pos3D*> *others, const std::set<Pos3D*> *
 	
 	return nearest;
 }
-
-
-Pos3D &Pos3D::operator +=( const Vec3D &vec )
-{
-	X += vec.X;
-	Y += vec.Y;
-	Z += vec.Z;
-	return *this;
-}
-
-
-Pos3D &Pos3D::operator -=( const Vec3D &vec )
-{
-	X -= vec.X;
-	Y -= vec.Y;
-	Z -= vec.Z;
-	return *this;
-}
-
-
-Pos3D &Pos3D::operator +=( const Pos3D &other )
-{
-	X += other.X;
-	Y += other.Y;
-	Z += other.Z;
-	return *this;
-}
-
-
-Pos3D &Pos3D::operator -=( const Pos3D &other )
-{
-	X -= other.X;
-	Y -= other.Y;
-	Z -= other.Z;
-	return *this;
-}
-
-
-const Pos3D Pos3D::operator+( const Vec3D &other ) const
-
-{
-
-	return Pos3D(this) += other;
-
-}
-
-
-
-
-
-const Pos3D Pos3D::operator-( const Vec3D &other ) const
-
-{
-
-	return Pos3D(this) -= other;
-
-}
-
@@ -3,7 +3,7 @@
  */
 
 #pragma once
-class Pos;
+class Pos3D;
 
 #include "PlatformSpecific.h"
 
@@ -11,8 +11,11 @@ class Pos;
 #include <list>
 #include <set>
 #include "Vec.h"
+#include "Quat.h"
 
 
+// Like Vec3D this has no virtual methods, so it adds no vtable pointer to GameObject, Effect or Camera,
+// and the default memberwise copy is used.  Copy() and the pointer constructor also renormalize the vectors.
 class Pos3D
 {
 public:
@@ -22,10 +25,8 @@ public:
 	Vec3D Right;
 	
 	Pos3D( void );
-	Pos3D( const Pos3D &other );
 	Pos3D( const Pos3D *other );
 	Pos3D( double x, double y, double z );
-	virtual ~Pos3D();
 	
 	void Copy( const Pos3D *other );
 	
@@ -37,11 +38,17 @@ public:
 	void UpdateRight( void );
 	void FixVectors( void );
 	void FixVectorsKeepUp( void );
+	void Orthonormalize( void );
+	
+	Quat Orientation( void ) const;
+	void SetOrientation( const Quat &orientation );
 	
 	void Yaw( double degrees );
 	void Pitch( double degrees );
 	void Roll( double degrees );
 	void RotateAround( const Vec3D *axis, double degrees );
+	void RotateBy( const Quat &rotation );
+	void Spin( double roll, double pitch, double yaw );
 	void Move( double dx, double dy, double dz );
 	void MoveAlong( const Vec3D *vec, double dist );
 	void MoveAlong( double w, double u, double v, double dist );
@@ -62,11 +69,11 @@ public:
 	Pos3D *Nearest( const std::vector<Pos3D*> *others, const std::set<Pos3D*> *except );
 	Pos3D *Nearest( const std::list<Pos3D*> *others, const std::set<Pos3D*> *except );
 	
-	virtual Pos3D &operator +=( const Vec3D &vec );
-	virtual Pos3D &operator -=( const Vec3D &vec );
-	virtual Pos3D &operator +=( const Pos3D &other );
-	virtual Pos3D &operator -=( const Pos3D &other );
+	Pos3D &operator +=( const Vec3D &vec ) { X += vec.X; Y += vec.Y; Z += vec.Z; return *this; }
+	Pos3D &operator -=( const Vec3D &vec ) { X -= vec.X; Y -= vec.Y; Z -= vec.Z; return *this; }
+	Pos3D &operator +=( const Pos3D &other ) { X += other.X; Y += other.Y; Z += other.Z; return *this; }
+	Pos3D &operator -=( const Pos3D &other ) { X -= other.X; Y -= other.Y; Z -= other.Z; return *this; }
 	
-	virtual const Pos3D operator+( const Vec3D &other ) const;
-	virtual const Pos3D operator-( const Vec3D &other ) const;
+	const Pos3D operator+( const Vec3D &other ) const { Pos3D pos = *this; return pos += other; }
+	const Pos3D operator-( const Vec3D &other ) const { Pos3D pos = *this; return pos -= other; }
 };
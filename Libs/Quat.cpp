@@ -0,0 +1,79 @@
+/*
+ *  Quat.cpp
+ */
+
+#include "Quat.h"
+
+#include <cmath>
+#include "Num.h"
+
+
+Quat::Quat( const Vec3D *axis, double degrees )
+{
+	double length = axis->Length();
+	if( ! length )
+	{
+		W = 1.;
+		X = Y = Z = 0.;
+		return;
+	}
+	
+	double half = Num::DegToRad( degrees ) / 2.;
+	double s = sin( half ) / length;
+	W = cos( half );
+	X = axis->X * s;
+	Y = axis->Y * s;
+	Z = axis->Z * s;
+}
+
+
+void Quat::Normalize( void )
+{
+	double length = sqrt( W*W + X*X + Y*Y + Z*Z );
+	if( ! length )
+	{
+		W = 1.;
+		X = Y = Z = 0.;
+		return;
+	}
+	
+	W /= length;
+	X /= length;
+	Y /= length;
+	Z /= length;
+}
+
+
+Vec3D Quat::Rotate( const Vec3D &vec ) const
+{
+	// v' = v + 2w(q x v) + 2q x (q x v), which avoids building the full rotation matrix.
+	Vec3D q( X, Y, Z );
+	Vec3D t = q.Cross( vec ) * 2.;
+	return vec + t * W + q.Cross( t );
+}
+
+
+Quat Quat::Slerp( const Quat &other, double fraction ) const
+{
+	// Take the short way around, and fall back to a normalized lerp when the two are nearly the same.
+	Quat to = other;
+	double cos_theta = Dot( other );
+	if( cos_theta < 0. )
+	{
+		to = Quat( -other.W, -other.X, -other.Y, -other.Z );
+		cos_theta = -cos_theta;
+	}
+	
+	double a = 1. - fraction, b = fraction;
+	if( cos_theta < 0.9995 )
+	{
+		double theta = acos( cos_theta );
+		double sin_theta = sin( theta );
+		a = sin( a * theta ) / sin_theta;
+		b = sin( b * theta ) / sin_theta;
+	}
+	
+	Quat result( W*a + to.W*b, X*a + to.X*b, Y*a + to.Y*b, Z*a + to.Z*b );
+	result.Normalize();
+	return result;
+}
@@ -0,0 +1,38 @@
+/*
+ *  Quat.h
+ */
+
+#pragma once
+class Quat;
+
+#include "PlatformSpecific.h"
+
+#include "Vec.h"
+
+
+// Unit quaternion rotation.  Like Vec3D this is a plain value type with the cheap operations inline.
+class Quat
+{
+public:
+	double W, X, Y, Z;
+	
+	Quat( double w = 1., double x = 0., double y = 0., double z = 0. ) : W( w ), X( x ), Y( y ), Z( z ) {}
+	Quat( const Vec3D *axis, double degrees );
+	
+	void Normalize( void );
+	Quat Conjugate( void ) const { return Quat( W, -X, -Y, -Z ); }
+	double Dot( const Quat &other ) const { return W*other.W + X*other.X + Y*other.Y + Z*other.Z; }
+	
+	Vec3D Rotate( const Vec3D &vec ) const;
+	Quat Slerp( const Quat &other, double fraction ) const;
+	
+	const Quat operator*( const Quat &other ) const
+	{
+		return Quat(
+			W*other.W - X*other.X - Y*other.Y - Z*other.Z,
+			W*other.X + X*other.W + Y*other.Z - Z*other.Y,
+			W*other.Y - X*other.Z + Y*other.W + Z*other.X,
+			W*other.Z + X*other.Y - Y*other.X + Z*other.W
+		);
+	}
+};
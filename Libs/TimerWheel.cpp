@@ -0,0 +1,389 @@
+/*
+ *  TimerWheel.cpp
+ */
+
+#include "TimerWheel.h"
+
+#include <cmath>
+
+
+#define TIMERWHEEL_FIRING (TIMERWHEEL_LEVELS * TIMERWHEEL_SLOTS)
+#define TIMERWHEEL_MAX_DELTA ((((uint64_t) 1) << (TIMERWHEEL_LEVELS * TIMERWHEEL_SLOT_BITS)) - 1)
+
+
+TimerTask::TimerTask( void )
+{
+	Wheel = NULL;
+	Entry = -1;
+	DeleteWhenDone = false;
+}
+
+
+TimerTask::~TimerTask()
+{
+	Cancel();
+}
+
+
+bool TimerTask::Scheduled( void ) const
+{
+	return (Wheel != NULL);
+}
+
+
+void TimerTask::Cancel( void )
+{
+	if( Wheel )
+		Wheel->Cancel( this );
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+TimerCountdown::TimerCountdown( void )
+{
+}
+
+
+TimerCountdown::~TimerCountdown()
+{
+}
+
+
+void TimerCountdown::Run( void )
+{
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+TimerEntry::TimerEntry( void )
+{
+	Task = NULL;
+	Due = 0;
+	Repeat = 0;
+	Slot = -1;
+	Prev = -1;
+	Next = -1;
+}
+
+
+TimerEntry::~TimerEntry()
+{
+}
+
+
+// ---------------------------------------------------------------------------
+
+
+TimerWheel::TimerWheel( double tick_seconds )
+{
+	TickSeconds = (tick_seconds > 0.) ? tick_seconds : 0.001;
+	CurrentTick = 0;
+	Source = Clock::DefaultSource();
+	StartSeconds = Clock::Now( Source );
+	FreeEntries = -1;
+	Active = 0;
+	
+	for( int i = 0; i <= TIMERWHEEL_FIRING; i ++ )
+		Heads[ i ] = -1;
+	for( int level = 0; level < TIMERWHEEL_LEVELS; level ++ )
+		LevelCounts[ level ] = 0;
+}
+
+
+TimerWheel::~TimerWheel()
+{
+	Clear();
+}
+
+
+void TimerWheel::Schedule( TimerTask *task, double seconds, double repeat_seconds )
+{
+	if( ! task )
+		return;
+	
+	// Rescheduling replaces whatever the task was waiting for before.
+	if( task->Wheel )
+		task->Wheel->Cancel( task );
+	
+	int32_t entry = FreeEntries;
+	if( entry >= 0 )
+		FreeEntries = Entries[ entry ].Next;
+	else
+	{
+		entry = Entries.size();
+		Entries.push_back( TimerEntry() );
+	}
+	
+	// Never fire early: round the delay up, and wait at least until the next tick.
+	uint64_t ticks = TicksFromSeconds( seconds );
+	Entries[ entry ].Task = task;
+	Entries[ entry ].Due = CurrentTick + (ticks ? ticks : 1);
+	Entries[ entry ].Repeat = 0;
+	if( repeat_seconds > 0. )
+	{
+		uint64_t repeat = (uint64_t)( repeat_seconds / TickSeconds + 0.5 );
+		Entries[ entry ].Repeat = repeat ? repeat : 1;
+	}
+	
+	task->Wheel = this;
+	task->Entry = entry;
+	Active ++;
+	
+	Insert( entry );
+}
+
+
+void TimerWheel::Cancel( TimerTask *task )
+{
+	if( ! (task && (task->Wheel == this)) )
+		return;
+	
+	Unlink( task->Entry );
+	Release( task->Entry );
+	Active --;
+	
+	task->Wheel = NULL;
+	task->Entry = -1;
+}
+
+
+void TimerWheel::Clear( void )
+{
+	std::vector<TimerTask*> owned;
+	
+	for( std::vector<TimerEntry>::iterator entry_iter = Entries.begin(); entry_iter != Entries.end(); entry_iter ++ )
+	{
+		TimerTask *task = entry_iter->Task;
+		if( ! task )
+			continue;
+		
+		task->Wheel = NULL;
+		task->Entry = -1;
+		if( task->DeleteWhenDone )
+			owned.push_back( task );
+	}
+	
+	// With nothing scheduled, the wheel's time starts over from now.
+	Entries.clear();
+	FreeEntries = -1;
+	Active = 0;
+	CurrentTick = 0;
+	StartSeconds = Clock::Now( Source );
+	for( int i = 0; i <= TIMERWHEEL_FIRING; i ++ )
+		Heads[ i ] = -1;
+	for( int level = 0; level < TIMERWHEEL_LEVELS; level ++ )
+		LevelCounts[ level ] = 0;
+	
+	for( std::vector<TimerTask*>::iterator task_iter = owned.begin(); task_iter != owned.end(); task_iter ++ )
+		delete *task_iter;
+}
+
+
+size_t TimerWheel::Count( void ) const
+{
+	return Active;
+}
+
+
+double TimerWheel::Now( void ) const
+{
+	return CurrentTick * TickSeconds;
+}
+
+
+double TimerWheel::RemainingSeconds( const TimerTask *task ) const
+{
+	if( ! (task && (task->Wheel == this)) )
+		return 0.;
+	
+	return (Entries[ task->Entry ].Due - CurrentTick) * TickSeconds;
+}
+
+
+size_t TimerWheel::Advance( void )
+{
+	return AdvanceTo( Clock::Now( Source ) - StartSeconds );
+}
+
+
+size_t TimerWheel::AdvanceTo( double seconds )
+{
+	if( seconds <= 0. )
+		return 0;
+	
+	uint64_t target = (uint64_t)( seconds / TickSeconds );
+	size_t fired = 0;
+	
+	while( CurrentTick < target )
+	{
+		if( ! Active )
+		{
+			CurrentTick = target;
+			break;
+		}
+		
+		// With nothing due within the lowest level, skip straight to the tick before it next cascades.
+		if( ! LevelCounts[ 0 ] )
+		{
+			uint64_t boundary = (CurrentTick | (TIMERWHEEL_SLOTS - 1)) + 1;
+			uint64_t skip_to = (boundary - 1 < target) ? (boundary - 1) : target;
+			if( skip_to > CurrentTick )
+			{
+				CurrentTick = skip_to;
+				continue;
+			}
+		}
+		
+		fired += Tick();
+	}
+	
+	return fired;
+}
+
+
+uint64_t TimerWheel::TicksFromSeconds( double seconds ) const
+{
+	if( seconds <= 0. )
+		return 0;
+	
+	double ticks = ceil( seconds / TickSeconds );
+	if( ticks >= (double) TIMERWHEEL_MAX_DELTA )
+		return TIMERWHEEL_MAX_DELTA;
+	return (uint64_t) ticks;
+}
+
+
+void TimerWheel::Insert( int32_t entry )
+{
+	// Entries go on the lowest level whose span covers the wait; far-off ones drop down as their slots cascade.
+	uint64_t due = Entries[ entry ].Due;
+	uint64_t delta = (due > CurrentTick) ? (due - CurrentTick) : 0;
+	if( delta > TIMERWHEEL_MAX_DELTA )
+	{
+		delta = TIMERWHEEL_MAX_DELTA;
+		due = CurrentTick + delta;
+	}
+	
+	int level = 0;
+	while( (level < TIMERWHEEL_LEVELS - 1) && (delta >> (TIMERWHEEL_SLOT_BITS * (level + 1))) )
+		level ++;
+	
+	int32_t slot = level * TIMERWHEEL_SLOTS + (int32_t)( (due >> (TIMERWHEEL_SLOT_BITS * level)) & (TIMERWHEEL_SLOTS - 1) );
+	Link( entry, slot );
+}
+
+
+void TimerWheel::Link( int32_t entry, int32_t slot )
+{
+	TimerEntry *timer = &(Entries[ entry ]);
+	timer->Slot = slot;
+	timer->Prev = -1;
+	timer->Next = Heads[ slot ];
+	if( timer->Next >= 0 )
+		Entries[ timer->Next ].Prev = entry;
+	Heads[ slot ] = entry;
+	
+	if( slot < TIMERWHEEL_FIRING )
+		LevelCounts[ slot / TIMERWHEEL_SLOTS ] ++;
+}
+
+
+void TimerWheel::Unlink( int32_t entry )
+{
+	TimerEntry *timer = &(Entries[ entry ]);
+	if( timer->Slot < 0 )
+		return;
+	
+	if( timer->Prev >= 0 )
+		Entries[ timer->Prev ].Next = timer->Next;
+	else
+		Heads[ timer->Slot ] = timer->Next;
+	if( timer->Next >= 0 )
+		Entries[ timer->Next ].Prev = timer->Prev;
+	
+	if( timer->Slot < TIMERWHEEL_FIRING )
+		LevelCounts[ timer->Slot / TIMERWHEEL_SLOTS ] --;
+	
+	timer->Slot = -1;
+	timer->Prev = -1;
+	timer->Next = -1;
+}
+
+
+void TimerWheel::Release( int32_t entry )
+{
+	Entries[ entry ].Task = NULL;
+	Entries[ entry ].Next = FreeEntries;
+	FreeEntries = entry;
+}
+
+
+void TimerWheel::Cascade( int level )
+{
+	int32_t slot = level * TIMERWHEEL_SLOTS + (int32_t)( (CurrentTick >> (TIMERWHEEL_SLOT_BITS * level)) & (TIMERWHEEL_SLOTS - 1) );
+	while( Heads[ slot ] >= 0 )
+	{
+		int32_t entry = Heads[ slot ];
+		Unlink( entry );
+		Insert( entry );
+	}
+}
+
+
+size_t TimerWheel::Tick( void )
+{
+	CurrentTick ++;
+	
+	// Each time a level wraps around, the next level's current slot is spread out over the levels below.
+	for( int level = 1; level < TIMERWHEEL_LEVELS; level ++ )
+	{
+		if( CurrentTick & ((((uint64_t) 1) << (TIMERWHEEL_SLOT_BITS * level)) - 1) )
+			break;
+		Cascade( level );
+	}
+	
+	// Move this tick's timers to their own list first, so tasks can schedule and cancel freely while they run.
+	int32_t slot = (int32_t)( CurrentTick & (TIMERWHEEL_SLOTS - 1) );
+	while( Heads[ slot ] >= 0 )
+	{
+		int32_t entry = Heads[ slot ];
+		Unlink( entry );
+		Link( entry, TIMERWHEEL_FIRING );
+	}
+	
+	size_t fired = 0;
+	while( Heads[ TIMERWHEEL_FIRING ] >= 0 )
+	{
+		int32_t entry = Heads[ TIMERWHEEL_FIRING ];
+		Unlink( entry );
+		TimerTask *task = Entries[ entry ].Task;
+		
+		if( Entries[ entry ].Repeat )
+		{
+			// Repeat from when it was due rather than now, so the interval doesn't drift.
+			Entries[ entry ].Due += Entries[ entry ].Repeat;
+			if( Entries[ entry ].Due <= CurrentTick )
+				Entries[ entry ].Due = CurrentTick + 1;
+			Insert( entry );
+		}
+		else
+		{
+			Release( entry );
+			Active --;
+			task->Wheel = NULL;
+			task->Entry = -1;
+		}
+		
+		task->Run();
+		fired ++;
+		
+		if( task->DeleteWhenDone && ! task->Scheduled() )
+			delete task;
+	}
+	
+	return fired;
+}
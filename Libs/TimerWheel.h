@@ -0,0 +1,107 @@
+/*
+ *  TimerWheel.h
+ */
+
+#pragma once
+class TimerTask;
+class TimerEntry;
+class TimerWheel;
+
+#include "PlatformSpecific.h"
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+#include "Clock.h"
+
+#define TIMERWHEEL_LEVELS 4
+#define TIMERWHEEL_SLOT_BITS 8
+#define TIMERWHEEL_SLOTS (1 << TIMERWHEEL_SLOT_BITS)
+
+
+// Something to run when its timer comes due.  A task is scheduled on at most one wheel at a time,
+// and cancels itself if destroyed while scheduled.
+class TimerTask
+{
+public:
+	TimerWheel *Wheel;
+	int32_t Entry;
+	bool DeleteWhenDone;
+	
+	
+	TimerTask( void );
+	virtual ~TimerTask();
+	
+	virtual void Run( void ) = 0;
+	
+	bool Scheduled( void ) const;
+	void Cancel( void );
+};
+
+
+// Does nothing when it fires: while Scheduled() it is counting down, and once it isn't the time is up.
+class TimerCountdown : public TimerTask
+{
+public:
+	TimerCountdown( void );
+	virtual ~TimerCountdown();
+	
+	void Run( void );
+};
+
+
+class TimerEntry
+{
+public:
+	TimerTask *Task;
+	uint64_t Due;
+	uint64_t Repeat;
+	int32_t Slot, Prev, Next;
+	
+	TimerEntry( void );
+	virtual ~TimerEntry();
+};
+
+
+// Hierarchical timing wheel: each level has 256 slots, each 256 times as long as the level below.
+// Scheduling and cancelling are O(1), and Advance reads its time source once and only visits slots that came due,
+// so thousands of timers cost nothing per frame until they fire.  A wheel belongs to the thread that advances it.
+class TimerWheel
+{
+public:
+	double TickSeconds;
+	uint64_t CurrentTick;
+	TimeSource *Source;  // NULL reads the system's monotonic clock.
+	double StartSeconds;
+	
+	
+	TimerWheel( double tick_seconds = 0.001 );
+	virtual ~TimerWheel();
+	
+	void Schedule( TimerTask *task, double seconds, double repeat_seconds = 0. );
+	void Cancel( TimerTask *task );
+	void Clear( void );
+	size_t Count( void ) const;
+	double Now( void ) const;
+	double RemainingSeconds( const TimerTask *task ) const;
+	
+	size_t Advance( void );
+	size_t AdvanceTo( double seconds );
+
+private:
+	std::vector<TimerEntry> Entries;
+	int32_t FreeEntries;
+	size_t Active;
+	
+	// One list head per slot on every level, plus one for timers that are firing this tick.
+	int32_t Heads[ TIMERWHEEL_LEVELS * TIMERWHEEL_SLOTS + 1 ];
+	size_t LevelCounts[ TIMERWHEEL_LEVELS ];
+	
+	uint64_t TicksFromSeconds( double seconds ) const;
+	void Insert( int32_t entry );
+	void Link( int32_t entry, int32_t slot );
+	void Unlink( int32_t entry );
+	void Release( int32_t entry );
+	void Cascade( int level );
+	size_t Tick( void );
+};
@@ -8,55 +8,6 @@
 #include "Num.h"
 
 
-Vec2D::Vec2D( const Vec2D &other )
-{
-	Set( other.X, other.Y );
-}
-
-
-Vec2D::Vec2D( const Vec2D *other )
-{
-	Set( other->X, other->Y );
-}
-
-
-Vec2D::Vec2D( double x, double y )
-{
-	Set( x, y );
-}
-
-
-Vec2D::~Vec2D()
-{
-}
-
-
-void Vec2D::Copy( const Vec2D &other )
-{
-	X = other.X;
-	Y = other.Y;
-}
-
-
-void Vec2D::Set( double x, double y )
-{
-	X = x;
-	Y = y;
-}
-
-
-double Vec2D::Length( void ) const
-{
-	return sqrt( X*X + Y*Y );
-}
-
-
-void Vec2D::ScaleBy( double factor )
-{
-	X *= factor;
-	Y *= factor;
-}
-
 void Vec2D::ScaleTo( double length )
 {
 	double old_length = sqrt( X*X + Y*Y );
@@ -65,26 +16,15 @@ void Vec2D::ScaleTo( double length )
 }
 
 
-double Vec2D::Dot( const Vec2D &other ) const
-{
-	return Dot( other.X, other.Y );
-}
-
-double Vec2D::Dot( double x, double y ) const
-{
-	return X*x + Y*y;
-}
-
-
 Vec2D Vec2D::Reflect( const Vec2D *normal ) const
 {
-	double dp_x2 = Dot(normal) * 2.0;
+	double dp_x2 = Dot(*normal) * 2.0;
 	return Vec2D( X - dp_x2 * normal->X, Y - dp_x2 * normal->Y );
 }
 
 Vec2D Vec2D::ReflectAnySide( const Vec2D *normal ) const
 {
-	if( Dot(normal) <= 0. )
+	if( Dot(*normal) <= 0. )
 		return Reflect( normal );
 	else
 	{
@@ -94,122 +34,9 @@ Vec2D Vec2D::ReflectAnySide( const Vec2D *normal ) const
 }
 
 
-Vec2D &Vec2D::operator +=( const Vec2D &other )
-{
-	X += other.X;
-	Y += other.Y;
-	return *this;
-}
-
-
-Vec2D &Vec2D::operator -=( const Vec2D &other )
-{
-	X -= other.X;
-	Y -= other.Y;
-	return *this;
-}
-
-
-Vec2D &Vec2D::operator *=( double scale )
-{
-	ScaleBy( scale );
-	return *this;
-}
-
-
-Vec2D &Vec2D::operator /=( double scale )
-{
-	ScaleBy( 1. / scale );
-	return *this;
-}
-
-
-const Vec2D Vec2D::operator+( const Vec2D &other ) const
-{
-	return Vec2D(this) += other;
-}
-
-
-const Vec2D Vec2D::operator-( const Vec2D &other ) const
-{
-	return Vec2D(this) -= other;
-}
-
-
-const Vec2D Vec2D::operator*( double scale ) const
-{
-	return Vec2D(this) *= scale;
-}
-
-
-const Vec2D Vec2D::operator/( double scale ) const
-{
-	return Vec2D(this) /= scale;
-}
-
-
 // ---------------------------------------------------------------------------
 
 
-Vec3D::Vec3D( const Vec3D &other ) : Vec2D()
-{
-	X = other.X;
-	Y = other.Y;
-	Z = other.Z;
-}
-
-
-Vec3D::Vec3D( const Vec3D *other ) : Vec2D()
-{
-	X = other->X;
-	Y = other->Y;
-	Z = other->Z;
-}
-
-
-Vec3D::Vec3D( double x, double y, double z ) : Vec2D()
-{
-	X = x;
-	Y = y;
-	Z = z;
-}
-
-
-Vec3D::~Vec3D()
-{
-}
-
-
-void Vec3D::Copy( const Vec3D &other )
-{
-	X = other.X;
-	Y = other.Y;
-	Z = other.Z;
-}
-
-
-void Vec3D::Set( double x, double y, double z )
-{
-	X = x;
-	Y = y;
-	Z = z;
-}
-
-
-double Vec3D::Length( void ) const
-{
-	return sqrt( X*X + Y*Y + Z*Z );
-}
-
-
-void Vec3D::ScaleBy( double factor )
-{
-	X *= factor;
-	Y *= factor;
-	Z *= factor;
-}
-
-
 void Vec3D::ScaleTo( double length )
 {
 	double old_length = sqrt( X*X + Y*Y + Z*Z );
@@ -253,27 +80,6 @@ void Vec3D::RotateAround( const Vec3D *axis, double degrees, const Vec3D *anchor
 }
 
 
-double Vec3D::Dot( const Vec3D &other ) const
-{
-	return Dot( other.X, other.Y, other.Z );
-}
-
-double Vec3D::Dot( double x, double y, double z ) const
-{
-	return X*x + Y*y + Z*z;
-}
-
-
-Vec3D Vec3D::Cross( const Vec3D &other ) const
-{
-	Vec3D cross;
-	cross.X = Y * other.Z - Z * other.Y;
-	cross.Y = Z * other.X - X * other.Z;
-	cross.Z = X * other.Y - Y * other.X;
-	return cross;
-}
-
-
 double Vec3D::AngleBetween( const Vec3D &other ) const
 {
 	Vec3D unit1 = this, unit2 = other;
@@ -287,13 +93,13 @@ Vec3D Vec3D::Reflect( const Vec3D *normal ) const
 {
 	// Note: The general formula is: Out = In - 2*Normal*(In dot Normal)
 	
-	double dp_x2 = Dot(normal) * 2.;
+	double dp_x2 = Dot(*normal) * 2.;
 	return Vec3D( X - dp_x2 * normal->X, Y - dp_x2 * normal->Y, Z - dp_x2 * normal->Z );
 }
 
 Vec3D Vec3D::ReflectAnySide( const Vec3D *normal ) const
 {
-	if( Dot(normal) <= 0. )
+	if( Dot(*normal) <= 0. )
 		return Reflect( normal );
 	else
 	{
@@ -301,59 +107,3 @@ Vec3D Vec3D::ReflectAnySide( const Vec3D *normal ) const
 		return Reflect( &new_normal );
 	}
 }
-
-
-Vec3D &Vec3D::operator +=( const Vec3D &other )
-{
-	X += other.X;
-	Y += other.Y;
-	Z += other.Z;
-	return *this;
-}
-
-
-Vec3D &Vec3D::operator -=( const Vec3D &other )
-{
-	X -= other.X;
-	Y -= other.Y;
-	Z -= other.Z;
-	return *this;
-}
-
-
-Vec3D &Vec3D::operator *=( double scale )
-{
-	ScaleBy( scale );
-	return *this;
-}
-
-
-Vec3D &Vec3D::operator /=( double scale )
-{
-	ScaleBy( 1. / scale );
-	return *this;
-}
-
-
-const Vec3D Vec3D::operator+( const Vec3D &other ) const
-{
-	return Vec3D(this) += other;
-}
-
-
-const Vec3D Vec3D::operator-( const Vec3D &other ) const
-{
-	return Vec3D(this) -= other;
-}
-
-
-const Vec3D Vec3D::operator*( double scale ) const
-{
-	return Vec3D(this) *= scale;
-}
-
-
-const Vec3D Vec3D::operator/( double scale ) const
-{
-	return Vec3D(this) /= scale;
-}
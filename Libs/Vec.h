@@ -8,39 +8,44 @@ class Vec3D;
 
 #include "PlatformSpecific.h"
 
+#include <cmath>
+
+
+// These are plain value types: no virtual methods and no user-defined copy or destructor, so they stay
+// trivially copyable (Vec3D is exactly 3 doubles) and the arithmetic below can be inlined into hot loops.
+// Nothing should derive from them to override behavior; hold one as a member instead.
+
 
 class Vec2D
 {
 public:
 	double X, Y;
 	
-	Vec2D( const Vec2D &other );
-	Vec2D( const Vec2D *other );
-	Vec2D( double x = 0., double y = 0. );
-	virtual ~Vec2D();
+	Vec2D( const Vec2D *other ) : X( other->X ), Y( other->Y ) {}
+	Vec2D( double x = 0., double y = 0. ) : X( x ), Y( y ) {}
 	
-	virtual void Copy( const Vec2D &other );
-	virtual void Set( double x, double y );
+	void Copy( const Vec2D &other ) { X = other.X; Y = other.Y; }
+	void Set( double x, double y ) { X = x; Y = y; }
 	
-	virtual double Length( void ) const;
+	double Length( void ) const { return sqrt( X*X + Y*Y ); }
 	
-	virtual void ScaleBy( double factor );
-	virtual void ScaleTo( double length );
+	void ScaleBy( double factor ) { X *= factor; Y *= factor; }
+	void ScaleTo( double length );
 	
-	virtual double Dot( const Vec2D &other ) const;
-	virtual double Dot( double x, double y ) const;
-
-	virtual Vec2D Reflect( const Vec2D *normal ) const;
-	virtual Vec2D ReflectAnySide( const Vec2D *normal ) const;
+	double Dot( const Vec2D &other ) const { return X*other.X + Y*other.Y; }
+	double Dot( double x, double y ) const { return X*x + Y*y; }
+	
+	Vec2D Reflect( const Vec2D *normal ) const;
+	Vec2D ReflectAnySide( const Vec2D *normal ) const;
 	
-	virtual Vec2D &operator +=( const Vec2D &other );
-	virtual Vec2D &operator -=( const Vec2D &other );
-	virtual Vec2D &operator *=( double scale );
-	virtual Vec2D &operator /=( double scale );
-	virtual const Vec2D operator+( const Vec2D &other ) const;
-	virtual const Vec2D operator-( const Vec2D &other ) const;
-	const Vec2D operator*( double scale ) const;
-	const Vec2D operator/( double scale ) const;
+	Vec2D &operator +=( const Vec2D &other ) { X += other.X; Y += other.Y; return *this; }
+	Vec2D &operator -=( const Vec2D &other ) { X -= other.X; Y -= other.Y; return *this; }
+	Vec2D &operator *=( double scale ) { X *= scale; Y *= scale; return *this; }
+	Vec2D &operator /=( double scale ) { return *this *= 1. / scale; }
+	const Vec2D operator+( const Vec2D &other ) const { return Vec2D( X + other.X, Y + other.Y ); }
+	const Vec2D operator-( const Vec2D &other ) const { return Vec2D( X - other.X, Y - other.Y ); }
+	const Vec2D operator*( double scale ) const { return Vec2D( X * scale, Y * scale ); }
+	const Vec2D operator/( double scale ) const { return *this * (1. / scale); }
 };
 
 
@@ -49,35 +54,33 @@ class Vec3D : public Vec2D
 public:
 	double Z;
 	
-	Vec3D( const Vec3D &other );
-	Vec3D( const Vec3D *other );
-	Vec3D( double x = 0., double y = 0., double z = 0. );
-	virtual ~Vec3D();
+	Vec3D( const Vec3D *other ) : Vec2D( other->X, other->Y ), Z( other->Z ) {}
+	Vec3D( double x = 0., double y = 0., double z = 0. ) : Vec2D( x, y ), Z( z ) {}
 	
-	virtual void Copy( const Vec3D &other );
-	virtual void Set( double x, double y, double z );
+	void Copy( const Vec3D &other ) { X = other.X; Y = other.Y; Z = other.Z; }
+	void Set( double x, double y, double z ) { X = x; Y = y; Z = z; }
 	
-	virtual double Length( void ) const;
+	double Length( void ) const { return sqrt( X*X + Y*Y + Z*Z ); }
 	
-	virtual void ScaleBy( double factor );
-	virtual void ScaleTo( double length );
-	virtual void RotateAround( const Vec3D *axis, double degrees );
-	virtual void RotateAround( const Vec3D *axis, double degrees, const Vec3D *anchor );
+	void ScaleBy( double factor ) { X *= factor; Y *= factor; Z *= factor; }
+	void ScaleTo( double length );
+	void RotateAround( const Vec3D *axis, double degrees );
+	void RotateAround( const Vec3D *axis, double degrees, const Vec3D *anchor );
 	
-	virtual double Dot( const Vec3D &other ) const;
-	virtual double Dot( double x, double y, double z ) const;
-	virtual Vec3D Cross( const Vec3D &other ) const;
-	virtual double AngleBetween( const Vec3D &other ) const;
+	double Dot( const Vec3D &other ) const { return X*other.X + Y*other.Y + Z*other.Z; }
+	double Dot( double x, double y, double z ) const { return X*x + Y*y + Z*z; }
+	Vec3D Cross( const Vec3D &other ) const { return Vec3D( Y * other.Z - Z * other.Y, Z * other.X - X * other.Z, X * other.Y - Y * other.X ); }
+	double AngleBetween( const Vec3D &other ) const;
 	
-	virtual Vec3D Reflect( const Vec3D *normal ) const;
-	virtual Vec3D ReflectAnySide( const Vec3D *normal ) const;
+	Vec3D Reflect( const Vec3D *normal ) const;
+	Vec3D ReflectAnySide( const Vec3D *normal ) const;
 	
-	virtual Vec3D &operator +=( const Vec3D &other );
-	virtual Vec3D &operator -=( const Vec3D &other );
-	virtual Vec3D &operator *=( double scale );
-	virtual Vec3D &operator /=( double scale );
-	virtual const Vec3D operator+( const Vec3D &other ) const;
-	virtual const Vec3D operator-( const Vec3D &other ) const;
-	const Vec3D operator*( double scale ) const;
-	const Vec3D operator/( double scale ) const;
+	Vec3D &operator +=( const Vec3D &other ) { X += other.X; Y += other.Y; Z += other.Z; return *this; }
+	Vec3D &operator -=( const Vec3D &other ) { X -= other.X; Y -= other.Y; Z -= other.Z; return *this; }
+	Vec3D &operator *=( double scale ) { X *= scale; Y *= scale; Z *= scale; return *this; }
+	Vec3D &operator /=( double scale ) { return *this *= 1. / scale; }
+	const Vec3D operator+( const Vec3D &other ) const { return Vec3D( X + other.X, Y + other.Y, Z + other.Z ); }
+	const Vec3D operator-( const Vec3D &other ) const { return Vec3D( X - other.X, Y - other.Y, Z - other.Z ); }
+	const Vec3D operator*( double scale ) const { return Vec3D( X * scale, Y * scale, Z * scale ); }
+	const Vec3D operator/( double scale ) const { return *this * (1. / scale); }
 };
@@ -0,0 +1,408 @@
+/*
+ *  ClientDemo.cpp
+ */
+
+#include "ClientDemo.h"
+
+#include <cstddef>
+#include "PacketJournal.h"
+
+
+DemoHeader::DemoHeader( void )
+{
+	Format = FORMAT;
+}
+
+
+DemoPacket::DemoPacket( void )
+{
+	Time = 0.;
+}
+
+
+DemoKeyframe::DemoKeyframe( void )
+{
+	Time = 0.;
+	State = 0;
+	PlayerID = 0;
+	PacketCount = 0;
+}
+
+
+DemoIndexEntry::DemoIndexEntry( double time, uint64_t offset )
+{
+	Time = time;
+	Offset = offset;
+}
+
+
+DemoIndex::DemoIndex( void )
+{
+	Duration = 0.;
+}
+
+
+DemoEnd::DemoEnd( void )
+{
+	IndexOffset = 0;
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+DemoRecorder::DemoRecorder( void )
+{
+	File = NULL;
+	KeyframeInterval = 10.;
+	BytesWritten = 0;
+}
+
+
+DemoRecorder::~DemoRecorder()
+{
+	Close();
+}
+
+
+bool DemoRecorder::Open( std::string filename, std::string game, std::string version, double keyframe_interval )
+{
+	Close();
+	
+	File = fopen( filename.c_str(), "wb" );
+	if( ! File )
+		return false;
+	
+	Filename = filename;
+	KeyframeInterval = keyframe_interval;
+	Index = DemoIndex();
+	BytesWritten = 0;
+	RecordClock.Reset();
+	
+	DemoHeader header;
+	header.Game = game;
+	header.Version = version;
+	Packet record;
+	EncodePacket( &record, &header );
+	Write( &record );
+	return true;
+}
+
+
+void DemoRecorder::Close( void )
+{
+	if( ! File )
+		return;
+	
+	// Finish with the keyframe index, then a fixed-size record saying where to find it.
+	DemoEnd end;
+	end.IndexOffset = ftell( File );
+	
+	Packet index;
+	EncodePacket( &index, &Index );
+	Write( &index );
+	
+	Packet record;
+	EncodePacket( &record, &end );
+	Write( &record );
+	
+	if( File )
+	{
+		fclose( File );
+		File = NULL;
+	}
+}
+
+
+bool DemoRecorder::IsOpen( void ) const
+{
+	return File;
+}
+
+
+bool DemoRecorder::KeyframeDue( void )
+{
+	return File && ( Index.Keyframes.empty() || (RecordClock.ElapsedSeconds() >= Index.Keyframes.back().Time + KeyframeInterval) );
+}
+
+
+void DemoRecorder::RecordPacket( Packet *packet )
+{
+	if( ! File )
+		return;
+	
+	DemoPacket demo_packet;
+	demo_packet.Time = RecordClock.ElapsedSeconds();
+	Packet record;
+	EncodePacket( &record, &demo_packet );
+	record.AddData( packet->Data, packet->Size() );
+	Write( &record );
+	
+	Index.Duration = demo_packet.Time;
+}
+
+
+void DemoRecorder::RecordKeyframe( int32_t state, uint16_t player_id, const std::vector<Packet*> *packets )
+{
+	if( ! File )
+		return;
+	
+	DemoKeyframe keyframe;
+	keyframe.Time = RecordClock.ElapsedSeconds();
+	keyframe.State = state;
+	keyframe.PlayerID = player_id;
+	keyframe.PacketCount = packets->size();
+	Packet record;
+	EncodePacket( &record, &keyframe );
+	for( std::vector<Packet*>::const_iterator packet_iter = packets->begin(); packet_iter != packets->end(); packet_iter ++ )
+		record.AddData( (*packet_iter)->Data, (*packet_iter)->Size() );
+	
+	Index.Keyframes.push_back( DemoIndexEntry( keyframe.Time, ftell( File ) ) );
+	Index.Duration = keyframe.Time;
+	Write( &record );
+}
+
+
+void DemoRecorder::Write( Packet *record )
+{
+	if( fwrite( record->Data, 1, record->Size(), File ) == record->Size() )
+		BytesWritten += record->Size();
+	else
+	{
+		fprintf( stderr, "DemoRecorder::Write: Failed to write %s, stopping recording.\n", Filename.c_str() );
+		fclose( File );
+		File = NULL;
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+DemoPlayer::DemoPlayer( void )
+{
+	File = NULL;
+	Time = 0.;
+	Speed = 1.;
+	FixedStep = 0.;
+	Finished = false;
+	Frames = 0;
+	Pending = NULL;
+	PendingTime = 0.;
+}
+
+
+DemoPlayer::~DemoPlayer()
+{
+	Close();
+}
+
+
+bool DemoPlayer::Open( std::string filename )
+{
+	Close();
+	
+	File = fopen( filename.c_str(), "rb" );
+	if( ! File )
+		return false;
+	
+	Packet *record = JournalReader::ReadRecord( File );
+	bool valid = record && (record->Type() == DemoHeader::TYPE) && DecodePacket( record, &Header ) && (Header.Format == DemoHeader::FORMAT);
+	delete record;
+	if( ! valid )
+	{
+		Close();
+		return false;
+	}
+	
+	// Demos that weren't closed properly (such as when the game crashed) have no index, so find the keyframes the slow way.
+	long first_record = ftell( File );
+	if( ! ReadIndex() )
+		BuildIndex( first_record );
+	fseek( File, first_record, SEEK_SET );
+	
+	Filename = filename;
+	Time = 0.;
+	Finished = false;
+	Frames = 0;
+	PlayClock.Reset();
+	return true;
+}
+
+
+void DemoPlayer::Close( void )
+{
+	if( File )
+	{
+		fclose( File );
+		File = NULL;
+	}
+	
+	delete Pending;
+	Pending = NULL;
+	Index = DemoIndex();
+}
+
+
+bool DemoPlayer::IsOpen( void ) const
+{
+	return File;
+}
+
+
+bool DemoPlayer::ReadIndex( void )
+{
+	if( fseek( File, - (long) DemoEnd::SIZE, SEEK_END ) != 0 )
+		return false;
+	
+	DemoEnd end;
+	Packet *record = JournalReader::ReadRecord( File );
+	bool valid = record && (record->Type() == DemoEnd::TYPE) && DecodePacket( record, &end );
+	delete record;
+	if( ! valid )
+		return false;
+	
+	if( fseek( File, end.IndexOffset, SEEK_SET ) != 0 )
+		return false;
+	
+	record = JournalReader::ReadRecord( File );
+	valid = record && (record->Type() == DemoIndex::TYPE) && DecodePacket( record, &Index );
+	delete record;
+	if( ! valid )
+		Index = DemoIndex();
+	
+	return valid;
+}
+
+
+void DemoPlayer::BuildIndex( long first_record )
+{
+	Index = DemoIndex();
+	fseek( File, first_record, SEEK_SET );
+	
+	for( ; ; )
+	{
+		long offset = ftell( File );
+		Packet *record = JournalReader::ReadRecord( File );
+		if( ! record )
+			break;
+		
+		if( record->Type() == DemoKeyframe::TYPE )
+		{
+			DemoKeyframe keyframe;
+			if( DecodePacket( record, &keyframe ) )
+			{
+				Index.Keyframes.push_back( DemoIndexEntry( keyframe.Time, offset ) );
+				Index.Duration = keyframe.Time;
+			}
+		}
+		else if( record->Type() == DemoPacket::TYPE )
+		{
+			DemoPacket demo_packet;
+			if( DecodePacket( record, &demo_packet ) )
+				Index.Duration = demo_packet.Time;
+		}
+		
+		delete record;
+	}
+}
+
+
+double DemoPlayer::Advance( double real_dt )
+{
+	// Benchmarks use a fixed step so every run draws the same frames no matter how fast they are drawn.
+	double dt = (FixedStep > 0.) ? FixedStep : (real_dt * Speed);
+	Time += dt;
+	Frames ++;
+	return dt;
+}
+
+
+Packet *DemoPlayer::Seek( double time )
+{
+	// Returns the keyframe to rebuild from (decode it with DemoKeyframe, then read its packets with NextKeyframePacket).
+	// After applying it, process everything from NextDue to catch up to the requested time.
+	if( ! File )
+		return NULL;
+	
+	if( time < 0. )
+		time = 0.;
+	
+	size_t best = 0;
+	for( size_t i = 1; i < Index.Keyframes.size(); i ++ )
+	{
+		if( Index.Keyframes[ i ].Time <= time )
+			best = i;
+		else
+			break;
+	}
+	
+	delete Pending;
+	Pending = NULL;
+	Finished = false;
+	Time = time;
+	
+	if( Index.Keyframes.empty() || (fseek( File, Index.Keyframes[ best ].Offset, SEEK_SET ) != 0) )
+		return NULL;
+	
+	Packet *record = JournalReader::ReadRecord( File );
+	if( record && (record->Type() != DemoKeyframe::TYPE) )
+	{
+		delete record;
+		record = NULL;
+	}
+	return record;
+}
+
+
+Packet *DemoPlayer::NextDue( void )
+{
+	// Read ahead one packet at a time, skipping keyframes since they only matter when seeking.
+	while( File && ! Pending && ! Finished )
+	{
+		Packet *record = JournalReader::ReadRecord( File );
+		if( ! record )
+		{
+			Finished = true;
+			break;
+		}
+		
+		if( record->Type() == DemoPacket::TYPE )
+		{
+			DemoPacket demo_packet;
+			if( DecodePacket( record, &demo_packet ) && (record->Offset + PACKET_HEADER_SIZE <= record->Size()) )
+			{
+				Pending = new Packet( record->Data + record->Offset, record->Size() - record->Offset );
+				PendingTime = demo_packet.Time;
+			}
+		}
+		else if( (record->Type() == DemoIndex::TYPE) || (record->Type() == DemoEnd::TYPE) )
+			Finished = true;
+		
+		delete record;
+	}
+	
+	if( Pending && (PendingTime <= Time) )
+	{
+		Packet *packet = Pending;
+		Pending = NULL;
+		return packet;
+	}
+	
+	return NULL;
+}
+
+
+Packet *DemoPlayer::NextKeyframePacket( Packet *keyframe )
+{
+	if( keyframe->Offset + PACKET_HEADER_SIZE > keyframe->Size() )
+		return NULL;
+	
+	PacketSize size = Packet::FirstPacketSize( keyframe->Data + keyframe->Offset );
+	if( (size < PACKET_HEADER_SIZE) || (keyframe->Offset + size > keyframe->Size()) )
+		return NULL;
+	
+	Packet *packet = new Packet( keyframe->Data + keyframe->Offset, size );
+	keyframe->Offset += size;
+	return packet;
+}
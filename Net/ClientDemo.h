@@ -0,0 +1,158 @@
+/*
+ *  ClientDemo.h
+ */
+
+#pragma once
+class DemoRecorder;
+class DemoPlayer;
+
+#include "PlatformSpecific.h"
+
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Packet.h"
+#include "PacketSchema.h"
+#include "Clock.h"
+
+
+// Demos record what the client received from the server, framed like server journals (see PacketJournal.h).
+// Every few seconds a KEYFRAME record holds the packets needed to rebuild GameData from scratch, and the
+// INDEX record written on close lists where they are, so playback can seek without reading from the start.
+
+
+class DemoHeader
+{
+public:
+	enum { TYPE = 'DHdr', FORMAT = 1 };
+	uint32_t Format;
+	std::string Game, Version;
+	DemoHeader( void );
+	template <class V> void Fields( V &v ) { v( Format ); v( Game ); v( Version ); }
+};
+
+
+class DemoPacket
+{
+public:
+	enum { TYPE = 'DPkt' };
+	double Time;
+	DemoPacket( void );
+	template <class V> void Fields( V &v ) { v( Time ); }
+};
+
+
+// Followed by PacketCount packets, each with its own header.
+class DemoKeyframe
+{
+public:
+	enum { TYPE = 'DKey' };
+	double Time;
+	int32_t State;
+	uint16_t PlayerID;
+	uint32_t PacketCount;
+	DemoKeyframe( void );
+	template <class V> void Fields( V &v ) { v( Time ); v( State ); v( PlayerID ); v( PacketCount ); }
+};
+
+
+class DemoIndexEntry
+{
+public:
+	double Time;
+	uint64_t Offset;
+	DemoIndexEntry( double time = 0., uint64_t offset = 0 );
+	template <class V> void Fields( V &v ) { v( Time ); v( Offset ); }
+};
+
+
+class DemoIndex
+{
+public:
+	enum { TYPE = 'DIdx' };
+	double Duration;
+	PacketList<uint32_t,DemoIndexEntry> Keyframes;
+	DemoIndex( void );
+	template <class V> void Fields( V &v ) { v( Duration ); v( Keyframes ); }
+};
+
+
+// Always the last 16 bytes of a finished demo.
+class DemoEnd
+{
+public:
+	enum { TYPE = 'DEnd', SIZE = 16 };
+	uint64_t IndexOffset;
+	DemoEnd( void );
+	template <class V> void Fields( V &v ) { v( IndexOffset ); }
+};
+
+
+// -----------------------------------------------------------------------------
+
+
+class DemoRecorder
+{
+public:
+	FILE *File;
+	std::string Filename;
+	double KeyframeInterval;
+	Clock RecordClock;
+	DemoIndex Index;
+	uint64_t BytesWritten;
+	
+	
+	DemoRecorder( void );
+	virtual ~DemoRecorder();
+	
+	bool Open( std::string filename, std::string game, std::string version, double keyframe_interval = 10. );
+	void Close( void );
+	bool IsOpen( void ) const;
+	
+	bool KeyframeDue( void );
+	void RecordPacket( Packet *packet );
+	void RecordKeyframe( int32_t state, uint16_t player_id, const std::vector<Packet*> *packets );
+
+private:
+	void Write( Packet *record );
+};
+
+
+class DemoPlayer
+{
+public:
+	FILE *File;
+	std::string Filename;
+	DemoHeader Header;
+	DemoIndex Index;
+	double Time;
+	double Speed;
+	double FixedStep;
+	bool Finished;
+	
+	// Frames drawn and real time spent since playback started, for benchmarks.
+	uint32_t Frames;
+	Clock PlayClock;
+	
+	
+	DemoPlayer( void );
+	virtual ~DemoPlayer();
+	
+	bool Open( std::string filename );
+	void Close( void );
+	bool IsOpen( void ) const;
+	
+	double Advance( double real_dt );
+	Packet *Seek( double time );
+	Packet *NextDue( void );
+	
+	static Packet *NextKeyframePacket( Packet *keyframe );
+
+private:
+	Packet *Pending;
+	double PendingTime;
+	
+	bool ReadIndex( void );
+	void BuildIndex( long first_record );
+};
@@ -10,17 +10,22 @@
 #include "PacketBuffer.h"
 #include "Rand.h"
 #include "Num.h"
-#include "RaptorServer.h"
 
 
-ConnectedClient::ConnectedClient( TCPsocket socket, bool use_out_thread, double net_rate, int8_t precision )
+ConnectedClient::ConnectedClient( RaptorServer *server, TCPsocket socket, bool use_out_thread, double net_rate, int8_t precision )
 {
+	Server = server;
 	Connected = false;
 	
 	Socket = socket;
 	IP = 0;
 	Port = 0;
 	Synchronized = false;
+	SyncSent = 0;
+	SyncTotal = 0;
+	SyncVersion = 0;
+	SentChangeVersion = 0;
+	KeepAliveSlot = 0;
 	NetRate = net_rate;
 	PingRate = 4.;
 	Precision = precision;
@@ -29,9 +34,25 @@ ConnectedClient::ConnectedClient( TCPsocket socket, bool use_out_thread, double
 	InThread = NULL;
 	OutThread = NULL;
 	UseOutThread = use_out_thread;
+	PlayerID = 0;
+	ClientID = 0;
+	ShardPeer = -1;
+	
+	Handlers.Register( &ConnectedClient::ProcessPing );
+	Handlers.Register( &ConnectedClient::ProcessPong );
+	Handlers.Register( &ConnectedClient::ProcessPadding );
+	Handlers.Register( &ConnectedClient::ProcessLogin );
+	Handlers.Register( &ConnectedClient::ProcessDisconnect );
 	
 	Connected = true;
 	
+	// Clients replayed from a journal have no socket, so they don't need network threads.
+	if( ! Socket )
+	{
+		UseOutThread = false;
+		return;
+	}
+	
 	// Start the listener thread.
 	if( !( InThread = SDL_CreateThread( ConnectedClientInThread, this ) ) )
 	{
@@ -80,13 +101,12 @@ void ConnectedClient::DisconnectNice( const char *message )
 {
 	if( Connected )
 	{
-		Packet packet( Raptor::Packet::DISCONNECT );
-		
+		DisconnectMessage disconnect;
 		if( message )
-			packet.AddString( message );
-		else
-			packet.AddString( "" );
+			disconnect.Reason = message;
 		
+		Packet packet;
+		EncodePacket( &packet, &disconnect );
 		Send( &packet );
 	}
 	
@@ -102,10 +122,18 @@ void ConnectedClient::Disconnect( void )
 	{
 		char cstr[ 1024 ] = "";
 		snprintf( cstr, 1024, "Client dropped: %i.%i.%i.%i:%i", (IP & 0xFF000000) >> 24, (IP & 0x00FF0000) >> 16, (IP & 0x0000FF00) >> 8, IP & 0x000000FF, Port );
-		Raptor::Server->ConsolePrint( cstr );
+		Server->ConsolePrint( cstr );
 		
 		Connected = false;
-		Raptor::Server->DroppedClient( this );
+		
+		if( ClientID && Server->Journal.IsOpen() )
+			Server->Journal.RecordDrop( ClientID );
+		
+		// Relay spectators and neighbouring shards were never added as players.
+		if( ShardPeer >= 0 )
+			Server->DroppedShardPeer( this );
+		else if( ! Server->Relaying() )
+			Server->DroppedClient( this );
 	}
 	
 	// Handle cleanup later, after the threads are finished.
@@ -144,132 +172,172 @@ void ConnectedClient::ProcessIn( void )
 	if( ! InLock.Lock() )
 		fprintf( stderr, "ConnectedClient::ProcessIn: InLock.Lock: %s\n", SDL_GetError() );
 	
-	// While locked, process all packets on the input buffer.
-	while( ! InBuffer.empty() )
-	{
-		Packet *packet = InBuffer.front();
-		ProcessPacket( packet );
-		delete packet;
-		InBuffer.pop();
-	}
+	// Only process packets that had arrived when we started, so this can't run forever.
+	size_t packet_count = InBuffer.size();
 	
 	if( ! InLock.Unlock() )
 		fprintf( stderr, "ConnectedClient::ProcessIn: InLock.Unlock: %s\n", SDL_GetError() );
+	
+	for( size_t i = 0; i < packet_count; i ++ )
+	{
+		if( ! ProcessTop() )
+			break;
+	}
 }
 
 
-void ConnectedClient::ProcessTop( void )
+bool ConnectedClient::ProcessTop( void )
 {
 	if( ! Connected )
-		return;
+		return false;
 	
 	if( ! InLock.Lock() )
 		fprintf( stderr, "ConnectedClient::ProcessTop: InLock.Lock: %s\n", SDL_GetError() );
 	
-	// While locked, process the oldest packet on the input buffer.
+	// While locked, take the oldest packet off the input buffer.
+	Packet *packet = NULL;
 	if( ! InBuffer.empty() )
 	{
-		Packet *packet = InBuffer.front();
+		packet = InBuffer.front();
 		InBuffer.pop();
-		ProcessPacket( packet );
-		delete packet;
 	}
 	
 	if( ! InLock.Unlock() )
 		fprintf( stderr, "ConnectedClient::ProcessTop: InLock.Unlock: %s\n", SDL_GetError() );
+	
+	if( ! packet )
+		return false;
+	
+	// Process it after unlocking, so the network thread can keep receiving (and decoding) in the meantime.
+	ProcessPacket( packet );
+	delete packet;
+	return true;
 }
 
 
 bool ConnectedClient::ProcessPacket( Packet *packet )
 {
-	packet->Rewind();
-	PacketType type = packet->Type();
+	if( Server->Journal.IsOpen() )
+		Server->Journal.RecordPacket( ClientID, packet );
 	
-	if( Raptor::Server->ProcessPacket( packet, this ) )
-		return true;
+	packet->Rewind();
 	
-	else if( type == Raptor::Packet::PING )
+	// Give the game server the first chance to handle each packet.
+	// Relays don't run the game, so spectators only get to pass chat upstream.
+	if( Server->Relaying() )
 	{
-		uint8_t ping_id = packet->NextUChar();
-		Packet pong( Raptor::Packet::PONG );
-		pong.AddUChar( ping_id );
-		Send( &pong );
-	}
-	
-	else if( type == Raptor::Packet::PONG )
-	{
-		uint8_t ping_id = packet->NextUChar();
-		std::map<uint8_t,Clock>::iterator ping_iter = SentPings.find( ping_id );
-		if( ping_iter != SentPings.end() )
-		{
-			double ms = ping_iter->second.ElapsedMilliseconds();
-			SentPings.erase( ping_iter );
-			PingTimes.push_back( ms );
-			while( PingTimes.size() > 120 )
-				PingTimes.pop_front();
-		}
+		if( Server->ProcessSpectatorPacket( packet, this ) )
+			return true;
 	}
+	else if( Server->ProcessPacket( packet, this ) )
+		return true;
 	
-	else if( type == Raptor::Packet::PADDING )
+	return Handlers.Dispatch( this, packet );
+}
+
+
+bool ConnectedClient::ProcessPing( PingMessage *msg, Packet *packet )
+{
+	PongMessage pong_msg;
+	pong_msg.PingID = msg->PingID;
+	Packet pong;
+	EncodePacket( &pong, &pong_msg );
+	Send( &pong );
+	return true;
+}
+
+
+bool ConnectedClient::ProcessPong( PongMessage *msg, Packet *packet )
+{
+	std::map<uint8_t,Clock>::iterator ping_iter = SentPings.find( msg->PingID );
+	if( ping_iter != SentPings.end() )
 	{
-		// Always ignore padding packets.
-		packet->Offset = packet->Size();
+		double ms = ping_iter->second.ElapsedMilliseconds();
+		SentPings.erase( ping_iter );
+		PingTimes.push_back( ms );
+		while( PingTimes.size() > 120 )
+			PingTimes.pop_front();
 	}
-	
-	else if( type == Raptor::Packet::LOGIN )
+	return true;
+}
+
+
+bool ConnectedClient::ProcessPadding( PaddingMessage *msg, Packet *packet )
+{
+	// Always ignore padding packets.
+	packet->Offset = packet->Size();
+	return true;
+}
+
+
+bool ConnectedClient::ProcessLogin( LoginRequestMessage *msg, Packet *packet )
+{
+	if( msg->Game == Server->Game )
 	{
-		std::string game = packet->NextString();
-		std::string version = packet->NextString();
-		std::string name = packet->NextString();
-		std::string password = packet->NextString();
-		
-		if( game == Raptor::Server->Game )
-		{
-			if( version == Raptor::Server->Version )
-				Login( name, password );
-			else
-				DisconnectNice( "Version mismatch.  Make sure all players have the latest build." );
-		}
+		if( msg->Version == Server->Version )
+			Login( msg->Name, msg->Password );
 		else
-			Disconnect();
+			DisconnectNice( "Version mismatch.  Make sure all players have the latest build." );
 	}
-	
-	else if( type == Raptor::Packet::DISCONNECT )
-	{
-		std::string message = packet->NextString();
-		
-		Disconnect();
-	}
-	
 	else
-		return false;
+		Disconnect();
 	
 	return true;
 }
 
 
+bool ConnectedClient::ProcessDisconnect( DisconnectMessage *msg, Packet *packet )
+{
+	Disconnect();
+	return true;
+}
+
+
 void ConnectedClient::Login( std::string name, std::string password )
 {
 	PlayerID = 0;
 	
-	bool valid_login = Raptor::Server->ValidateLogin( name, password );
-	if( valid_login )
+	if( Server->Relaying() )
+	{
+		// Relays only accept spectators, since every player belongs to the upstream server.
+		if( Server->ValidateLogin( name, password ) )
+		{
+			LoginAcceptMessage accept_msg;
+			Packet accept;
+			EncodePacket( &accept, &accept_msg );
+			Send( &accept );
+			
+			Server->AcceptedSpectator( this );
+		}
+		else
+			Disconnect();
+		
+		return;
+	}
+	
+	// Players handed off from a neighbouring shard already have a player here, and log in with its token.
+	PlayerID = Server->ClaimShardArrival( password );
+	
+	bool valid_login = PlayerID || Server->ValidateLogin( name, password );
+	if( valid_login && ! PlayerID )
 	{
 		Player *player = new Player();
-		PlayerID = Raptor::Server->Data.AddPlayer( player );
+		PlayerID = Server->Data.AddPlayer( player );
 		if( ! PlayerID )
 			delete player;
 	}
 	
 	if( PlayerID )
 	{
-		Raptor::Server->Data.Players[ PlayerID ]->Name = name;
+		Server->Data.Players[ PlayerID ]->Name = name;
 		
-		Packet accept( Raptor::Packet::LOGIN );
-		accept.AddUShort( PlayerID );
+		LoginAcceptMessage accept_msg;
+		accept_msg.PlayerID = PlayerID;
+		Packet accept;
+		EncodePacket( &accept, &accept_msg );
 		Send( &accept );
 		
-		Raptor::Server->AcceptedClient( this );
+		Server->AcceptedClient( this );
 	}
 	else
 		Disconnect();
@@ -293,6 +361,13 @@ bool ConnectedClient::SendNow( Packet *packet )
 	if( ! Connected )
 		return false;
 	
+	// Replayed clients have nowhere to send, but count it so replays can report bandwidth.
+	if( ! Socket )
+	{
+		BytesSent += packet->Size();
+		return true;
+	}
+	
 	if( SDLNet_TCP_Send( Socket, (void *) packet->Data, packet->Size() ) < (int) packet->Size() )
 	{
 		Disconnect();
@@ -326,7 +401,7 @@ void ConnectedClient::SendToOutBuffer( Packet *packet )
 
 void ConnectedClient::SendOthers( Packet *packet )
 {
-	return Raptor::Server->Net.SendAllExcept( packet, this );
+	return Server->Net.SendAllExcept( packet, this );
 }
 
 
@@ -368,8 +443,10 @@ void ConnectedClient::SendPing( void )
 	{
 		SentPings[ ping_id ].Reset();
 		
-		Packet ping( Raptor::Packet::PING );
-		ping.AddUChar( ping_id );
+		PingMessage ping_msg;
+		ping_msg.PingID = ping_id;
+		Packet ping;
+		EncodePacket( &ping, &ping_msg );
 		Send( &ping );
 	}
 }
@@ -417,6 +494,9 @@ int ConnectedClient::ConnectedClientInThread( void *client )
 			
 			while( Packet *packet = Buffer.Pop() )
 			{
+				// Decode what we can here, so the server thread only has to apply it.
+				connected_client->Server->Handlers.Predecode( connected_client->Server, packet );
+				
 				if( ! connected_client->InLock.Lock() )
 					fprintf( stderr, "ConnectedClientInThread: connected_client->InLock.Lock: %s\n", SDL_GetError() );
 				
@@ -4,11 +4,13 @@
 
 #pragma once
 class ConnectedClient;
+class RaptorServer;
 
 #include "PlatformSpecific.h"
 #include <cstddef>
 #include <queue>
 #include <map>
+#include <set>
 #include <stdexcept>
 #include <SDL/SDL.h>
 #include <SDL/SDL_thread.h>
@@ -20,7 +22,10 @@ class ConnectedClient;
 #endif
 
 #include "Packet.h"
+#include "PacketRegistry.h"
+#include "Messages.h"
 #include "Clock.h"
+#include "TimerWheel.h"
 #include "Identifier.h"
 #include "NetServer.h"
 #include "Mutex.h"
@@ -29,6 +34,7 @@ class ConnectedClient;
 class ConnectedClient
 {
 public:
+	RaptorServer *Server;
 	volatile bool Connected;
 	SDL_Thread *InThread, *OutThread;
 	Mutex InLock, OutLock;
@@ -37,7 +43,13 @@ public:
 	unsigned short Port;
 	std::queue< Packet*, std::list<Packet*> > InBuffer, OutBuffer;
 	bool Synchronized;
-	Clock NetClock, PingClock;
+	std::list<uint32_t> SyncQueue;
+	std::set<uint32_t> SyncPending;
+	uint32_t SyncSent, SyncTotal;
+	uint64_t SyncVersion;
+	uint64_t SentChangeVersion;
+	uint32_t KeepAliveSlot;
+	TimerCountdown UpdateTimer, PingTimer;
 	double NetRate, PingRate;
 	int8_t Precision;
 	uint64_t BytesSent;
@@ -48,8 +60,16 @@ public:
 	
 	uint16_t PlayerID;
 	
+	// Unique for the life of the server, so journals can tell clients apart after PlayerIDs are reused.
+	uint32_t ClientID;
 	
-	ConnectedClient( TCPsocket socket, bool use_out_thread = true, double net_rate = 30., int8_t precision = 0 );
+	// Index of the neighbouring shard on the other end, or -1 for players and spectators.
+	int ShardPeer;
+	
+	PacketRegistry<ConnectedClient> Handlers;
+	
+	
+	ConnectedClient( RaptorServer *server, TCPsocket socket, bool use_out_thread = true, double net_rate = 30., int8_t precision = 0 );
 	virtual ~ConnectedClient();
 	
 	void DisconnectNice( const char *message = NULL );
@@ -57,8 +77,13 @@ public:
 	void Cleanup( void );
 	
 	void ProcessIn( void );
-	void ProcessTop( void );
+	bool ProcessTop( void );
 	bool ProcessPacket( Packet *packet );
+	bool ProcessPing( PingMessage *msg, Packet *packet );
+	bool ProcessPong( PongMessage *msg, Packet *packet );
+	bool ProcessPadding( PaddingMessage *msg, Packet *packet );
+	bool ProcessLogin( LoginRequestMessage *msg, Packet *packet );
+	bool ProcessDisconnect( DisconnectMessage *msg, Packet *packet );
 	
 	void Login( std::string name, std::string password );
 	
@@ -0,0 +1,170 @@
+/*
+ *  Messages.cpp
+ */
+
+#include "Messages.h"
+
+
+// Field layouts are in the header because Fields is a template method.
+
+
+PacketProperty::PacketProperty( void )
+{
+}
+
+
+PacketProperty::PacketProperty( std::string name, std::string value )
+{
+	Name = name;
+	Value = value;
+}
+
+
+PropertyKeyDef::PropertyKeyDef( uint16_t id, std::string name )
+{
+	ID = id;
+	Name = name;
+}
+
+
+PropertyChange::PropertyChange( uint16_t key, uint32_t version, std::string value )
+{
+	Key = key;
+	Version = version;
+	Value = value;
+}
+
+
+PropertyStoreDelta::PropertyStoreDelta( uint16_t player_id )
+{
+	PlayerID = player_id;
+}
+
+
+ShardPlayer::ShardPlayer( uint16_t id, std::string name, std::string token )
+{
+	ID = id;
+	Name = name;
+	Token = token;
+}
+
+
+PlayerListEntry::PlayerListEntry( uint16_t id, std::string name )
+{
+	ID = id;
+	Name = name;
+}
+
+
+LoginAcceptMessage::LoginAcceptMessage( void )
+{
+	PlayerID = 0;
+}
+
+
+ReconnectMessage::ReconnectMessage( void )
+{
+	Seconds = 0;
+}
+
+
+InfoQueryMessage::InfoQueryMessage( void )
+{
+	ReplyPort = 0;
+}
+
+
+ChangeStateMessage::ChangeStateMessage( void )
+{
+	State = 0;
+}
+
+
+UpdateMessage::UpdateMessage( void )
+{
+	Precision = 0;
+	ObjectCount = 0;
+}
+
+
+ObjectsAddMessage::ObjectsAddMessage( void )
+{
+	ObjectCount = 0;
+}
+
+
+SyncProgressMessage::SyncProgressMessage( void )
+{
+	Sent = 0;
+	Total = 0;
+}
+
+
+PlayerAddMessage::PlayerAddMessage( void )
+{
+	PlayerID = 0;
+}
+
+
+PlayerRemoveMessage::PlayerRemoveMessage( void )
+{
+	PlayerID = 0;
+}
+
+
+PlayerPropertiesMessage::PlayerPropertiesMessage( void )
+{
+	PlayerID = 0;
+}
+
+
+ShardHelloMessage::ShardHelloMessage( void )
+{
+	ShardIndex = 0;
+}
+
+
+ShardHandoffMessage::ShardHandoffMessage( void )
+{
+	ObjectCount = 0;
+}
+
+
+ShardGhostsMessage::ShardGhostsMessage( void )
+{
+	Precision = 0;
+	AddedCount = 0;
+	UpdatedCount = 0;
+}
+
+
+ShardRedirectMessage::ShardRedirectMessage( void )
+{
+	Port = 0;
+}
+
+
+PingMessage::PingMessage( void )
+{
+	PingID = 0;
+}
+
+
+PongMessage::PongMessage( void )
+{
+	PingID = 0;
+}
+
+
+TextMessage::TextMessage( void )
+{
+	// TextConsole::MSG_NORMAL
+	MsgType = 0;
+}
+
+
+PlaySoundMessage::PlaySoundMessage( void )
+{
+	MusicVolume = 127;
+	SoundVolume = 127;
+}
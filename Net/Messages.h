@@ -0,0 +1,382 @@
+/*
+ *  Messages.h
+ */
+
+#pragma once
+
+#include "PlatformSpecific.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "RaptorDefs.h"
+#include "PacketSchema.h"
+#include "ObjectUpdate.h"
+
+
+// Wire formats of the engine's packet types.  Each Fields method is the single definition of a message
+// layout, used for encoding, bounds-checked decoding, and PacketRegistry dispatch.
+// UPDATE and OBJECTS_ADD only describe their headers; the per-object data after them is read by GameObject,
+// except for UPDATE objects that a network thread already decoded into UpdateMessage::Objects.
+
+
+class PacketProperty
+{
+public:
+	std::string Name, Value;
+	
+	PacketProperty( void );
+	PacketProperty( std::string name, std::string value );
+	
+	template <class V> void Fields( V &v ) { v( Name ); v( Value ); }
+};
+
+
+class PropertyKeyDef
+{
+public:
+	uint16_t ID;
+	std::string Name;
+	
+	PropertyKeyDef( uint16_t id = 0, std::string name = "" );
+	
+	template <class V> void Fields( V &v ) { v( ID ); v( Name ); }
+};
+
+
+class PropertyChange
+{
+public:
+	uint16_t Key;
+	uint32_t Version;
+	std::string Value;
+	
+	PropertyChange( uint16_t key = 0, uint32_t version = 0, std::string value = "" );
+	
+	template <class V> void Fields( V &v ) { v( Key ); v( Version ); v( Value ); }
+};
+
+
+class PropertyStoreDelta
+{
+public:
+	uint16_t PlayerID;  // 0 means the server's own properties.
+	PacketList<uint16_t,PropertyChange> Changes;
+	
+	PropertyStoreDelta( uint16_t player_id = 0 );
+	
+	template <class V> void Fields( V &v ) { v( PlayerID ); v( Changes ); }
+};
+
+
+class ShardPlayer
+{
+public:
+	uint16_t ID;
+	std::string Name, Token;
+	PacketList<uint16_t,PacketProperty> Properties;
+	
+	ShardPlayer( uint16_t id = 0, std::string name = "", std::string token = "" );
+	
+	template <class V> void Fields( V &v ) { v( ID ); v( Name ); v( Token ); v( Properties ); }
+};
+
+
+class PlayerListEntry
+{
+public:
+	uint16_t ID;
+	std::string Name;
+	
+	PlayerListEntry( uint16_t id = 0, std::string name = "" );
+	
+	template <class V> void Fields( V &v ) { v( ID ); v( Name ); }
+};
+
+
+// -----------------------------------------------------------------------------
+
+
+class PaddingMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::PADDING };
+	template <class V> void Fields( V &v ) {}
+};
+
+
+class LoginRequestMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::LOGIN };
+	std::string Game, Version, Name, Password;
+	template <class V> void Fields( V &v ) { v( Game ); v( Version ); v( Name ); v( Password ); }
+};
+
+
+class LoginAcceptMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::LOGIN };
+	uint16_t PlayerID;
+	LoginAcceptMessage( void );
+	template <class V> void Fields( V &v ) { v( PlayerID ); }
+};
+
+
+class DisconnectMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::DISCONNECT };
+	std::string Reason;
+	template <class V> void Fields( V &v ) { v( Reason ); }
+};
+
+
+class ReconnectMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::RECONNECT };
+	uint8_t Seconds;
+	ReconnectMessage( void );
+	template <class V> void Fields( V &v ) { v( Seconds ); }
+};
+
+
+class InfoMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::INFO };
+	PacketList<uint16_t,PacketProperty> Properties;
+	template <class V> void Fields( V &v ) { v( Properties ); }
+};
+
+
+class InfoAnnounceMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::INFO };
+	PacketList<uint16_t,PacketProperty> Properties;
+	PacketList<uint16_t,std::string> PlayerNames;
+	template <class V> void Fields( V &v ) { v( Properties ); v( PlayerNames ); }
+};
+
+
+class InfoQueryMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::INFO_QUERY };
+	uint16_t ReplyPort;
+	InfoQueryMessage( void );
+	template <class V> void Fields( V &v ) { v.Optional(); v( ReplyPort ); }
+};
+
+
+class ChangeStateMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::CHANGE_STATE };
+	int32_t State;
+	ChangeStateMessage( void );
+	template <class V> void Fields( V &v ) { v( State ); }
+};
+
+
+class UpdateMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::UPDATE };
+	int8_t Precision;
+	uint32_t ObjectCount;
+	std::vector<ObjectUpdate> Objects;
+	UpdateMessage( void );
+	template <class V> void Fields( V &v ) { v( Precision ); v( ObjectCount ); }
+};
+
+
+class ObjectsAddMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::OBJECTS_ADD };
+	uint32_t ObjectCount;
+	ObjectsAddMessage( void );
+	template <class V> void Fields( V &v ) { v( ObjectCount ); }
+};
+
+
+class ObjectsRemoveMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::OBJECTS_REMOVE };
+	PacketList<uint32_t,uint32_t> ObjectIDs;
+	template <class V> void Fields( V &v ) { v( ObjectIDs ); }
+};
+
+
+class ObjectsClearMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::OBJECTS_CLEAR };
+	template <class V> void Fields( V &v ) {}
+};
+
+
+class SyncProgressMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::SYNC_PROGRESS };
+	uint32_t Sent, Total;
+	SyncProgressMessage( void );
+	template <class V> void Fields( V &v ) { v( Sent ); v( Total ); }
+};
+
+
+class PropertyDeltaMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::PROPERTY_DELTA };
+	PacketList<uint16_t,PropertyKeyDef> Keys;
+	PacketList<uint16_t,PropertyStoreDelta> Stores;
+	template <class V> void Fields( V &v ) { v( Keys ); v( Stores ); }
+};
+
+
+class PlayerListMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::PLAYER_LIST };
+	PacketList<uint16_t,PlayerListEntry> Players;
+	template <class V> void Fields( V &v ) { v( Players ); }
+};
+
+
+class PlayerAddMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::PLAYER_ADD };
+	uint16_t PlayerID;
+	std::string Name;
+	PlayerAddMessage( void );
+	template <class V> void Fields( V &v ) { v( PlayerID ); v( Name ); }
+};
+
+
+class PlayerRemoveMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::PLAYER_REMOVE };
+	uint16_t PlayerID;
+	PlayerRemoveMessage( void );
+	template <class V> void Fields( V &v ) { v( PlayerID ); }
+};
+
+
+class PlayerPropertiesMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::PLAYER_PROPERTIES };
+	uint16_t PlayerID;
+	PacketList<uint32_t,PacketProperty> Properties;
+	PlayerPropertiesMessage( void );
+	template <class V> void Fields( V &v ) { v( PlayerID ); v( Properties ); }
+};
+
+
+class ShardHelloMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::SHARD_HELLO };
+	std::string Game, Version;
+	uint16_t ShardIndex;
+	ShardHelloMessage( void );
+	template <class V> void Fields( V &v ) { v( Game ); v( Version ); v( ShardIndex ); }
+};
+
+
+// Objects and players moving to the receiving shard; followed by ID, type, and init data for each object.
+class ShardHandoffMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::SHARD_HANDOFF };
+	PacketList<uint16_t,ShardPlayer> Players;
+	uint32_t ObjectCount;
+	ShardHandoffMessage( void );
+	template <class V> void Fields( V &v ) { v( Players ); v( ObjectCount ); }
+};
+
+
+// Read-only copies of objects near the border, followed by ID, type, and init data for each added object,
+// then ID and update data (from server, at Precision) for each updated object.
+class ShardGhostsMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::SHARD_GHOSTS };
+	int8_t Precision;
+	PacketList<uint32_t,uint32_t> RemovedIDs;
+	uint32_t AddedCount, UpdatedCount;
+	ShardGhostsMessage( void );
+	template <class V> void Fields( V &v ) { v( Precision ); v( RemovedIDs ); v( AddedCount ); v( UpdatedCount ); }
+};
+
+
+class ShardRedirectMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::SHARD_REDIRECT };
+	std::string Host;
+	uint16_t Port;
+	std::string Token;
+	ShardRedirectMessage( void );
+	template <class V> void Fields( V &v ) { v( Host ); v( Port ); v( Token ); }
+};
+
+
+class PingMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::PING };
+	uint8_t PingID;
+	PingMessage( void );
+	template <class V> void Fields( V &v ) { v( PingID ); }
+};
+
+
+class PongMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::PONG };
+	uint8_t PingID;
+	PongMessage( void );
+	template <class V> void Fields( V &v ) { v( PingID ); }
+};
+
+
+class TextMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::MESSAGE };
+	std::string Text;
+	uint32_t MsgType;
+	TextMessage( void );
+	template <class V> void Fields( V &v ) { v( Text ); v.Optional(); v( MsgType ); }
+};
+
+
+class PlaySoundMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::PLAY_SOUND };
+	std::string Sound;
+	int8_t MusicVolume, SoundVolume;
+	PlaySoundMessage( void );
+	template <class V> void Fields( V &v ) { v( Sound ); v.Optional(); v( MusicVolume ); v( SoundVolume ); }
+};
+
+
+class PlayMusicMessage
+{
+public:
+	enum { TYPE = Raptor::Packet::PLAY_MUSIC };
+	std::string Music;
+	template <class V> void Fields( V &v ) { v( Music ); }
+};
@@ -28,6 +28,19 @@ NetClient::NetClient( void )
 	
 	ReconnectTime = 0;
 	ReconnectAttempts = 0;
+	
+	Redirecting = false;
+	Redirected = false;
+	RedirectPort = 0;
+	
+	Handlers.Register( &NetClient::ProcessPing );
+	Handlers.Register( &NetClient::ProcessPong );
+	Handlers.Register( &NetClient::ProcessPadding );
+	Handlers.Register( &NetClient::ProcessChangeState );
+	Handlers.Register( &NetClient::ProcessLoginAccept );
+	Handlers.Register( &NetClient::ProcessDisconnect );
+	Handlers.Register( &NetClient::ProcessReconnect );
+	Handlers.Register( &NetClient::ProcessShardRedirect );
 }
 
 
@@ -120,6 +133,10 @@ int NetClient::Connect( const char *hostname, int port, const char *name, const
 	if( Connected )
 		DisconnectNice();
 	
+	// A new connection replaces any pending redirect.
+	Redirecting = false;
+	Redirected = false;
+	
 	// Clean up old data and socket.
 	SDL_Delay( 1 );
 	Cleanup();
@@ -130,12 +147,58 @@ int NetClient::Connect( const char *hostname, int port, const char *name, const
 	Raptor::Game->Console.Print( cstr );
 	Raptor::Game->ChangeState( Raptor::State::CONNECTING );
 	
+	if( Open() < 0 )
+	{
+		Raptor::Game->ChangeState( Raptor::State::DISCONNECTED );
+		return -1;
+	}
+	
+	// Send login information.
+	Login( name, password );
+	
+	// If we connected successfully, don't try to reconnect.
+	ReconnectTime = 0;
+	ReconnectAttempts = 0;
+	
+	return 0;
+}
+
+
+int NetClient::FollowRedirect( const char *name )
+{
+	// Wait until the listener thread for the old server has finished.
+	if( (! Redirecting) || Thread )
+		return -1;
+	
+	Redirecting = false;
+	Cleanup();
+	
+	// The new server sends everything again, so start over without leaving the connected state.
+	Raptor::Game->Data.Clear();
+	
+	Host = RedirectHost;
+	Port = RedirectPort;
+	
+	char cstr[ 1024 ] = "";
+	snprintf( cstr, 1024, "Moving to %s:%i...", Host.c_str(), Port );
+	Raptor::Game->Console.Print( cstr );
+	
+	if( Open() < 0 )
+		return -1;
+	
+	Redirected = true;
+	Login( name, RedirectToken.c_str() );
+	return 0;
+}
+
+
+int NetClient::Open( void )
+{
 	// Resolve the host we are connecting to.
 	IPaddress ip;
-	if( SDLNet_ResolveHost( &ip, hostname, Port ) < 0 )
+	if( SDLNet_ResolveHost( &ip, Host.c_str(), Port ) < 0 )
 	{
 		Raptor::Game->Console.Print( "Failed to resolve server hostname.", TextConsole::MSG_ERROR );
-		Raptor::Game->ChangeState( Raptor::State::DISCONNECTED );
 		return -1;
 	}
 	
@@ -143,7 +206,6 @@ int NetClient::Connect( const char *hostname, int port, const char *name, const
 	if( !( Socket = SDLNet_TCP_Open(&ip) ) )
 	{
 		Raptor::Game->Console.Print( "Failed to open socket to server.", TextConsole::MSG_ERROR );
-		Raptor::Game->ChangeState( Raptor::State::DISCONNECTED );
 		return -1;
 	}
 	
@@ -158,31 +220,32 @@ int NetClient::Connect( const char *hostname, int port, const char *name, const
 		Connected = false;
 		SDLNet_TCP_Close( Socket );
 		Socket = NULL;
-		Raptor::Game->ChangeState( Raptor::State::DISCONNECTED );
 		return -1;
 	}
 	
+	char cstr[ 1024 ] = "";
 	uint32_t ip_int = Endian::ReadBig32(&(ip.host));
 	uint16_t port_int = Endian::ReadBig16(&(ip.port));
 	snprintf( cstr, 1024, "Connected to: %i.%i.%i.%i:%i", (ip_int & 0xFF000000) >> 24, (ip_int & 0x00FF0000) >> 16, (ip_int & 0x0000FF00) >> 8, ip_int & 0x000000FF, port_int );
 	Raptor::Game->Console.Print( cstr );
 	
-	// Send login information.
-	Packet packet( Raptor::Packet::LOGIN );
-	packet.AddString( Raptor::Game->Game );
-	packet.AddString( Raptor::Game->Version );
-	packet.AddString( name );
-	packet.AddString( password );  // FIXME: This assumes every game requires a password!
-	Send( &packet );
-	
-	// If we connected successfully, don't try to reconnect.
-	ReconnectTime = 0;
-	ReconnectAttempts = 0;
-	
 	return 0;
 }
 
 
+void NetClient::Login( const char *name, const char *password )
+{
+	LoginRequestMessage login;
+	login.Game = Raptor::Game->Game;
+	login.Version = Raptor::Game->Version;
+	login.Name = name;
+	login.Password = password;  // FIXME: This assumes every game requires a password!
+	Packet packet;
+	EncodePacket( &packet, &login );
+	Send( &packet );
+}
+
+
 int NetClient::Reconnect( const char *name, const char *password )
 {
 	if( ReconnectAttempts )
@@ -205,13 +268,12 @@ void NetClient::DisconnectNice( const char *message )
 	{
 		// Tell the server we're leaving.
 
-		Packet packet( Raptor::Packet::DISCONNECT );
-		
+		DisconnectMessage disconnect;
 		if( message )
-			packet.AddString( message );
-		else
-			packet.AddString( "" );
+			disconnect.Reason = message;
 		
+		Packet packet;
+		EncodePacket( &packet, &disconnect );
 		Send( &packet );
 	}
 	
@@ -230,9 +292,9 @@ void NetClient::Disconnect( void )
 	
 	ReconnectClock.Reset();
 	
-	// If we're hosting the game, stop the server.
-	if( Raptor::Server->IsRunning() )
-		Raptor::Server->StopAndWait();
+	// If we're hosting the game, stop the server (unless we're only moving to another shard).
+	if( (! Redirecting) && Raptor::Game->Server && Raptor::Game->Server->IsRunning() )
+		Raptor::Game->Server->StopAndWait();
 }
 
 
@@ -240,7 +302,9 @@ void NetClient::Cleanup( void )
 {
 	if( ! Connected )
 	{
-		Raptor::Game->ChangeState( Raptor::State::DISCONNECTED );
+		// Moving to another shard shouldn't look like leaving the game, and demo playback runs without a server.
+		if( ! (Redirecting || Raptor::Game->DemoPlay.IsOpen()) )
+			Raptor::Game->ChangeState( Raptor::State::DISCONNECTED );
 		
 		if( ! Thread )
 		{
@@ -281,93 +345,130 @@ void NetClient::ClearPackets( void )
 void NetClient::ProcessIn( void )
 {
 	SDL_mutexP( Lock );
+	size_t packet_count = InBuffer.size();
+	SDL_mutexV( Lock );
 	
-	// Process the entire incoming packet buffer.
-	while( ! InBuffer.empty() )
+	// Process the packets that had arrived when we started, holding the lock only long enough to take each one.
+	// If processing a packet clears the buffer (such as by disconnecting), stop there.
+	for( size_t i = 0; i < packet_count; i ++ )
 	{
-		Packet *packet = InBuffer.front();
+		Packet *packet = NULL;
+		
+		SDL_mutexP( Lock );
+		if( ! InBuffer.empty() )
+		{
+			packet = InBuffer.front();
+			InBuffer.pop();
+		}
+		SDL_mutexV( Lock );
+		
+		if( ! packet )
+			break;
+		
 		ProcessPacket( packet );
 		delete packet;
-		InBuffer.pop();
 	}
-	
-	SDL_mutexV( Lock );
 }
 
 
 bool NetClient::ProcessPacket( Packet *packet )
 {
+	if( Raptor::Game->DemoRecord.IsOpen() )
+		Raptor::Game->DemoRecord.RecordPacket( packet );
+	
 	packet->Rewind();
-	PacketType type = packet->Type();
 	
+	// Give the game the first chance to handle each packet.
 	if( Raptor::Game->ProcessPacket( packet ) )
 		return true;
 	
-	else if( type == Raptor::Packet::PING )
-	{
-		uint8_t ping_id = packet->NextUChar();
-		Packet pong( Raptor::Packet::PONG );
-		pong.AddUChar( ping_id );
-		Send( &pong );
-	}
-	
-	else if( type == Raptor::Packet::PONG )
-	{
-		uint8_t ping_id = packet->NextUChar();
-		std::map<uint8_t,Clock>::iterator ping_iter = SentPings.find( ping_id );
-		if( ping_iter != SentPings.end() )
-		{
-			double ms = ping_iter->second.ElapsedMilliseconds();
-			SentPings.erase( ping_iter );
-			PingTimes.push_back( ms );
-			while( PingTimes.size() > 120 )
-				PingTimes.pop_front();
-		}
-	}
-	
-	else if( type == Raptor::Packet::PADDING )
-	{
-		// Always ignore padding packets.
-		packet->Offset = packet->Size();
-	}
-	
-	else if( type == Raptor::Packet::CHANGE_STATE )
-	{
-		int state = packet->NextInt();
-		Raptor::Game->ChangeState( state );
-	}
-	
-	else if( type == Raptor::Packet::LOGIN )
-	{
-		Raptor::Game->PlayerID = packet->NextUShort();
-		if( Raptor::Game->State >= Raptor::State::CONNECTING )
-			Raptor::Game->ChangeState( Raptor::State::CONNECTED );
-		else
-			DisconnectNice();
-	}
-	
-	else if( type == Raptor::Packet::DISCONNECT )
-	{
-		std::string message = packet->NextString();
-		
-		Disconnect();
-	}
-	
-	else if( type == Raptor::Packet::RECONNECT )
+	return Handlers.Dispatch( this, packet );
+}
+
+
+bool NetClient::ProcessPing( PingMessage *msg, Packet *packet )
+{
+	PongMessage pong_msg;
+	pong_msg.PingID = msg->PingID;
+	Packet pong;
+	EncodePacket( &pong, &pong_msg );
+	Send( &pong );
+	return true;
+}
+
+
+bool NetClient::ProcessPong( PongMessage *msg, Packet *packet )
+{
+	std::map<uint8_t,Clock>::iterator ping_iter = SentPings.find( msg->PingID );
+	if( ping_iter != SentPings.end() )
 	{
-		uint8_t time = packet->NextUChar();
-		
-		Disconnect();
-		
-		ReconnectTime = time;
-		ReconnectAttempts = 3;
-		ReconnectClock.Reset();
+		double ms = ping_iter->second.ElapsedMilliseconds();
+		SentPings.erase( ping_iter );
+		PingTimes.push_back( ms );
+		while( PingTimes.size() > 120 )
+			PingTimes.pop_front();
 	}
+	return true;
+}
+
+
+bool NetClient::ProcessPadding( PaddingMessage *msg, Packet *packet )
+{
+	// Always ignore padding packets.
+	packet->Offset = packet->Size();
+	return true;
+}
+
+
+bool NetClient::ProcessChangeState( ChangeStateMessage *msg, Packet *packet )
+{
+	Raptor::Game->ChangeState( msg->State );
+	return true;
+}
+
+
+bool NetClient::ProcessLoginAccept( LoginAcceptMessage *msg, Packet *packet )
+{
+	Raptor::Game->PlayerID = msg->PlayerID;
 	
+	// After a redirect we're already in whatever state the game was in.
+	if( Redirected )
+		Redirected = false;
+	else if( Raptor::Game->State >= Raptor::State::CONNECTING )
+		Raptor::Game->ChangeState( Raptor::State::CONNECTED );
 	else
-		return false;
+		DisconnectNice();
+	return true;
+}
+
+
+bool NetClient::ProcessDisconnect( DisconnectMessage *msg, Packet *packet )
+{
+	Disconnect();
+	return true;
+}
+
+
+bool NetClient::ProcessReconnect( ReconnectMessage *msg, Packet *packet )
+{
+	Disconnect();
 	
-	// This means one of the if statements above matched, so NetClient did handle the packet.
+	ReconnectTime = msg->Seconds;
+	ReconnectAttempts = 3;
+	ReconnectClock.Reset();
+	return true;
+}
+
+
+bool NetClient::ProcessShardRedirect( ShardRedirectMessage *msg, Packet *packet )
+{
+	// Our player moved to another shard.  Leave this one without stopping a hosted server,
+	// and let FollowRedirect connect to the new one once the listener thread has finished.
+	RedirectHost = msg->Host;
+	RedirectPort = msg->Port;
+	RedirectToken = msg->Token;
+	Redirecting = true;
+	DisconnectNice( "Moving to another shard." );
 	return true;
 }
 
@@ -458,8 +559,10 @@ void NetClient::SendPing( void )
 	{
 		SentPings[ ping_id ].Reset();
 		
-		Packet ping( Raptor::Packet::PING );
-		ping.AddUChar( ping_id );
+		PingMessage ping_msg;
+		ping_msg.PingID = ping_id;
+		Packet ping;
+		EncodePacket( &ping, &ping_msg );
 		Send( &ping );
 	}
 }
@@ -518,6 +621,9 @@ int NetClientThread( void *client )
 			
 			while( Packet *packet = Buffer.Pop() )
 			{
+				// Decode what we can here, so the main thread only has to apply it.
+				Raptor::Game->Handlers.Predecode( Raptor::Game, packet );
+				
 				SDL_mutexP( net_client->Lock );
 				net_client->InBuffer.push( packet );
 				SDL_mutexV( net_client->Lock );
@@ -21,6 +21,8 @@ class NetClient;
 #endif
 
 #include "Packet.h"
+#include "PacketRegistry.h"
+#include "Messages.h"
 #include "Clock.h"
 
 
@@ -47,6 +49,15 @@ public:
 	std::string Host;
 	int Port;
 	
+	// Set when a sharded server hands us to a neighbour, which we log in to with the token it gave.
+	volatile bool Redirecting;
+	bool Redirected;
+	std::string RedirectHost;
+	int RedirectPort;
+	std::string RedirectToken;
+	
+	PacketRegistry<NetClient> Handlers;
+	
 	
 	NetClient( void );
 	virtual ~NetClient();
@@ -55,6 +66,9 @@ public:
 	int Connect( const char *host, const char *name, const char *password );
 	int Connect( const char *hostname, int port, const char *name, const char *password );
 	int Reconnect( const char *name, const char *password );
+	int FollowRedirect( const char *name );
+	int Open( void );
+	void Login( const char *name, const char *password );
 	void DisconnectNice( const char *message = NULL );
 	void Disconnect( void );
 	void Cleanup( void );
@@ -62,6 +76,14 @@ public:
 	
 	void ProcessIn( void );
 	bool ProcessPacket( Packet *packet );
+	bool ProcessPing( PingMessage *msg, Packet *packet );
+	bool ProcessPong( PongMessage *msg, Packet *packet );
+	bool ProcessPadding( PaddingMessage *msg, Packet *packet );
+	bool ProcessChangeState( ChangeStateMessage *msg, Packet *packet );
+	bool ProcessLoginAccept( LoginAcceptMessage *msg, Packet *packet );
+	bool ProcessDisconnect( DisconnectMessage *msg, Packet *packet );
+	bool ProcessReconnect( ReconnectMessage *msg, Packet *packet );
+	bool ProcessShardRedirect( ShardRedirectMessage *msg, Packet *packet );
 	
 	int Send( Packet *packet );
 	
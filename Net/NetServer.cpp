@@ -9,8 +9,9 @@
 #include "RaptorServer.h"
 
 
-NetServer::NetServer( void )
+NetServer::NetServer( RaptorServer *server )
 {
+	Server = server;
 	Initialized = false;
 	Listening = false;
 	Thread = NULL;
@@ -18,6 +19,7 @@ NetServer::NetServer( void )
 	NetRate = 30.0;
 	UseOutThreads = true;
 	Precision = 0;
+	NextClientID = 0;
 }
 
 
@@ -286,6 +288,28 @@ void NetServer::SendAllExcept( Packet *packet, ConnectedClient *except )
 }
 
 
+void NetServer::SendAllSynchronized( Packet *packet, bool sync_complete )
+{
+	if( ! Lock.Lock() )
+		fprintf( stderr, "NetServer::SendAllSynchronized: Lock.Lock: %s\n", SDL_GetError() );
+	
+	for( std::list<ConnectedClient*>::iterator iter = Clients.begin(); iter != Clients.end(); )
+	{
+		std::list<ConnectedClient*>::iterator next = iter;
+		next ++;
+		
+		// Clients that haven't logged in shouldn't see game data, and object updates must wait until the client has every object.
+		if( (*iter)->Synchronized && !( sync_complete && (*iter)->SyncQueue.size() ) )
+			(*iter)->Send( packet );
+		
+		iter = next;
+	}
+	
+	if( ! Lock.Unlock() )
+		fprintf( stderr, "NetServer::SendAllSynchronized: Lock.Unlock: %s\n", SDL_GetError() );
+}
+
+
 void NetServer::SendAllReconnect( uint8_t seconds_to_wait )
 {
 	Packet reconnect_packet( Raptor::Packet::RECONNECT );
@@ -306,22 +330,28 @@ void NetServer::SendUpdates( void )
 		
 		ConnectedClient *client = *iter;
 		
+		// Keep streaming the initial object list to newly-joined clients.
+		if( client->Connected && client->SyncQueue.size() )
+			Server->SendSyncChunk( client );
+		
 		// Reduce update rate temporarily in high-ping situations.
 		double temp_netrate = client->NetRate;
 		temp_netrate /= ((int) client->LatestPing() / 100) + 1;
 		
 		// Send an update if it's time to do so.
-		if( client->Connected && client->PlayerID && ( client->NetClock.ElapsedSeconds() >= (1.0 / temp_netrate) ) )
+		if( client->Connected && client->PlayerID && ! client->UpdateTimer.Scheduled() )
 		{
-			client->NetClock.Reset();
+			Server->Timers.Schedule( &(client->UpdateTimer), 1.0 / temp_netrate );
 			
-			if( client->PingClock.ElapsedSeconds() >= (1.0 / client->PingRate) )
+			if( ! client->PingTimer.Scheduled() )
 			{
-				client->PingClock.Reset();
+				Server->Timers.Schedule( &(client->PingTimer), 1.0 / client->PingRate );
 				client->SendPing();
 			}
 			
-			Raptor::Server->SendUpdate( client, client->Precision );
+			// Replication tasks build the update from the last snapshot if they can.
+			if( ! Server->QueueReplication( client ) )
+				Server->SendUpdate( client, client->Precision );
 		}
 		
 		iter = next;
@@ -361,7 +391,8 @@ int NetServer::NetServerThread( void *server )
 		// Check for new connections.
 		if( (client_socket = SDLNet_TCP_Accept(net_server->Socket)) )
 		{
-			ConnectedClient *connected_client = new ConnectedClient( client_socket, net_server->UseOutThreads, net_server->NetRate, net_server->Precision );
+			ConnectedClient *connected_client = new ConnectedClient( net_server->Server, client_socket, net_server->UseOutThreads, net_server->NetRate, net_server->Precision );
+			connected_client->ClientID = ++ net_server->NextClientID;
 			
 			if( (remote_ip = SDLNet_TCP_GetPeerAddress(client_socket)) )
 			{
@@ -370,12 +401,12 @@ int NetServer::NetServerThread( void *server )
 				
 				char cstr[ 1024 ] = "";
 				snprintf( cstr, 1024, "Client connected: %i.%i.%i.%i:%i", (connected_client->IP & 0xFF000000) >> 24, (connected_client->IP & 0x00FF0000) >> 16, (connected_client->IP & 0x0000FF00) >> 8, connected_client->IP & 0x000000FF, connected_client->Port );
-				Raptor::Server->ConsolePrint( cstr );
+				net_server->Server->ConsolePrint( cstr );
 			}
 			else
 			{
 				fprintf( stderr, "SDLNet_TCP_GetPeerAddress: %s\n", SDLNet_GetError() );
-				Raptor::Server->ConsolePrint( "Client connected from unknown IP!\n" );
+				net_server->Server->ConsolePrint( "Client connected from unknown IP!\n" );
 			}
 			
 			if( ! net_server->Lock.Lock() )
@@ -4,6 +4,7 @@
 
 #pragma once
 class NetServer;
+class RaptorServer;
 
 #include "PlatformSpecific.h"
 
@@ -28,6 +29,7 @@ class NetServer;
 class NetServer
 {
 public:
+	RaptorServer *Server;
 	bool Initialized;
 	volatile bool Listening;
 	SDL_Thread *Thread;
@@ -38,9 +40,10 @@ public:
 	double NetRate;
 	bool UseOutThreads;
 	int8_t Precision;
+	uint32_t NextClientID;
 	
 	
-	NetServer( void );
+	NetServer( RaptorServer *server = NULL );
 	virtual ~NetServer();
 	
 	int Initialize( int port = 7000 );
@@ -54,6 +57,7 @@ public:
 	void SendToPlayer( Packet *packet, uint32_t player_id );
 	void SendAll( Packet *packet );
 	void SendAllExcept( Packet *packet, ConnectedClient *except );
+	void SendAllSynchronized( Packet *packet, bool sync_complete = false );
 	void SendAllReconnect( uint8_t seconds_to_wait = 3 );
 	void SendUpdates( void );
 	
@@ -0,0 +1,115 @@
+/*
+ *  ObjectUpdate.cpp
+ */
+
+#include "ObjectUpdate.h"
+
+#include "Num.h"
+
+
+ObjectUpdate::ObjectUpdate( uint32_t id )
+{
+	ID = id;
+	Offset = 0;
+	X = 0.;
+	Y = 0.;
+	Z = 0.;
+	PlayerID = 0;
+}
+
+
+ObjectUpdate::~ObjectUpdate()
+{
+}
+
+
+void ObjectUpdate::Read( Packet *packet, int8_t precision, bool from_server )
+{
+	// This must match GameObject::AddToUpdatePacket and AddToUpdatePacketFromServer.
+	
+	X = packet->NextDouble();
+	Y = packet->NextDouble();
+	Z = packet->NextDouble();
+	if( precision >= 0 )
+	{
+		Fwd.X = packet->NextFloat();
+		Fwd.Y = packet->NextFloat();
+		Fwd.Z = packet->NextFloat();
+	}
+	else
+	{
+		Fwd.X = Num::UnitFloatFrom16( packet->NextShort() );
+		Fwd.Y = Num::UnitFloatFrom16( packet->NextShort() );
+		Fwd.Z = Num::UnitFloatFrom16( packet->NextShort() );
+	}
+	if( precision >= 1 )
+	{
+		Up.X = packet->NextFloat();
+		Up.Y = packet->NextFloat();
+		Up.Z = packet->NextFloat();
+	}
+	else if( precision >= 0 )
+	{
+		Up.X = Num::UnitFloatFrom16( packet->NextShort() );
+		Up.Y = Num::UnitFloatFrom16( packet->NextShort() );
+		Up.Z = Num::UnitFloatFrom16( packet->NextShort() );
+	}
+	else
+	{
+		Up.X = Num::UnitFloatFrom8( packet->NextChar() );
+		Up.Y = Num::UnitFloatFrom8( packet->NextChar() );
+		Up.Z = Num::UnitFloatFrom8( packet->NextChar() );
+	}
+	MotionVector.X = packet->NextFloat();
+	MotionVector.Y = packet->NextFloat();
+	MotionVector.Z = packet->NextFloat();
+	
+	if( from_server )
+		PlayerID = packet->NextUShort();
+}
+
+
+void ObjectUpdate::Write( Packet *packet, int8_t precision, bool from_server ) const
+{
+	// This must match GameObject::AddToUpdatePacket and AddToUpdatePacketFromServer.
+	
+	packet->AddDouble( X );
+	packet->AddDouble( Y );
+	packet->AddDouble( Z );
+	if( precision >= 0 )
+	{
+		packet->AddFloat( Fwd.X );
+		packet->AddFloat( Fwd.Y );
+		packet->AddFloat( Fwd.Z );
+	}
+	else
+	{
+		packet->AddShort( Num::UnitFloatTo16(Fwd.X) );
+		packet->AddShort( Num::UnitFloatTo16(Fwd.Y) );
+		packet->AddShort( Num::UnitFloatTo16(Fwd.Z) );
+	}
+	if( precision >= 1 )
+	{
+		packet->AddFloat( Up.X );
+		packet->AddFloat( Up.Y );
+		packet->AddFloat( Up.Z );
+	}
+	else if( precision >= 0 )
+	{
+		packet->AddShort( Num::UnitFloatTo16(Up.X) );
+		packet->AddShort( Num::UnitFloatTo16(Up.Y) );
+		packet->AddShort( Num::UnitFloatTo16(Up.Z) );
+	}
+	else
+	{
+		packet->AddChar( Num::UnitFloatTo8(Up.X) );
+		packet->AddChar( Num::UnitFloatTo8(Up.Y) );
+		packet->AddChar( Num::UnitFloatTo8(Up.Z) );
+	}
+	packet->AddFloat( MotionVector.X );
+	packet->AddFloat( MotionVector.Y );
+	packet->AddFloat( MotionVector.Z );
+	
+	if( from_server )
+		packet->AddUShort( PlayerID );
+}
@@ -0,0 +1,35 @@
+/*
+ *  ObjectUpdate.h
+ */
+
+#pragma once
+class ObjectUpdate;
+
+#include "PlatformSpecific.h"
+
+#include <stdint.h>
+#include "Vec.h"
+#include "Packet.h"
+
+
+// Plain copy of one object's standard update data, decoded from an UPDATE packet without touching the object.
+// Network threads fill these in so the main thread only has to apply them.
+
+
+class ObjectUpdate
+{
+public:
+	uint32_t ID;
+	PacketSize Offset;
+	double X, Y, Z;
+	Vec3D Fwd, Up;
+	Vec3D MotionVector;
+	uint16_t PlayerID;
+	
+	
+	ObjectUpdate( uint32_t id = 0 );
+	virtual ~ObjectUpdate();
+	
+	void Read( Packet *packet, int8_t precision, bool from_server );
+	void Write( Packet *packet, int8_t precision, bool from_server ) const;
+};
@@ -8,6 +8,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include "PacketSchema.h"
 
 
 // Allocate for outgoing data.
@@ -15,6 +16,7 @@ Packet::Packet( PacketType packet_type )
 {
 	AllocationChunkSize = PACKET_OUTGOING_ALLOCATION_CHUNK_SIZE;
 	ThrowExceptions = false;
+	Decoded = NULL;
 	
 	Data = NULL;
 	Allocated = 0;
@@ -32,6 +34,7 @@ Packet::Packet( const void *data, int size )
 {
 	AllocationChunkSize = PACKET_INCOMING_ALLOCATION_CHUNK_SIZE;
 	ThrowExceptions = false;
+	Decoded = NULL;
 	
 	Data = NULL;
 	Allocated = 0;
@@ -50,6 +53,7 @@ Packet::Packet( const void *data, int size )
 Packet::Packet( const Packet *other )
 {
 	ThrowExceptions = other->ThrowExceptions;
+	Decoded = NULL;
 	AllocationChunkSize = 1;
 	Data = NULL;
 	Allocated = 0;
@@ -69,6 +73,9 @@ Packet::Packet( const Packet *other )
 
 Packet::~Packet()
 {
+	delete Decoded;
+	Decoded = NULL;
+	
 	if( Allocated )
 	{
 		SetType( PACKET_DEFAULT_TYPE );
@@ -158,6 +165,9 @@ void Packet::SetSize( PacketSize size )
 
 void Packet::Clear( void )
 {
+	delete Decoded;
+	Decoded = NULL;
+	
 	SetSize( PACKET_HEADER_SIZE );
 	Rewind();
 }
@@ -4,6 +4,7 @@
 
 #pragma once
 class Packet;
+class PacketDecoded;
 
 #include "PlatformSpecific.h"
 
@@ -36,8 +37,11 @@ public:
 	int AllocationChunkSize;
 	bool ThrowExceptions;
 	
+	// Message fields already decoded by a network thread, if any.
+	PacketDecoded *Decoded;
 	
-	Packet( PacketType packet_type );
+	
+	Packet( PacketType packet_type = PACKET_DEFAULT_TYPE );
 	Packet( const void *data, int size );
 	Packet( const Packet *other );
 	virtual ~Packet();
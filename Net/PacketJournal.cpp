@@ -0,0 +1,240 @@
+/*
+ *  PacketJournal.cpp
+ */
+
+#include "PacketJournal.h"
+
+#include <cstddef>
+#include <vector>
+
+
+JournalHeader::JournalHeader( void )
+{
+	Format = FORMAT;
+	Seed = 0;
+}
+
+
+JournalTick::JournalTick( void )
+{
+	Tick = 0;
+	dT = 0.;
+}
+
+
+JournalPacket::JournalPacket( void )
+{
+	ClientID = 0;
+}
+
+
+JournalDrop::JournalDrop( void )
+{
+	ClientID = 0;
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+PacketJournal::PacketJournal( void )
+{
+	File = NULL;
+	Tick = 0;
+	BytesWritten = 0;
+}
+
+
+PacketJournal::~PacketJournal()
+{
+	Close();
+}
+
+
+bool PacketJournal::Open( std::string filename, std::string game, std::string version, uint32_t seed )
+{
+	Close();
+	
+	if( ! Lock.Lock() )
+		fprintf( stderr, "PacketJournal::Open: Lock.Lock: %s\n", SDL_GetError() );
+	
+	File = fopen( filename.c_str(), "wb" );
+	Filename = filename;
+	Tick = 0;
+	BytesWritten = 0;
+	
+	if( ! Lock.Unlock() )
+		fprintf( stderr, "PacketJournal::Open: Lock.Unlock: %s\n", SDL_GetError() );
+	
+	if( ! File )
+		return false;
+	
+	JournalHeader header;
+	header.Game = game;
+	header.Version = version;
+	header.Seed = seed;
+	Packet record;
+	EncodePacket( &record, &header );
+	Write( &record );
+	return true;
+}
+
+
+void PacketJournal::Close( void )
+{
+	if( ! Lock.Lock() )
+		fprintf( stderr, "PacketJournal::Close: Lock.Lock: %s\n", SDL_GetError() );
+	
+	if( File )
+	{
+		fclose( File );
+		File = NULL;
+	}
+	
+	if( ! Lock.Unlock() )
+		fprintf( stderr, "PacketJournal::Close: Lock.Unlock: %s\n", SDL_GetError() );
+}
+
+
+bool PacketJournal::IsOpen( void ) const
+{
+	return File;
+}
+
+
+void PacketJournal::RecordTick( double dt )
+{
+	if( ! File )
+		return;
+	
+	JournalTick tick;
+	tick.Tick = ++ Tick;
+	tick.dT = dt;
+	Packet record;
+	EncodePacket( &record, &tick );
+	Write( &record );
+}
+
+
+void PacketJournal::RecordPacket( uint32_t client_id, Packet *packet )
+{
+	if( ! File )
+		return;
+	
+	JournalPacket journal_packet;
+	journal_packet.ClientID = client_id;
+	Packet record;
+	EncodePacket( &record, &journal_packet );
+	record.AddData( packet->Data, packet->Size() );
+	Write( &record );
+}
+
+
+void PacketJournal::RecordDrop( uint32_t client_id )
+{
+	if( ! File )
+		return;
+	
+	JournalDrop drop;
+	drop.ClientID = client_id;
+	Packet record;
+	EncodePacket( &record, &drop );
+	Write( &record );
+}
+
+
+void PacketJournal::Write( Packet *record )
+{
+	// Drops can be recorded by network threads, so keep whole records together.
+	if( ! Lock.Lock() )
+		fprintf( stderr, "PacketJournal::Write: Lock.Lock: %s\n", SDL_GetError() );
+	
+	if( File )
+	{
+		if( fwrite( record->Data, 1, record->Size(), File ) == record->Size() )
+			BytesWritten += record->Size();
+		else
+		{
+			fprintf( stderr, "PacketJournal::Write: Failed to write %s, stopping journal.\n", Filename.c_str() );
+			fclose( File );
+			File = NULL;
+		}
+	}
+	
+	if( ! Lock.Unlock() )
+		fprintf( stderr, "PacketJournal::Write: Lock.Unlock: %s\n", SDL_GetError() );
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+JournalReader::JournalReader( void )
+{
+	File = NULL;
+}
+
+
+JournalReader::~JournalReader()
+{
+	Close();
+}
+
+
+bool JournalReader::Open( std::string filename )
+{
+	Close();
+	
+	File = fopen( filename.c_str(), "rb" );
+	if( ! File )
+		return false;
+	
+	Packet *record = Next();
+	bool valid = record && (record->Type() == JournalHeader::TYPE) && DecodePacket( record, &Header ) && (Header.Format == JournalHeader::FORMAT);
+	delete record;
+	
+	if( ! valid )
+		Close();
+	
+	return valid;
+}
+
+
+void JournalReader::Close( void )
+{
+	if( File )
+	{
+		fclose( File );
+		File = NULL;
+	}
+}
+
+
+Packet *JournalReader::Next( void )
+{
+	return ReadRecord( File );
+}
+
+
+Packet *JournalReader::ReadRecord( FILE *file )
+{
+	// Demos use the same record framing, so this is shared with DemoPlayer.
+	if( ! file )
+		return NULL;
+	
+	uint8_t header[ PACKET_HEADER_SIZE ];
+	if( fread( header, 1, PACKET_HEADER_SIZE, file ) < PACKET_HEADER_SIZE )
+		return NULL;
+	
+	// A size that can't be right means the rest of the file is unusable (probably cut off mid-write).
+	PacketSize size = Packet::FirstPacketSize( header );
+	if( (size < PACKET_HEADER_SIZE) || (size > 0x04000000) )
+		return NULL;
+	
+	std::vector<uint8_t> data( size );
+	memcpy( &(data[ 0 ]), header, PACKET_HEADER_SIZE );
+	if( (size > PACKET_HEADER_SIZE) && (fread( &(data[ PACKET_HEADER_SIZE ]), 1, size - PACKET_HEADER_SIZE, file ) < size - PACKET_HEADER_SIZE) )
+		return NULL;
+	
+	return new Packet( &(data[ 0 ]), size );
+}
@@ -0,0 +1,112 @@
+/*
+ *  PacketJournal.h
+ */
+
+#pragma once
+class PacketJournal;
+class JournalReader;
+
+#include "PlatformSpecific.h"
+
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+#include "Packet.h"
+#include "PacketSchema.h"
+#include "Mutex.h"
+
+
+// A journal records everything the server thread received, in the order it was handled, so a run can be replayed
+// through RaptorServer::ReplayJournal.  Each record is stored like a packet: size, type, then its fields.
+// PACKET records are followed by the received packet exactly as it arrived, including its own header.
+
+
+class JournalHeader
+{
+public:
+	enum { TYPE = 'JHdr', FORMAT = 1 };
+	uint32_t Format;
+	std::string Game, Version;
+	uint32_t Seed;
+	JournalHeader( void );
+	template <class V> void Fields( V &v ) { v( Format ); v( Game ); v( Version ); v( Seed ); }
+};
+
+
+class JournalTick
+{
+public:
+	enum { TYPE = 'JTck' };
+	uint32_t Tick;
+	double dT;
+	JournalTick( void );
+	template <class V> void Fields( V &v ) { v( Tick ); v( dT ); }
+};
+
+
+class JournalPacket
+{
+public:
+	enum { TYPE = 'JPkt' };
+	uint32_t ClientID;
+	JournalPacket( void );
+	template <class V> void Fields( V &v ) { v( ClientID ); }
+};
+
+
+class JournalDrop
+{
+public:
+	enum { TYPE = 'JDrp' };
+	uint32_t ClientID;
+	JournalDrop( void );
+	template <class V> void Fields( V &v ) { v( ClientID ); }
+};
+
+
+// -----------------------------------------------------------------------------
+
+
+class PacketJournal
+{
+public:
+	FILE *File;
+	std::string Filename;
+	Mutex Lock;
+	uint32_t Tick;
+	uint64_t BytesWritten;
+	
+	
+	PacketJournal( void );
+	virtual ~PacketJournal();
+	
+	bool Open( std::string filename, std::string game, std::string version, uint32_t seed );
+	void Close( void );
+	bool IsOpen( void ) const;
+	
+	void RecordTick( double dt );
+	void RecordPacket( uint32_t client_id, Packet *packet );
+	void RecordDrop( uint32_t client_id );
+
+private:
+	void Write( Packet *record );
+};
+
+
+class JournalReader
+{
+public:
+	FILE *File;
+	JournalHeader Header;
+	
+	
+	JournalReader( void );
+	virtual ~JournalReader();
+	
+	bool Open( std::string filename );
+	void Close( void );
+	
+	Packet *Next( void );
+	
+	static Packet *ReadRecord( FILE *file );
+};
@@ -0,0 +1,41 @@
+/*
+ *  PacketRegistry.cpp
+ */
+
+#include "PacketRegistry.h"
+
+#include <cstdio>
+
+
+// PacketRegistry and PacketHandler code is in the header because they are template classes.
+
+
+PacketStats::PacketStats( PacketType type )
+{
+	Type = type;
+	Count = 0;
+	Bytes = 0;
+	Malformed = 0;
+	DecodeSeconds = 0.;
+}
+
+
+PacketStats::~PacketStats()
+{
+}
+
+
+std::string PacketStats::Status( void ) const
+{
+	char type_str[ 5 ] = "";
+	Endian::WriteBig32( Type, type_str );
+	type_str[ 4 ] = '\0';
+	
+	char cstr[ 1024 ] = "";
+	#ifdef WIN32
+		snprintf( cstr, 1024, "%s: %I64u packets, %I64u bytes, %I64u malformed, %.3f ms decoding", type_str, (unsigned long long) Count, (unsigned long long) Bytes, (unsigned long long) Malformed, DecodeSeconds * 1000. );
+	#else
+		snprintf( cstr, 1024, "%s: %llu packets, %llu bytes, %llu malformed, %.3f ms decoding", type_str, (unsigned long long) Count, (unsigned long long) Bytes, (unsigned long long) Malformed, DecodeSeconds * 1000. );
+	#endif
+	return std::string(cstr);
+}
@@ -0,0 +1,303 @@
+/*
+ *  PacketRegistry.h
+ */
+
+#pragma once
+class PacketStats;
+template <class Owner, class Context> class PacketHandlerBase;
+template <class Owner, class Context, class Msg> class PacketHandler;
+template <class Owner, class Context> class PacketRegistry;
+
+#include "PlatformSpecific.h"
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Packet.h"
+#include "PacketSchema.h"
+#include "Clock.h"
+
+
+class PacketStats
+{
+public:
+	PacketType Type;
+	uint64_t Count;
+	uint64_t Bytes;
+	uint64_t Malformed;
+	double DecodeSeconds;
+	
+	PacketStats( PacketType type = PACKET_DEFAULT_TYPE );
+	virtual ~PacketStats();
+	
+	std::string Status( void ) const;
+};
+
+
+template <class Owner, class Context>
+class PacketHandlerBase
+{
+public:
+	PacketStats Stats;
+	bool OffThread;
+	
+	PacketHandlerBase( PacketType type ) : Stats( type ) { OffThread = false; }
+	virtual ~PacketHandlerBase() {}
+	
+	virtual bool Handle( Owner *owner, Packet *packet, Context context ) = 0;
+	virtual void Predecode( Owner *owner, Packet *packet ) = 0;
+};
+
+
+template <class Owner, class Context, class Msg>
+class PacketHandler : public PacketHandlerBase<Owner,Context>
+{
+public:
+	typedef bool (Owner::*Method)( Msg *msg, Packet *packet, Context context );
+	typedef bool (Owner::*MethodNoContext)( Msg *msg, Packet *packet );
+	typedef bool (Owner::*DecodeMethod)( Msg *msg, Packet *packet );
+	
+	Method Func;
+	MethodNoContext FuncNoContext;
+	DecodeMethod DecodeFunc;
+	
+	
+	PacketHandler( Method func, DecodeMethod decode_func = NULL ) : PacketHandlerBase<Owner,Context>( Msg::TYPE )
+	{
+		Func = func;
+		FuncNoContext = NULL;
+		DecodeFunc = decode_func;
+	}
+	
+	PacketHandler( MethodNoContext func, DecodeMethod decode_func = NULL ) : PacketHandlerBase<Owner,Context>( Msg::TYPE )
+	{
+		Func = NULL;
+		FuncNoContext = func;
+		DecodeFunc = decode_func;
+	}
+	
+	bool Handle( Owner *owner, Packet *packet, Context context )
+	{
+		Msg local_msg;
+		Msg *msg = &local_msg;
+		bool failed = false;
+		
+		this->Stats.Count ++;
+		this->Stats.Bytes += packet->Size();
+		
+		if( packet->Decoded && (packet->Decoded->Decoder == this) )
+		{
+			// A network thread already did the work, so pick up where it left off.
+			DecodedMessage<Msg> *decoded = (DecodedMessage<Msg>*) packet->Decoded;
+			msg = &(decoded->Message);
+			failed = decoded->Failed;
+			packet->Offset = decoded->Offset;
+			this->Stats.DecodeSeconds += decoded->DecodeSeconds;
+		}
+		else
+		{
+			// Decode the schema fields with bounds checking before the handler sees anything.
+			Clock decode_clock;
+			PacketDecoder decoder( packet );
+			msg->Fields( decoder );
+			failed = decoder.Failed;
+			this->Stats.DecodeSeconds += decode_clock.ElapsedSeconds();
+		}
+		
+		if( failed )
+		{
+			this->Stats.Malformed ++;
+			return true;
+		}
+		
+		// Anything the handler reads beyond the schema (such as per-object data) throws instead of returning garbage.
+		bool throw_exceptions = packet->ThrowExceptions;
+		packet->ThrowExceptions = true;
+		
+		bool handled = true;
+		try
+		{
+			handled = Func ? (owner->*Func)( msg, packet, context ) : (owner->*FuncNoContext)( msg, packet );
+		}
+		catch( PacketSmall &e )
+		{
+			this->Stats.Malformed ++;
+		}
+		
+		packet->ThrowExceptions = throw_exceptions;
+		return handled;
+	}
+	
+	void Predecode( Owner *owner, Packet *packet )
+	{
+		// This runs on a network thread, so it must not touch Stats or anything else the main thread uses.
+		Clock decode_clock;
+		DecodedMessage<Msg> *decoded = new DecodedMessage<Msg>();
+		decoded->Decoder = this;
+		
+		packet->Rewind();
+		PacketDecoder decoder( packet );
+		decoded->Message.Fields( decoder );
+		decoded->Failed = decoder.Failed;
+		
+		if( DecodeFunc && ! decoded->Failed )
+		{
+			bool throw_exceptions = packet->ThrowExceptions;
+			packet->ThrowExceptions = true;
+			try
+			{
+				if( ! (owner->*DecodeFunc)( &(decoded->Message), packet ) )
+					decoded->Failed = true;
+			}
+			catch( PacketSmall &e )
+			{
+				decoded->Failed = true;
+			}
+			packet->ThrowExceptions = throw_exceptions;
+		}
+		
+		decoded->Offset = packet->Offset;
+		decoded->DecodeSeconds = decode_clock.ElapsedSeconds();
+		packet->Rewind();
+		
+		delete packet->Decoded;
+		packet->Decoded = decoded;
+	}
+};
+
+
+template <class Owner, class Context = void*>
+class PacketRegistry
+{
+public:
+	PacketRegistry( void )
+	{
+		Count = 0;
+		Table.resize( 32, NULL );
+	}
+	
+	~PacketRegistry()
+	{
+		for( size_t i = 0; i < Table.size(); i ++ )
+			delete Table[ i ];
+		Table.clear();
+	}
+	
+	template <class Msg>
+	void Register( bool (Owner::*func)( Msg *msg, Packet *packet, Context context ) )
+	{
+		Insert( new PacketHandler<Owner,Context,Msg>( func ) );
+	}
+	
+	template <class Msg>
+	void Register( bool (Owner::*func)( Msg *msg, Packet *packet ) )
+	{
+		Insert( new PacketHandler<Owner,Context,Msg>( func ) );
+	}
+	
+	// Packets registered this way are decoded by Predecode on the network thread that received them.
+	// The optional decode method reads anything beyond the schema fields, and must be safe to call from that thread.
+	template <class Msg>
+	void RegisterOffThread( bool (Owner::*func)( Msg *msg, Packet *packet, Context context ), bool (Owner::*decode_func)( Msg *msg, Packet *packet ) = NULL )
+	{
+		PacketHandler<Owner,Context,Msg> *handler = new PacketHandler<Owner,Context,Msg>( func, decode_func );
+		handler->OffThread = true;
+		Insert( handler );
+	}
+	
+	template <class Msg>
+	void RegisterOffThread( bool (Owner::*func)( Msg *msg, Packet *packet ), bool (Owner::*decode_func)( Msg *msg, Packet *packet ) = NULL )
+	{
+		PacketHandler<Owner,Context,Msg> *handler = new PacketHandler<Owner,Context,Msg>( func, decode_func );
+		handler->OffThread = true;
+		Insert( handler );
+	}
+	
+	PacketHandlerBase<Owner,Context> *Find( PacketType type ) const
+	{
+		size_t mask = Table.size() - 1;
+		for( size_t i = Hash( type ) & mask; Table[ i ]; i = (i + 1) & mask )
+		{
+			if( Table[ i ]->Stats.Type == type )
+				return Table[ i ];
+		}
+		return NULL;
+	}
+	
+	bool Dispatch( Owner *owner, Packet *packet, Context context = Context() )
+	{
+		PacketHandlerBase<Owner,Context> *handler = Find( packet->Type() );
+		if( ! handler )
+			return false;
+		
+		packet->Rewind();
+		return handler->Handle( owner, packet, context );
+	}
+	
+	void Predecode( Owner *owner, Packet *packet ) const
+	{
+		// Handlers must all be registered before network threads start calling this.
+		PacketHandlerBase<Owner,Context> *handler = Find( packet->Type() );
+		if( handler && handler->OffThread )
+			handler->Predecode( owner, packet );
+	}
+	
+	std::string Status( void ) const
+	{
+		std::string status;
+		for( size_t i = 0; i < Table.size(); i ++ )
+		{
+			if( Table[ i ] && Table[ i ]->Stats.Count )
+			{
+				if( status.size() )
+					status += "\n";
+				status += Table[ i ]->Stats.Status();
+			}
+		}
+		return status;
+	}
+
+private:
+	std::vector< PacketHandlerBase<Owner,Context>* > Table;
+	size_t Count;
+	
+	static size_t Hash( PacketType type )
+	{
+		// Packet types are four-character codes, so mix the bytes together before masking.
+		return (type * 2654435761u) >> 16;
+	}
+	
+	void Insert( PacketHandlerBase<Owner,Context> *handler )
+	{
+		// Keep the open-addressed table at most half full so lookups stay short.
+		if( (Count + 1) * 2 > Table.size() )
+		{
+			std::vector< PacketHandlerBase<Owner,Context>* > old_table = Table;
+			Table.clear();
+			Table.resize( old_table.size() * 2, NULL );
+			Count = 0;
+			for( size_t i = 0; i < old_table.size(); i ++ )
+			{
+				if( old_table[ i ] )
+					Insert( old_table[ i ] );
+			}
+		}
+		
+		size_t mask = Table.size() - 1;
+		size_t i = Hash( handler->Stats.Type ) & mask;
+		for( ; Table[ i ]; i = (i + 1) & mask )
+		{
+			// Registering the same packet type again replaces the old handler.
+			if( Table[ i ]->Stats.Type == handler->Stats.Type )
+			{
+				delete Table[ i ];
+				Table[ i ] = handler;
+				return;
+			}
+		}
+		
+		Table[ i ] = handler;
+		Count ++;
+	}
+};
@@ -0,0 +1,248 @@
+/*
+ *  PacketSchema.cpp
+ */
+
+#include "PacketSchema.h"
+
+#include <cstddef>
+#include <cstring>
+
+
+// Template code for lists and whole messages is in the header.
+
+
+PacketEncoder::PacketEncoder( Packet *packet )
+{
+	Out = packet;
+	Failed = false;
+}
+
+
+PacketEncoder::~PacketEncoder()
+{
+}
+
+
+void PacketEncoder::Optional( void )
+{
+	// Optional fields are always written when encoding.
+}
+
+
+void PacketEncoder::operator()( int8_t &value )
+{
+	Out->AddChar( value );
+}
+
+
+void PacketEncoder::operator()( uint8_t &value )
+{
+	Out->AddUChar( value );
+}
+
+
+void PacketEncoder::operator()( int16_t &value )
+{
+	Out->AddShort( value );
+}
+
+
+void PacketEncoder::operator()( uint16_t &value )
+{
+	Out->AddUShort( value );
+}
+
+
+void PacketEncoder::operator()( int32_t &value )
+{
+	Out->AddInt( value );
+}
+
+
+void PacketEncoder::operator()( uint32_t &value )
+{
+	Out->AddUInt( value );
+}
+
+
+void PacketEncoder::operator()( int64_t &value )
+{
+	Out->AddInt64( value );
+}
+
+
+void PacketEncoder::operator()( uint64_t &value )
+{
+	Out->AddUInt64( value );
+}
+
+
+void PacketEncoder::operator()( float &value )
+{
+	Out->AddFloat( value );
+}
+
+
+void PacketEncoder::operator()( double &value )
+{
+	Out->AddDouble( value );
+}
+
+
+void PacketEncoder::operator()( std::string &value )
+{
+	Out->AddString( value );
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+PacketDecoded::PacketDecoded( PacketType type )
+{
+	Type = type;
+	Decoder = NULL;
+	Offset = PACKET_HEADER_SIZE;
+	Failed = false;
+	DecodeSeconds = 0.;
+}
+
+
+PacketDecoded::~PacketDecoded()
+{
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+PacketDecoder::PacketDecoder( Packet *packet )
+{
+	In = packet;
+	Failed = false;
+	InOptional = false;
+	Ended = false;
+}
+
+
+PacketDecoder::~PacketDecoder()
+{
+}
+
+
+void PacketDecoder::Optional( void )
+{
+	InOptional = true;
+}
+
+
+PacketSize PacketDecoder::Available( void ) const
+{
+	PacketSize size = In->Size();
+	return (In->Offset < size) ? (size - In->Offset) : 0;
+}
+
+
+bool PacketDecoder::Need( PacketSize bytes )
+{
+	if( Failed || Ended )
+		return false;
+	
+	PacketSize available = Available();
+	if( available >= bytes )
+		return true;
+	
+	// Trailing optional fields may be left off entirely; anything else means the packet was truncated.
+	if( InOptional && ! available )
+		Ended = true;
+	else
+		Failed = true;
+	
+	return false;
+}
+
+
+void PacketDecoder::operator()( int8_t &value )
+{
+	if( Need(1) )
+		value = In->NextChar();
+}
+
+
+void PacketDecoder::operator()( uint8_t &value )
+{
+	if( Need(1) )
+		value = In->NextUChar();
+}
+
+
+void PacketDecoder::operator()( int16_t &value )
+{
+	if( Need(2) )
+		value = In->NextShort();
+}
+
+
+void PacketDecoder::operator()( uint16_t &value )
+{
+	if( Need(2) )
+		value = In->NextUShort();
+}
+
+
+void PacketDecoder::operator()( int32_t &value )
+{
+	if( Need(4) )
+		value = In->NextInt();
+}
+
+
+void PacketDecoder::operator()( uint32_t &value )
+{
+	if( Need(4) )
+		value = In->NextUInt();
+}
+
+
+void PacketDecoder::operator()( int64_t &value )
+{
+	if( Need(8) )
+		value = In->NextInt64();
+}
+
+
+void PacketDecoder::operator()( uint64_t &value )
+{
+	if( Need(8) )
+		value = In->NextUInt64();
+}
+
+
+void PacketDecoder::operator()( float &value )
+{
+	if( Need(4) )
+		value = In->NextFloat();
+}
+
+
+void PacketDecoder::operator()( double &value )
+{
+	if( Need(8) )
+		value = In->NextDouble();
+}
+
+
+void PacketDecoder::operator()( std::string &value )
+{
+	if( ! Need(1) )
+		return;
+	
+	// Make sure the string is terminated before the end of the packet.
+	if( ! memchr( In->Data + In->Offset, '\0', Available() ) )
+	{
+		Failed = true;
+		return;
+	}
+	
+	value = In->NextString();
+}
@@ -0,0 +1,187 @@
+/*
+ *  PacketSchema.h
+ */
+
+#pragma once
+class PacketEncoder;
+class PacketDecoder;
+class PacketDecoded;
+template <typename C, typename T> class PacketList;
+template <class Msg> class DecodedMessage;
+
+#include "PlatformSpecific.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Packet.h"
+
+
+// Each message type describes its fields once in a Fields template method, for example:
+//   class PingMessage { public: uint8_t PingID; template <class V> void Fields( V &v ) { v( PingID ); } };
+// The same method drives PacketEncoder when sending and PacketDecoder when receiving.
+// Calling v.Optional() marks the remaining fields as allowed to be missing from the end of the packet.
+
+
+template <typename C, typename T>
+class PacketList : public std::vector<T>
+{
+	// C is the integer type used to send the element count.
+};
+
+
+class PacketEncoder
+{
+public:
+	Packet *Out;
+	bool Failed;
+	
+	PacketEncoder( Packet *packet );
+	virtual ~PacketEncoder();
+	
+	void Optional( void );
+	
+	void operator()( int8_t &value );
+	void operator()( uint8_t &value );
+	void operator()( int16_t &value );
+	void operator()( uint16_t &value );
+	void operator()( int32_t &value );
+	void operator()( uint32_t &value );
+	void operator()( int64_t &value );
+	void operator()( uint64_t &value );
+	void operator()( float &value );
+	void operator()( double &value );
+	void operator()( std::string &value );
+	
+	template <typename T>
+	void operator()( T &value )
+	{
+		value.Fields( *this );
+	}
+	
+	template <typename C, typename T>
+	void operator()( PacketList<C,T> &values )
+	{
+		// A list too long for its count type is cut short so the packet still parses, and the encode is marked failed.
+		size_t size = values.size();
+		C count = size;
+		if( (size_t) count != size )
+		{
+			Failed = true;
+			count = ~ (C) 0;
+		}
+		(*this)( count );
+		
+		typename PacketList<C,T>::iterator value_iter = values.begin();
+		for( C i = 0; i < count; i ++, value_iter ++ )
+			(*this)( *value_iter );
+	}
+};
+
+
+class PacketDecoder
+{
+public:
+	Packet *In;
+	bool Failed;
+	bool InOptional;
+	bool Ended;
+	
+	PacketDecoder( Packet *packet );
+	virtual ~PacketDecoder();
+	
+	void Optional( void );
+	PacketSize Available( void ) const;
+	
+	void operator()( int8_t &value );
+	void operator()( uint8_t &value );
+	void operator()( int16_t &value );
+	void operator()( uint16_t &value );
+	void operator()( int32_t &value );
+	void operator()( uint32_t &value );
+	void operator()( int64_t &value );
+	void operator()( uint64_t &value );
+	void operator()( float &value );
+	void operator()( double &value );
+	void operator()( std::string &value );
+	
+	template <typename T>
+	void operator()( T &value )
+	{
+		if( ! (Failed || Ended) )
+			value.Fields( *this );
+	}
+	
+	template <typename C, typename T>
+	void operator()( PacketList<C,T> &values )
+	{
+		C count = 0;
+		(*this)( count );
+		if( Failed || Ended )
+			return;
+		
+		// Every element takes at least one byte, so a larger count means the packet is corrupt.
+		if( count > Available() )
+		{
+			Failed = true;
+			return;
+		}
+		
+		values.resize( count );
+		for( typename PacketList<C,T>::iterator value_iter = values.begin(); value_iter != values.end(); value_iter ++ )
+		{
+			(*this)( *value_iter );
+			if( Failed )
+				return;
+		}
+	}
+
+private:
+	bool Need( PacketSize bytes );
+};
+
+
+// A message decoded ahead of time (usually on a network thread), stored in Packet::Decoded until it is handled.
+class PacketDecoded
+{
+public:
+	PacketType Type;
+	const void *Decoder;
+	PacketSize Offset;
+	bool Failed;
+	double DecodeSeconds;
+	
+	PacketDecoded( PacketType type );
+	virtual ~PacketDecoded();
+};
+
+
+template <class Msg>
+class DecodedMessage : public PacketDecoded
+{
+public:
+	Msg Message;
+	
+	DecodedMessage( void ) : PacketDecoded( Msg::TYPE ) {}
+	virtual ~DecodedMessage() {}
+};
+
+
+template <class Msg>
+bool EncodePacket( Packet *packet, Msg *msg )
+{
+	packet->Clear( Msg::TYPE );
+	PacketEncoder encoder( packet );
+	msg->Fields( encoder );
+	return ! encoder.Failed;
+}
+
+
+template <class Msg>
+bool DecodePacket( Packet *packet, Msg *msg )
+{
+	packet->Rewind();
+	PacketDecoder decoder( packet );
+	msg->Fields( decoder );
+	return ! decoder.Failed;
+}
@@ -0,0 +1,355 @@
+/*
+ *  RelayClient.cpp
+ */
+
+#include "RelayClient.h"
+
+#include "RaptorDefs.h"
+#include "RaptorServer.h"
+#include "PacketBuffer.h"
+
+
+RelayClient::RelayClient( RaptorServer *server )
+{
+	Server = server;
+	Connected = false;
+	LoggedIn = false;
+	Thread = NULL;
+	Socket = NULL;
+	BytesSent = 0;
+	BytesReceived = 0;
+	Port = 7000;
+	
+	ReconnectTime = 0;
+	ReconnectAttempts = 0;
+	
+	Handlers.Register( &RelayClient::ProcessPing );
+	Handlers.Register( &RelayClient::ProcessPadding );
+	Handlers.Register( &RelayClient::ProcessLoginAccept );
+	Handlers.Register( &RelayClient::ProcessDisconnect );
+	Handlers.Register( &RelayClient::ProcessReconnect );
+}
+
+
+RelayClient::~RelayClient()
+{
+	Connected = false;
+	
+	// Sleep until the other thread has finished (max 4 sec).
+	Clock wait_for_thread;
+	while( Thread && (wait_for_thread.ElapsedSeconds() < 4.) )
+		SDL_Delay( 1 );
+	
+	// If the thread didn't finish, kill it.
+	if( Thread )
+	{
+		SDL_KillThread( Thread );
+		Thread = NULL;
+	}
+	
+	Cleanup();
+}
+
+
+int RelayClient::Connect( std::string host, int port, std::string name, std::string password )
+{
+	// This is called from the server thread after NetServer::Initialize has started SDL_net.
+	Host = host;
+	Port = (port > 0) ? port : 7000;
+	Name = name;
+	Password = password;
+	
+	if( Connected )
+		DisconnectNice();
+	
+	// Wait for the old listener thread before reusing the socket.
+	Clock wait_for_thread;
+	while( Thread && (wait_for_thread.ElapsedSeconds() < 2.) )
+		SDL_Delay( 1 );
+	Cleanup();
+	
+	char cstr[ 1024 ] = "";
+	snprintf( cstr, 1024, "Relaying from %s:%i...", Host.c_str(), Port );
+	Server->ConsolePrint( cstr );
+	
+	IPaddress ip;
+	if( SDLNet_ResolveHost( &ip, Host.c_str(), Port ) < 0 )
+	{
+		Server->ConsolePrint( "Failed to resolve upstream server hostname.", TextConsole::MSG_ERROR );
+		return -1;
+	}
+	
+	if( !( Socket = SDLNet_TCP_Open(&ip) ) )
+	{
+		Server->ConsolePrint( "Failed to open socket to upstream server.", TextConsole::MSG_ERROR );
+		return -1;
+	}
+	
+	BytesSent = 0;
+	BytesReceived = 0;
+	LoggedIn = false;
+	
+	// Start the listener thread.
+	Connected = true;
+	if( !( Thread = SDL_CreateThread( RelayClientThread, this ) ) )
+	{
+		fprintf( stderr, "RelayClient::Connect: SDL_CreateThread: %s\n", SDLNet_GetError() );
+		Connected = false;
+		SDLNet_TCP_Close( Socket );
+		Socket = NULL;
+		return -1;
+	}
+	
+	// Log in the same way a game client would.
+	LoginRequestMessage login;
+	login.Game = Server->Game;
+	login.Version = Server->Version;
+	login.Name = Name;
+	login.Password = Password;
+	Packet packet;
+	EncodePacket( &packet, &login );
+	Send( &packet );
+	
+	ReconnectTime = 0;
+	ReconnectAttempts = 0;
+	
+	return 0;
+}
+
+
+int RelayClient::Reconnect( void )
+{
+	if( ReconnectAttempts )
+	{
+		ReconnectClock.Reset();
+		ReconnectAttempts --;
+		return Connect( Host, Port, Name, Password );
+	}
+	
+	return -1;
+}
+
+
+bool RelayClient::ReconnectReady( void )
+{
+	return ReconnectAttempts && (ReconnectClock.ElapsedSeconds() >= ReconnectTime);
+}
+
+
+void RelayClient::DisconnectNice( const char *message )
+{
+	if( Connected )
+	{
+		DisconnectMessage disconnect;
+		if( message )
+			disconnect.Reason = message;
+		
+		Packet packet;
+		EncodePacket( &packet, &disconnect );
+		Send( &packet );
+	}
+	
+	Disconnect();
+}
+
+
+void RelayClient::Disconnect( void )
+{
+	// This may be called from the listener thread, so the server thread notices it next frame.
+	Connected = false;
+	LoggedIn = false;
+	ReconnectClock.Reset();
+}
+
+
+void RelayClient::Cleanup( void )
+{
+	if( Connected || Thread )
+		return;
+	
+	if( Socket )
+	{
+		SDLNet_TCP_Close( Socket );
+		Socket = NULL;
+	}
+	
+	if( ! Lock.Lock() )
+		fprintf( stderr, "RelayClient::Cleanup: Lock.Lock: %s\n", SDL_GetError() );
+	
+	while( ! InBuffer.empty() )
+	{
+		Packet *packet = InBuffer.front();
+		InBuffer.pop();
+		delete packet;
+	}
+	
+	if( ! Lock.Unlock() )
+		fprintf( stderr, "RelayClient::Cleanup: Lock.Unlock: %s\n", SDL_GetError() );
+}
+
+
+void RelayClient::ProcessIn( void )
+{
+	if( ! Lock.Lock() )
+		fprintf( stderr, "RelayClient::ProcessIn: Lock.Lock: %s\n", SDL_GetError() );
+	
+	// Take everything that has arrived so far, so the listener thread isn't blocked while we relay it.
+	std::queue< Packet*, std::list<Packet*> > packets = InBuffer;
+	InBuffer = std::queue< Packet*, std::list<Packet*> >();
+	
+	if( ! Lock.Unlock() )
+		fprintf( stderr, "RelayClient::ProcessIn: Lock.Unlock: %s\n", SDL_GetError() );
+	
+	while( ! packets.empty() )
+	{
+		Packet *packet = packets.front();
+		packets.pop();
+		ProcessPacket( packet );
+		delete packet;
+	}
+}
+
+
+bool RelayClient::ProcessPacket( Packet *packet )
+{
+	packet->Rewind();
+	
+	// Connection housekeeping is handled here; everything else is mirrored and passed downstream.
+	if( Handlers.Dispatch( this, packet ) )
+		return true;
+	
+	return Server->ProcessRelayPacket( packet );
+}
+
+
+bool RelayClient::ProcessPing( PingMessage *msg, Packet *packet )
+{
+	PongMessage pong_msg;
+	pong_msg.PingID = msg->PingID;
+	Packet pong;
+	EncodePacket( &pong, &pong_msg );
+	Send( &pong );
+	return true;
+}
+
+
+bool RelayClient::ProcessPadding( PaddingMessage *msg, Packet *packet )
+{
+	// Always ignore padding packets.
+	packet->Offset = packet->Size();
+	return true;
+}
+
+
+bool RelayClient::ProcessLoginAccept( LoginAcceptMessage *msg, Packet *packet )
+{
+	LoggedIn = true;
+	
+	char cstr[ 1024 ] = "";
+	snprintf( cstr, 1024, "Relaying %s:%i.", Host.c_str(), Port );
+	Server->ConsolePrint( cstr );
+	return true;
+}
+
+
+bool RelayClient::ProcessDisconnect( DisconnectMessage *msg, Packet *packet )
+{
+	Disconnect();
+	return true;
+}
+
+
+bool RelayClient::ProcessReconnect( ReconnectMessage *msg, Packet *packet )
+{
+	Disconnect();
+	
+	ReconnectTime = msg->Seconds;
+	ReconnectAttempts = 3;
+	ReconnectClock.Reset();
+	
+	// Spectators should come back once we have had a chance to reconnect upstream.
+	Server->Net.SendAllReconnect( msg->Seconds + 2 );
+	return true;
+}
+
+
+int RelayClient::Send( Packet *packet )
+{
+	if( ! Connected )
+		return -1;
+	
+	if( SDLNet_TCP_Send( Socket, (void *) packet->Data, packet->Size() ) < (int) packet->Size() )
+	{
+		Disconnect();
+		return -1;
+	}
+	else
+		BytesSent += packet->Size();
+	
+	return 0;
+}
+
+
+std::string RelayClient::Status( void )
+{
+	char cstr[ 1024 ] = "";
+	#ifdef WIN32
+		snprintf( cstr, 1024, "Relaying from: %s:%i (%s)\nBytes sent upstream: %I64u\nBytes received from upstream: %I64u", Host.c_str(), Port, LoggedIn ? "connected" : "not connected", (unsigned long long) BytesSent, (unsigned long long) BytesReceived );
+	#else
+		snprintf( cstr, 1024, "Relaying from: %s:%i (%s)\nBytes sent upstream: %llu\nBytes received from upstream: %llu", Host.c_str(), Port, LoggedIn ? "connected" : "not connected", (unsigned long long) BytesSent, (unsigned long long) BytesReceived );
+	#endif
+	return std::string(cstr);
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+int RelayClient::RelayClientThread( void *client )
+{
+	RelayClient *relay_client = (RelayClient *) client;
+	char data[ PACKET_BUFFER_SIZE ] = "";
+	PacketBuffer Buffer;
+	
+	while( relay_client->Connected )
+	{
+		// Check for packets.
+		int size = 0;
+		if( ( size = SDLNet_TCP_Recv( relay_client->Socket, data, PACKET_BUFFER_SIZE ) ) > 0 )
+		{
+			if( ! relay_client->Connected )
+				break;
+			
+			relay_client->BytesReceived += size;
+			Buffer.AddData( data, size );
+			
+			while( Packet *packet = Buffer.Pop() )
+			{
+				// Decode what we can here, so the server thread only has to apply it to the mirror.
+				relay_client->Server->RelayHandlers.Predecode( relay_client->Server, packet );
+				
+				if( ! relay_client->Lock.Lock() )
+					fprintf( stderr, "RelayClientThread: relay_client->Lock.Lock: %s\n", SDL_GetError() );
+				
+				relay_client->InBuffer.push( packet );
+				
+				if( ! relay_client->Lock.Unlock() )
+					fprintf( stderr, "RelayClientThread: relay_client->Lock.Unlock: %s\n", SDL_GetError() );
+			}
+		}
+		else
+		{
+			// If 0 (disconnect) or -1 (error), stop listening.
+			relay_client->Disconnect();
+			break;
+		}
+		
+		// Let the thread rest a bit.
+		SDL_Delay( 1 );
+	}
+	
+	// Set the thread pointer to NULL so the socket can be cleaned up.
+	relay_client->Thread = NULL;
+	
+	return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ *  RelayClient.h
+ */
+
+#pragma once
+class RelayClient;
+class RaptorServer;
+
+#include "PlatformSpecific.h"
+#include <cstddef>
+#include <stdint.h>
+#include <queue>
+#include <list>
+#include <string>
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+
+#ifdef __APPLE__
+	#include <SDL_net/SDL_net.h>
+#else
+	#include <SDL/SDL_net.h>
+#endif
+
+#include "Packet.h"
+#include "PacketRegistry.h"
+#include "Messages.h"
+#include "Clock.h"
+#include "Mutex.h"
+
+
+// Upstream connection for a RaptorServer running as a spectator relay.
+// The relay logs in like any other client; everything it receives is handed to RaptorServer::ProcessRelayPacket.
+
+
+class RelayClient
+{
+public:
+	RaptorServer *Server;
+	volatile bool Connected;
+	bool LoggedIn;
+	SDL_Thread *Thread;
+	Mutex Lock;
+	TCPsocket Socket;
+	std::queue< Packet*, std::list<Packet*> > InBuffer;
+	uint64_t BytesSent;
+	uint64_t BytesReceived;
+	
+	std::string Host;
+	int Port;
+	std::string Name, Password;
+	
+	int ReconnectTime;
+	int ReconnectAttempts;
+	Clock ReconnectClock;
+	
+	PacketRegistry<RelayClient> Handlers;
+	
+	
+	RelayClient( RaptorServer *server = NULL );
+	virtual ~RelayClient();
+	
+	int Connect( std::string host, int port, std::string name, std::string password );
+	int Reconnect( void );
+	bool ReconnectReady( void );
+	void DisconnectNice( const char *message = NULL );
+	void Disconnect( void );
+	void Cleanup( void );
+	
+	void ProcessIn( void );
+	bool ProcessPacket( Packet *packet );
+	bool ProcessPing( PingMessage *msg, Packet *packet );
+	bool ProcessPadding( PaddingMessage *msg, Packet *packet );
+	bool ProcessLoginAccept( LoginAcceptMessage *msg, Packet *packet );
+	bool ProcessDisconnect( DisconnectMessage *msg, Packet *packet );
+	bool ProcessReconnect( ReconnectMessage *msg, Packet *packet );
+	
+	int Send( Packet *packet );
+	
+	std::string Status( void );
+	
+	static int RelayClientThread( void *client );
+};
@@ -0,0 +1,173 @@
+/*
+ *  ShardLink.cpp
+ */
+
+#include "ShardLink.h"
+
+#include "RaptorDefs.h"
+#include "RaptorServer.h"
+#include "Messages.h"
+
+
+ShardLink::ShardLink( RaptorServer *server, int index )
+{
+	Server = server;
+	Index = index;
+	Connected = false;
+	Thread = NULL;
+	Socket = NULL;
+	BytesSent = 0;
+	Port = 7000;
+}
+
+
+ShardLink::~ShardLink()
+{
+	Connected = false;
+	
+	// Sleep until the other thread has finished (max 2 sec).
+	Clock wait_for_thread;
+	while( Thread && (wait_for_thread.ElapsedSeconds() < 2.) )
+		SDL_Delay( 1 );
+	
+	// If the thread didn't finish, kill it.
+	if( Thread )
+	{
+		SDL_KillThread( Thread );
+		Thread = NULL;
+	}
+	
+	Cleanup();
+}
+
+
+int ShardLink::Connect( std::string host, int port )
+{
+	// This is called from the server thread after NetServer::Initialize has started SDL_net.
+	Host = host;
+	Port = port;
+	RetryClock.Reset();
+	
+	Cleanup();
+	if( Connected || Thread || Socket )
+		return -1;
+	
+	IPaddress ip;
+	if( SDLNet_ResolveHost( &ip, Host.c_str(), Port ) < 0 )
+		return -1;
+	
+	// Neighbours start at different times, so failing here is normal; the server thread tries again later.
+	if( !( Socket = SDLNet_TCP_Open(&ip) ) )
+		return -1;
+	
+	BytesSent = 0;
+	
+	// Start the listener thread, which only watches for the connection closing.
+	Connected = true;
+	if( !( Thread = SDL_CreateThread( ShardLinkThread, this ) ) )
+	{
+		fprintf( stderr, "ShardLink::Connect: SDL_CreateThread: %s\n", SDLNet_GetError() );
+		Connected = false;
+		SDLNet_TCP_Close( Socket );
+		Socket = NULL;
+		return -1;
+	}
+	
+	// Identify ourselves, so the neighbour treats this connection as a shard rather than a player.
+	ShardHelloMessage hello;
+	hello.Game = Server->Game;
+	hello.Version = Server->Version;
+	hello.ShardIndex = Server->ShardIndex;
+	Packet packet;
+	EncodePacket( &packet, &hello );
+	Send( &packet );
+	
+	char cstr[ 1024 ] = "";
+	snprintf( cstr, 1024, "Linked to shard %i at %s:%i.", Index, Host.c_str(), Port );
+	Server->ConsolePrint( cstr );
+	
+	return 0;
+}
+
+
+void ShardLink::Disconnect( void )
+{
+	// This may be called from the listener thread, so the server thread notices it next frame.
+	Connected = false;
+	RetryClock.Reset();
+}
+
+
+void ShardLink::Cleanup( void )
+{
+	if( Connected || Thread )
+		return;
+	
+	if( Socket )
+	{
+		SDLNet_TCP_Close( Socket );
+		Socket = NULL;
+	}
+}
+
+
+bool ShardLink::RetryReady( void )
+{
+	return (! Connected) && (! Thread) && (RetryClock.ElapsedSeconds() >= 2.);
+}
+
+
+int ShardLink::Send( Packet *packet )
+{
+	if( ! Connected )
+		return -1;
+	
+	if( SDLNet_TCP_Send( Socket, (void *) packet->Data, packet->Size() ) < (int) packet->Size() )
+	{
+		Disconnect();
+		return -1;
+	}
+	else
+		BytesSent += packet->Size();
+	
+	return 0;
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+int ShardLink::ShardLinkThread( void *link )
+{
+	ShardLink *shard_link = (ShardLink *) link;
+	char data[ 4096 ] = "";
+	
+	// Wait on a socket set, so we notice Disconnect even when the neighbour has nothing to say.
+	SDLNet_SocketSet socket_set = SDLNet_AllocSocketSet( 1 );
+	if( socket_set )
+		SDLNet_TCP_AddSocket( socket_set, shard_link->Socket );
+	else
+		shard_link->Disconnect();
+	
+	while( shard_link->Connected )
+	{
+		if( SDLNet_CheckSockets( socket_set, 100 ) <= 0 )
+			continue;
+		
+		// The neighbour sends us things like broadcasts, which we don't need.
+		if( SDLNet_TCP_Recv( shard_link->Socket, data, sizeof(data) ) <= 0 )
+		{
+			// If 0 (disconnect) or -1 (error), stop listening.
+			shard_link->Disconnect();
+			break;
+		}
+	}
+	
+	if( socket_set )
+		SDLNet_FreeSocketSet( socket_set );
+	
+	// Set the thread pointer to NULL so the socket can be cleaned up.
+	shard_link->Thread = NULL;
+	
+	return 0;
+}
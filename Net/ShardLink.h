@@ -0,0 +1,56 @@
+/*
+ *  ShardLink.h
+ */
+
+#pragma once
+class ShardLink;
+class RaptorServer;
+
+#include "PlatformSpecific.h"
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+
+#ifdef __APPLE__
+	#include <SDL_net/SDL_net.h>
+#else
+	#include <SDL/SDL_net.h>
+#endif
+
+#include "Packet.h"
+#include "Clock.h"
+
+
+// Outbound connection from one shard to a neighbour, used to send it handoffs and ghosts.
+// Each pair of shards has a link in both directions, so nothing needs to come back on this one.
+
+
+class ShardLink
+{
+public:
+	RaptorServer *Server;
+	int Index;
+	volatile bool Connected;
+	SDL_Thread *Thread;
+	TCPsocket Socket;
+	uint64_t BytesSent;
+	
+	std::string Host;
+	int Port;
+	Clock RetryClock;
+	
+	
+	ShardLink( RaptorServer *server = NULL, int index = 0 );
+	virtual ~ShardLink();
+	
+	int Connect( std::string host, int port );
+	void Disconnect( void );
+	void Cleanup( void );
+	bool RetryReady( void );
+	
+	int Send( Packet *packet );
+	
+	static int ShardLinkThread( void *link );
+};
@@ -0,0 +1,129 @@
+/*
+ *  ShardMap.cpp
+ */
+
+#include "ShardMap.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cfloat>
+#include "Str.h"
+
+
+ShardInfo::ShardInfo( std::string host, int port )
+{
+	Host = host;
+	Port = port;
+	MinX = -DBL_MAX;
+	MaxX = DBL_MAX;
+}
+
+
+// -----------------------------------------------------------------------------
+
+
+ShardMap::ShardMap( void )
+{
+	GhostDistance = 500.;
+}
+
+
+ShardMap::~ShardMap()
+{
+}
+
+
+bool ShardMap::Configure( std::string hosts, std::string bounds )
+{
+	// Hosts are "host:port" separated by spaces or commas, and there should be one fewer X boundary than hosts.
+	Clear();
+	
+	std::vector<std::string> host_list = Str::SplitToVector( hosts, " ," );
+	std::vector<std::string> bound_list = Str::SplitToVector( bounds, " ," );
+	if( (host_list.size() < 2) || (host_list.size() > MAX_SHARDS) || (bound_list.size() != host_list.size() - 1) )
+		return false;
+	
+	for( size_t i = 0; i < host_list.size(); i ++ )
+	{
+		ShardInfo shard;
+		shard.Host = host_list[ i ];
+		
+		size_t colon = host_list[ i ].rfind( ':' );
+		if( colon != std::string::npos )
+		{
+			shard.Host = host_list[ i ].substr( 0, colon );
+			shard.Port = atoi( host_list[ i ].substr( colon + 1 ).c_str() );
+			if( shard.Port <= 0 )
+				shard.Port = 7000;
+		}
+		
+		if( i > 0 )
+			shard.MinX = Str::AsDouble( bound_list[ i - 1 ] );
+		if( i < bound_list.size() )
+			shard.MaxX = Str::AsDouble( bound_list[ i ] );
+		
+		if( shard.MaxX <= shard.MinX )
+		{
+			Clear();
+			return false;
+		}
+		
+		Shards.push_back( shard );
+	}
+	
+	return true;
+}
+
+
+void ShardMap::Clear( void )
+{
+	Shards.clear();
+}
+
+
+size_t ShardMap::size( void ) const
+{
+	return Shards.size();
+}
+
+
+int ShardMap::ShardAt( double x ) const
+{
+	// Boundaries belong to the shard above them, so every X has exactly one owner.
+	for( size_t i = 0; i < Shards.size(); i ++ )
+	{
+		if( x < Shards[ i ].MaxX )
+			return i;
+	}
+	
+	return Shards.size() ? (Shards.size() - 1) : -1;
+}
+
+
+std::vector<int> ShardMap::GhostShards( double x, int owner ) const
+{
+	// Other shards that should see a copy of an object at this X for collisions along their border.
+	std::vector<int> shards;
+	for( size_t i = 0; i < Shards.size(); i ++ )
+	{
+		if( (int) i == owner )
+			continue;
+		if( (x >= Shards[ i ].MinX - GhostDistance) && (x < Shards[ i ].MaxX + GhostDistance) )
+			shards.push_back( i );
+	}
+	return shards;
+}
+
+
+uint32_t ShardMap::FirstObjectID( int shard )
+{
+	// Each shard assigns IDs from its own range so objects keep their IDs when they move between shards.
+	// The ranges stay below 0x10000000, which clients use for their own non-networked objects.
+	return 1 + shard * 0x00400000;
+}
+
+
+uint16_t ShardMap::FirstPlayerID( int shard )
+{
+	return 1 + shard * 0x0400;
+}
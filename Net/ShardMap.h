@@ -0,0 +1,55 @@
+/*
+ *  ShardMap.h
+ */
+
+#pragma once
+class ShardInfo;
+class ShardMap;
+
+#include "PlatformSpecific.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+// Sharded servers split the world into slabs along the X axis, one per server process.
+// Every shard is configured with the same list, and owns the objects whose X falls within its slab.
+
+
+class ShardInfo
+{
+public:
+	std::string Host;
+	int Port;
+	double MinX, MaxX;
+	
+	ShardInfo( std::string host = "localhost", int port = 7000 );
+};
+
+
+class ShardMap
+{
+public:
+	enum
+	{
+		MAX_SHARDS = 64
+	};
+	
+	std::vector<ShardInfo> Shards;
+	double GhostDistance;
+	
+	
+	ShardMap( void );
+	virtual ~ShardMap();
+	
+	bool Configure( std::string hosts, std::string bounds );
+	void Clear( void );
+	size_t size( void ) const;
+	
+	int ShardAt( double x ) const;
+	std::vector<int> GhostShards( double x, int owner ) const;
+	
+	static uint32_t FirstObjectID( int shard );
+	static uint16_t FirstPlayerID( int shard );
+};
@@ -0,0 +1,238 @@
+/*
+ *  Math3DTest.cpp
+ */
+
+// Checks that every Math3D batch kernel gives bit-for-bit the same answers as its single version.
+// Build with the Makefile here, which makes both the SSE2 and scalar-fallback variants.
+
+#include "Math3D.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <stdint.h>
+
+
+namespace
+{
+	int Failures = 0;
+	int Checks = 0;
+	
+	
+	double RandomDouble( double scale )
+	{
+		return ((rand() / (double) RAND_MAX) * 2. - 1.) * scale;
+	}
+	
+	
+	bool SameBits( double a, double b )
+	{
+		// Any NaN matches any NaN; everything else must match exactly, including the sign of zero.
+		if( (a != a) && (b != b) )
+			return true;
+		return (memcmp( &a, &b, sizeof(double) ) == 0);
+	}
+	
+	
+	void Check( const char *kernel, size_t index, double batch, double single )
+	{
+		Checks ++;
+		if( SameBits( batch, single ) )
+			return;
+		
+		Failures ++;
+		if( Failures <= 20 )
+			fprintf( stderr, "%s[%lu]: batch %.17g != single %.17g\n", kernel, (unsigned long) index, batch, single );
+	}
+	
+	
+	struct Points
+	{
+		std::vector<double> X, Y, Z;
+		
+		void Add( double x, double y, double z )
+		{
+			X.push_back( x );
+			Y.push_back( y );
+			Z.push_back( z );
+		}
+		
+		Pos3D At( size_t i ) const { return Pos3D( X[ i ], Y[ i ], Z[ i ] ); }
+		Vec3D VecAt( size_t i ) const { return Vec3D( X[ i ], Y[ i ], Z[ i ] ); }
+		size_t Count( void ) const { return X.size(); }
+	};
+	
+	
+	void TestPointsToLineSeg( const Points &pts, const Pos3D &end1, const Pos3D &end2 )
+	{
+		std::vector<double> dists( pts.Count() + 1 );
+		Math3D::PointsToLineSegDist( &(pts.X[ 0 ]), &(pts.Y[ 0 ]), &(pts.Z[ 0 ]), pts.Count(), &end1, &end2, &(dists[ 0 ]) );
+		
+		for( size_t i = 0; i < pts.Count(); i ++ )
+		{
+			Pos3D pt = pts.At( i );
+			Check( "PointsToLineSegDist", i, dists[ i ], Math3D::PointToLineSegDist( &pt, &end1, &end2 ) );
+		}
+	}
+	
+	
+	void TestLineSegToLineSegs( const Pos3D &end1, const Pos3D &end2, const Points &ends1, const Points &ends2 )
+	{
+		std::vector<double> dists( ends1.Count() + 1 );
+		Math3D::LineSegToLineSegsDist( &end1, &end2, &(ends1.X[ 0 ]), &(ends1.Y[ 0 ]), &(ends1.Z[ 0 ]), &(ends2.X[ 0 ]), &(ends2.Y[ 0 ]), &(ends2.Z[ 0 ]), ends1.Count(), &(dists[ 0 ]) );
+		
+		for( size_t i = 0; i < ends1.Count(); i ++ )
+		{
+			Pos3D other1 = ends1.At( i ), other2 = ends2.At( i );
+			Check( "LineSegToLineSegsDist", i, dists[ i ], Math3D::LineSegToLineSegDist( &end1, &end2, &other1, &other2 ) );
+		}
+	}
+	
+	
+	void TestMovingPoints( const Pos3D &pt1, const Vec3D &motion1, double radius1, const Points &pts, const Points *motions, const std::vector<double> *radii, double dt )
+	{
+		size_t count = pts.Count();
+		const double *motion_x = motions ? &(motions->X[ 0 ]) : NULL;
+		const double *motion_y = motions ? &(motions->Y[ 0 ]) : NULL;
+		const double *motion_z = motions ? &(motions->Z[ 0 ]) : NULL;
+		
+		std::vector<double> dists( count + 1 );
+		Math3D::MinimumDistances( &pt1, &motion1, &(pts.X[ 0 ]), &(pts.Y[ 0 ]), &(pts.Z[ 0 ]), motion_x, motion_y, motion_z, count, &(dists[ 0 ]), dt );
+		
+		std::vector<uint8_t> hits( count + 1 );
+		size_t hit_count = Math3D::SweptSphereHits( &pt1, &motion1, radius1, &(pts.X[ 0 ]), &(pts.Y[ 0 ]), &(pts.Z[ 0 ]), radii ? &((*radii)[ 0 ]) : NULL, motion_x, motion_y, motion_z, count, &(hits[ 0 ]), dt );
+		
+		size_t expected_hits = 0;
+		for( size_t i = 0; i < count; i ++ )
+		{
+			Pos3D pt2 = pts.At( i );
+			Vec3D motion2 = motions ? motions->VecAt( i ) : Vec3D( 0., 0., 0. );
+			double single = Math3D::MinimumDistance( &pt1, &motion1, &pt2, &motion2, dt );
+			Check( "MinimumDistances", i, dists[ i ], single );
+			
+			uint8_t hit = (single <= radius1 + (radii ? (*radii)[ i ] : 0.));
+			Check( "SweptSphereHits", i, hits[ i ], hit );
+			expected_hits += hit;
+		}
+		
+		Check( "SweptSphereHits count", count, hit_count, expected_hits );
+	}
+	
+	
+	void RandomPoints( Points *pts, size_t count, double scale )
+	{
+		for( size_t i = 0; i < count; i ++ )
+			pts->Add( RandomDouble( scale ), RandomDouble( scale ), RandomDouble( scale ) );
+	}
+	
+	
+	void RandomTests( void )
+	{
+		// Odd counts leave a tail for the scalar loop after the paired SIMD lanes, and cross the 64-element hit blocks.
+		size_t counts[] = { 1, 2, 3, 7, 64, 65, 129, 1001 };
+		double scales[] = { 1e-9, 1., 1000., 1e12 };
+		
+		for( size_t c = 0; c < sizeof(counts) / sizeof(counts[ 0 ]); c ++ )
+		{
+			for( size_t s = 0; s < sizeof(scales) / sizeof(scales[ 0 ]); s ++ )
+			{
+				double scale = scales[ s ];
+				Points pts, ends, motions;
+				RandomPoints( &pts, counts[ c ], scale );
+				RandomPoints( &ends, counts[ c ], scale );
+				RandomPoints( &motions, counts[ c ], scale );
+				std::vector<double> radii;
+				for( size_t i = 0; i < counts[ c ]; i ++ )
+					radii.push_back( fabs( RandomDouble( scale ) ) );
+				
+				Pos3D end1( RandomDouble( scale ), RandomDouble( scale ), RandomDouble( scale ) );
+				Pos3D end2( RandomDouble( scale ), RandomDouble( scale ), RandomDouble( scale ) );
+				Vec3D motion1( RandomDouble( scale ), RandomDouble( scale ), RandomDouble( scale ) );
+				double dt = fabs( RandomDouble( 2. ) );
+				
+				TestPointsToLineSeg( pts, end1, end2 );
+				TestLineSegToLineSegs( end1, end2, pts, ends );
+				TestMovingPoints( end1, motion1, fabs( RandomDouble( scale ) ), pts, &motions, &radii, dt );
+				TestMovingPoints( end1, motion1, 0., pts, NULL, NULL, dt );
+			}
+		}
+	}
+	
+	
+	void EdgeCaseTests( void )
+	{
+		double values[] = { 0., -0., 1., -1., 0.5, 1e-300, -1e-300, DBL_MIN, DBL_EPSILON, 1e150, -1e150 };
+		size_t value_count = sizeof(values) / sizeof(values[ 0 ]);
+		
+		// Every combination of the special values, so each lands in both SIMD lanes and the scalar tail.
+		Points pts, motions;
+		for( size_t a = 0; a < value_count; a ++ )
+			for( size_t b = 0; b < value_count; b ++ )
+				for( size_t c = 0; c < value_count; c += 3 )
+				{
+					pts.Add( values[ a ], values[ b ], values[ c ] );
+					motions.Add( values[ b ], values[ c ], values[ a ] );
+				}
+		std::vector<double> radii( pts.Count(), 0. );
+		
+		Points shifted;
+		for( size_t i = 0; i < pts.Count(); i ++ )
+			shifted.Add( pts.Y[ i ], pts.Z[ i ], pts.X[ i ] );
+		
+		// Degenerate segments (both ends the same), axis-aligned ones, and points exactly on the segment.
+		Pos3D origin( 0., 0., 0. );
+		Pos3D unit_x( 1., 0., 0. );
+		Pos3D far_pt( 1e150, -1e150, 1e150 );
+		Pos3D tiny( 1e-300, 0., -1e-300 );
+		Pos3D segments[][ 2 ] = { { origin, origin }, { unit_x, unit_x }, { origin, unit_x }, { unit_x, origin }, { tiny, origin }, { far_pt, origin }, { far_pt, far_pt } };
+		size_t segment_count = sizeof(segments) / sizeof(segments[ 0 ]);
+		
+		Vec3D still( 0., 0., 0. );
+		Vec3D along_x( 1., 0., 0. );
+		Vec3D huge( 1e150, 1e150, -1e150 );
+		Vec3D moves[] = { still, along_x, huge };
+		double dts[] = { 0., 1., 0.5 };
+		
+		for( size_t s = 0; s < segment_count; s ++ )
+		{
+			TestPointsToLineSeg( pts, segments[ s ][ 0 ], segments[ s ][ 1 ] );
+			TestLineSegToLineSegs( segments[ s ][ 0 ], segments[ s ][ 1 ], pts, pts );
+			TestLineSegToLineSegs( segments[ s ][ 0 ], segments[ s ][ 1 ], pts, shifted );
+			
+			for( size_t m = 0; m < sizeof(moves) / sizeof(moves[ 0 ]); m ++ )
+				for( size_t d = 0; d < sizeof(dts) / sizeof(dts[ 0 ]); d ++ )
+				{
+					TestMovingPoints( segments[ s ][ 0 ], moves[ m ], 0., pts, &motions, &radii, dts[ d ] );
+					TestMovingPoints( segments[ s ][ 0 ], moves[ m ], 1., pts, NULL, &radii, dts[ d ] );
+				}
+		}
+		
+		// Moving exactly with the target leaves a zero-length relative path.
+		Points same_motion;
+		for( size_t i = 0; i < pts.Count(); i ++ )
+			same_motion.Add( 1., 0., 0. );
+		TestMovingPoints( origin, along_x, 0., pts, &same_motion, NULL, 1. );
+	}
+}
+
+
+int main( int argc, char **argv )
+{
+	unsigned int seed = (argc > 1) ? (unsigned int) strtoul( argv[ 1 ], NULL, 10 ) : 1;
+	srand( seed );
+	
+	RandomTests();
+	EdgeCaseTests();
+	
+	#if defined(__SSE2__) && ! defined(MATH3D_NO_SSE2)
+		const char *variant = "SSE2";
+	#else
+		const char *variant = "scalar";
+	#endif
+	
+	printf( "Math3DTest (%s, seed %u): %i checks, %i failures\n", variant, seed, Checks, Failures );
+	return Failures ? 1 : 0;
+}
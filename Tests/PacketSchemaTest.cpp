@@ -0,0 +1,95 @@
+/*
+ *  PacketSchemaTest.cpp
+ */
+
+// Checks that messages survive an encode/decode round trip, and that a list too long for its count type
+// fails the encode but still leaves a packet the other side can parse.
+// Build with the Makefile here.
+
+#include "PacketSchema.h"
+
+#include <cstdio>
+#include <string>
+#include <stdint.h>
+
+
+namespace
+{
+	int Failures = 0;
+	int Checks = 0;
+	
+	
+	void Check( const char *what, bool ok )
+	{
+		Checks ++;
+		if( ok )
+			return;
+		
+		Failures ++;
+		fprintf( stderr, "%s: failed\n", what );
+	}
+	
+	
+	class ListMessage
+	{
+	public:
+		enum { TYPE = 'Test' };
+		PacketList<uint16_t,uint8_t> Bytes;
+		PacketList<uint8_t,std::string> Names;
+		uint32_t After;
+		ListMessage( void ) { After = 0; }
+		template <class V> void Fields( V &v ) { v( Bytes ); v( Names ); v( After ); }
+	};
+	
+	
+	void RoundTripTest( void )
+	{
+		ListMessage sent;
+		for( int i = 0; i < 1000; i ++ )
+			sent.Bytes.push_back( i );
+		sent.Names.push_back( "alpha" );
+		sent.Names.push_back( "" );
+		sent.After = 0xDEADBEEF;
+		
+		Packet packet;
+		Check( "round trip encode", EncodePacket( &packet, &sent ) );
+		
+		ListMessage received;
+		Check( "round trip decode", DecodePacket( &packet, &received ) );
+		Check( "round trip bytes", received.Bytes == sent.Bytes );
+		Check( "round trip names", received.Names == sent.Names );
+		Check( "round trip after", received.After == sent.After );
+	}
+	
+	
+	void OverflowTest( void )
+	{
+		ListMessage sent;
+		for( int i = 0; i < 70000; i ++ )
+			sent.Bytes.push_back( i );
+		for( int i = 0; i < 300; i ++ )
+			sent.Names.push_back( "name" );
+		sent.After = 12345;
+		
+		Packet packet;
+		Check( "overflow encode fails", ! EncodePacket( &packet, &sent ) );
+		
+		// Each list is cut to the most its count can hold, and the fields after it still line up.
+		ListMessage received;
+		Check( "overflow decode", DecodePacket( &packet, &received ) );
+		Check( "overflow bytes count", received.Bytes.size() == 65535 );
+		Check( "overflow bytes values", received.Bytes.size() && (received.Bytes.back() == (uint8_t) 65534) );
+		Check( "overflow names count", received.Names.size() == 255 );
+		Check( "overflow after", received.After == 12345 );
+	}
+}
+
+
+int main( int argc, char **argv )
+{
+	RoundTripTest();
+	OverflowTest();
+	
+	printf( "PacketSchemaTest: %i checks, %i failures\n", Checks, Failures );
+	return Failures ? 1 : 0;
+}